@@ -53,7 +53,11 @@ typedef struct ape ape_t;
 typedef struct ape_object { uint64_t _internal; } ape_object_t;
 typedef struct ape_error ape_error_t;
 typedef struct ape_program ape_program_t;
+typedef struct ape_shared_program ape_shared_program_t;
+typedef struct ape_pool ape_pool_t;
+typedef struct ape_snapshot ape_snapshot_t;
 typedef struct ape_traceback ape_traceback_t;
+typedef struct ape_function_handle { int _type; int _index; } ape_function_handle_t;
 
 typedef enum ape_error_type {
     APE_ERROR_NONE = 0,
@@ -78,9 +82,22 @@ typedef enum ape_object_type {
     APE_OBJECT_FUNCTION        = 1 << 8,
     APE_OBJECT_EXTERNAL        = 1 << 9,
     APE_OBJECT_FREED           = 1 << 10,
+    APE_OBJECT_RANGE           = 1 << 11,
+    APE_OBJECT_TYPED_ARRAY     = 1 << 12,
+    APE_OBJECT_STRUCT          = 1 << 13,
+    APE_OBJECT_STRUCT_TYPE     = 1 << 14,
+    APE_OBJECT_SET             = 1 << 15,
     APE_OBJECT_ANY             = 0xffff, // for checking types with &
 } ape_object_type_t;
 
+typedef enum ape_typed_array_type {
+    APE_TYPED_ARRAY_U8,
+    APE_TYPED_ARRAY_I32,
+    APE_TYPED_ARRAY_I64,
+    APE_TYPED_ARRAY_F32,
+    APE_TYPED_ARRAY_F64,
+} ape_typed_array_type_t;
+
 typedef ape_object_t (*ape_native_fn)(ape_t *ape, void *data, int argc, ape_object_t *args);
 typedef void*        (*ape_malloc_fn)(void *ctx, size_t size);
 typedef void         (*ape_free_fn)(void *ctx, void *ptr);
@@ -91,6 +108,9 @@ typedef size_t (*ape_stdout_write_fn)(void* context, const void *data, size_t da
 typedef char*  (*ape_read_file_fn)(void* context, const char *path);
 typedef size_t (*ape_write_file_fn)(void* context, const char *path, const char *string, size_t string_size);
 
+typedef void (*ape_pool_setup_fn)(ape_t *ape, void *context);
+typedef void (*ape_pool_callback_fn)(ape_t *ape, ape_object_t result, void *context);
+
 //-----------------------------------------------------------------------------
 // Ape API
 //-----------------------------------------------------------------------------
@@ -102,6 +122,19 @@ void   ape_free_allocated(ape_t *ape, void *ptr);
 
 void ape_set_repl_mode(ape_t *ape, bool enabled);
 
+// Saves files compiled by ape_compile_file and imported modules next to them as .apec bytecode caches and loads
+// those instead of compiling while the files don't change. Caches depend on the builtins and native functions
+// set when they were saved. Only files importing modules before any other statement are cached. Cache files are
+// read and written directly, not with the file read and write functions.
+void ape_set_bytecode_cache(ape_t *ape, bool enabled);
+
+// Shares modules imported by instances with the module cache enabled between all of them (in any thread), so that
+// each module is compiled once per process while its file doesn't change. Like bytecode caches, cached modules
+// depend on the builtins and native functions set and only modules importing others before any other statement
+// are cached. Modules stay cached until ape_clear_module_cache is called.
+void ape_set_module_cache(ape_t *ape, bool enabled);
+void ape_clear_module_cache(void);
+
 // -1 to disable, returns false if it can't be set for current platform (otherwise true).
 // If execution time exceeds given limit an APE_ERROR_TIMEOUT error is set.
 // Precision is not guaranteed because time can't be checked every VM tick
@@ -117,9 +150,51 @@ ape_program_t* ape_compile_file(ape_t *ape, const char *path);
 ape_object_t   ape_execute_program(ape_t *ape, const ape_program_t *program);
 void           ape_program_destroy(ape_program_t *program);
 
+// Shared programs are compiled once and can be executed by any number of ape instances, also concurrently
+// from different threads as long as every instance is used by one thread at a time. Bytecode isn't copied
+// and constants live outside of any instance's GC heap.
+// Executing instances need the same native functions and constants as the compiling one (defined in the same
+// order) and can't compile or execute other code before executing the program, but can call its functions
+// afterwards. The compiling instance must outlive its shared programs and must not be used while they run,
+// shared programs must outlive the instances that executed them.
+ape_shared_program_t* ape_compile_shared(ape_t *ape, const char *code);
+ape_shared_program_t* ape_compile_file_shared(ape_t *ape, const char *path);
+ape_object_t          ape_execute_shared_program(ape_t *ape, const ape_shared_program_t *program);
+void                  ape_shared_program_destroy(ape_shared_program_t *program);
+
+// Snapshots save the state left by code an instance executed (its globals, global constants, native functions
+// and imported modules) so that new instances can start from it without compiling and running that code again.
+// Values reachable from globals are copied to the new instance's heap, keeping shared references and cycles,
+// and natives set with ape_set_native_function are set again with the same function and data. Values that
+// aren't data or ape functions (e.g. external objects) can't be saved. New instances get the same allocator and
+// configuration and can execute other code. Bytecode isn't copied, so the instance that made the snapshot must
+// outlive it, and the snapshot must outlive instances made from it. Snapshots can be used from multiple threads.
+ape_snapshot_t* ape_snapshot_make(ape_t *ape);
+ape_t*          ape_make_from_snapshot(const ape_snapshot_t *snapshot);
+void            ape_snapshot_destroy(ape_snapshot_t *snapshot);
+
+// Runs functions of shared programs on a fixed number of threads (0 for one per core). Every thread has its own
+// ape instance (isolate) per program, created on first use: setup is called on it (e.g. to register the same
+// native functions as the compiling instance) and then the program is executed once.
+// Arguments are serialized when submitting, so they can't be functions and changing them afterwards has no effect.
+// Only null, bools, numbers, strings, arrays, maps, sets and typed arrays can be passed, otherwise submit fails.
+// Callbacks are called on the worker's thread with its isolate, result is only valid until the callback returns
+// and ape is NULL if the isolate couldn't be made. Failed calls leave errors on ape (and result is null).
+// Destroying the pool waits for all submitted jobs, programs have to outlive it. Returns NULL if threads
+// aren't supported on the platform.
+ape_pool_t* ape_pool_make(int threads_count, ape_pool_setup_fn setup, void *setup_context);
+bool        ape_pool_submit(ape_pool_t *pool, const ape_shared_program_t *program, const char *function_name,
+                            int argc, ape_object_t *args, ape_pool_callback_fn callback, void *callback_context);
+void        ape_pool_wait(ape_pool_t *pool); // until all submitted jobs are done
+void        ape_pool_destroy(ape_pool_t *pool);
+
 ape_object_t  ape_execute(ape_t *ape, const char *code);
 ape_object_t  ape_execute_file(ape_t *ape, const char *path);
 
+// Calls can also be made from native functions, e.g. to call back a function passed to them as an argument.
+// Objects a native function creates before calling back aren't reachable by the GC unless they're
+// protected with ape_object_disable_gc. If the call fails the native function should return and its error
+// propagates to the ape code that called it (and can be recovered from there).
 ape_object_t  ape_call(ape_t *ape, const char *function_name, int argc, ape_object_t *args);
 #define APE_CALL(ape, function_name, ...) \
     ape_call(\
@@ -128,6 +203,26 @@ ape_object_t  ape_call(ape_t *ape, const char *function_name, int argc, ape_obje
         sizeof((ape_object_t[]){__VA_ARGS__}) / sizeof(ape_object_t),\
         (ape_object_t[]){__VA_ARGS__})
 
+ape_object_t  ape_call_object(ape_t *ape, ape_object_t callee, int argc, ape_object_t *args);
+#define APE_CALL_OBJECT(ape, callee, ...) \
+    ape_call_object(\
+        (ape),\
+        (callee),\
+        sizeof((ape_object_t[]){__VA_ARGS__}) / sizeof(ape_object_t),\
+        (ape_object_t[]){__VA_ARGS__})
+
+// Resolves function_name once so that hot loops can call it with ape_call_handle instead of ape_call.
+// A handle refers to the global, not to its value, so it stays valid if the global is reassigned.
+ape_function_handle_t ape_get_function_handle(ape_t *ape, const char *function_name);
+bool                  ape_function_handle_is_valid(ape_function_handle_t handle);
+ape_object_t          ape_call_handle(ape_t *ape, ape_function_handle_t handle, int argc, ape_object_t *args);
+#define APE_CALL_HANDLE(ape, handle, ...) \
+    ape_call_handle(\
+        (ape),\
+        (handle),\
+        sizeof((ape_object_t[]){__VA_ARGS__}) / sizeof(ape_object_t),\
+        (ape_object_t[]){__VA_ARGS__})
+
 void ape_set_runtime_error(ape_t *ape, const char *message);
 void ape_set_runtime_errorf(ape_t *ape, const char *format, ...) __attribute__ ((format (printf, 2, 3)));
 bool ape_has_errors(const ape_t *ape);
@@ -135,6 +230,10 @@ int  ape_errors_count(const ape_t *ape);
 void ape_clear_errors(ape_t *ape);
 const ape_error_t* ape_get_error(const ape_t *ape, int index);
 
+// Garbage is collected during execution once enough objects have been allocated since the last collection,
+// this frees everything that's unreachable right away, e.g. when the host is idle.
+void ape_collect_garbage(ape_t *ape);
+
 bool ape_set_native_function(ape_t *ape, const char *name, ape_native_fn fn, void *data);
 bool ape_set_global_constant(ape_t *ape, const char *name, ape_object_t obj);
 ape_object_t ape_get_object(ape_t *ape, const char *name);
@@ -154,6 +253,7 @@ bool ape_check_args(ape_t *ape, bool generate_error, int argc, ape_object_t *arg
 //-----------------------------------------------------------------------------
 
 ape_object_t ape_object_make_number(double val);
+ape_object_t ape_object_make_int(ape_t *ape, int64_t val); // ints outside +-2^47 are allocated
 ape_object_t ape_object_make_bool(bool val);
 ape_object_t ape_object_make_null(void);
 ape_object_t ape_object_make_string(ape_t *ape, const char *str);
@@ -173,6 +273,7 @@ void ape_object_enable_gc(ape_object_t obj);
 bool ape_object_equals(ape_object_t a, ape_object_t b);
 
 bool ape_object_is_null(ape_object_t obj);
+bool ape_object_is_int(ape_object_t obj);
 
 ape_object_t ape_object_copy(ape_object_t obj);
 ape_object_t ape_object_deep_copy(ape_object_t obj);
@@ -182,6 +283,7 @@ const char*       ape_object_get_type_string(ape_object_t obj);
 const char*       ape_object_get_type_name(ape_object_type_t type);
 
 double       ape_object_get_number(ape_object_t obj);
+int64_t      ape_object_get_int(ape_object_t obj);
 bool         ape_object_get_bool(ape_object_t obj);
 const char * ape_object_get_string(ape_object_t obj);
 
@@ -212,6 +314,22 @@ bool ape_object_add_array_string(ape_object_t object, const char *string);
 bool ape_object_add_array_number(ape_object_t object, double number);
 bool ape_object_add_array_bool(ape_object_t object, bool value);
 
+//-----------------------------------------------------------------------------
+// Ape object typed array
+//-----------------------------------------------------------------------------
+
+// Items are stored contiguously as native values (uint8_t, int32_t, int64_t, float or double).
+// ape_object_get_typed_array_data returns that storage without copying, writes to it are visible to scripts.
+ape_object_t ape_object_make_typed_array(ape_t *ape, ape_typed_array_type_t type, int length); // zero filled
+// Wraps host memory without copying, data must stay valid until destroy_fn (can be NULL) is called with it
+// when the object is freed.
+ape_object_t ape_object_make_typed_array_with_data(ape_t *ape, ape_typed_array_type_t type, void *data, int length,
+                                                   ape_data_destroy_fn destroy_fn);
+
+int                    ape_object_get_typed_array_length(ape_object_t obj);
+ape_typed_array_type_t ape_object_get_typed_array_type(ape_object_t obj);
+void*                  ape_object_get_typed_array_data(ape_object_t obj);
+
 //-----------------------------------------------------------------------------
 // Ape object map
 //-----------------------------------------------------------------------------
@@ -2,11 +2,14 @@
 #include <time.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 
 #define ARRAY_LEN(array) (int)(sizeof(array) / sizeof(array[0]))
 #include "ape.h"
 
 static bool execute_file(const char *filename, bool must_succeed);
+static void benchmark_api_calls(void);
+static void benchmark_api_calls_large_heap(void);
 static void *counted_malloc(void *ctx, size_t size);
 static void counted_free(void *ctx, void *ptr);
 static void print_ape_errors(ape_t *ape);
@@ -31,6 +34,21 @@ int main(int argc, char *argv[]) {
             "raytracer_profile_optimised.ape",
             "primes.ape",
             "fibonacci.ape",
+            "serialize_numbers.ape",
+            "native_sort.ape",
+            "higher_order.ape",
+            "range_loop.ape",
+            "small_maps.ape",
+            "numeric_arrays.ape",
+            "int_hash.ape",
+            "raytracer_structs.ape",
+            "sets.ape",
+            "sets_with_maps.ape",
+            "deque.ape",
+            "copies.ape",
+            "map_churn.ape",
+            "api_calls", // not a file, calls an ape function from C
+            "api_calls_large_heap", // not a file, same as api_calls with many live objects
         };
         int tests_len = ARRAY_LEN(tests);
 #endif
@@ -44,7 +62,13 @@ int main(int argc, char *argv[]) {
         g_alloc_data.total_malloc_count = 0;
         printf("Benchmarking %s: \n", test);
         clock_t start = clock();
-        execute_file(test, true);
+        if (strcmp(test, "api_calls") == 0) {
+            benchmark_api_calls();
+        } else if (strcmp(test, "api_calls_large_heap") == 0) {
+            benchmark_api_calls_large_heap();
+        } else {
+            execute_file(test, true);
+        }
         clock_t end = clock();
         float seconds = (float)(end - start) / CLOCKS_PER_SEC;
         printf("\tTime: %1.3g seconds\n", (double)seconds);
@@ -73,6 +97,68 @@ static bool execute_file(const char *filename, bool must_succeed) {
     return true;
 }
 
+static void benchmark_api_calls(void) {
+    const int calls_count = 2000000;
+    ape_t *ape = ape_make_ex(counted_malloc, counted_free, &g_alloc_data);
+    ape_execute(ape, "fn handle(a, b) { return a + b }");
+    assert(!ape_has_errors(ape));
+
+    clock_t start = clock();
+    double acc = 0;
+    for (int i = 0; i < calls_count; i++) {
+        ape_object_t res = APE_CALL(ape, "handle", ape_object_make_number(i), ape_object_make_number(1));
+        acc += ape_object_get_number(res);
+    }
+    float seconds = (float)(clock() - start) / CLOCKS_PER_SEC;
+    printf("\tape_call: %1.3g calls/second\n", calls_count / (double)seconds);
+
+    ape_function_handle_t handle = ape_get_function_handle(ape, "handle");
+    assert(ape_function_handle_is_valid(handle));
+    start = clock();
+    for (int i = 0; i < calls_count; i++) {
+        ape_object_t res = APE_CALL_HANDLE(ape, handle, ape_object_make_number(i), ape_object_make_number(1));
+        acc -= ape_object_get_number(res);
+    }
+    seconds = (float)(clock() - start) / CLOCKS_PER_SEC;
+    printf("\tape_call_handle: %1.3g calls/second\n", calls_count / (double)seconds);
+
+    if (ape_has_errors(ape)) {
+        print_ape_errors(ape);
+        assert(false);
+    }
+    assert(acc == 0);
+    ape_destroy(ape);
+}
+
+static void benchmark_api_calls_large_heap(void) {
+    const int calls_count = 100000;
+    ape_t *ape = ape_make_ex(counted_malloc, counted_free, &g_alloc_data);
+    ape_execute(ape,
+        "var heap = []\n"
+        "for (var i = 0; i < 200000; i++) { append(heap, {\"id\": i, \"tags\": [to_str(i)]}) }\n"
+        "fn handle(a) { return heap[a][\"id\"] }\n");
+    assert(!ape_has_errors(ape));
+
+    ape_function_handle_t handle = ape_get_function_handle(ape, "handle");
+    assert(ape_function_handle_is_valid(handle));
+    clock_t start = clock();
+    double acc = 0;
+    for (int i = 0; i < calls_count; i++) {
+        ape_object_t res = APE_CALL_HANDLE(ape, handle, ape_object_make_number(i));
+        acc += ape_object_get_number(res);
+    }
+    float seconds = (float)(clock() - start) / CLOCKS_PER_SEC;
+    printf("\tape_call_handle: %1.3g calls/second\n", calls_count / (double)seconds);
+
+    if (ape_has_errors(ape)) {
+        print_ape_errors(ape);
+        assert(false);
+    }
+    assert(acc == (calls_count - 1) * (calls_count / 2.0));
+    ape_collect_garbage(ape);
+    ape_destroy(ape);
+}
+
 static void *counted_malloc(void *ctx, size_t size) {
     alloc_data_t *alloc_data = (alloc_data_t*)ctx;
     if (size == 0) {
@@ -22,4 +22,19 @@ echo "Running benchmarks"
 ./benchmarks raytracer_profile_optimised.ape
 ./benchmarks primes.ape
 ./benchmarks fibonacci.ape
+./benchmarks serialize_numbers.ape
+./benchmarks native_sort.ape
+./benchmarks higher_order.ape
+./benchmarks range_loop.ape
+./benchmarks small_maps.ape
+./benchmarks numeric_arrays.ape
+./benchmarks int_hash.ape
+./benchmarks raytracer_structs.ape
+./benchmarks sets.ape
+./benchmarks sets_with_maps.ape
+./benchmarks deque.ape
+./benchmarks copies.ape
+./benchmarks map_churn.ape
+./benchmarks api_calls
+./benchmarks api_calls_large_heap
 echo "    OK"
@@ -5,6 +5,8 @@
 #include "ape.h"
 
 static ape_object_t external_add(ape_t *ape, void *data, int argc, ape_object_t *args);
+static ape_object_t external_call_twice(ape_t *ape, void *data, int argc, ape_object_t *args);
+static void print_square(ape_t *ape, ape_object_t result, void *context);
 
 //分割： 源代码为多个 utils/split.py --input ape.c --output-path ape
 int main() {
@@ -17,11 +19,23 @@ int main() {
                                 ape_object_make_number(42));
     assert(ape_object_get_number(res) == 84);
 
+    // Resolving a function once when calling it many times
+    ape_function_handle_t add_handle = ape_get_function_handle(ape, "add");
+    for (int i = 0; i < 10; i++) {
+        res = APE_CALL_HANDLE(ape, add_handle, ape_object_make_number(i), ape_object_make_number(1));
+        assert(ape_object_get_number(res) == i + 1);
+    }
+
     // Calling C functions from Ape code
     ape_set_native_function(ape, "external_add", external_add, NULL);
     ape_execute(ape, "assert(external_add(42, 42) == 84)");
     assert(!ape_has_errors(ape));
 
+    // Calling back into Ape code from C functions
+    ape_set_native_function(ape, "external_call_twice", external_call_twice, NULL);
+    ape_execute(ape, "assert(external_call_twice(fn(x) { return x * 2 }, 3) == 12)");
+    assert(!ape_has_errors(ape));
+
     // Handling errors
     ape_execute(ape, "external_add()");
     assert(ape_has_errors(ape));
@@ -32,6 +46,44 @@ int main() {
         ape_free_allocated(ape, err_string);
     }
 
+    // Compiling once and running on many instances (e.g. one per thread)
+    ape_t *template_ape = ape_make();
+    ape_shared_program_t *program = ape_compile_shared(template_ape, "fn square(x) { return x * x }");
+    for (int i = 0; i < 3; i++) {
+        ape_t *instance = ape_make();
+        ape_execute_shared_program(instance, program);
+        res = APE_CALL(instance, "square", ape_object_make_number(i));
+        assert(ape_object_get_number(res) == i * i);
+        ape_destroy(instance);
+    }
+
+    // Running calls on all cores, every thread gets its own instance
+    ape_pool_t *pool = ape_pool_make(0, NULL, NULL);
+    if (pool) {
+        for (int i = 0; i < 3; i++) {
+            ape_object_t arg = ape_object_make_number(i);
+            ape_pool_submit(pool, program, "square", 1, &arg, print_square, NULL);
+        }
+        ape_pool_destroy(pool); // waits for the calls
+    }
+
+    ape_shared_program_destroy(program);
+    ape_destroy(template_ape);
+
+    // Initialising once and starting new instances from the initialised state
+    ape_t *init_ape = ape_make();
+    ape_execute(init_ape, "var squares = []\nfor (var i = 0; i < 100; i += 1) { append(squares, i * i) }\n"
+                          "fn get_square(x) { return squares[x] }");
+    ape_snapshot_t *snapshot = ape_snapshot_make(init_ape);
+    for (int i = 0; i < 3; i++) {
+        ape_t *instance = ape_make_from_snapshot(snapshot);
+        res = APE_CALL(instance, "get_square", ape_object_make_number(9));
+        assert(ape_object_get_number(res) == 81);
+        ape_destroy(instance);
+    }
+    ape_snapshot_destroy(snapshot);
+    ape_destroy(init_ape);
+
     ape_destroy(ape);
     return 0;
 }
@@ -47,3 +99,22 @@ static ape_object_t external_add(ape_t *ape, void *data, int argc, ape_object_t
 
     return ape_object_make_number(a + b);
 }
+
+static ape_object_t external_call_twice(ape_t *ape, void *data, int argc, ape_object_t *args) {
+    if (!APE_CHECK_ARGS(ape, true, argc, args, APE_OBJECT_FUNCTION, APE_OBJECT_ANY)) {
+        return ape_object_make_null();
+    }
+
+    ape_object_t res = APE_CALL_OBJECT(ape, args[0], args[1]);
+    if (ape_has_errors(ape)) {
+        return ape_object_make_null(); // the error is reported to (or recovered by) the caller
+    }
+    return APE_CALL_OBJECT(ape, args[0], res);
+}
+
+static void print_square(ape_t *ape, ape_object_t result, void *context) {
+    // Called on one of the pool's threads
+    if (ape && !ape_has_errors(ape)) {
+        printf("square: %g\n", ape_object_get_number(result));
+    }
+}
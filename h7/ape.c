@@ -26,6 +26,12 @@
 #include "symbol_table.h"
 #include "traceback.h"
 #include "global_store.h"
+#include "message.h"
+#include "module_cache.h"
+#endif
+
+#if defined(APE_POSIX)
+#include <pthread.h>
 #endif
 
 typedef struct native_fn_wrapper {
@@ -39,6 +45,31 @@ typedef struct ape_program {
     compilation_result_t *comp_res;
 } ape_program_t;
 
+typedef struct ape_shared_program {
+    ape_t *ape; // compiled the program, function constants still point to its compilation results
+    compilation_result_t *comp_res;
+    array(object_t) *constants; // static copies of ape's constants, see object_make_static_copy
+    compiler_globals_t *compiler_globals;
+} ape_shared_program_t;
+
+typedef struct ape_snapshot_global {
+    char *name;
+    bool is_native; // set with ape_set_native_function, made again for every new instance
+    ape_native_fn native_fn;
+    void *native_data;
+} ape_snapshot_global_t;
+
+typedef struct ape_snapshot {
+    ape_t *ape; // made the snapshot, functions still point to its compilation results
+    ape_config_t config;
+    array(object_t) *constants; // static copies of ape's constants, see object_make_static_copy
+    compiler_globals_t *compiler_globals;
+    array(ape_snapshot_global_t) *ape_globals; // in global store order
+    int globals_count;
+    array(uint8_t) *heap; // message with values of ape globals that aren't natives and module globals
+    uint64_t random_state;
+} ape_snapshot_t;
+
 typedef struct ape {
     allocator_t alloc;
     gcmem_t *mem;
@@ -51,15 +82,27 @@ typedef struct ape {
 
     allocator_t custom_allocator;
 
+    int shared_programs_count; // compiled by this instance
+    int snapshots_count; // made from this instance
+    const ape_shared_program_t *shared_program; // adopted by this instance
 } ape_t;
 
 static void ape_deinit(ape_t *ape);
+static ape_shared_program_t* make_shared_program(ape_t *ape, compilation_result_t *comp_res);
+static array(object_t)* make_static_constants(ape_t *ape);
+static void destroy_static_constants(ape_t *ape, array(object_t) *constants);
+static bool snapshot_write_globals(ape_snapshot_t *snapshot);
+static bool snapshot_read_globals(const ape_snapshot_t *snapshot, ape_t *ape);
+static const char* get_module_global_name(ape_t *ape, int ix);
 static object_t ape_native_fn_wrapper(vm_t *vm, void *data, int argc, object_t *args);
 static object_t ape_object_to_object(ape_object_t obj);
 static ape_object_t object_to_ape_object(object_t obj);
+static bool typed_array_type_from_ape(ape_typed_array_type_t type, typed_array_type_t *out_type);
 static ape_object_t ape_object_make_native_function_with_name(ape_t *ape, const char *name, ape_native_fn fn, void *data);
 
 static void reset_state(ape_t *ape);
+static void reset_state_for_call(ape_t *ape);
+static ape_object_t call_ape_object(ape_t *ape, object_t callee, int argc, ape_object_t *args);
 static void set_default_config(ape_t *ape);
 static char* read_file_default(void *ctx, const char *filename);
 static size_t write_file_default(void* context, const char *path, const char *string, size_t string_size);
@@ -140,6 +183,18 @@ void ape_set_repl_mode(ape_t *ape, bool enabled) {
     ape->config.repl_mode = enabled;
 }
 
+void ape_set_bytecode_cache(ape_t *ape, bool enabled) {
+    ape->config.bytecode_cache = enabled;
+}
+
+void ape_set_module_cache(ape_t *ape, bool enabled) {
+    ape->config.module_cache = enabled;
+}
+
+void ape_clear_module_cache(void) {
+    module_cache_clear();
+}
+
 bool ape_set_timeout(ape_t *ape, double max_execution_time_ms) {
     if (!ape_timer_platform_supported()) {
         ape->config.max_execution_time_ms = 0;
@@ -250,6 +305,145 @@ void ape_program_destroy(ape_program_t *program) {
     allocator_free(&program->ape->alloc, program);
 }
 
+ape_shared_program_t* ape_compile_shared(ape_t *ape, const char *code) {
+    ape_clear_errors(ape);
+
+    compilation_result_t *comp_res = compiler_compile(ape->compiler, code);
+    if (!comp_res || errors_get_count(&ape->errors) > 0) {
+        compilation_result_destroy(comp_res);
+        return NULL;
+    }
+    return make_shared_program(ape, comp_res);
+}
+
+ape_shared_program_t* ape_compile_file_shared(ape_t *ape, const char *path) {
+    ape_clear_errors(ape);
+
+    compilation_result_t *comp_res = compiler_compile_file(ape->compiler, path);
+    if (!comp_res || errors_get_count(&ape->errors) > 0) {
+        compilation_result_destroy(comp_res);
+        return NULL;
+    }
+    return make_shared_program(ape, comp_res);
+}
+
+ape_object_t ape_execute_shared_program(ape_t *ape, const ape_shared_program_t *program) {
+    reset_state(ape);
+
+    if (ape != program->ape && ape->shared_program != program) {
+        if (!global_store_has_symbols_of(ape->global_store, program->ape->global_store)) {
+            errors_add_error(&ape->errors, ERROR_USER, src_pos_invalid,
+                             "ape instance doesn't define the same native functions and constants as the one that compiled the program");
+            return ape_object_make_null();
+        }
+        bool ok = compiler_define_shared_globals(ape->compiler, program->compiler_globals, program->constants);
+        if (!ok) {
+            errors_add_error(&ape->errors, ERROR_USER, src_pos_invalid,
+                             "shared program can't be executed by an ape instance that has already compiled other code");
+            return ape_object_make_null();
+        }
+        ape->shared_program = program;
+    }
+
+    bool ok = vm_run(ape->vm, program->comp_res, compiler_get_constants(ape->compiler));
+    if (!ok || errors_get_count(&ape->errors) > 0) {
+        return ape_object_make_null();
+    }
+
+    APE_ASSERT(ape->vm->sp == 0);
+
+    object_t res = vm_get_last_popped(ape->vm);
+    if (object_get_type(res) == OBJECT_NONE) {
+        return ape_object_make_null();
+    }
+
+    return object_to_ape_object(res);
+}
+
+void ape_shared_program_destroy(ape_shared_program_t *program) {
+    if (!program) {
+        return;
+    }
+    ape_t *ape = program->ape;
+    destroy_static_constants(ape, program->constants);
+    compiler_globals_destroy(program->compiler_globals);
+    compilation_result_destroy(program->comp_res);
+    allocator_free(&ape->alloc, program);
+    ape->shared_programs_count--;
+}
+
+ape_snapshot_t* ape_snapshot_make(ape_t *ape) {
+    ape_clear_errors(ape);
+    if (ape->vm->running) {
+        errors_add_error(&ape->errors, ERROR_USER, src_pos_invalid, "Snapshot can't be made while ape is running");
+        return NULL;
+    }
+
+    ape_snapshot_t *snapshot = allocator_malloc(&ape->alloc, sizeof(ape_snapshot_t));
+    if (!snapshot) {
+        return NULL;
+    }
+    memset(snapshot, 0, sizeof(ape_snapshot_t));
+    snapshot->ape = ape;
+    snapshot->config = ape->config;
+    snapshot->random_state = ape->vm->random_state;
+    ape->snapshots_count++;
+
+    snapshot->constants = make_static_constants(ape);
+    if (!snapshot->constants) {
+        goto err;
+    }
+    snapshot->compiler_globals = compiler_copy_globals(ape->compiler);
+    if (!snapshot->compiler_globals) {
+        goto err;
+    }
+    snapshot->ape_globals = array_make(&ape->alloc, ape_snapshot_global_t);
+    snapshot->heap = array_make(&ape->alloc, uint8_t);
+    if (!snapshot->ape_globals || !snapshot->heap) {
+        goto err;
+    }
+    if (!snapshot_write_globals(snapshot)) {
+        goto err;
+    }
+    return snapshot;
+err:
+    ape_snapshot_destroy(snapshot);
+    return NULL;
+}
+
+ape_t* ape_make_from_snapshot(const ape_snapshot_t *snapshot) {
+    const allocator_t *custom_alloc = &snapshot->ape->custom_allocator;
+    ape_t *ape = ape_make_ex((ape_malloc_fn)custom_alloc->malloc, (ape_free_fn)custom_alloc->free, custom_alloc->ctx);
+    if (!ape) {
+        return NULL;
+    }
+    ape->config = snapshot->config;
+    ape->vm->random_state = snapshot->random_state;
+    bool ok = compiler_define_shared_globals(ape->compiler, snapshot->compiler_globals, snapshot->constants);
+    if (!ok || !snapshot_read_globals(snapshot, ape)) {
+        ape_destroy(ape);
+        return NULL;
+    }
+    return ape;
+}
+
+void ape_snapshot_destroy(ape_snapshot_t *snapshot) {
+    if (!snapshot) {
+        return;
+    }
+    ape_t *ape = snapshot->ape;
+    destroy_static_constants(ape, snapshot->constants);
+    compiler_globals_destroy(snapshot->compiler_globals);
+    for (int i = 0; i < array_count(snapshot->ape_globals); i++) {
+        ape_snapshot_global_t *global = array_get(snapshot->ape_globals, i);
+        allocator_free(&ape->alloc, global->name);
+    }
+    array_destroy(snapshot->ape_globals);
+    array_destroy(snapshot->heap);
+    allocator_free(&ape->alloc, snapshot);
+    ape->snapshots_count--;
+}
+
 ape_object_t ape_execute(ape_t *ape, const char *code) {
     reset_state(ape);
 
@@ -313,17 +507,59 @@ err:
 }
 
 ape_object_t ape_call(ape_t *ape, const char *function_name, int argc, ape_object_t *args) {
-    reset_state(ape);
+    reset_state_for_call(ape);
 
     object_t callee = ape_object_to_object(ape_get_object(ape, function_name));
     if (object_get_type(callee) == OBJECT_NULL) {
         return ape_object_make_null();
     }
-    object_t res = vm_call(ape->vm, compiler_get_constants(ape->compiler), callee, argc, (object_t*)args);
-    if (errors_get_count(&ape->errors) > 0) {
+    return call_ape_object(ape, callee, argc, args);
+}
+
+ape_object_t ape_call_object(ape_t *ape, ape_object_t callee, int argc, ape_object_t *args) {
+    reset_state_for_call(ape);
+    return call_ape_object(ape, ape_object_to_object(callee), argc, args);
+}
+
+ape_function_handle_t ape_get_function_handle(ape_t *ape, const char *function_name) {
+    ape_function_handle_t handle = { SYMBOL_NONE, -1 };
+    object_t callee = ape_object_to_object(ape_get_object(ape, function_name));
+    object_type_t type = object_get_type(callee);
+    if (type == OBJECT_NULL) {
+        return handle;
+    }
+    if (!(type & (OBJECT_FUNCTION | OBJECT_NATIVE_FUNCTION | OBJECT_STRUCT_TYPE))) {
+        errors_add_errorf(&ape->errors, ERROR_USER, src_pos_invalid, "Symbol \"%s\" is not callable", function_name);
+        return handle;
+    }
+    symbol_table_t *st = compiler_get_symbol_table(ape->compiler);
+    const symbol_t *symbol = symbol_table_resolve(st, function_name);
+    handle._type = symbol->type;
+    handle._index = symbol->index;
+    return handle;
+}
+
+bool ape_function_handle_is_valid(ape_function_handle_t handle) {
+    return handle._type != SYMBOL_NONE;
+}
+
+ape_object_t ape_call_handle(ape_t *ape, ape_function_handle_t handle, int argc, ape_object_t *args) {
+    // vm_call restores the stack and frames itself, so unlike ape_call there's no need for vm_reset
+    if (!ape->vm->running) {
+        ape_clear_errors(ape);
+    }
+
+    object_t callee = object_make_null();
+    if (handle._type == SYMBOL_MODULE_GLOBAL) {
+        callee = vm_get_global(ape->vm, handle._index);
+    } else if (handle._type == SYMBOL_APE_GLOBAL) {
+        bool ok = false;
+        callee = global_store_get_object_at(ape->global_store, handle._index, &ok);
+    } else {
+        errors_add_error(&ape->errors, ERROR_USER, src_pos_invalid, "Invalid function handle");
         return ape_object_make_null();
     }
-    return object_to_ape_object(res);
+    return call_ape_object(ape, callee, argc, args);
 }
 
 bool ape_has_errors(const ape_t *ape) {
@@ -342,6 +578,10 @@ const ape_error_t* ape_get_error(const ape_t *ape, int index) {
     return (const ape_error_t*)errors_getc(&ape->errors, index);
 }
 
+void ape_collect_garbage(ape_t *ape) {
+    vm_collect_garbage(ape->vm, compiler_get_constants(ape->compiler));
+}
+
 bool ape_set_native_function(ape_t *ape, const char *name, ape_native_fn fn, void *data) {
     ape_object_t obj = ape_object_make_native_function_with_name(ape, name, fn, data);
     if (ape_object_is_null(obj)) {
@@ -410,6 +650,10 @@ ape_object_t ape_object_make_number(double val) {
     return object_to_ape_object(object_make_number(val));
 }
 
+ape_object_t ape_object_make_int(ape_t *ape, int64_t val) {
+    return object_to_ape_object(object_make_int(ape->mem, val));
+}
+
 ape_object_t ape_object_make_bool(bool val) {
     return object_to_ape_object(object_make_bool(val));
 }
@@ -503,9 +747,16 @@ bool ape_object_is_null(ape_object_t obj) {
     return ape_object_get_type(obj) == APE_OBJECT_NULL;
 }
 
+bool ape_object_is_int(ape_object_t obj) {
+    return object_is_int(ape_object_to_object(obj));
+}
+
 ape_object_t ape_object_copy(ape_object_t ape_obj) {
     object_t obj = ape_object_to_object(ape_obj);
     gcmem_t *mem = object_get_mem(obj);
+    if (!mem) {
+        return ape_obj; // constants of shared programs are immutable
+    }
     object_t res = object_copy(mem, obj);
     return object_to_ape_object(res);
 }
@@ -513,6 +764,9 @@ ape_object_t ape_object_copy(ape_object_t ape_obj) {
 ape_object_t ape_object_deep_copy(ape_object_t ape_obj) {
     object_t obj = ape_object_to_object(ape_obj);
     gcmem_t *mem = object_get_mem(obj);
+    if (!mem) {
+        return ape_obj; // constants of shared programs are immutable
+    }
     object_t res = object_deep_copy(mem, obj);
     return object_to_ape_object(res);
 }
@@ -551,6 +805,11 @@ ape_object_type_t ape_object_get_type(ape_object_t ape_obj) {
         case OBJECT_FUNCTION:        return APE_OBJECT_FUNCTION;
         case OBJECT_EXTERNAL:        return APE_OBJECT_EXTERNAL;
         case OBJECT_FREED:           return APE_OBJECT_FREED;
+        case OBJECT_RANGE:           return APE_OBJECT_RANGE;
+        case OBJECT_TYPED_ARRAY:     return APE_OBJECT_TYPED_ARRAY;
+        case OBJECT_STRUCT:          return APE_OBJECT_STRUCT;
+        case OBJECT_STRUCT_TYPE:     return APE_OBJECT_STRUCT_TYPE;
+        case OBJECT_SET:             return APE_OBJECT_SET;
         case OBJECT_ANY:             return APE_OBJECT_ANY;
         default:                     return APE_OBJECT_NONE;
     }
@@ -574,6 +833,11 @@ const char* ape_object_get_type_name(ape_object_type_t type) {
         case APE_OBJECT_FUNCTION:        return "FUNCTION";
         case APE_OBJECT_EXTERNAL:        return "EXTERNAL";
         case APE_OBJECT_FREED:           return "FREED";
+        case APE_OBJECT_RANGE:           return "RANGE";
+        case APE_OBJECT_TYPED_ARRAY:     return "TYPED_ARRAY";
+        case APE_OBJECT_STRUCT:          return "STRUCT";
+        case APE_OBJECT_STRUCT_TYPE:     return "STRUCT_TYPE";
+        case APE_OBJECT_SET:             return "SET";
         case APE_OBJECT_ANY:             return "ANY";
         default:                         return "NONE";
     }
@@ -583,6 +847,10 @@ double ape_object_get_number(ape_object_t obj) {
     return object_get_number(ape_object_to_object(obj));
 }
 
+int64_t ape_object_get_int(ape_object_t obj) {
+    return object_get_int(ape_object_to_object(obj));
+}
+
 bool ape_object_get_bool(ape_object_t obj) {
     return object_get_bool(ape_object_to_object(obj));
 }
@@ -695,6 +963,47 @@ bool ape_object_add_array_bool(ape_object_t obj, bool value) {
     return ape_object_add_array_value(obj, object_to_ape_object(new_value));
 }
 
+//-----------------------------------------------------------------------------
+// Ape object typed array
+//-----------------------------------------------------------------------------
+
+ape_object_t ape_object_make_typed_array(ape_t *ape, ape_typed_array_type_t ape_type, int length) {
+    typed_array_type_t type;
+    if (length < 0 || !typed_array_type_from_ape(ape_type, &type)) {
+        return ape_object_make_null();
+    }
+    return object_to_ape_object(object_make_typed_array(ape->mem, type, length));
+}
+
+ape_object_t ape_object_make_typed_array_with_data(ape_t *ape, ape_typed_array_type_t ape_type, void *data, int length,
+                                                   ape_data_destroy_fn destroy_fn) {
+    typed_array_type_t type;
+    if (length < 0 || (!data && length > 0) || !typed_array_type_from_ape(ape_type, &type)) {
+        return ape_object_make_null();
+    }
+    object_t res = object_make_typed_array_with_data(ape->mem, type, data, length, (external_data_destroy_fn)destroy_fn);
+    return object_to_ape_object(res);
+}
+
+int ape_object_get_typed_array_length(ape_object_t obj) {
+    return object_get_typed_array_length(ape_object_to_object(obj));
+}
+
+ape_typed_array_type_t ape_object_get_typed_array_type(ape_object_t obj) {
+    switch (object_get_typed_array_type(ape_object_to_object(obj))) {
+        case TYPED_ARRAY_U8:  return APE_TYPED_ARRAY_U8;
+        case TYPED_ARRAY_I32: return APE_TYPED_ARRAY_I32;
+        case TYPED_ARRAY_I64: return APE_TYPED_ARRAY_I64;
+        case TYPED_ARRAY_F32: return APE_TYPED_ARRAY_F32;
+        case TYPED_ARRAY_F64: return APE_TYPED_ARRAY_F64;
+    }
+    return APE_TYPED_ARRAY_U8;
+}
+
+void* ape_object_get_typed_array_data(ape_object_t obj) {
+    return object_get_typed_array_data(ape_object_to_object(obj));
+}
+
 //-----------------------------------------------------------------------------
 // Ape object map
 //-----------------------------------------------------------------------------
@@ -972,10 +1281,314 @@ const char* ape_traceback_get_function_name(const ape_traceback_t *ape_traceback
     return item->function_name;
 }
 
+//-----------------------------------------------------------------------------
+// Ape pool
+//-----------------------------------------------------------------------------
+#if defined(APE_POSIX)
+
+typedef struct ape_pool_job {
+    const ape_shared_program_t *program;
+    char *function_name;
+    int argc;
+    array(uint8_t) *args; // serialized on the submitting thread, see message_write
+    ape_pool_callback_fn callback;
+    void *callback_context;
+    struct ape_pool_job *next;
+} ape_pool_job_t;
+
+typedef struct ape_pool_isolate {
+    const ape_shared_program_t *program;
+    ape_t *ape;
+} ape_pool_isolate_t;
+
+typedef struct ape_pool_worker {
+    ape_pool_t *pool;
+    pthread_t thread;
+    array(ape_pool_isolate_t) *isolates; // one per program, only touched by the worker's thread
+} ape_pool_worker_t;
+
+typedef struct ape_pool {
+    allocator_t alloc;
+    pthread_mutex_t mutex;
+    pthread_cond_t job_added;
+    pthread_cond_t jobs_done;
+    ape_pool_job_t *first_job;
+    ape_pool_job_t *last_job;
+    int pending_jobs_count; // queued and running
+    bool stopping;
+    ape_pool_worker_t *workers;
+    int workers_count;
+    ape_pool_setup_fn setup;
+    void *setup_context;
+} ape_pool_t;
+
+static void* pool_worker_run(void *arg);
+static void pool_run_job(ape_pool_worker_t *worker, ape_pool_job_t *job);
+static ape_t* pool_get_isolate(ape_pool_worker_t *worker, const ape_shared_program_t *program);
+static void pool_job_destroy(ape_pool_t *pool, ape_pool_job_t *job);
+static void pool_stop(ape_pool_t *pool, int started_workers_count);
+
+ape_pool_t* ape_pool_make(int threads_count, ape_pool_setup_fn setup, void *setup_context) {
+    if (threads_count <= 0) {
+        threads_count = (int)sysconf(_SC_NPROCESSORS_ONLN);
+        threads_count = threads_count > 0 ? threads_count : 1;
+    }
+
+    allocator_t alloc = allocator_make(NULL, NULL, NULL);
+    ape_pool_t *pool = allocator_malloc(&alloc, sizeof(ape_pool_t));
+    if (!pool) {
+        return NULL;
+    }
+    memset(pool, 0, sizeof(ape_pool_t));
+    pool->alloc = alloc;
+    pool->setup = setup;
+    pool->setup_context = setup_context;
+    pool->workers = allocator_malloc(&pool->alloc, sizeof(ape_pool_worker_t) * threads_count);
+    if (!pool->workers) {
+        allocator_free(&alloc, pool);
+        return NULL;
+    }
+    memset(pool->workers, 0, sizeof(ape_pool_worker_t) * threads_count);
+    pool->workers_count = threads_count;
+
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_cond_init(&pool->job_added, NULL);
+    pthread_cond_init(&pool->jobs_done, NULL);
+
+    for (int i = 0; i < threads_count; i++) {
+        ape_pool_worker_t *worker = &pool->workers[i];
+        worker->pool = pool;
+        worker->isolates = array_make(&pool->alloc, ape_pool_isolate_t);
+        if (!worker->isolates || pthread_create(&worker->thread, NULL, pool_worker_run, worker) != 0) {
+            array_destroy(worker->isolates);
+            worker->isolates = NULL;
+            pool_stop(pool, i);
+            return NULL;
+        }
+    }
+    return pool;
+}
+
+bool ape_pool_submit(ape_pool_t *pool, const ape_shared_program_t *program, const char *function_name,
+                     int argc, ape_object_t *args, ape_pool_callback_fn callback, void *callback_context) {
+    ape_pool_job_t *job = allocator_malloc(&pool->alloc, sizeof(ape_pool_job_t));
+    if (!job) {
+        return false;
+    }
+    memset(job, 0, sizeof(ape_pool_job_t));
+    job->program = program;
+    job->argc = argc;
+    job->callback = callback;
+    job->callback_context = callback_context;
+    job->function_name = ape_strdup(&pool->alloc, function_name);
+    if (!job->function_name) {
+        goto err;
+    }
+    job->args = array_make(&pool->alloc, uint8_t);
+    if (!job->args) {
+        goto err;
+    }
+    for (int i = 0; i < argc; i++) {
+        bool ok = message_write(job->args, ape_object_to_object(args[i]), false);
+        if (!ok) {
+            goto err;
+        }
+    }
+
+    pthread_mutex_lock(&pool->mutex);
+    if (pool->last_job) {
+        pool->last_job->next = job;
+    } else {
+        pool->first_job = job;
+    }
+    pool->last_job = job;
+    pool->pending_jobs_count++;
+    pthread_cond_signal(&pool->job_added);
+    pthread_mutex_unlock(&pool->mutex);
+    return true;
+err:
+    pool_job_destroy(pool, job);
+    return false;
+}
+
+void ape_pool_wait(ape_pool_t *pool) {
+    pthread_mutex_lock(&pool->mutex);
+    while (pool->pending_jobs_count > 0) {
+        pthread_cond_wait(&pool->jobs_done, &pool->mutex);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+void ape_pool_destroy(ape_pool_t *pool) {
+    if (!pool) {
+        return;
+    }
+    pool_stop(pool, pool->workers_count);
+}
+
+static void* pool_worker_run(void *arg) {
+    ape_pool_worker_t *worker = arg;
+    ape_pool_t *pool = worker->pool;
+    while (true) {
+        pthread_mutex_lock(&pool->mutex);
+        while (!pool->first_job && !pool->stopping) {
+            pthread_cond_wait(&pool->job_added, &pool->mutex);
+        }
+        ape_pool_job_t *job = pool->first_job;
+        if (!job) {
+            pthread_mutex_unlock(&pool->mutex); // stopping and all jobs are taken
+            break;
+        }
+        pool->first_job = job->next;
+        if (!pool->first_job) {
+            pool->last_job = NULL;
+        }
+        pthread_mutex_unlock(&pool->mutex);
+
+        pool_run_job(worker, job);
+        pool_job_destroy(pool, job);
+
+        pthread_mutex_lock(&pool->mutex);
+        pool->pending_jobs_count--;
+        if (pool->pending_jobs_count == 0) {
+            pthread_cond_broadcast(&pool->jobs_done);
+        }
+        pthread_mutex_unlock(&pool->mutex);
+    }
+    return NULL;
+}
+
+static void pool_run_job(ape_pool_worker_t *worker, ape_pool_job_t *job) {
+    ape_t *ape = pool_get_isolate(worker, job->program);
+    if (!ape || ape_has_errors(ape)) {
+        if (job->callback) {
+            job->callback(ape, ape_object_make_null(), job->callback_context);
+        }
+        ape_destroy(ape); // isolates that failed to execute the program aren't kept
+        return;
+    }
+
+    ape_object_t res = ape_object_make_null();
+    ape_object_t *args = allocator_malloc(&ape->alloc, sizeof(ape_object_t) * (job->argc > 0 ? job->argc : 1));
+    if (args) {
+        const uint8_t *data = array_data(job->args);
+        int data_len = array_count(job->args);
+        int pos = 0;
+        bool ok = true;
+        for (int i = 0; i < job->argc && ok; i++) {
+            object_t arg = object_make_null();
+            ok = message_read(ape->mem, data, data_len, &pos, &arg);
+            args[i] = object_to_ape_object(arg);
+        }
+        if (ok) {
+            res = ape_call(ape, job->function_name, job->argc, args);
+        } else {
+            ape_set_runtime_error(ape, "Reading job arguments failed");
+        }
+        allocator_free(&ape->alloc, args);
+    }
+    if (job->callback) {
+        job->callback(ape, res, job->callback_context);
+    }
+}
+
+static ape_t* pool_get_isolate(ape_pool_worker_t *worker, const ape_shared_program_t *program) {
+    for (int i = 0; i < array_count(worker->isolates); i++) {
+        ape_pool_isolate_t *isolate = array_get(worker->isolates, i);
+        if (isolate->program == program) {
+            ape_clear_errors(isolate->ape); // left by the previous job
+            return isolate->ape;
+        }
+    }
+
+    ape_t *ape = ape_make();
+    if (!ape) {
+        return NULL;
+    }
+    ape_pool_t *pool = worker->pool;
+    if (pool->setup) {
+        pool->setup(ape, pool->setup_context);
+    }
+    if (ape_has_errors(ape)) {
+        return ape;
+    }
+    ape_execute_shared_program(ape, program);
+    if (ape_has_errors(ape)) {
+        return ape;
+    }
+
+    ape_pool_isolate_t isolate = { .program = program, .ape = ape };
+    bool ok = array_add(worker->isolates, &isolate);
+    if (!ok) {
+        ape_set_runtime_error(ape, "Allocation failed");
+    }
+    return ape;
+}
+
+static void pool_job_destroy(ape_pool_t *pool, ape_pool_job_t *job) {
+    if (!job) {
+        return;
+    }
+    array_destroy(job->args);
+    allocator_free(&pool->alloc, job->function_name);
+    allocator_free(&pool->alloc, job);
+}
+
+static void pool_stop(ape_pool_t *pool, int started_workers_count) {
+    pthread_mutex_lock(&pool->mutex);
+    pool->stopping = true;
+    pthread_cond_broadcast(&pool->job_added);
+    pthread_mutex_unlock(&pool->mutex);
+
+    for (int i = 0; i < started_workers_count; i++) {
+        ape_pool_worker_t *worker = &pool->workers[i];
+        pthread_join(worker->thread, NULL);
+        for (int j = 0; j < array_count(worker->isolates); j++) {
+            ape_pool_isolate_t *isolate = array_get(worker->isolates, j);
+            ape_destroy(isolate->ape);
+        }
+        array_destroy(worker->isolates);
+    }
+
+    pthread_cond_destroy(&pool->jobs_done);
+    pthread_cond_destroy(&pool->job_added);
+    pthread_mutex_destroy(&pool->mutex);
+    allocator_t alloc = pool->alloc;
+    allocator_free(&alloc, pool->workers);
+    allocator_free(&alloc, pool);
+}
+
+#else
+
+ape_pool_t* ape_pool_make(int threads_count, ape_pool_setup_fn setup, void *setup_context) {
+    (void)threads_count;
+    (void)setup;
+    (void)setup_context;
+    return NULL;
+}
+
+bool ape_pool_submit(ape_pool_t *pool, const ape_shared_program_t *program, const char *function_name,
+                     int argc, ape_object_t *args, ape_pool_callback_fn callback, void *callback_context) {
+    (void)pool; (void)program; (void)function_name; (void)argc; (void)args; (void)callback; (void)callback_context;
+    return false;
+}
+
+void ape_pool_wait(ape_pool_t *pool) {
+    (void)pool;
+}
+
+void ape_pool_destroy(ape_pool_t *pool) {
+    (void)pool;
+}
+
+#endif
+
 //-----------------------------------------------------------------------------
 // Ape internal
 //-----------------------------------------------------------------------------
 static void ape_deinit(ape_t *ape) {
+    APE_ASSERT(ape->shared_programs_count == 0); // shared programs have to be destroyed first
+    APE_ASSERT(ape->snapshots_count == 0); // and snapshots too
     vm_destroy(ape->vm);
     compiler_destroy(ape->compiler);
     global_store_destroy(ape->global_store);
@@ -984,6 +1597,166 @@ static void ape_deinit(ape_t *ape) {
     errors_deinit(&ape->errors);
 }
 
+static ape_shared_program_t* make_shared_program(ape_t *ape, compilation_result_t *comp_res) {
+    ape_shared_program_t *program = allocator_malloc(&ape->alloc, sizeof(ape_shared_program_t));
+    if (!program) {
+        compilation_result_destroy(comp_res);
+        return NULL;
+    }
+    memset(program, 0, sizeof(ape_shared_program_t));
+    program->ape = ape;
+    program->comp_res = comp_res;
+    ape->shared_programs_count++;
+
+    program->constants = make_static_constants(ape);
+    if (!program->constants) {
+        goto err;
+    }
+
+    program->compiler_globals = compiler_copy_globals(ape->compiler);
+    if (!program->compiler_globals) {
+        goto err;
+    }
+    return program;
+err:
+    ape_shared_program_destroy(program);
+    return NULL;
+}
+
+static array(object_t)* make_static_constants(ape_t *ape) {
+    array(object_t) *constants = compiler_get_constants(ape->compiler);
+    array(object_t) *res = array_make(&ape->alloc, object_t);
+    if (!res) {
+        return NULL;
+    }
+    for (int i = 0; i < array_count(constants); i++) {
+        object_t *constant = array_get(constants, i);
+        object_t copy = object_make_static_copy(&ape->alloc, *constant);
+        if (object_is_null(copy)) {
+            destroy_static_constants(ape, res);
+            return NULL;
+        }
+        bool ok = array_add(res, &copy);
+        if (!ok) {
+            object_destroy_static_copy(&ape->alloc, copy);
+            destroy_static_constants(ape, res);
+            return NULL;
+        }
+    }
+    return res;
+}
+
+static void destroy_static_constants(ape_t *ape, array(object_t) *constants) {
+    for (int i = 0; i < array_count(constants); i++) {
+        object_t *constant = array_get(constants, i);
+        object_destroy_static_copy(&ape->alloc, *constant);
+    }
+    array_destroy(constants);
+}
+
+// Natives set by the host are written as externals (see message_writer_add_external) and made again with the
+// same function and data for new instances, everything else reachable from globals is written to the heap.
+static bool snapshot_write_globals(ape_snapshot_t *snapshot) {
+    ape_t *ape = snapshot->ape;
+    message_writer_t writer;
+    message_writer_init(&writer, &ape->alloc, snapshot->heap, true);
+    int ape_globals_count = global_store_get_object_count(ape->global_store);
+    for (int i = 0; i < ape_globals_count; i++) {
+        bool ok = false;
+        object_t obj = global_store_get_object_at(ape->global_store, i, &ok);
+        if (!ok) {
+            goto err;
+        }
+        ape_snapshot_global_t global;
+        memset(&global, 0, sizeof(ape_snapshot_global_t));
+        if (object_get_type(obj) == OBJECT_NATIVE_FUNCTION
+            && object_get_native_function(obj)->fn == ape_native_fn_wrapper) {
+            native_fn_wrapper_t *wrapper = (native_fn_wrapper_t*)object_get_native_function(obj)->data;
+            global.is_native = true;
+            global.native_fn = wrapper->fn;
+            global.native_data = wrapper->data;
+            ok = message_writer_add_external(&writer, obj);
+        } else {
+            ok = message_writer_write(&writer, obj);
+        }
+        const char *name = global_store_get_name_at(ape->global_store, i);
+        if (!ok) {
+            errors_add_errorf(&ape->errors, ERROR_USER, src_pos_invalid,
+                              "Global constant \"%s\" can't be saved in a snapshot", name);
+            goto err;
+        }
+        global.name = ape_strdup(&ape->alloc, name);
+        if (!global.name) {
+            goto err;
+        }
+        if (!array_add(snapshot->ape_globals, &global)) {
+            allocator_free(&ape->alloc, global.name);
+            goto err;
+        }
+    }
+    snapshot->globals_count = ape->vm->globals_count;
+    for (int i = 0; i < snapshot->globals_count; i++) {
+        if (!message_writer_write(&writer, vm_get_global(ape->vm, i))) {
+            const char *name = get_module_global_name(ape, i);
+            if (name) {
+                errors_add_errorf(&ape->errors, ERROR_USER, src_pos_invalid,
+                                  "Global \"%s\" can't be saved in a snapshot, it references values that aren't data or ape functions", name);
+            } else {
+                errors_add_error(&ape->errors, ERROR_USER, src_pos_invalid,
+                                 "Global of an imported module can't be saved in a snapshot, it references values that aren't data or ape functions");
+            }
+            goto err;
+        }
+    }
+    message_writer_deinit(&writer);
+    return true;
+err:
+    message_writer_deinit(&writer);
+    return false;
+}
+
+static bool snapshot_read_globals(const ape_snapshot_t *snapshot, ape_t *ape) {
+    message_reader_t reader;
+    message_reader_init(&reader, ape->mem, array_data(snapshot->heap), array_count(snapshot->heap));
+    for (int i = 0; i < array_count(snapshot->ape_globals); i++) {
+        ape_snapshot_global_t *global = array_get(snapshot->ape_globals, i);
+        object_t obj = object_make_null();
+        bool ok = false;
+        if (global->is_native) {
+            obj = ape_object_to_object(ape_object_make_native_function_with_name(ape, global->name, global->native_fn, global->native_data));
+            ok = !object_is_null(obj) && message_reader_add_external(&reader, obj);
+        } else {
+            ok = message_reader_read(&reader, &obj);
+        }
+        // builtins are already defined and keep their indices, the rest is added in the same order
+        if (!ok || !global_store_set(ape->global_store, global->name, obj)) {
+            goto err;
+        }
+    }
+    for (int i = 0; i < snapshot->globals_count; i++) {
+        object_t obj = object_make_null();
+        if (!message_reader_read(&reader, &obj) || !vm_set_global(ape->vm, i, obj)) {
+            goto err;
+        }
+    }
+    message_reader_deinit(&reader);
+    return true;
+err:
+    message_reader_deinit(&reader);
+    return false;
+}
+
+static const char* get_module_global_name(ape_t *ape, int ix) {
+    block_scope_t *scope = symbol_table_get_block_scope(compiler_get_symbol_table(ape->compiler));
+    for (int i = 0; i < dict_count(scope->store); i++) {
+        const symbol_t *symbol = dict_get_value_at(scope->store, i);
+        if (symbol->type == SYMBOL_MODULE_GLOBAL && symbol->index == ix) {
+            return symbol->name;
+        }
+    }
+    return NULL; // globals of imported modules aren't visible in global scope
+}
+
 static object_t ape_native_fn_wrapper(vm_t *vm, void *data, int argc, object_t *args) {
     (void)vm;
     native_fn_wrapper_t *wrapper = (native_fn_wrapper_t*)data;
@@ -1003,6 +1776,17 @@ static ape_object_t object_to_ape_object(object_t obj) {
     return (ape_object_t){ ._internal = obj.handle };
 }
 
+static bool typed_array_type_from_ape(ape_typed_array_type_t type, typed_array_type_t *out_type) {
+    switch (type) {
+        case APE_TYPED_ARRAY_U8:  *out_type = TYPED_ARRAY_U8;  return true;
+        case APE_TYPED_ARRAY_I32: *out_type = TYPED_ARRAY_I32; return true;
+        case APE_TYPED_ARRAY_I64: *out_type = TYPED_ARRAY_I64; return true;
+        case APE_TYPED_ARRAY_F32: *out_type = TYPED_ARRAY_F32; return true;
+        case APE_TYPED_ARRAY_F64: *out_type = TYPED_ARRAY_F64; return true;
+    }
+    return false;
+}
+
 static ape_object_t ape_object_make_native_function_with_name(ape_t *ape, const char *name, ape_native_fn fn, void *data) {
     native_fn_wrapper_t wrapper;
     memset(&wrapper, 0, sizeof(native_fn_wrapper_t));
@@ -1021,9 +1805,27 @@ static void reset_state(ape_t *ape) {
     vm_reset(ape->vm);
 }
 
+// Calls made by native functions while the vm is running are nested on its stack and frames,
+// so they must not reset them. Errors they raise propagate to the calling native's caller.
+static void reset_state_for_call(ape_t *ape) {
+    if (!ape->vm->running) {
+        reset_state(ape);
+    }
+}
+
+static ape_object_t call_ape_object(ape_t *ape, object_t callee, int argc, ape_object_t *args) {
+    object_t res = vm_call(ape->vm, compiler_get_constants(ape->compiler), callee, argc, (object_t*)args);
+    if (errors_get_count(&ape->errors) > 0) {
+        return ape_object_make_null();
+    }
+    return object_to_ape_object(res);
+}
+
 static void set_default_config(ape_t *ape) {
     memset(&ape->config, 0, sizeof(ape_config_t));
     ape_set_repl_mode(ape, false);
+    ape_set_bytecode_cache(ape, false);
+    ape_set_module_cache(ape, false);
     ape_set_timeout(ape, -1);
     ape_set_file_read_function(ape, read_file_default, ape);
     ape_set_file_write_function(ape, write_file_default, ape);
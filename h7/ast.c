@@ -27,6 +27,15 @@ expression_t* expression_make_number_literal(allocator_t *alloc, double val) {
     return res;
 }
 
+expression_t* expression_make_int_literal(allocator_t *alloc, int64_t val) {
+    expression_t *res = expression_make(alloc, EXPRESSION_INT_LITERAL);
+    if (!res) {
+        return NULL;
+    }
+    res->int_literal = val;
+    return res;
+}
+
 expression_t* expression_make_bool_literal(allocator_t *alloc, bool val) {
     expression_t *res = expression_make(alloc, EXPRESSION_BOOL_LITERAL);
     if (!res) {
@@ -172,6 +181,7 @@ void expression_destroy(expression_t *expr) {
             break;
         }
         case EXPRESSION_NUMBER_LITERAL:
+        case EXPRESSION_INT_LITERAL:
         case EXPRESSION_BOOL_LITERAL: {
             break;
         }
@@ -264,6 +274,10 @@ expression_t* expression_copy(expression_t *expr) {
             res = expression_make_number_literal(expr->alloc, expr->number_literal);
             break;
         }
+        case EXPRESSION_INT_LITERAL: {
+            res = expression_make_int_literal(expr->alloc, expr->int_literal);
+            break;
+        }
         case EXPRESSION_BOOL_LITERAL: {
             res = expression_make_bool_literal(expr->alloc, expr->bool_literal);
             break;
@@ -569,6 +583,17 @@ statement_t* statement_make_recover(allocator_t *alloc, ident_t *error_ident, co
     return res;
 }
 
+statement_t* statement_make_struct(allocator_t *alloc, ident_t *name, ptrarray(ident_t) *fields, ptrarray(expression_t) *operators) {
+    statement_t *res = statement_make(alloc, STATEMENT_STRUCT);
+    if (!res) {
+        return NULL;
+    }
+    res->struct_statement.name = name;
+    res->struct_statement.fields = fields;
+    res->struct_statement.operators = operators;
+    return res;
+}
+
 void statement_destroy(statement_t *stmt) {
     if (!stmt) {
         return;
@@ -633,6 +658,12 @@ void statement_destroy(statement_t *stmt) {
             ident_destroy(stmt->recover.error_ident);
             break;
         }
+        case STATEMENT_STRUCT: {
+            ident_destroy(stmt->struct_statement.name);
+            ptrarray_destroy_with_items(stmt->struct_statement.fields, ident_destroy);
+            ptrarray_destroy_with_items(stmt->struct_statement.operators, expression_destroy);
+            break;
+        }
     }
     allocator_free(stmt->alloc, stmt);
 }
@@ -652,7 +683,7 @@ statement_t* statement_copy(const statement_t *stmt) {
             if (!value_copy) {
                 return NULL;
             }
-            res = statement_make_define(stmt->alloc, ident_copy(stmt->define.name), value_copy, stmt->define.assignable);
+            res = statement_make_define(stmt->alloc, ident_copy(stmt->define.name), stmt->define.type, value_copy, stmt->define.assignable);
             if (!res) {
                 expression_destroy(value_copy);
                 return NULL;
@@ -801,6 +832,25 @@ statement_t* statement_copy(const statement_t *stmt) {
             }
             break;
         }
+        case STATEMENT_STRUCT: {
+            ident_t *name_copy = ident_copy(stmt->struct_statement.name);
+            ptrarray(ident_t) *fields_copy = ptrarray_copy_with_items(stmt->struct_statement.fields, ident_copy, ident_destroy);
+            ptrarray(expression_t) *operators_copy = ptrarray_copy_with_items(stmt->struct_statement.operators, expression_copy, expression_destroy);
+            if (!name_copy || !fields_copy || !operators_copy) {
+                ident_destroy(name_copy);
+                ptrarray_destroy_with_items(fields_copy, ident_destroy);
+                ptrarray_destroy_with_items(operators_copy, expression_destroy);
+                return NULL;
+            }
+            res = statement_make_struct(stmt->alloc, name_copy, fields_copy, operators_copy);
+            if (!res) {
+                ident_destroy(name_copy);
+                ptrarray_destroy_with_items(fields_copy, ident_destroy);
+                ptrarray_destroy_with_items(operators_copy, expression_destroy);
+                return NULL;
+            }
+            break;
+        }
     }
     if (!res) {
         return NULL;
@@ -971,6 +1021,24 @@ void statement_to_string(const statement_t *stmt, strbuf_t *buf) {
             code_block_to_string(stmt->recover.body, buf);
             break;
         }
+        case STATEMENT_STRUCT: {
+            const struct_statement_t *struct_stmt = &stmt->struct_statement;
+            strbuf_appendf(buf, "struct %s { ", struct_stmt->name->value);
+            for (int i = 0; i < ptrarray_count(struct_stmt->fields); i++) {
+                ident_t *field = ptrarray_get(struct_stmt->fields, i);
+                strbuf_append(buf, field->value);
+                if (i < (ptrarray_count(struct_stmt->fields) - 1)) {
+                    strbuf_append(buf, ", ");
+                }
+            }
+            for (int i = 0; i < ptrarray_count(struct_stmt->operators); i++) {
+                expression_t *op = ptrarray_get(struct_stmt->operators, i);
+                strbuf_appendf(buf, " %s = ", op->fn_literal.name);
+                expression_to_string(op, buf);
+            }
+            strbuf_append(buf, " }");
+            break;
+        }
     }
 }
 
@@ -984,6 +1052,10 @@ void expression_to_string(expression_t *expr, strbuf_t *buf) {
             strbuf_appendf(buf, "%1.17g", expr->number_literal);
             break;
         }
+        case EXPRESSION_INT_LITERAL: {
+            strbuf_appendf(buf, "%lld", (long long)expr->int_literal);
+            break;
+        }
         case EXPRESSION_BOOL_LITERAL: {
             strbuf_appendf(buf, "%s", expr->bool_literal ? "true" : "false");
             break;
@@ -1156,7 +1228,8 @@ const char *expression_type_to_string(expression_type_t type) {
     switch (type) {
         case EXPRESSION_NONE:             return "NONE";
         case EXPRESSION_IDENT:            return "IDENT";
-        case EXPRESSION_NUMBER_LITERAL:   return "INT_LITERAL";
+        case EXPRESSION_NUMBER_LITERAL:   return "NUMBER_LITERAL";
+        case EXPRESSION_INT_LITERAL:      return "INT_LITERAL";
         case EXPRESSION_BOOL_LITERAL:     return "BOOL_LITERAL";
         case EXPRESSION_STRING_LITERAL:   return "STRING_LITERAL";
         case EXPRESSION_ARRAY_LITERAL:    return "ARRAY_LITERAL";
@@ -112,6 +112,7 @@ typedef enum expression_type {
     EXPRESSION_ASSIGN,
     EXPRESSION_LOGICAL, //like: a && b
     EXPRESSION_TERNARY,
+    EXPRESSION_INT_LITERAL,
 } expression_type_t;
 
 typedef struct ident {
@@ -126,6 +127,7 @@ typedef struct expression {
     union {
         ident_t *ident;
         double number_literal;
+        int64_t int_literal;
         bool bool_literal;
         char *string_literal;
         ptrarray(expression_t) *array;
@@ -156,6 +158,7 @@ typedef enum statement_type {
     STATEMENT_BLOCK,
     STATEMENT_IMPORT,
     STATEMENT_RECOVER,
+    STATEMENT_STRUCT,
 } statement_type_t;
 
 typedef struct define_statement {
@@ -197,6 +200,12 @@ typedef struct recover_statement {
     code_block_t *body;
 } recover_statement_t;
 
+typedef struct struct_statement {
+    ident_t *name;
+    ptrarray(ident_t) *fields;
+    ptrarray(expression_t) *operators; // function literals named after the overloaded operator
+} struct_statement_t;
+
 typedef struct statement {
     allocator_t *alloc;
     statement_type_t type;
@@ -211,6 +220,7 @@ typedef struct statement {
         code_block_t *block;
         import_statement_t import;
         recover_statement_t recover;
+        struct_statement_t struct_statement;
     };
     src_pos_t pos;
 } statement_t;
@@ -233,6 +243,7 @@ APE_INTERNAL statement_t* statement_make_continue(allocator_t *alloc);
 APE_INTERNAL statement_t* statement_make_block(allocator_t *alloc, code_block_t *block);
 APE_INTERNAL statement_t* statement_make_import(allocator_t *alloc, char *path);
 APE_INTERNAL statement_t* statement_make_recover(allocator_t *alloc, ident_t *error_ident, code_block_t *body);
+APE_INTERNAL statement_t* statement_make_struct(allocator_t *alloc, ident_t *name, ptrarray(ident_t) *fields, ptrarray(expression_t) *operators);
 
 APE_INTERNAL void statement_destroy(statement_t *stmt);
 
@@ -244,6 +255,7 @@ APE_INTERNAL code_block_t* code_block_copy(code_block_t *block);
 
 APE_INTERNAL expression_t* expression_make_ident(allocator_t *alloc, ident_t *ident);
 APE_INTERNAL expression_t* expression_make_number_literal(allocator_t *alloc, double val);
+APE_INTERNAL expression_t* expression_make_int_literal(allocator_t *alloc, int64_t val);
 APE_INTERNAL expression_t* expression_make_bool_literal(allocator_t *alloc, bool val);
 APE_INTERNAL expression_t* expression_make_string_literal(allocator_t *alloc, char *value);
 APE_INTERNAL expression_t* expression_make_null_literal(allocator_t *alloc);
@@ -1,6 +1,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <errno.h>
+#include <limits.h>
 
 #ifndef APE_AMALGAMATED
 #include "builtins.h"
@@ -8,6 +9,8 @@
 #include "common.h"
 #include "object.h"
 #include "vm.h"
+#include "gc.h"
+#include "parallel.h"
 #endif
 
 static object_t len_fn(vm_t *vm, void *data, int argc, object_t *args);
@@ -16,15 +19,20 @@ static object_t last_fn(vm_t *vm, void *data, int argc, object_t *args);
 static object_t rest_fn(vm_t *vm, void *data, int argc, object_t *args);
 static object_t reverse_fn(vm_t *vm, void *data, int argc, object_t *args);
 static object_t array_fn(vm_t *vm, void *data, int argc, object_t *args);
+static object_t to_array_fn(vm_t *vm, void *data, int argc, object_t *args);
 static object_t append_fn(vm_t *vm, void *data, int argc, object_t *args);
 static object_t remove_fn(vm_t *vm, void *data, int argc, object_t *args);
 static object_t remove_at_fn(vm_t *vm, void *data, int argc, object_t *args);
+static object_t push_front_fn(vm_t *vm, void *data, int argc, object_t *args);
+static object_t pop_front_fn(vm_t *vm, void *data, int argc, object_t *args);
 static object_t println_fn(vm_t *vm, void *data, int argc, object_t *args);
 static object_t print_fn(vm_t *vm, void *data, int argc, object_t *args);
 static object_t read_file_fn(vm_t *vm, void *data, int argc, object_t *args);
 static object_t write_file_fn(vm_t *vm, void *data, int argc, object_t *args);
 static object_t to_str_fn(vm_t *vm, void *data, int argc, object_t *args);
 static object_t to_num_fn(vm_t *vm, void *data, int argc, object_t *args);
+static object_t to_nums_fn(vm_t *vm, void *data, int argc, object_t *args);
+static object_t to_int_fn(vm_t *vm, void *data, int argc, object_t *args);
 static object_t char_to_str_fn(vm_t *vm, void *data, int argc, object_t *args);
 static object_t range_fn(vm_t *vm, void *data, int argc, object_t *args);
 static object_t keys_fn(vm_t *vm, void *data, int argc, object_t *args);
@@ -39,15 +47,45 @@ static object_t random_seed_fn(vm_t *vm, void *data, int argc, object_t *args);
 static object_t random_fn(vm_t *vm, void *data, int argc, object_t *args);
 static object_t slice_fn(vm_t *vm, void *data, int argc, object_t *args);
 
+// Sorting
+static object_t sort_fn(vm_t *vm, void *data, int argc, object_t *args);
+static object_t sort_stable_fn(vm_t *vm, void *data, int argc, object_t *args);
+
+// Higher order functions
+static object_t map_fn(vm_t *vm, void *data, int argc, object_t *args);
+static object_t filter_fn(vm_t *vm, void *data, int argc, object_t *args);
+static object_t reduce_fn(vm_t *vm, void *data, int argc, object_t *args);
+static object_t each_fn(vm_t *vm, void *data, int argc, object_t *args);
+static object_t parallel_map_fn(vm_t *vm, void *data, int argc, object_t *args);
+
+// Typed arrays
+static object_t u8_array_fn(vm_t *vm, void *data, int argc, object_t *args);
+static object_t i32_array_fn(vm_t *vm, void *data, int argc, object_t *args);
+static object_t i64_array_fn(vm_t *vm, void *data, int argc, object_t *args);
+static object_t f32_array_fn(vm_t *vm, void *data, int argc, object_t *args);
+static object_t f64_array_fn(vm_t *vm, void *data, int argc, object_t *args);
+
+// Sets
+static object_t set_fn(vm_t *vm, void *data, int argc, object_t *args);
+static object_t has_fn(vm_t *vm, void *data, int argc, object_t *args);
+static object_t union_fn(vm_t *vm, void *data, int argc, object_t *args);
+static object_t intersection_fn(vm_t *vm, void *data, int argc, object_t *args);
+static object_t difference_fn(vm_t *vm, void *data, int argc, object_t *args);
+
 // Type checks
 static object_t is_string_fn(vm_t *vm, void *data, int argc, object_t *args);
 static object_t is_array_fn(vm_t *vm, void *data, int argc, object_t *args);
 static object_t is_map_fn(vm_t *vm, void *data, int argc, object_t *args);
 static object_t is_number_fn(vm_t *vm, void *data, int argc, object_t *args);
+static object_t is_int_fn(vm_t *vm, void *data, int argc, object_t *args);
 static object_t is_bool_fn(vm_t *vm, void *data, int argc, object_t *args);
 static object_t is_null_fn(vm_t *vm, void *data, int argc, object_t *args);
 static object_t is_function_fn(vm_t *vm, void *data, int argc, object_t *args);
 static object_t is_external_fn(vm_t *vm, void *data, int argc, object_t *args);
+static object_t is_typed_array_fn(vm_t *vm, void *data, int argc, object_t *args);
+static object_t is_range_fn(vm_t *vm, void *data, int argc, object_t *args);
+static object_t is_struct_fn(vm_t *vm, void *data, int argc, object_t *args);
+static object_t is_set_fn(vm_t *vm, void *data, int argc, object_t *args);
 static object_t is_error_fn(vm_t *vm, void *data, int argc, object_t *args);
 static object_t is_native_function_fn(vm_t *vm, void *data, int argc, object_t *args);
 
@@ -62,7 +100,16 @@ static object_t ceil_fn(vm_t *vm, void *data, int argc, object_t *args);
 static object_t floor_fn(vm_t *vm, void *data, int argc, object_t *args);
 static object_t abs_fn(vm_t *vm, void *data, int argc, object_t *args);
 
+// Numeric arrays
+static object_t sum_fn(vm_t *vm, void *data, int argc, object_t *args);
+static object_t dot_fn(vm_t *vm, void *data, int argc, object_t *args);
+static object_t scale_fn(vm_t *vm, void *data, int argc, object_t *args);
+
 static bool check_args(vm_t *vm, bool generate_error, int argc, object_t *args, int expected_argc, object_type_t *expected_types);
+static bool object_to_number(object_t obj, double *out_num);
+static bool set_add_checked(vm_t *vm, object_t set, object_t val);
+static int sequence_get_length(object_t seq);
+static object_t sequence_get_value_at(object_t seq, int ix);
 #define CHECK_ARGS(vm, generate_error, argc, args, ...) \
     check_args(\
         (vm),\
@@ -87,8 +134,12 @@ static struct {
     {"append",      append_fn},
     {"remove",      remove_fn},
     {"remove_at",   remove_at_fn},
+    {"push_front",  push_front_fn},
+    {"pop_front",   pop_front_fn},
     {"to_str",      to_str_fn},
     {"to_num",      to_num_fn},
+    {"to_nums",     to_nums_fn},
+    {"to_int",      to_int_fn},
     {"range",       range_fn},
     {"keys",        keys_fn},
     {"values",      values_fn},
@@ -98,6 +149,7 @@ static struct {
     {"char_to_str", char_to_str_fn},
     {"reverse",     reverse_fn},
     {"array",       array_fn},
+    {"to_array",    to_array_fn},
     {"error",       error_fn},
     {"crash",       crash_fn},
     {"assert",      assert_fn},
@@ -105,15 +157,44 @@ static struct {
     {"random",      random_fn},
     {"slice",       slice_fn},
 
+    // Sorting
+    {"sort",        sort_fn},
+    {"sort_stable", sort_stable_fn},
+
+    {"map",         map_fn},
+    {"filter",      filter_fn},
+    {"reduce",      reduce_fn},
+    {"each",        each_fn},
+    {"parallel_map", parallel_map_fn},
+
+    // Typed arrays
+    {"u8_array",    u8_array_fn},
+    {"i32_array",   i32_array_fn},
+    {"i64_array",   i64_array_fn},
+    {"f32_array",   f32_array_fn},
+    {"f64_array",   f64_array_fn},
+
+    // Sets
+    {"set",          set_fn},
+    {"has",          has_fn},
+    {"union",        union_fn},
+    {"intersection", intersection_fn},
+    {"difference",   difference_fn},
+
     // Type checks
     {"is_string",   is_string_fn},
     {"is_array",    is_array_fn},
     {"is_map",      is_map_fn},
     {"is_number",   is_number_fn},
+    {"is_int",      is_int_fn},
     {"is_bool",     is_bool_fn},
     {"is_null",     is_null_fn},
     {"is_function", is_function_fn},
     {"is_external", is_external_fn},
+    {"is_typed_array", is_typed_array_fn},
+    {"is_range",    is_range_fn},
+    {"is_struct",   is_struct_fn},
+    {"is_set",      is_set_fn},
     {"is_error",    is_error_fn},
     {"is_native_function", is_native_function_fn},
 
@@ -127,6 +208,11 @@ static struct {
     {"ceil",  ceil_fn},
     {"floor", floor_fn},
     {"abs",   abs_fn},
+
+    // Numeric arrays
+    {"sum",   sum_fn},
+    {"dot",   dot_fn},
+    {"scale", scale_fn},
 };
 
 int builtins_count() {
@@ -141,10 +227,19 @@ const char* builtins_get_name(int ix) {
     return g_native_functions[ix].name;
 }
 
+int builtins_get_ix(native_fn fn) {
+    for (int i = 0; i < builtins_count(); i++) {
+        if (g_native_functions[i].fn == fn) {
+            return i;
+        }
+    }
+    return -1;
+}
+
 // INTERNAL
 static object_t len_fn(vm_t *vm, void *data, int argc, object_t *args) {
     (void)data;
-    if (!CHECK_ARGS(vm, true, argc, args, OBJECT_STRING | OBJECT_ARRAY | OBJECT_MAP)) {
+    if (!CHECK_ARGS(vm, true, argc, args, OBJECT_STRING | OBJECT_ARRAY | OBJECT_MAP | OBJECT_RANGE | OBJECT_TYPED_ARRAY | OBJECT_SET)) {
         return object_make_null();
     }
 
@@ -152,13 +247,22 @@ static object_t len_fn(vm_t *vm, void *data, int argc, object_t *args) {
     object_type_t type = object_get_type(arg);
     if (type == OBJECT_STRING) {
         int len = object_get_string_length(arg);
-        return object_make_number(len);
+        return object_make_int(vm->mem, len);
     } else if (type == OBJECT_ARRAY) {
         int len = object_get_array_length(arg);
-        return object_make_number(len);
+        return object_make_int(vm->mem, len);
+    } else if (type == OBJECT_RANGE) {
+        int len = object_get_range_length(arg);
+        return object_make_int(vm->mem, len);
+    } else if (type == OBJECT_TYPED_ARRAY) {
+        int len = object_get_typed_array_length(arg);
+        return object_make_int(vm->mem, len);
     } else if (type == OBJECT_MAP) {
         int len = object_get_map_length(arg);
-        return object_make_number(len);
+        return object_make_int(vm->mem, len);
+    } else if (type == OBJECT_SET) {
+        int len = object_get_set_length(arg);
+        return object_make_int(vm->mem, len);
     }
 
     return object_make_null();
@@ -166,29 +270,29 @@ static object_t len_fn(vm_t *vm, void *data, int argc, object_t *args) {
 
 static object_t first_fn(vm_t *vm, void *data, int argc, object_t *args) {
     (void)data;
-    if (!CHECK_ARGS(vm, true, argc, args, OBJECT_ARRAY)) {
+    if (!CHECK_ARGS(vm, true, argc, args, OBJECT_ARRAY | OBJECT_RANGE)) {
         return object_make_null();
     }
      object_t arg = args[0];
-    return object_get_array_value_at(arg, 0);
+    return sequence_get_value_at(arg, 0);
 }
 
 static object_t last_fn(vm_t *vm, void *data, int argc, object_t *args) {
     (void)data;
-    if (!CHECK_ARGS(vm, true, argc, args, OBJECT_ARRAY)) {
+    if (!CHECK_ARGS(vm, true, argc, args, OBJECT_ARRAY | OBJECT_RANGE)) {
         return object_make_null();
     }
     object_t arg = args[0];
-    return object_get_array_value_at(arg, object_get_array_length(arg) - 1);
+    return sequence_get_value_at(arg, sequence_get_length(arg) - 1);
 }
 
 static object_t rest_fn(vm_t *vm, void *data, int argc, object_t *args) {
     (void)data;
-    if (!CHECK_ARGS(vm, true, argc, args, OBJECT_ARRAY)) {
+    if (!CHECK_ARGS(vm, true, argc, args, OBJECT_ARRAY | OBJECT_RANGE)) {
         return object_make_null();
     }
     object_t arg = args[0];
-    int len = object_get_array_length(arg);
+    int len = sequence_get_length(arg);
     if (len == 0) {
         return object_make_null();
     }
@@ -198,7 +302,7 @@ static object_t rest_fn(vm_t *vm, void *data, int argc, object_t *args) {
         return object_make_null();
     }
     for (int i = 1; i < len; i++) {
-        object_t item = object_get_array_value_at(arg, i);
+        object_t item = sequence_get_value_at(arg, i);
         bool ok = object_add_array_value(res, item);
         if (!ok) {
             return object_make_null();
@@ -209,20 +313,20 @@ static object_t rest_fn(vm_t *vm, void *data, int argc, object_t *args) {
 
 static object_t reverse_fn(vm_t *vm, void *data, int argc, object_t *args) {
     (void)data;
-    if (!CHECK_ARGS(vm, true, argc, args, OBJECT_ARRAY | OBJECT_STRING)) {
+    if (!CHECK_ARGS(vm, true, argc, args, OBJECT_ARRAY | OBJECT_RANGE | OBJECT_STRING)) {
         return object_make_null();
     }
     object_t arg = args[0];
     object_type_t type = object_get_type(arg);
-    if (type == OBJECT_ARRAY) {
-        int len = object_get_array_length(arg);
+    if (type == OBJECT_ARRAY || type == OBJECT_RANGE) {
+        int len = sequence_get_length(arg);
         object_t res = object_make_array_with_capacity(vm->mem, len);
         if (object_is_null(res)) {
             return object_make_null();
         }
-        for (int i = 0; i < len; i++) {
-            object_t obj = object_get_array_value_at(arg, i);
-            bool ok = object_set_array_value_at(res, len - i - 1, obj);
+        for (int i = len - 1; i >= 0; i--) {
+            object_t obj = sequence_get_value_at(arg, i);
+            bool ok = object_add_array_value(res, obj);
             if (!ok) {
                 return object_make_null();
             }
@@ -287,17 +391,43 @@ static object_t array_fn(vm_t *vm, void *data, int argc, object_t *args) {
     return object_make_null();
 }
 
+static object_t to_array_fn(vm_t *vm, void *data, int argc, object_t *args) {
+    (void)data;
+    if (!CHECK_ARGS(vm, true, argc, args, OBJECT_ARRAY | OBJECT_RANGE | OBJECT_TYPED_ARRAY | OBJECT_SET)) {
+        return object_make_null();
+    }
+    object_t seq = args[0];
+    int len = sequence_get_length(seq);
+    object_t res = object_make_array_with_capacity(vm->mem, len);
+    if (object_is_null(res)) {
+        return object_make_null();
+    }
+    for (int i = 0; i < len; i++) {
+        bool ok = object_add_array_value(res, sequence_get_value_at(seq, i));
+        if (!ok) {
+            return object_make_null();
+        }
+    }
+    return res;
+}
+
 static object_t append_fn(vm_t *vm, void *data, int argc, object_t *args) {
     (void)data;
-    if (!CHECK_ARGS(vm, true, argc, args, OBJECT_ARRAY, OBJECT_ANY)) {
+    if (!CHECK_ARGS(vm, true, argc, args, OBJECT_ARRAY | OBJECT_SET, OBJECT_ANY)) {
         return object_make_null();
     }
+    if (object_get_type(args[0]) == OBJECT_SET) {
+        if (!set_add_checked(vm, args[0], args[1])) {
+            return object_make_null();
+        }
+        return object_make_int(vm->mem, object_get_set_length(args[0]));
+    }
     bool ok = object_add_array_value(args[0], args[1]);
     if (!ok) {
         return object_make_null();
     }
     int len = object_get_array_length(args[0]);
-    return object_make_number(len);
+    return object_make_int(vm->mem, len);
 }
 
 static object_t println_fn(vm_t *vm, void *data, int argc, object_t *args) {
@@ -370,7 +500,7 @@ static object_t write_file_fn(vm_t *vm, void *data, int argc, object_t *args) {
 
     int written = (int)config->fileio.write_file.write_file(config->fileio.write_file.context, path, string, string_len);
     
-    return object_make_number(written);
+    return object_make_int(vm->mem, written);
 }
 
 static object_t read_file_fn(vm_t *vm, void *data, int argc, object_t *args) {
@@ -398,10 +528,21 @@ static object_t read_file_fn(vm_t *vm, void *data, int argc, object_t *args) {
 
 static object_t to_str_fn(vm_t *vm, void *data, int argc, object_t *args) {
     (void)data;
-    if (!CHECK_ARGS(vm, true, argc, args, OBJECT_STRING | OBJECT_NUMBER | OBJECT_BOOL | OBJECT_NULL | OBJECT_MAP | OBJECT_ARRAY)) {
+    if (!CHECK_ARGS(vm, true, argc, args, OBJECT_STRING | OBJECT_NUMBER | OBJECT_BOOL | OBJECT_NULL | OBJECT_MAP | OBJECT_ARRAY | OBJECT_TYPED_ARRAY | OBJECT_STRUCT | OBJECT_SET)) {
         return object_make_null();
     }
     object_t arg = args[0];
+    if (object_get_type(arg) == OBJECT_NUMBER) { // skips the intermediate buffer
+        char number_str[APE_DTOA_BUFFER_SIZE];
+        int number_len = ape_dtoa(object_get_number(arg), number_str);
+        object_t res = object_make_string_with_capacity(vm->mem, number_len);
+        if (object_is_null(res)) {
+            return object_make_null();
+        }
+        memcpy(object_get_mutable_string(res), number_str, number_len + 1);
+        object_set_string_length(res, number_len);
+        return res;
+    }
     strbuf_t *buf = strbuf_make(vm->alloc);
     if (!buf) {
         return object_make_null();
@@ -421,35 +562,70 @@ static object_t to_num_fn(vm_t *vm, void *data, int argc, object_t *args) {
     if (!CHECK_ARGS(vm, true, argc, args, OBJECT_STRING | OBJECT_NUMBER | OBJECT_BOOL | OBJECT_NULL)) {
         return object_make_null();
     }
+    if (object_get_type(args[0]) == OBJECT_NUMBER) {
+        return args[0];
+    }
     double result = 0;
-    const char *string = "";
-    if (object_is_numeric(args[0])) {
-        result = object_get_number(args[0]);
-    } else if (object_is_null(args[0])) {
-        result = 0;
-    } else if (object_get_type(args[0]) == OBJECT_STRING) {
-        string = object_get_string(args[0]);
-        char *end;
-        errno = 0;
-        result = strtod(string, &end);
-        if (errno == ERANGE && (result <= -HUGE_VAL || result >= HUGE_VAL)) {
-            goto err;;
-        }
-        if (errno && errno != ERANGE) {
-            goto err;
-        }
-        int string_len = object_get_string_length(args[0]);
-        int parsed_len = (int)(end - string);
-        if (string_len != parsed_len) {
-            goto err;
-        }
-    } else {
-        goto err;
+    if (!object_to_number(args[0], &result)) {
+        const char *string = object_get_type(args[0]) == OBJECT_STRING ? object_get_string(args[0]) : "";
+        errors_add_errorf(vm->errors, ERROR_RUNTIME, src_pos_invalid, "Cannot convert \"%s\" to number", string);
+        return object_make_null();
     }
     return object_make_number(result);
-err:
-    errors_add_errorf(vm->errors, ERROR_RUNTIME, src_pos_invalid, "Cannot convert \"%s\" to number", string);
-    return object_make_null();
+}
+
+static object_t to_nums_fn(vm_t *vm, void *data, int argc, object_t *args) {
+    (void)data;
+    if (!CHECK_ARGS(vm, true, argc, args, OBJECT_ARRAY)) {
+        return object_make_null();
+    }
+    int len = object_get_array_length(args[0]);
+    object_t res = object_make_array_with_capacity(vm->mem, len);
+    if (object_is_null(res)) {
+        return object_make_null();
+    }
+    for (int i = 0; i < len; i++) {
+        object_t item = object_get_array_value_at(args[0], i);
+        double num = 0;
+        if (!object_to_number(item, &num)) {
+            if (object_get_type(item) == OBJECT_STRING) {
+                errors_add_errorf(vm->errors, ERROR_RUNTIME, src_pos_invalid,
+                                  "Cannot convert \"%s\" at index %d to number", object_get_string(item), i);
+            } else {
+                const char *type_name = object_get_type_name(object_get_type(item));
+                errors_add_errorf(vm->errors, ERROR_RUNTIME, src_pos_invalid,
+                                  "Cannot convert %s at index %d to number", type_name, i);
+            }
+            return object_make_null();
+        }
+        bool ok = object_add_array_value(res, object_make_number(num));
+        if (!ok) {
+            return object_make_null();
+        }
+    }
+    return res;
+}
+
+static object_t to_int_fn(vm_t *vm, void *data, int argc, object_t *args) {
+    (void)data;
+    if (!CHECK_ARGS(vm, true, argc, args, OBJECT_STRING | OBJECT_NUMBER | OBJECT_BOOL | OBJECT_NULL)) {
+        return object_make_null();
+    }
+    object_t arg = args[0];
+    if (object_is_int(arg)) {
+        return arg;
+    }
+    double num = 0;
+    // doubles are truncated, everything from 2^63 up doesn't fit in an int
+    if (!object_to_number(arg, &num) || isnan(num) || num >= 9223372036854775808.0 || num < -9223372036854775808.0) {
+        if (object_get_type(arg) == OBJECT_STRING) {
+            errors_add_errorf(vm->errors, ERROR_RUNTIME, src_pos_invalid, "Cannot convert \"%s\" to int", object_get_string(arg));
+        } else {
+            errors_add_errorf(vm->errors, ERROR_RUNTIME, src_pos_invalid, "Cannot convert %1.17g to int", num);
+        }
+        return object_make_null();
+    }
+    return object_make_int(vm->mem, (int64_t)num);
 }
 
 static object_t char_to_str_fn(vm_t *vm, void *data, int argc, object_t *args) {
@@ -502,18 +678,14 @@ static object_t range_fn(vm_t *vm, void *data, int argc, object_t *args) {
         return object_make_null();
     }
 
-    object_t res = object_make_array(vm->mem);
-    if (object_is_null(res)) {
+    int64_t length = object_count_range_values(start, end, step);
+    if (length > INT_MAX) {
+        errors_add_errorf(vm->errors, ERROR_RUNTIME, src_pos_invalid,
+                          "range has too many values, got %lld, max is %d", (long long)length, INT_MAX);
         return object_make_null();
     }
-    for (int i = start; i < end; i += step) {
-        object_t item = object_make_number(i);
-        bool ok = object_add_array_value(res, item);
-        if (!ok) {
-            return object_make_null();
-        }
-    }
-    return res;
+
+    return object_make_range(vm->mem, start, end, step);
 }
 
 static object_t keys_fn(vm_t *vm, void *data, int argc, object_t *args) {
@@ -576,27 +748,27 @@ static object_t deep_copy_fn(vm_t *vm, void *data, int argc, object_t *args) {
 
 static object_t concat_fn(vm_t *vm, void *data, int argc, object_t *args) {
     (void)data;
-    if (!CHECK_ARGS(vm, true, argc, args, OBJECT_ARRAY | OBJECT_STRING, OBJECT_ARRAY | OBJECT_STRING)) {
+    if (!CHECK_ARGS(vm, true, argc, args, OBJECT_ARRAY | OBJECT_STRING, OBJECT_ARRAY | OBJECT_RANGE | OBJECT_STRING)) {
         return object_make_null();
     }
     object_type_t type = object_get_type(args[0]);
     object_type_t item_type = object_get_type(args[1]);
     if (type == OBJECT_ARRAY) {
-        if (item_type != OBJECT_ARRAY) {
+        if (item_type != OBJECT_ARRAY && item_type != OBJECT_RANGE) {
             const char *item_type_str = object_get_type_name(item_type);
             errors_add_errorf(vm->errors, ERROR_RUNTIME, src_pos_invalid,
                               "Invalid argument 2 passed to concat, got %s",
                               item_type_str);
             return object_make_null();
         }
-        for (int i = 0; i < object_get_array_length(args[1]); i++) {
-            object_t item = object_get_array_value_at(args[1], i);
+        for (int i = 0; i < sequence_get_length(args[1]); i++) {
+            object_t item = sequence_get_value_at(args[1], i);
             bool ok = object_add_array_value(args[0], item);
             if (!ok) {
                 return object_make_null();
             }
         }
-        return object_make_number(object_get_array_length(args[0]));
+        return object_make_int(vm->mem, object_get_array_length(args[0]));
     } else if (type == OBJECT_STRING) {
         if (!CHECK_ARGS(vm, true, argc, args, OBJECT_STRING, OBJECT_STRING)) {
             return object_make_null();
@@ -629,10 +801,18 @@ static object_t concat_fn(vm_t *vm, void *data, int argc, object_t *args) {
 
 static object_t remove_fn(vm_t *vm, void *data, int argc, object_t *args) {
     (void)data;
-    if (!CHECK_ARGS(vm, true, argc, args, OBJECT_ARRAY, OBJECT_ANY)) {
+    if (!CHECK_ARGS(vm, true, argc, args, OBJECT_ARRAY | OBJECT_MAP | OBJECT_SET, OBJECT_ANY)) {
         return object_make_null();
     }
 
+    if (object_get_type(args[0]) == OBJECT_SET) {
+        return object_make_bool(object_set_remove(args[0], args[1]));
+    }
+
+    if (object_get_type(args[0]) == OBJECT_MAP) {
+        return object_make_bool(object_remove_map_value(args[0], args[1]));
+    }
+
     int ix = -1;
     for (int i = 0; i < object_get_array_length(args[0]); i++) {
         object_t obj = object_get_array_value_at(args[0], i);
@@ -671,6 +851,32 @@ static object_t remove_at_fn(vm_t *vm, void *data, int argc, object_t *args) {
     return object_make_bool(true);
 }
 
+static object_t push_front_fn(vm_t *vm, void *data, int argc, object_t *args) {
+    (void)data;
+    if (!CHECK_ARGS(vm, true, argc, args, OBJECT_ARRAY, OBJECT_ANY)) {
+        return object_make_null();
+    }
+    bool ok = object_add_array_value_front(args[0], args[1]);
+    if (!ok) {
+        return object_make_null();
+    }
+    int len = object_get_array_length(args[0]);
+    return object_make_int(vm->mem, len);
+}
+
+static object_t pop_front_fn(vm_t *vm, void *data, int argc, object_t *args) {
+    (void)data;
+    if (!CHECK_ARGS(vm, true, argc, args, OBJECT_ARRAY)) {
+        return object_make_null();
+    }
+    if (object_get_array_length(args[0]) == 0) {
+        return object_make_null();
+    }
+    object_t res = object_get_array_value_at(args[0], 0);
+    object_remove_array_value_at(args[0], 0);
+    return res;
+}
+
 
 static object_t error_fn(vm_t *vm, void *data, int argc, object_t *args) {
     (void)data;
@@ -710,14 +916,13 @@ static object_t random_seed_fn(vm_t *vm, void *data, int argc, object_t *args) {
     if (!CHECK_ARGS(vm, true, argc, args, OBJECT_NUMBER)) {
         return object_make_null();
     }
-    int seed = (int)object_get_number(args[0]);
-    srand(seed);
+    vm->random_state = (uint64_t)object_get_int(args[0]);
     return object_make_bool(true);
 }
 
 static object_t random_fn(vm_t *vm, void *data, int argc, object_t *args) {
     (void)data;
-    double res = (double)rand() / RAND_MAX;
+    double res = ape_random_next_double(&vm->random_state);
     if (argc == 0) {
         return object_make_number(res);
     } else if (argc == 2) {
@@ -741,13 +946,13 @@ static object_t random_fn(vm_t *vm, void *data, int argc, object_t *args) {
 
 static object_t slice_fn(vm_t *vm, void *data, int argc, object_t *args) {
     (void)data;
-    if (!CHECK_ARGS(vm, true, argc, args, OBJECT_STRING | OBJECT_ARRAY, OBJECT_NUMBER)) {
+    if (!CHECK_ARGS(vm, true, argc, args, OBJECT_STRING | OBJECT_ARRAY | OBJECT_RANGE, OBJECT_NUMBER)) {
         return object_make_null();
     }
     object_type_t arg_type = object_get_type(args[0]);
     int index = (int)object_get_number(args[1]);
-    if (arg_type == OBJECT_ARRAY) {
-        int len = object_get_array_length(args[0]);
+    if (arg_type == OBJECT_ARRAY || arg_type == OBJECT_RANGE) {
+        int len = sequence_get_length(args[0]);
         if (index < 0) {
             index = len + index;
             if (index < 0) {
@@ -759,7 +964,7 @@ static object_t slice_fn(vm_t *vm, void *data, int argc, object_t *args) {
             return object_make_null();
         }
         for (int i = index; i < len; i++) {
-            object_t item = object_get_array_value_at(args[0], i);
+            object_t item = sequence_get_value_at(args[0], i);
             bool ok = object_add_array_value(res, item);
             if (!ok) {
                 return object_make_null();
@@ -801,145 +1006,902 @@ static object_t slice_fn(vm_t *vm, void *data, int argc, object_t *args) {
 }
 
 //-----------------------------------------------------------------------------
-// Type checks
+// Sorting
 //-----------------------------------------------------------------------------
 
-static object_t is_string_fn(vm_t *vm, void *data, int argc, object_t *args) {
+typedef enum {
+    SORT_NUMBERS,
+    SORT_STRINGS,
+    SORT_COMPARATOR,
+} sort_mode_t;
+
+typedef struct sort_ctx {
+    vm_t *vm;
+    sort_mode_t mode;
+    object_t comparator;
+    bool failed;
+} sort_ctx_t;
+
+#define SORT_INSERTION_THRESHOLD 16
+
+static object_t sort_array(vm_t *vm, int argc, object_t *args, bool stable);
+static bool sort_less(sort_ctx_t *ctx, object_t a, object_t b);
+static int  sort_compare_strings(object_t a, object_t b);
+static void sort_swap(object_t *items, int a, int b);
+static void sort_insertion(sort_ctx_t *ctx, object_t *items, int lo, int hi);
+static void sort_heapsort(sort_ctx_t *ctx, object_t *items, int lo, int hi);
+static int  sort_partition(sort_ctx_t *ctx, object_t *items, int lo, int hi);
+static void sort_introsort(sort_ctx_t *ctx, object_t *items, int lo, int hi, int depth_limit);
+static void sort_merge_pass(sort_ctx_t *ctx, const object_t *src, object_t *dst, int len, int width);
+
+static object_t sort_fn(vm_t *vm, void *data, int argc, object_t *args) {
     (void)data;
-    if (!CHECK_ARGS(vm, true, argc, args, OBJECT_ANY)) {
-        return object_make_null();
-    }
-    return object_make_bool(object_get_type(args[0]) == OBJECT_STRING);
+    return sort_array(vm, argc, args, false);
 }
 
-static object_t is_array_fn(vm_t *vm, void *data, int argc, object_t *args) {
+static object_t sort_stable_fn(vm_t *vm, void *data, int argc, object_t *args) {
     (void)data;
-    if (!CHECK_ARGS(vm, true, argc, args, OBJECT_ANY)) {
-        return object_make_null();
-    }
-    return object_make_bool(object_get_type(args[0]) == OBJECT_ARRAY);
+    return sort_array(vm, argc, args, true);
 }
 
-static object_t is_map_fn(vm_t *vm, void *data, int argc, object_t *args) {
-    (void)data;
-    if (!CHECK_ARGS(vm, true, argc, args, OBJECT_ANY)) {
+// Sorts a copy of the array. Elements are only ever swapped so that every object stays
+// reachable from a gc-disabled array while a comparator runs (and possibly triggers gc).
+static object_t sort_array(vm_t *vm, int argc, object_t *args, bool stable) {
+    if (argc == 1) {
+        if (!CHECK_ARGS(vm, true, argc, args, OBJECT_ARRAY | OBJECT_RANGE)) {
+            return object_make_null();
+        }
+    } else if (!CHECK_ARGS(vm, true, argc, args, OBJECT_ARRAY | OBJECT_RANGE, OBJECT_FUNCTION | OBJECT_NATIVE_FUNCTION)) {
         return object_make_null();
     }
-    return object_make_bool(object_get_type(args[0]) == OBJECT_MAP);
-}
 
-static object_t is_number_fn(vm_t *vm, void *data, int argc, object_t *args){
-    (void)data;
-    if (!CHECK_ARGS(vm, true, argc, args, OBJECT_ANY)) {
-        return object_make_null();
+    object_t arr = args[0];
+    int len = sequence_get_length(arr);
+
+    sort_ctx_t ctx;
+    memset(&ctx, 0, sizeof(sort_ctx_t));
+    ctx.vm = vm;
+    ctx.comparator = argc == 2 ? args[1] : object_make_null();
+    if (argc == 2) {
+        ctx.mode = SORT_COMPARATOR;
+    } else {
+        bool all_numbers = true;
+        bool all_strings = true;
+        for (int i = 0; i < len; i++) {
+            object_type_t type = object_get_type(sequence_get_value_at(arr, i));
+            all_numbers = all_numbers && type == OBJECT_NUMBER;
+            all_strings = all_strings && type == OBJECT_STRING;
+        }
+        if (!all_numbers && !all_strings) {
+            errors_add_error(vm->errors, ERROR_RUNTIME, src_pos_invalid,
+                             "Sorting without a comparator requires an array of only numbers or only strings");
+            return object_make_null();
+        }
+        ctx.mode = all_numbers ? SORT_NUMBERS : SORT_STRINGS;
     }
-    return object_make_bool(object_get_type(args[0]) == OBJECT_NUMBER);
-}
 
-static object_t is_bool_fn(vm_t *vm, void *data, int argc, object_t *args) {
-    (void)data;
-    if (!CHECK_ARGS(vm, true, argc, args, OBJECT_ANY)) {
+    object_t res = object_make_array_with_capacity(vm->mem, len);
+    if (object_is_null(res)) {
         return object_make_null();
     }
-    return object_make_bool(object_get_type(args[0]) == OBJECT_BOOL);
-}
+    for (int i = 0; i < len; i++) {
+        bool ok = object_add_array_value(res, sequence_get_value_at(arr, i));
+        if (!ok) {
+            return object_make_null();
+        }
+    }
+    if (len < 2) {
+        return res;
+    }
 
-static object_t is_null_fn(vm_t *vm, void *data, int argc, object_t *args) {
-    (void)data;
-    if (!CHECK_ARGS(vm, true, argc, args, OBJECT_ANY)) {
-        return object_make_null();
+    object_t tmp = object_make_null();
+    if (stable) {
+        tmp = object_make_array_with_capacity(vm->mem, len);
+        if (object_is_null(tmp)) {
+            return object_make_null();
+        }
+        for (int i = 0; i < len; i++) {
+            bool ok = object_add_array_value(tmp, object_get_array_value_at(res, i));
+            if (!ok) {
+                return object_make_null();
+            }
+        }
     }
-    return object_make_bool(object_get_type(args[0]) == OBJECT_NULL);
-}
 
-static object_t is_function_fn(vm_t *vm, void *data, int argc, object_t *args) {
-    (void)data;
-    if (!CHECK_ARGS(vm, true, argc, args, OBJECT_ANY)) {
-        return object_make_null();
+    gc_disable_on_object(res);
+    gc_disable_on_object(tmp);
+
+    object_t *items = object_get_array_data(res);
+    if (stable) {
+        for (int lo = 0; lo < len; lo += SORT_INSERTION_THRESHOLD) {
+            int hi = lo + SORT_INSERTION_THRESHOLD < len ? lo + SORT_INSERTION_THRESHOLD : len;
+            sort_insertion(&ctx, items, lo, hi);
+        }
+        object_t *src = items;
+        object_t *dst = object_get_array_data(tmp);
+        for (int width = SORT_INSERTION_THRESHOLD; width < len && !ctx.failed; width *= 2) {
+            sort_merge_pass(&ctx, src, dst, len, width);
+            object_t *swap = src;
+            src = dst;
+            dst = swap;
+        }
+        if (src != items) {
+            memcpy(items, src, len * sizeof(object_t));
+        }
+    } else {
+        int depth_limit = 0;
+        for (int n = len; n > 1; n >>= 1) {
+            depth_limit += 2;
+        }
+        sort_introsort(&ctx, items, 0, len, depth_limit);
     }
-    return object_make_bool(object_get_type(args[0]) == OBJECT_FUNCTION);
-}
 
-static object_t is_external_fn(vm_t *vm, void *data, int argc, object_t *args) {
-    (void)data;
-    if (!CHECK_ARGS(vm, true, argc, args, OBJECT_ANY)) {
+    gc_enable_on_object(tmp);
+    gc_enable_on_object(res);
+
+    if (ctx.failed) {
         return object_make_null();
     }
-    return object_make_bool(object_get_type(args[0]) == OBJECT_EXTERNAL);
+    return res;
 }
 
-static object_t is_error_fn(vm_t *vm, void *data, int argc, object_t *args) {
-    (void)data;
-    if (!CHECK_ARGS(vm, true, argc, args, OBJECT_ANY)) {
-        return object_make_null();
+static bool sort_less(sort_ctx_t *ctx, object_t a, object_t b) {
+    switch (ctx->mode) {
+        case SORT_NUMBERS: {
+            return object_get_number(a) < object_get_number(b);
+        }
+        case SORT_STRINGS: {
+            return sort_compare_strings(a, b) < 0;
+        }
+        case SORT_COMPARATOR: {
+            if (ctx->failed) {
+                return false;
+            }
+            vm_t *vm = ctx->vm;
+            object_t res = vm_call(vm, vm->constants, ctx->comparator, 2, (object_t[]){a, b});
+            if (vm_has_errors(vm)) {
+                ctx->failed = true;
+                return false;
+            }
+            object_type_t res_type = object_get_type(res);
+            if (res_type != OBJECT_NUMBER) {
+                errors_add_errorf(vm->errors, ERROR_RUNTIME, src_pos_invalid,
+                                  "Sort comparator returned %s instead of NUMBER", object_get_type_name(res_type));
+                ctx->failed = true;
+                return false;
+            }
+            return object_get_number(res) < 0;
+        }
     }
-    return object_make_bool(object_get_type(args[0]) == OBJECT_ERROR);
+    return false;
 }
 
-static object_t is_native_function_fn(vm_t *vm, void *data, int argc, object_t *args) {
-    (void)data;
-    if (!CHECK_ARGS(vm, true, argc, args, OBJECT_ANY)) {
-        return object_make_null();
+static int sort_compare_strings(object_t a, object_t b) {
+    int a_len = object_get_string_length(a);
+    int b_len = object_get_string_length(b);
+    int res = memcmp(object_get_string(a), object_get_string(b), a_len < b_len ? a_len : b_len);
+    if (res != 0) {
+        return res;
     }
-    return object_make_bool(object_get_type(args[0]) == OBJECT_NATIVE_FUNCTION);
+    return a_len - b_len;
 }
 
-//-----------------------------------------------------------------------------
-// Math
-//-----------------------------------------------------------------------------
+static void sort_swap(object_t *items, int a, int b) {
+    object_t tmp = items[a];
+    items[a] = items[b];
+    items[b] = tmp;
+}
 
-static object_t sqrt_fn(vm_t *vm, void *data, int argc, object_t *args) {
-    (void)data;
-    if (!CHECK_ARGS(vm, true, argc, args, OBJECT_NUMBER)) {
-        return object_make_null();
+static void sort_insertion(sort_ctx_t *ctx, object_t *items, int lo, int hi) {
+    for (int i = lo + 1; i < hi; i++) {
+        for (int j = i; j > lo && sort_less(ctx, items[j], items[j - 1]); j--) {
+            sort_swap(items, j, j - 1);
+        }
     }
-    double arg = object_get_number(args[0]);
-    double res = sqrt(arg);
-    return object_make_number(res);
 }
 
-static object_t pow_fn(vm_t *vm, void *data, int argc, object_t *args) {
-    (void)data;
-    if (!CHECK_ARGS(vm, true, argc, args, OBJECT_NUMBER, OBJECT_NUMBER)) {
-        return object_make_null();
+static void sort_sift_down(sort_ctx_t *ctx, object_t *items, int lo, int root, int count) {
+    for (;;) {
+        int child = 2 * root + 1;
+        if (child >= count) {
+            return;
+        }
+        if (child + 1 < count && sort_less(ctx, items[lo + child], items[lo + child + 1])) {
+            child++;
+        }
+        if (!sort_less(ctx, items[lo + root], items[lo + child])) {
+            return;
+        }
+        sort_swap(items, lo + root, lo + child);
+        root = child;
     }
-    double arg1 = object_get_number(args[0]);
-    double arg2 = object_get_number(args[1]);
-    double res = pow(arg1, arg2);
-    return object_make_number(res);
 }
 
-static object_t sin_fn(vm_t *vm, void *data, int argc, object_t *args) {
-    (void)data;
-    if (!CHECK_ARGS(vm, true, argc, args, OBJECT_NUMBER)) {
-        return object_make_null();
+static void sort_heapsort(sort_ctx_t *ctx, object_t *items, int lo, int hi) {
+    int count = hi - lo;
+    for (int i = count / 2 - 1; i >= 0; i--) {
+        sort_sift_down(ctx, items, lo, i, count);
+    }
+    for (int end = count - 1; end > 0 && !ctx->failed; end--) {
+        sort_swap(items, lo, lo + end);
+        sort_sift_down(ctx, items, lo, 0, end);
     }
-    double arg = object_get_number(args[0]);
-    double res = sin(arg);
-    return object_make_number(res);
 }
 
-static object_t cos_fn(vm_t *vm, void *data, int argc, object_t *args) {
-    (void)data;
-    if (!CHECK_ARGS(vm, true, argc, args, OBJECT_NUMBER)) {
-        return object_make_null();
+// Pivot is expected at items[lo]. Scans are bounds checked so inconsistent comparators
+// (or NaNs) can produce an odd order but never read outside of the range.
+static int sort_partition(sort_ctx_t *ctx, object_t *items, int lo, int hi) {
+    int i = lo + 1;
+    int j = hi - 1;
+    for (;;) {
+        while (i <= j && sort_less(ctx, items[i], items[lo])) {
+            i++;
+        }
+        while (i <= j && sort_less(ctx, items[lo], items[j])) {
+            j--;
+        }
+        if (i >= j) {
+            break;
+        }
+        sort_swap(items, i, j);
+        i++;
+        j--;
     }
-    double arg = object_get_number(args[0]);
-    double res = cos(arg);
-    return object_make_number(res);
+    sort_swap(items, lo, j);
+    return j;
 }
 
-static object_t tan_fn(vm_t *vm, void *data, int argc, object_t *args) {
-    (void)data;
-    if (!CHECK_ARGS(vm, true, argc, args, OBJECT_NUMBER)) {
-        return object_make_null();
+static void sort_introsort(sort_ctx_t *ctx, object_t *items, int lo, int hi, int depth_limit) {
+    while (hi - lo > SORT_INSERTION_THRESHOLD) {
+        if (ctx->failed) {
+            return;
+        }
+        if (depth_limit == 0) {
+            sort_heapsort(ctx, items, lo, hi);
+            return;
+        }
+        depth_limit--;
+
+        // median of three moved to items[lo]
+        int a = lo + 1;
+        int b = lo + (hi - lo) / 2;
+        int c = hi - 1;
+        if (sort_less(ctx, items[b], items[a])) {
+            sort_swap(items, a, b);
+        }
+        if (sort_less(ctx, items[c], items[b])) {
+            sort_swap(items, b, c);
+            if (sort_less(ctx, items[b], items[a])) {
+                sort_swap(items, a, b);
+            }
+        }
+        sort_swap(items, lo, b);
+
+        int p = sort_partition(ctx, items, lo, hi);
+        if (p - lo < hi - p) {
+            sort_introsort(ctx, items, lo, p, depth_limit);
+            lo = p + 1;
+        } else {
+            sort_introsort(ctx, items, p + 1, hi, depth_limit);
+            hi = p;
+        }
     }
-    double arg = object_get_number(args[0]);
-    double res = tan(arg);
-    return object_make_number(res);
+    sort_insertion(ctx, items, lo, hi);
 }
 
-static object_t log_fn(vm_t *vm, void *data, int argc, object_t *args) {
+static void sort_merge_pass(sort_ctx_t *ctx, const object_t *src, object_t *dst, int len, int width) {
+    for (int lo = 0; lo < len; lo += 2 * width) {
+        int mid = lo + width < len ? lo + width : len;
+        int hi = lo + 2 * width < len ? lo + 2 * width : len;
+        int i = lo;
+        int j = mid;
+        int k = lo;
+        while (i < mid && j < hi) {
+            if (sort_less(ctx, src[j], src[i])) {
+                dst[k++] = src[j++];
+            } else {
+                dst[k++] = src[i++];
+            }
+        }
+        while (i < mid) {
+            dst[k++] = src[i++];
+        }
+        while (j < hi) {
+            dst[k++] = src[j++];
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Higher order functions
+//-----------------------------------------------------------------------------
+
+// Callbacks get (item) or (item, index), reduce's get (acc, item) or (acc, item, index).
+// The callee is prepared once and then called through vm_call_prepared for every item.
+// Array length is re-read on every iteration because callbacks may modify the array.
+
+static int sequence_get_length(object_t seq) {
+    object_type_t type = object_get_type(seq);
+    if (type == OBJECT_RANGE) {
+        return object_get_range_length(seq);
+    } else if (type == OBJECT_TYPED_ARRAY) {
+        return object_get_typed_array_length(seq);
+    } else if (type == OBJECT_SET) {
+        return object_get_set_length(seq);
+    }
+    return object_get_array_length(seq);
+}
+
+static object_t sequence_get_value_at(object_t seq, int ix) {
+    object_type_t type = object_get_type(seq);
+    if (type == OBJECT_RANGE) {
+        return object_get_range_value_at(seq, ix);
+    } else if (type == OBJECT_TYPED_ARRAY) {
+        return object_get_typed_array_value_at(seq, ix);
+    } else if (type == OBJECT_SET) {
+        return object_get_set_value_at(seq, ix);
+    }
+    return object_get_array_value_at(seq, ix);
+}
+
+static object_t map_fn(vm_t *vm, void *data, int argc, object_t *args) {
+    (void)data;
+    if (!CHECK_ARGS(vm, true, argc, args, OBJECT_ARRAY | OBJECT_RANGE | OBJECT_TYPED_ARRAY | OBJECT_SET, OBJECT_FUNCTION | OBJECT_NATIVE_FUNCTION)) {
+        return object_make_null();
+    }
+    object_t arr = args[0];
+    vm_prepared_call_t call;
+    if (!vm_prepare_call(vm, args[1], 1, 2, &call)) {
+        return object_make_null();
+    }
+    object_t res = object_make_array_with_capacity(vm->mem, sequence_get_length(arr));
+    if (object_is_null(res)) {
+        return object_make_null();
+    }
+    gc_disable_on_object(res);
+    for (int i = 0; i < sequence_get_length(arr); i++) {
+        object_t call_args[2] = {sequence_get_value_at(arr, i), object_make_int(vm->mem, i)};
+        object_t val = vm_call_prepared(vm, &call, call_args);
+        if (vm_has_errors(vm)) {
+            gc_enable_on_object(res);
+            return object_make_null();
+        }
+        bool ok = object_add_array_value(res, val);
+        if (!ok) {
+            gc_enable_on_object(res);
+            return object_make_null();
+        }
+    }
+    gc_enable_on_object(res);
+    return res;
+}
+
+// Same as map, but items are split into chunks mapped on worker threads when there's more than one core.
+// Every call gets its own random state derived from the item's index, so results are the same however
+// items are split, including when mapped sequentially.
+static object_t parallel_map_fn(vm_t *vm, void *data, int argc, object_t *args) {
+    (void)data;
+    if (argc == 2) {
+        if (!CHECK_ARGS(vm, true, argc, args, OBJECT_ARRAY | OBJECT_RANGE | OBJECT_TYPED_ARRAY | OBJECT_SET, OBJECT_FUNCTION | OBJECT_NATIVE_FUNCTION)) {
+            return object_make_null();
+        }
+    } else if (!CHECK_ARGS(vm, true, argc, args, OBJECT_ARRAY | OBJECT_RANGE | OBJECT_TYPED_ARRAY | OBJECT_SET, OBJECT_FUNCTION | OBJECT_NATIVE_FUNCTION, OBJECT_NUMBER | OBJECT_NULL)) {
+        return object_make_null();
+    }
+    int chunk_size = 0; // picked by parallel_map
+    if (argc == 3 && object_get_type(args[2]) == OBJECT_NUMBER) {
+        double chunk_size_dbl = object_get_number(args[2]);
+        if (!(chunk_size_dbl >= 1)) {
+            errors_add_errorf(vm->errors, ERROR_RUNTIME, src_pos_invalid, "Chunk size must be at least 1, got %1.17g", chunk_size_dbl);
+            return object_make_null();
+        }
+        chunk_size = chunk_size_dbl > INT_MAX ? INT_MAX : (int)chunk_size_dbl;
+    }
+    object_t arr = args[0];
+    vm_prepared_call_t call;
+    if (!vm_prepare_call(vm, args[1], 1, 2, &call)) {
+        return object_make_null();
+    }
+    uint64_t random_seed = ape_random_next(&vm->random_state);
+    uint64_t random_state = vm->random_state;
+    object_t res = object_make_null();
+    if (parallel_map(vm, arr, sequence_get_length(arr), sequence_get_value_at, args[1], chunk_size, random_seed, &res)) {
+        return res;
+    }
+
+    res = object_make_array_with_capacity(vm->mem, sequence_get_length(arr));
+    if (object_is_null(res)) {
+        return object_make_null();
+    }
+    gc_disable_on_object(res);
+    for (int i = 0; i < sequence_get_length(arr); i++) {
+        object_t call_args[2] = {sequence_get_value_at(arr, i), object_make_int(vm->mem, i)};
+        vm->random_state = parallel_item_random_state(random_seed, i);
+        object_t val = vm_call_prepared(vm, &call, call_args);
+        if (vm_has_errors(vm)) {
+            vm->random_state = random_state;
+            gc_enable_on_object(res);
+            return object_make_null();
+        }
+        bool ok = object_add_array_value(res, val);
+        if (!ok) {
+            vm->random_state = random_state;
+            gc_enable_on_object(res);
+            return object_make_null();
+        }
+    }
+    vm->random_state = random_state;
+    gc_enable_on_object(res);
+    return res;
+}
+
+static object_t filter_fn(vm_t *vm, void *data, int argc, object_t *args) {
+    (void)data;
+    if (!CHECK_ARGS(vm, true, argc, args, OBJECT_ARRAY | OBJECT_RANGE | OBJECT_TYPED_ARRAY | OBJECT_SET, OBJECT_FUNCTION | OBJECT_NATIVE_FUNCTION)) {
+        return object_make_null();
+    }
+    object_t arr = args[0];
+    vm_prepared_call_t call;
+    if (!vm_prepare_call(vm, args[1], 1, 2, &call)) {
+        return object_make_null();
+    }
+    object_t res = object_make_array_with_capacity(vm->mem, sequence_get_length(arr));
+    if (object_is_null(res)) {
+        return object_make_null();
+    }
+    gc_disable_on_object(res);
+    for (int i = 0; i < sequence_get_length(arr); i++) {
+        object_t item = sequence_get_value_at(arr, i);
+        object_t call_args[2] = {item, object_make_int(vm->mem, i)};
+        object_t keep = vm_call_prepared(vm, &call, call_args);
+        if (vm_has_errors(vm)) {
+            gc_enable_on_object(res);
+            return object_make_null();
+        }
+        if (!object_get_bool(keep)) {
+            continue;
+        }
+        bool ok = object_add_array_value(res, item);
+        if (!ok) {
+            gc_enable_on_object(res);
+            return object_make_null();
+        }
+    }
+    gc_enable_on_object(res);
+    return res;
+}
+
+static object_t reduce_fn(vm_t *vm, void *data, int argc, object_t *args) {
+    (void)data;
+    if (argc == 2) {
+        if (!CHECK_ARGS(vm, true, argc, args, OBJECT_ARRAY | OBJECT_RANGE | OBJECT_TYPED_ARRAY | OBJECT_SET, OBJECT_FUNCTION | OBJECT_NATIVE_FUNCTION)) {
+            return object_make_null();
+        }
+    } else if (!CHECK_ARGS(vm, true, argc, args, OBJECT_ARRAY | OBJECT_RANGE | OBJECT_TYPED_ARRAY | OBJECT_SET, OBJECT_FUNCTION | OBJECT_NATIVE_FUNCTION, OBJECT_ANY)) {
+        return object_make_null();
+    }
+    object_t arr = args[0];
+    int start = 0;
+    object_t acc = object_make_null();
+    if (argc == 3) {
+        acc = args[2];
+    } else if (sequence_get_length(arr) > 0) {
+        acc = sequence_get_value_at(arr, 0);
+        start = 1;
+    } else {
+        errors_add_error(vm->errors, ERROR_RUNTIME, src_pos_invalid,
+                         "Cannot reduce an empty array without an initial value");
+        return object_make_null();
+    }
+    vm_prepared_call_t call;
+    if (!vm_prepare_call(vm, args[1], 2, 3, &call)) {
+        return object_make_null();
+    }
+    // accumulator is only referenced from C between calls, keep it in a gc-disabled array
+    object_t holder = object_make_array_with_capacity(vm->mem, 1);
+    if (object_is_null(holder)) {
+        return object_make_null();
+    }
+    if (!object_add_array_value(holder, acc)) {
+        return object_make_null();
+    }
+    gc_disable_on_object(holder);
+    for (int i = start; i < sequence_get_length(arr); i++) {
+        object_t call_args[3] = {acc, sequence_get_value_at(arr, i), object_make_int(vm->mem, i)};
+        acc = vm_call_prepared(vm, &call, call_args);
+        if (vm_has_errors(vm)) {
+            gc_enable_on_object(holder);
+            return object_make_null();
+        }
+        object_set_array_value_at(holder, 0, acc);
+    }
+    gc_enable_on_object(holder);
+    return acc;
+}
+
+static object_t each_fn(vm_t *vm, void *data, int argc, object_t *args) {
+    (void)data;
+    if (!CHECK_ARGS(vm, true, argc, args, OBJECT_ARRAY | OBJECT_RANGE | OBJECT_TYPED_ARRAY | OBJECT_SET, OBJECT_FUNCTION | OBJECT_NATIVE_FUNCTION)) {
+        return object_make_null();
+    }
+    object_t arr = args[0];
+    vm_prepared_call_t call;
+    if (!vm_prepare_call(vm, args[1], 1, 2, &call)) {
+        return object_make_null();
+    }
+    for (int i = 0; i < sequence_get_length(arr); i++) {
+        object_t call_args[2] = {sequence_get_value_at(arr, i), object_make_int(vm->mem, i)};
+        vm_call_prepared(vm, &call, call_args);
+        if (vm_has_errors(vm)) {
+            return object_make_null();
+        }
+    }
+    return object_make_null();
+}
+
+//-----------------------------------------------------------------------------
+// Typed arrays
+//-----------------------------------------------------------------------------
+
+// xx_array(len) makes a zeroed typed array, xx_array(seq) converts an array, range or another typed array.
+
+static object_t make_typed_array(vm_t *vm, typed_array_type_t type, int argc, object_t *args) {
+    if (!CHECK_ARGS(vm, true, argc, args, OBJECT_NUMBER | OBJECT_ARRAY | OBJECT_RANGE | OBJECT_TYPED_ARRAY)) {
+        return object_make_null();
+    }
+    object_t arg = args[0];
+    if (object_get_type(arg) == OBJECT_NUMBER) {
+        int len = (int)object_get_number(arg);
+        if (len < 0) {
+            errors_add_errorf(vm->errors, ERROR_RUNTIME, src_pos_invalid, "Invalid typed array length: %d", len);
+            return object_make_null();
+        }
+        return object_make_typed_array(vm->mem, type, len);
+    }
+    int len = sequence_get_length(arg);
+    object_t res = object_make_typed_array(vm->mem, type, len);
+    if (object_is_null(res)) {
+        return object_make_null();
+    }
+    for (int i = 0; i < len; i++) {
+        object_t item = sequence_get_value_at(arg, i);
+        if (object_get_type(item) != OBJECT_NUMBER) {
+            errors_add_errorf(vm->errors, ERROR_RUNTIME, src_pos_invalid,
+                              "Cannot store %s in %s typed array", object_get_type_name(object_get_type(item)),
+                              typed_array_type_get_name(type));
+            return object_make_null();
+        }
+        object_set_typed_array_value_at(res, i, item);
+    }
+    return res;
+}
+
+static object_t u8_array_fn(vm_t *vm, void *data, int argc, object_t *args) {
+    (void)data;
+    return make_typed_array(vm, TYPED_ARRAY_U8, argc, args);
+}
+
+static object_t i32_array_fn(vm_t *vm, void *data, int argc, object_t *args) {
+    (void)data;
+    return make_typed_array(vm, TYPED_ARRAY_I32, argc, args);
+}
+
+static object_t i64_array_fn(vm_t *vm, void *data, int argc, object_t *args) {
+    (void)data;
+    return make_typed_array(vm, TYPED_ARRAY_I64, argc, args);
+}
+
+static object_t f32_array_fn(vm_t *vm, void *data, int argc, object_t *args) {
+    (void)data;
+    return make_typed_array(vm, TYPED_ARRAY_F32, argc, args);
+}
+
+static object_t f64_array_fn(vm_t *vm, void *data, int argc, object_t *args) {
+    (void)data;
+    return make_typed_array(vm, TYPED_ARRAY_F64, argc, args);
+}
+
+//-----------------------------------------------------------------------------
+// Sets
+//-----------------------------------------------------------------------------
+
+// Sets share objmap with maps (keys only), so values are hashed and compared the same way as map keys.
+// union, intersection and difference return new sets ordered like their first argument.
+
+static bool set_add_checked(vm_t *vm, object_t set, object_t val) {
+    if (!object_is_hashable(val)) {
+        errors_add_errorf(vm->errors, ERROR_RUNTIME, src_pos_invalid,
+                          "Value of type %s is not hashable", object_get_type_name(object_get_type(val)));
+        return false;
+    }
+    return object_set_add(set, val);
+}
+
+static object_t set_fn(vm_t *vm, void *data, int argc, object_t *args) {
+    (void)data;
+    if (argc == 0) {
+        return object_make_set(vm->mem, 0);
+    }
+    if (!CHECK_ARGS(vm, true, argc, args, OBJECT_ARRAY | OBJECT_RANGE | OBJECT_TYPED_ARRAY | OBJECT_SET)) {
+        return object_make_null();
+    }
+    object_t seq = args[0];
+    int len = sequence_get_length(seq);
+    object_t res = object_make_set(vm->mem, len);
+    if (object_is_null(res)) {
+        return object_make_null();
+    }
+    for (int i = 0; i < len; i++) {
+        if (!set_add_checked(vm, res, sequence_get_value_at(seq, i))) {
+            return object_make_null();
+        }
+    }
+    return res;
+}
+
+static object_t has_fn(vm_t *vm, void *data, int argc, object_t *args) {
+    (void)data;
+    if (!CHECK_ARGS(vm, true, argc, args, OBJECT_SET | OBJECT_MAP, OBJECT_ANY)) {
+        return object_make_null();
+    }
+    if (object_get_type(args[0]) == OBJECT_MAP) {
+        return object_make_bool(object_map_has_key(args[0], args[1]));
+    }
+    return object_make_bool(object_set_has(args[0], args[1]));
+}
+
+static object_t union_fn(vm_t *vm, void *data, int argc, object_t *args) {
+    (void)data;
+    if (!CHECK_ARGS(vm, true, argc, args, OBJECT_SET, OBJECT_SET)) {
+        return object_make_null();
+    }
+    int a_len = object_get_set_length(args[0]);
+    int b_len = object_get_set_length(args[1]);
+    object_t res = object_make_set(vm->mem, a_len + b_len);
+    if (object_is_null(res)) {
+        return object_make_null();
+    }
+    for (int i = 0; i < a_len; i++) {
+        if (!object_set_add(res, object_get_set_value_at(args[0], i))) {
+            return object_make_null();
+        }
+    }
+    for (int i = 0; i < b_len; i++) {
+        if (!object_set_add(res, object_get_set_value_at(args[1], i))) {
+            return object_make_null();
+        }
+    }
+    return res;
+}
+
+static object_t intersection_fn(vm_t *vm, void *data, int argc, object_t *args) {
+    (void)data;
+    if (!CHECK_ARGS(vm, true, argc, args, OBJECT_SET, OBJECT_SET)) {
+        return object_make_null();
+    }
+    int a_len = object_get_set_length(args[0]);
+    int b_len = object_get_set_length(args[1]);
+    object_t res = object_make_set(vm->mem, a_len < b_len ? a_len : b_len);
+    if (object_is_null(res)) {
+        return object_make_null();
+    }
+    for (int i = 0; i < a_len; i++) {
+        object_t val = object_get_set_value_at(args[0], i);
+        if (object_set_has(args[1], val) && !object_set_add(res, val)) {
+            return object_make_null();
+        }
+    }
+    return res;
+}
+
+static object_t difference_fn(vm_t *vm, void *data, int argc, object_t *args) {
+    (void)data;
+    if (!CHECK_ARGS(vm, true, argc, args, OBJECT_SET, OBJECT_SET)) {
+        return object_make_null();
+    }
+    int a_len = object_get_set_length(args[0]);
+    object_t res = object_make_set(vm->mem, a_len);
+    if (object_is_null(res)) {
+        return object_make_null();
+    }
+    for (int i = 0; i < a_len; i++) {
+        object_t val = object_get_set_value_at(args[0], i);
+        if (!object_set_has(args[1], val) && !object_set_add(res, val)) {
+            return object_make_null();
+        }
+    }
+    return res;
+}
+
+//-----------------------------------------------------------------------------
+// Type checks
+//-----------------------------------------------------------------------------
+
+static object_t is_string_fn(vm_t *vm, void *data, int argc, object_t *args) {
+    (void)data;
+    if (!CHECK_ARGS(vm, true, argc, args, OBJECT_ANY)) {
+        return object_make_null();
+    }
+    return object_make_bool(object_get_type(args[0]) == OBJECT_STRING);
+}
+
+static object_t is_array_fn(vm_t *vm, void *data, int argc, object_t *args) {
+    (void)data;
+    if (!CHECK_ARGS(vm, true, argc, args, OBJECT_ANY)) {
+        return object_make_null();
+    }
+    return object_make_bool(object_get_type(args[0]) == OBJECT_ARRAY);
+}
+
+static object_t is_map_fn(vm_t *vm, void *data, int argc, object_t *args) {
+    (void)data;
+    if (!CHECK_ARGS(vm, true, argc, args, OBJECT_ANY)) {
+        return object_make_null();
+    }
+    return object_make_bool(object_get_type(args[0]) == OBJECT_MAP);
+}
+
+static object_t is_number_fn(vm_t *vm, void *data, int argc, object_t *args){
+    (void)data;
+    if (!CHECK_ARGS(vm, true, argc, args, OBJECT_ANY)) {
+        return object_make_null();
+    }
+    return object_make_bool(object_get_type(args[0]) == OBJECT_NUMBER);
+}
+
+static object_t is_int_fn(vm_t *vm, void *data, int argc, object_t *args) {
+    (void)data;
+    if (!CHECK_ARGS(vm, true, argc, args, OBJECT_ANY)) {
+        return object_make_null();
+    }
+    return object_make_bool(object_is_int(args[0]));
+}
+
+static object_t is_bool_fn(vm_t *vm, void *data, int argc, object_t *args) {
+    (void)data;
+    if (!CHECK_ARGS(vm, true, argc, args, OBJECT_ANY)) {
+        return object_make_null();
+    }
+    return object_make_bool(object_get_type(args[0]) == OBJECT_BOOL);
+}
+
+static object_t is_null_fn(vm_t *vm, void *data, int argc, object_t *args) {
+    (void)data;
+    if (!CHECK_ARGS(vm, true, argc, args, OBJECT_ANY)) {
+        return object_make_null();
+    }
+    return object_make_bool(object_get_type(args[0]) == OBJECT_NULL);
+}
+
+static object_t is_function_fn(vm_t *vm, void *data, int argc, object_t *args) {
+    (void)data;
+    if (!CHECK_ARGS(vm, true, argc, args, OBJECT_ANY)) {
+        return object_make_null();
+    }
+    return object_make_bool(object_get_type(args[0]) == OBJECT_FUNCTION);
+}
+
+static object_t is_external_fn(vm_t *vm, void *data, int argc, object_t *args) {
+    (void)data;
+    if (!CHECK_ARGS(vm, true, argc, args, OBJECT_ANY)) {
+        return object_make_null();
+    }
+    return object_make_bool(object_get_type(args[0]) == OBJECT_EXTERNAL);
+}
+
+static object_t is_typed_array_fn(vm_t *vm, void *data, int argc, object_t *args) {
+    (void)data;
+    if (!CHECK_ARGS(vm, true, argc, args, OBJECT_ANY)) {
+        return object_make_null();
+    }
+    return object_make_bool(object_get_type(args[0]) == OBJECT_TYPED_ARRAY);
+}
+
+static object_t is_range_fn(vm_t *vm, void *data, int argc, object_t *args) {
+    (void)data;
+    if (!CHECK_ARGS(vm, true, argc, args, OBJECT_ANY)) {
+        return object_make_null();
+    }
+    return object_make_bool(object_get_type(args[0]) == OBJECT_RANGE);
+}
+
+static object_t is_struct_fn(vm_t *vm, void *data, int argc, object_t *args) {
+    (void)data;
+    if (argc == 2) {
+        if (!CHECK_ARGS(vm, true, argc, args, OBJECT_ANY, OBJECT_STRUCT_TYPE)) {
+            return object_make_null();
+        }
+        if (object_get_type(args[0]) != OBJECT_STRUCT) {
+            return object_make_bool(false);
+        }
+        return object_make_bool(object_get_struct_type(args[0]).handle == args[1].handle);
+    }
+    if (!CHECK_ARGS(vm, true, argc, args, OBJECT_ANY)) {
+        return object_make_null();
+    }
+    return object_make_bool(object_get_type(args[0]) == OBJECT_STRUCT);
+}
+
+static object_t is_set_fn(vm_t *vm, void *data, int argc, object_t *args) {
+    (void)data;
+    if (!CHECK_ARGS(vm, true, argc, args, OBJECT_ANY)) {
+        return object_make_null();
+    }
+    return object_make_bool(object_get_type(args[0]) == OBJECT_SET);
+}
+
+static object_t is_error_fn(vm_t *vm, void *data, int argc, object_t *args) {
+    (void)data;
+    if (!CHECK_ARGS(vm, true, argc, args, OBJECT_ANY)) {
+        return object_make_null();
+    }
+    return object_make_bool(object_get_type(args[0]) == OBJECT_ERROR);
+}
+
+static object_t is_native_function_fn(vm_t *vm, void *data, int argc, object_t *args) {
+    (void)data;
+    if (!CHECK_ARGS(vm, true, argc, args, OBJECT_ANY)) {
+        return object_make_null();
+    }
+    return object_make_bool(object_get_type(args[0]) == OBJECT_NATIVE_FUNCTION);
+}
+
+//-----------------------------------------------------------------------------
+// Math
+//-----------------------------------------------------------------------------
+
+static object_t sqrt_fn(vm_t *vm, void *data, int argc, object_t *args) {
+    (void)data;
+    if (!CHECK_ARGS(vm, true, argc, args, OBJECT_NUMBER)) {
+        return object_make_null();
+    }
+    double arg = object_get_number(args[0]);
+    double res = sqrt(arg);
+    return object_make_number(res);
+}
+
+static object_t pow_fn(vm_t *vm, void *data, int argc, object_t *args) {
+    (void)data;
+    if (!CHECK_ARGS(vm, true, argc, args, OBJECT_NUMBER, OBJECT_NUMBER)) {
+        return object_make_null();
+    }
+    double arg1 = object_get_number(args[0]);
+    double arg2 = object_get_number(args[1]);
+    double res = pow(arg1, arg2);
+    return object_make_number(res);
+}
+
+static object_t sin_fn(vm_t *vm, void *data, int argc, object_t *args) {
+    (void)data;
+    if (!CHECK_ARGS(vm, true, argc, args, OBJECT_NUMBER)) {
+        return object_make_null();
+    }
+    double arg = object_get_number(args[0]);
+    double res = sin(arg);
+    return object_make_number(res);
+}
+
+static object_t cos_fn(vm_t *vm, void *data, int argc, object_t *args) {
+    (void)data;
+    if (!CHECK_ARGS(vm, true, argc, args, OBJECT_NUMBER)) {
+        return object_make_null();
+    }
+    double arg = object_get_number(args[0]);
+    double res = cos(arg);
+    return object_make_number(res);
+}
+
+static object_t tan_fn(vm_t *vm, void *data, int argc, object_t *args) {
+    (void)data;
+    if (!CHECK_ARGS(vm, true, argc, args, OBJECT_NUMBER)) {
+        return object_make_null();
+    }
+    double arg = object_get_number(args[0]);
+    double res = tan(arg);
+    return object_make_number(res);
+}
+
+static object_t log_fn(vm_t *vm, void *data, int argc, object_t *args) {
     (void)data;
     if (!CHECK_ARGS(vm, true, argc, args, OBJECT_NUMBER)) {
         return object_make_null();
@@ -979,6 +1941,240 @@ static object_t abs_fn(vm_t *vm, void *data, int argc, object_t *args) {
     return object_make_number(res);
 }
 
+//-----------------------------------------------------------------------------
+// Numeric arrays
+//-----------------------------------------------------------------------------
+
+// Items of arrays, typed arrays and ranges are read where they're stored and converted while iterating,
+// arrays of doubles and f64 typed arrays are read as double arrays. Arrays flagged by
+// object_array_has_only_numbers skip the type checks, other arrays are checked once. Ints are added
+// and multiplied exactly until the result overflows and is promoted to a double, the same as in the vm.
+typedef struct numbers {
+    object_t seq;
+    object_type_t type;
+    object_t *items; // OBJECT_ARRAY
+    void *data;      // OBJECT_TYPED_ARRAY
+    typed_array_type_t data_type;
+    int len;
+} numbers_t;
+
+static bool numbers_init(vm_t *vm, object_t seq, numbers_t *out_nums) {
+    memset(out_nums, 0, sizeof(numbers_t));
+    out_nums->seq = seq;
+    out_nums->type = object_get_type(seq);
+    if (out_nums->type == OBJECT_RANGE) {
+        out_nums->len = object_get_range_length(seq);
+        return true;
+    } else if (out_nums->type == OBJECT_TYPED_ARRAY) {
+        out_nums->data = object_get_typed_array_data(seq);
+        out_nums->data_type = object_get_typed_array_type(seq);
+        out_nums->len = object_get_typed_array_length(seq);
+        return true;
+    }
+    out_nums->items = object_get_array_data(seq);
+    out_nums->len = object_get_array_length(seq);
+    if (object_array_has_only_numbers(seq)) {
+        return true;
+    }
+    for (int i = 0; i < out_nums->len; i++) {
+        if (object_get_type(out_nums->items[i]) != OBJECT_NUMBER) {
+            errors_add_error(vm->errors, ERROR_RUNTIME, src_pos_invalid, "Array contains items that are not numbers");
+            return false;
+        }
+    }
+    return true;
+}
+
+// NULL unless every item is a double
+static double* numbers_get_doubles(const numbers_t *nums) {
+    double *res = NULL;
+    if (nums->type == OBJECT_ARRAY) {
+        object_get_array_doubles(nums->seq, &res);
+    } else if (nums->type == OBJECT_TYPED_ARRAY && nums->data_type == TYPED_ARRAY_F64) {
+        res = nums->data;
+    }
+    return res;
+}
+
+// false for doubles
+static bool numbers_get_int(const numbers_t *nums, int ix, int64_t *out_val) {
+    if (nums->type == OBJECT_RANGE) {
+        *out_val = object_get_small_int(object_get_range_value_at(nums->seq, ix));
+        return true;
+    } else if (nums->type == OBJECT_TYPED_ARRAY) {
+        switch (nums->data_type) {
+            case TYPED_ARRAY_U8:  *out_val = ((uint8_t*)nums->data)[ix]; return true;
+            case TYPED_ARRAY_I32: *out_val = ((int32_t*)nums->data)[ix]; return true;
+            case TYPED_ARRAY_I64: *out_val = ((int64_t*)nums->data)[ix]; return true;
+            default:              return false;
+        }
+    }
+    object_t item = nums->items[ix];
+    if (object_is_small_int(item)) {
+        *out_val = object_get_small_int(item);
+        return true;
+    } else if (object_is_double(item)) {
+        return false;
+    }
+    *out_val = object_get_int(item);
+    return true;
+}
+
+static double numbers_get_double(const numbers_t *nums, int ix) {
+    if (nums->type == OBJECT_TYPED_ARRAY && nums->data_type == TYPED_ARRAY_F32) {
+        return ((float*)nums->data)[ix];
+    } else if (nums->type == OBJECT_TYPED_ARRAY && nums->data_type == TYPED_ARRAY_F64) {
+        return ((double*)nums->data)[ix];
+    } else if (nums->type != OBJECT_ARRAY) {
+        int64_t val = 0;
+        numbers_get_int(nums, ix, &val);
+        return (double)val;
+    }
+    object_t item = nums->items[ix];
+    if (object_is_double(item)) {
+        return item.number;
+    } else if (object_is_small_int(item)) {
+        return (double)object_get_small_int(item);
+    }
+    return object_get_number(item);
+}
+
+static double numbers_multiply(const numbers_t *a, const numbers_t *b, int ix) {
+    int64_t a_val = 0;
+    int64_t b_val = 0;
+    int64_t res = 0;
+    if (numbers_get_int(a, ix, &a_val) && numbers_get_int(b, ix, &b_val) && ape_int64_mul(a_val, b_val, &res)) {
+        return (double)res;
+    }
+    return numbers_get_double(a, ix) * numbers_get_double(b, ix);
+}
+
+static object_t sum_fn(vm_t *vm, void *data, int argc, object_t *args) {
+    (void)data;
+    if (!CHECK_ARGS(vm, true, argc, args, OBJECT_ARRAY | OBJECT_TYPED_ARRAY | OBJECT_RANGE)) {
+        return object_make_null();
+    }
+    numbers_t nums;
+    if (!numbers_init(vm, args[0], &nums)) {
+        return object_make_null();
+    }
+    int64_t int_acc = 0;
+    int i = 0;
+    for (; i < nums.len; i++) {
+        int64_t val = 0;
+        if (!numbers_get_int(&nums, i, &val) || !ape_int64_add(int_acc, val, &val)) {
+            break;
+        }
+        int_acc = val;
+    }
+    if (i == nums.len) {
+        return object_make_int(vm->mem, int_acc);
+    }
+    // independent partial sums so the additions don't wait on each other
+    double acc[4] = {(double)int_acc, 0, 0, 0};
+    double *doubles = i == 0 ? numbers_get_doubles(&nums) : NULL;
+    if (doubles) {
+        for (; i + 4 <= nums.len; i += 4) {
+            acc[0] += doubles[i];
+            acc[1] += doubles[i + 1];
+            acc[2] += doubles[i + 2];
+            acc[3] += doubles[i + 3];
+        }
+    }
+    for (; i + 4 <= nums.len; i += 4) {
+        acc[0] += numbers_get_double(&nums, i);
+        acc[1] += numbers_get_double(&nums, i + 1);
+        acc[2] += numbers_get_double(&nums, i + 2);
+        acc[3] += numbers_get_double(&nums, i + 3);
+    }
+    for (; i < nums.len; i++) {
+        acc[0] += numbers_get_double(&nums, i);
+    }
+    return object_make_number((acc[0] + acc[1]) + (acc[2] + acc[3]));
+}
+
+static object_t dot_fn(vm_t *vm, void *data, int argc, object_t *args) {
+    (void)data;
+    if (!CHECK_ARGS(vm, true, argc, args, OBJECT_ARRAY | OBJECT_TYPED_ARRAY | OBJECT_RANGE,
+                                            OBJECT_ARRAY | OBJECT_TYPED_ARRAY | OBJECT_RANGE)) {
+        return object_make_null();
+    }
+    numbers_t a;
+    numbers_t b;
+    if (!numbers_init(vm, args[0], &a) || !numbers_init(vm, args[1], &b)) {
+        return object_make_null();
+    }
+    if (a.len != b.len) {
+        errors_add_errorf(vm->errors, ERROR_RUNTIME, src_pos_invalid,
+                          "Arrays have different lengths (%d and %d)", a.len, b.len);
+        return object_make_null();
+    }
+    int64_t int_acc = 0;
+    int i = 0;
+    for (; i < a.len; i++) {
+        int64_t a_val = 0;
+        int64_t b_val = 0;
+        int64_t val = 0;
+        if (!numbers_get_int(&a, i, &a_val) || !numbers_get_int(&b, i, &b_val)
+            || !ape_int64_mul(a_val, b_val, &val) || !ape_int64_add(int_acc, val, &val)) {
+            break;
+        }
+        int_acc = val;
+    }
+    if (i == a.len) {
+        return object_make_int(vm->mem, int_acc);
+    }
+    double acc[4] = {(double)int_acc, 0, 0, 0};
+    double *a_doubles = i == 0 ? numbers_get_doubles(&a) : NULL;
+    double *b_doubles = a_doubles ? numbers_get_doubles(&b) : NULL;
+    if (a_doubles && b_doubles) {
+        for (; i + 4 <= a.len; i += 4) {
+            acc[0] += a_doubles[i] * b_doubles[i];
+            acc[1] += a_doubles[i + 1] * b_doubles[i + 1];
+            acc[2] += a_doubles[i + 2] * b_doubles[i + 2];
+            acc[3] += a_doubles[i + 3] * b_doubles[i + 3];
+        }
+    }
+    for (; i + 4 <= a.len; i += 4) {
+        acc[0] += numbers_multiply(&a, &b, i);
+        acc[1] += numbers_multiply(&a, &b, i + 1);
+        acc[2] += numbers_multiply(&a, &b, i + 2);
+        acc[3] += numbers_multiply(&a, &b, i + 3);
+    }
+    for (; i < a.len; i++) {
+        acc[0] += numbers_multiply(&a, &b, i);
+    }
+    return object_make_number((acc[0] + acc[1]) + (acc[2] + acc[3]));
+}
+
+static object_t scale_fn(vm_t *vm, void *data, int argc, object_t *args) {
+    (void)data;
+    if (!CHECK_ARGS(vm, true, argc, args, OBJECT_ARRAY | OBJECT_TYPED_ARRAY | OBJECT_RANGE, OBJECT_NUMBER)) {
+        return object_make_null();
+    }
+    numbers_t nums;
+    if (!numbers_init(vm, args[0], &nums)) {
+        return object_make_null();
+    }
+    bool k_is_int = object_is_int(args[1]);
+    int64_t k_int = object_get_int(args[1]);
+    double k = object_get_number(args[1]);
+    object_t res = object_make_array_with_capacity(vm->mem, nums.len);
+    for (int i = 0; i < nums.len && !object_is_null(res); i++) {
+        int64_t val = 0;
+        object_t item = object_make_null();
+        if (k_is_int && numbers_get_int(&nums, i, &val) && ape_int64_mul(val, k_int, &val)) {
+            item = object_make_int(vm->mem, val);
+        } else {
+            item = object_make_number(numbers_get_double(&nums, i) * k);
+        }
+        if (object_is_null(item) || !object_add_array_value(res, item)) {
+            res = object_make_null();
+        }
+    }
+    return res;
+}
+
 static bool check_args(vm_t *vm, bool generate_error, int argc, object_t *args, int expected_argc, object_type_t *expected_types) {
     if (argc != expected_argc) {
         if (generate_error) {
@@ -1010,3 +2206,16 @@ static bool check_args(vm_t *vm, bool generate_error, int argc, object_t *args,
     }
     return true;
 }
+
+static bool object_to_number(object_t obj, double *out_num) {
+    if (object_is_numeric(obj)) {
+        *out_num = object_get_number(obj);
+        return true;
+    } else if (object_is_null(obj)) {
+        *out_num = 0;
+        return true;
+    } else if (object_get_type(obj) == OBJECT_STRING) {
+        return ape_parse_number(object_get_string(obj), object_get_string_length(obj), out_num);
+    }
+    return false;
+}
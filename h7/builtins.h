@@ -13,5 +13,6 @@ typedef struct vm vm_t;
 APE_INTERNAL int builtins_count(void);
 APE_INTERNAL native_fn builtins_get_fn(int ix);
 APE_INTERNAL const char* builtins_get_name(int ix);
+APE_INTERNAL int builtins_get_ix(native_fn fn); // -1 if fn isn't a builtin
 
 #endif /* builtins_h */
@@ -0,0 +1,652 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+
+#ifndef APE_AMALGAMATED
+#include "bytecode_cache.h"
+#include "code.h"
+#endif
+
+#if defined(APE_POSIX) // after common.h defines it
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// Layout: header, then the sections in order, each starting at a multiple of 8. All numbers are little endian
+// u32 (hashes u64), strings are offsets into the data section and end with a 0 there.
+//   header:    "APEC", version, opcodes count, flags, source hash, globals hash, size, globals span,
+//              globals start (or CACHE_NONE), checksum, (offset, count) of every section
+// The checksum covers everything but itself and is checked before any of the sections is read, so a file that
+// was damaged after it was written is ignored instead of loading bytecode that doesn't do what it did.
+//   imports:   path, line, column
+//   symbols:   name, index, assignable
+//   globals:   kind, index, name (or CACHE_NONE)
+//   constants: kind, string, code, num_locals, num_args
+//   codes:     bytecode offset, count, positions offset, positions count (all in data)
+//   data:      strings, bytecode and position runs of (count, line, column)
+
+#define CACHE_MAGIC "APEC"
+#define CACHE_NONE UINT32_MAX
+#define CACHE_FLAG_REPL_MODE 1
+
+typedef enum cache_section {
+    CACHE_SECTION_IMPORTS = 0,
+    CACHE_SECTION_SYMBOLS,
+    CACHE_SECTION_GLOBALS,
+    CACHE_SECTION_CONSTANTS,
+    CACHE_SECTION_CODES,
+    CACHE_SECTION_DATA,
+    CACHE_SECTION_MAX,
+} cache_section_t;
+
+#define CACHE_HEADER_SIZE (48 + CACHE_SECTION_MAX * 8)
+
+static const int g_record_sizes[CACHE_SECTION_MAX] = { 12, 12, 12, 20, 16, 1 };
+
+static void* own(bytecode_cache_t *cache, void *ptr);
+static bool map_file(bytecode_cache_t *cache, const char *path);
+static bool write_file_replacing(const bytecode_cache_t *cache, const char *path, const uint8_t *data, size_t size);
+static bool read_sections(bytecode_cache_t *cache, uint64_t source_hash, uint64_t globals_hash, bool repl_mode);
+static const char* read_data_string(const uint8_t *data, uint32_t data_size, uint32_t offset);
+static bool add_data_string(array(uint8_t) *data, const char *string, uint32_t *out_offset);
+static bool put_u32(array(uint8_t) *buf, uint32_t val);
+static bool put_u64(array(uint8_t) *buf, uint64_t val);
+static bool put_padding(array(uint8_t) *buf);
+static void set_u32(array(uint8_t) *buf, int pos, uint32_t val);
+static uint32_t get_u32(const uint8_t *data);
+static uint64_t get_u64(const uint8_t *data);
+static uint32_t get_checksum(const uint8_t *data, uint32_t size);
+
+uint64_t bytecode_cache_hash(const void *data, size_t size, uint64_t hash) {
+    // FNV-1a
+    if (hash == 0) {
+        hash = 14695981039346656037ull;
+    }
+    const uint8_t *bytes = data;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+char* bytecode_cache_get_path(allocator_t *alloc, const char *source_path) {
+    size_t len = strlen(source_path);
+    if (len >= 4 && APE_STREQ(source_path + len - 4, ".ape")) {
+        return ape_stringf(alloc, "%sc", source_path);
+    }
+    return ape_stringf(alloc, "%s.apec", source_path);
+}
+
+bytecode_cache_t* bytecode_cache_make(allocator_t *alloc) {
+    bytecode_cache_t *cache = allocator_malloc(alloc, sizeof(bytecode_cache_t));
+    if (!cache) {
+        return NULL;
+    }
+    memset(cache, 0, sizeof(bytecode_cache_t));
+    cache->alloc = alloc;
+    cache->globals_start = -1;
+    cache->imports = array_make(alloc, cache_import_t);
+    cache->symbols = array_make(alloc, cache_symbol_t);
+    cache->globals = array_make(alloc, cache_global_t);
+    cache->constants = array_make(alloc, cache_constant_t);
+    cache->codes = array_make(alloc, cache_code_t);
+    cache->owned = ptrarray_make(alloc);
+    if (!cache->imports || !cache->symbols || !cache->globals || !cache->constants || !cache->codes || !cache->owned) {
+        bytecode_cache_destroy(cache);
+        return NULL;
+    }
+    return cache;
+}
+
+void bytecode_cache_destroy(bytecode_cache_t *cache) {
+    if (!cache) {
+        return;
+    }
+    array_destroy(cache->imports);
+    array_destroy(cache->symbols);
+    array_destroy(cache->globals);
+    array_destroy(cache->constants);
+    array_destroy(cache->codes);
+    for (int i = 0; i < ptrarray_count(cache->owned); i++) {
+        allocator_free(cache->alloc, ptrarray_get(cache->owned, i));
+    }
+    ptrarray_destroy(cache->owned);
+    if (cache->data_mapped) {
+#if defined(APE_POSIX)
+        munmap((void*)cache->data, cache->data_size);
+#endif
+    } else {
+        allocator_free(cache->alloc, (void*)cache->data);
+    }
+    allocator_free(cache->alloc, cache);
+}
+
+bytecode_cache_t* bytecode_cache_load(allocator_t *alloc, const char *path,
+                                      uint64_t source_hash, uint64_t globals_hash, bool repl_mode) {
+    bytecode_cache_t *cache = bytecode_cache_make(alloc);
+    if (!cache) {
+        return NULL;
+    }
+    if (!map_file(cache, path) || !read_sections(cache, source_hash, globals_hash, repl_mode)) {
+        bytecode_cache_destroy(cache);
+        return NULL;
+    }
+    return cache;
+}
+
+bytecode_cache_t* bytecode_cache_load_data(allocator_t *alloc, uint8_t *data, size_t size,
+                                           uint64_t source_hash, uint64_t globals_hash, bool repl_mode) {
+    bytecode_cache_t *cache = bytecode_cache_make(alloc);
+    if (!cache) {
+        allocator_free(alloc, data);
+        return NULL;
+    }
+    cache->data = data;
+    cache->data_size = size;
+    cache->data_mapped = false;
+    if (size < CACHE_HEADER_SIZE || size > INT_MAX || !read_sections(cache, source_hash, globals_hash, repl_mode)) {
+        bytecode_cache_destroy(cache);
+        return NULL;
+    }
+    return cache;
+}
+
+bool bytecode_cache_save(const bytecode_cache_t *cache, const char *path) {
+    size_t size = 0;
+    uint8_t *data = bytecode_cache_serialize(cache, cache->alloc, &size);
+    if (!data) {
+        return false;
+    }
+    bool result = write_file_replacing(cache, path, data, size);
+    allocator_free(cache->alloc, data);
+    return result;
+}
+
+uint8_t* bytecode_cache_serialize(const bytecode_cache_t *cache, allocator_t *alloc, size_t *out_size) {
+    uint8_t *result = NULL;
+    array(uint8_t) *data = array_make(cache->alloc, uint8_t);
+    array(uint8_t) *buf = array_make(cache->alloc, uint8_t);
+    if (!data || !buf) {
+        goto end;
+    }
+
+    bool ok = true;
+    int counts[CACHE_SECTION_MAX] = {
+        array_count(cache->imports), array_count(cache->symbols), array_count(cache->globals),
+        array_count(cache->constants), array_count(cache->codes), 0,
+    };
+
+    // header
+    ok = ok && array_addn(buf, CACHE_MAGIC, 4);
+    ok = ok && put_u32(buf, BYTECODE_CACHE_VERSION);
+    ok = ok && put_u32(buf, OPCODE_MAX);
+    ok = ok && put_u32(buf, cache->repl_mode ? CACHE_FLAG_REPL_MODE : 0);
+    ok = ok && put_u64(buf, cache->source_hash);
+    ok = ok && put_u64(buf, cache->globals_hash);
+    ok = ok && put_u32(buf, 0); // size
+    ok = ok && put_u32(buf, cache->globals_span);
+    ok = ok && put_u32(buf, cache->globals_start >= 0 ? (uint32_t)cache->globals_start : CACHE_NONE);
+    ok = ok && put_u32(buf, 0); // checksum
+    for (int i = 0; i < CACHE_SECTION_MAX; i++) {
+        ok = ok && put_u32(buf, 0) && put_u32(buf, 0);
+    }
+    if (!ok) {
+        goto end;
+    }
+    APE_ASSERT(array_count(buf) == CACHE_HEADER_SIZE);
+
+    int section_pos[CACHE_SECTION_MAX];
+    uint32_t str_offset = 0;
+
+    section_pos[CACHE_SECTION_IMPORTS] = array_count(buf);
+    for (int i = 0; ok && i < array_count(cache->imports); i++) {
+        const cache_import_t *import = array_get(cache->imports, i);
+        ok = add_data_string(data, import->path, &str_offset)
+          && put_u32(buf, str_offset) && put_u32(buf, import->line) && put_u32(buf, import->column);
+    }
+    ok = ok && put_padding(buf);
+
+    section_pos[CACHE_SECTION_SYMBOLS] = array_count(buf);
+    for (int i = 0; ok && i < array_count(cache->symbols); i++) {
+        const cache_symbol_t *symbol = array_get(cache->symbols, i);
+        ok = add_data_string(data, symbol->name, &str_offset)
+          && put_u32(buf, str_offset) && put_u32(buf, symbol->index) && put_u32(buf, symbol->assignable);
+    }
+    ok = ok && put_padding(buf);
+
+    section_pos[CACHE_SECTION_GLOBALS] = array_count(buf);
+    for (int i = 0; ok && i < array_count(cache->globals); i++) {
+        const cache_global_t *global = array_get(cache->globals, i);
+        str_offset = CACHE_NONE;
+        if (global->name) {
+            ok = add_data_string(data, global->name, &str_offset);
+        }
+        ok = ok && put_u32(buf, global->kind) && put_u32(buf, global->index) && put_u32(buf, str_offset);
+    }
+    ok = ok && put_padding(buf);
+
+    section_pos[CACHE_SECTION_CONSTANTS] = array_count(buf);
+    for (int i = 0; ok && i < array_count(cache->constants); i++) {
+        const cache_constant_t *constant = array_get(cache->constants, i);
+        ok = add_data_string(data, constant->string, &str_offset)
+          && put_u32(buf, constant->kind) && put_u32(buf, str_offset) && put_u32(buf, constant->code)
+          && put_u32(buf, constant->num_locals) && put_u32(buf, constant->num_args);
+    }
+    ok = ok && put_padding(buf);
+
+    section_pos[CACHE_SECTION_CODES] = array_count(buf);
+    for (int i = 0; ok && i < array_count(cache->codes); i++) {
+        const cache_code_t *code = array_get(cache->codes, i);
+        uint32_t bytecode_offset = array_count(data);
+        ok = array_addn(data, code->bytecode, code->count);
+        while (ok && array_count(data) % 4 != 0) {
+            uint8_t zero = 0;
+            ok = array_add(data, &zero);
+        }
+        uint32_t positions_offset = array_count(data);
+        ok = ok && array_addn(data, code->positions, code->positions_count * 12);
+        ok = ok && put_u32(buf, bytecode_offset) && put_u32(buf, code->count)
+                && put_u32(buf, positions_offset) && put_u32(buf, code->positions_count);
+    }
+    ok = ok && put_padding(buf);
+
+    section_pos[CACHE_SECTION_DATA] = array_count(buf);
+    counts[CACHE_SECTION_DATA] = array_count(data);
+    ok = ok && array_add_array(buf, data);
+    if (!ok) {
+        goto end;
+    }
+
+    set_u32(buf, 32, array_count(buf));
+    for (int i = 0; i < CACHE_SECTION_MAX; i++) {
+        set_u32(buf, 48 + i * 8, section_pos[i]);
+        set_u32(buf, 52 + i * 8, counts[i]);
+    }
+    set_u32(buf, 44, get_checksum(array_data(buf), array_count(buf)));
+
+    result = allocator_malloc(alloc, array_count(buf));
+    if (!result) {
+        goto end;
+    }
+    memcpy(result, array_data(buf), array_count(buf));
+    *out_size = array_count(buf);
+end:
+    array_destroy(data);
+    array_destroy(buf);
+    return result;
+}
+
+int bytecode_cache_add_import(bytecode_cache_t *cache, const char *path, int line, int column) {
+    cache_import_t import = { .path = own(cache, ape_strdup(cache->alloc, path)), .line = line, .column = column };
+    if (!import.path || !array_add(cache->imports, &import)) {
+        return -1;
+    }
+    return array_count(cache->imports) - 1;
+}
+
+int bytecode_cache_add_symbol(bytecode_cache_t *cache, const char *name, int index, bool assignable) {
+    cache_symbol_t symbol = { .name = own(cache, ape_strdup(cache->alloc, name)), .index = index, .assignable = assignable };
+    if (!symbol.name || !array_add(cache->symbols, &symbol)) {
+        return -1;
+    }
+    return array_count(cache->symbols) - 1;
+}
+
+int bytecode_cache_add_global(bytecode_cache_t *cache, cache_global_kind_t kind, int index, const char *name) {
+    cache_global_t global = { .kind = kind, .index = index, .name = NULL };
+    if (name) {
+        global.name = own(cache, ape_strdup(cache->alloc, name));
+        if (!global.name) {
+            return -1;
+        }
+    }
+    if (!array_add(cache->globals, &global)) {
+        return -1;
+    }
+    return array_count(cache->globals) - 1;
+}
+
+int bytecode_cache_add_constant(bytecode_cache_t *cache, cache_constant_kind_t kind, const char *string) {
+    cache_constant_t constant = { .kind = kind, .string = own(cache, ape_strdup(cache->alloc, string)) };
+    if (!constant.string || !array_add(cache->constants, &constant)) {
+        return -1;
+    }
+    return array_count(cache->constants) - 1;
+}
+
+int bytecode_cache_add_code(bytecode_cache_t *cache, const uint8_t *bytecode, const src_pos_t *positions, int count) {
+    cache_code_t code = { .bytecode = NULL, .count = count, .positions = NULL, .positions_count = 0 };
+    uint8_t *bytecode_copy = own(cache, allocator_malloc(cache->alloc, count > 0 ? count : 1));
+    if (!bytecode_copy) {
+        return -1;
+    }
+    memcpy(bytecode_copy, bytecode, count);
+    code.bytecode = bytecode_copy;
+
+    array(uint8_t) *runs = array_make(cache->alloc, uint8_t);
+    if (!runs) {
+        return -1;
+    }
+    bool ok = true;
+    int run_start = 0;
+    for (int i = 1; ok && i <= count; i++) {
+        if (i < count && positions[i].line == positions[run_start].line
+            && positions[i].column == positions[run_start].column) {
+            continue;
+        }
+        ok = put_u32(runs, i - run_start) && put_u32(runs, positions[run_start].line)
+          && put_u32(runs, positions[run_start].column);
+        code.positions_count++;
+        run_start = i;
+    }
+    if (ok && array_count(runs) > 0) {
+        code.positions = own(cache, allocator_malloc(cache->alloc, array_count(runs)));
+        if (code.positions) {
+            memcpy((void*)code.positions, array_data(runs), array_count(runs));
+        }
+        ok = code.positions != NULL;
+    }
+    array_destroy(runs);
+    if (!ok || !array_add(cache->codes, &code)) {
+        return -1;
+    }
+    return array_count(cache->codes) - 1;
+}
+
+uint8_t* bytecode_cache_get_added_bytecode(bytecode_cache_t *cache, int code_ix) {
+    cache_code_t *code = array_get(cache->codes, code_ix);
+    return code ? (uint8_t*)code->bytecode : NULL;
+}
+
+bool bytecode_cache_read_positions(const cache_code_t *code, const compiled_file_t *file, src_pos_t *out_positions) {
+    int pos = 0;
+    for (int i = 0; i < code->positions_count; i++) {
+        const uint8_t *run = code->positions + i * 12;
+        uint32_t count = get_u32(run);
+        int line = (int)get_u32(run + 4);
+        int column = (int)get_u32(run + 8);
+        if (count > (uint32_t)(code->count - pos) || line < 0 || column < 0) {
+            return false;
+        }
+        for (uint32_t j = 0; out_positions && j < count; j++) {
+            out_positions[pos + j] = src_pos_make(file, line, column);
+        }
+        pos += count;
+    }
+    return pos == code->count;
+}
+
+// INTERNAL
+static void* own(bytecode_cache_t *cache, void *ptr) {
+    if (!ptr) {
+        return NULL;
+    }
+    if (!ptrarray_add(cache->owned, ptr)) {
+        allocator_free(cache->alloc, ptr);
+        return NULL;
+    }
+    return ptr;
+}
+
+static bool map_file(bytecode_cache_t *cache, const char *path) {
+#if defined(APE_POSIX)
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < CACHE_HEADER_SIZE || st.st_size > INT_MAX) {
+        close(fd);
+        return false;
+    }
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return false;
+    }
+    cache->data = data;
+    cache->data_size = st.st_size;
+    cache->data_mapped = true;
+    return true;
+#else
+    FILE *fp = fopen(path, "rb");
+    if (!fp) {
+        return false;
+    }
+    fseek(fp, 0L, SEEK_END);
+    long size = ftell(fp);
+    rewind(fp);
+    if (size < CACHE_HEADER_SIZE || size > INT_MAX) {
+        fclose(fp);
+        return false;
+    }
+    uint8_t *data = allocator_malloc(cache->alloc, size);
+    if (!data) {
+        fclose(fp);
+        return false;
+    }
+    size_t size_read = fread(data, 1, size, fp);
+    fclose(fp);
+    cache->data = data;
+    cache->data_size = size;
+    cache->data_mapped = false;
+    return size_read == (size_t)size;
+#endif
+}
+
+// The file is written next to path and renamed over it, so that readers that have the old one mapped keep
+// reading it and concurrent writers can't leave a mix of their files behind.
+static bool write_file_replacing(const bytecode_cache_t *cache, const char *path, const uint8_t *data, size_t size) {
+#if defined(APE_POSIX)
+    // unique for every cache being saved at the same time, O_EXCL catches files left by crashed processes
+    char *tmp_path = ape_stringf(cache->alloc, "%s.%ld.%p.tmp", path, (long)getpid(), (const void*)cache);
+    if (!tmp_path) {
+        return false;
+    }
+    bool result = false;
+    int fd = open(tmp_path, O_WRONLY | O_CREAT | O_EXCL, 0666);
+    if (fd >= 0) {
+        size_t written = 0;
+        while (written < size) {
+            ssize_t res = write(fd, data + written, size - written);
+            if (res <= 0) {
+                break;
+            }
+            written += (size_t)res;
+        }
+        result = close(fd) == 0 && written == size && rename(tmp_path, path) == 0;
+        if (!result) {
+            unlink(tmp_path);
+        }
+    }
+    allocator_free(cache->alloc, tmp_path);
+    return result;
+#else
+    char *tmp_path = ape_stringf(cache->alloc, "%s.tmp", path);
+    if (!tmp_path) {
+        return false;
+    }
+    bool result = false;
+    FILE *fp = fopen(tmp_path, "wb");
+    if (fp) {
+        size_t written = fwrite(data, 1, size, fp);
+        result = fclose(fp) == 0 && written == size;
+        if (result) {
+            remove(path); // rename doesn't replace files everywhere
+            result = rename(tmp_path, path) == 0;
+        }
+        if (!result) {
+            remove(tmp_path);
+        }
+    }
+    allocator_free(cache->alloc, tmp_path);
+    return result;
+#endif
+}
+
+static bool read_sections(bytecode_cache_t *cache, uint64_t source_hash, uint64_t globals_hash, bool repl_mode) {
+    const uint8_t *data = cache->data;
+    uint32_t size = (uint32_t)cache->data_size;
+    if (memcmp(data, CACHE_MAGIC, 4) != 0
+        || get_u32(data + 4) != BYTECODE_CACHE_VERSION
+        || get_u32(data + 8) != OPCODE_MAX
+        || get_u32(data + 12) != (repl_mode ? CACHE_FLAG_REPL_MODE : 0)
+        || get_u64(data + 16) != source_hash
+        || get_u64(data + 24) != globals_hash
+        || get_u32(data + 32) != size
+        || get_u32(data + 44) != get_checksum(data, size)) {
+        return false;
+    }
+    cache->source_hash = source_hash;
+    cache->globals_hash = globals_hash;
+    cache->repl_mode = repl_mode;
+    cache->globals_span = (int)get_u32(data + 36);
+    uint32_t globals_start = get_u32(data + 40);
+    cache->globals_start = globals_start == CACHE_NONE ? -1 : (int)globals_start;
+    if (cache->globals_span < 0 || (globals_start != CACHE_NONE && cache->globals_start < 0)) {
+        return false;
+    }
+
+    const uint8_t *sections[CACHE_SECTION_MAX];
+    uint32_t counts[CACHE_SECTION_MAX];
+    for (int i = 0; i < CACHE_SECTION_MAX; i++) {
+        uint32_t offset = get_u32(data + 48 + i * 8);
+        counts[i] = get_u32(data + 52 + i * 8);
+        if (offset > size || counts[i] > (size - offset) / g_record_sizes[i]) {
+            return false;
+        }
+        sections[i] = data + offset;
+    }
+    const uint8_t *strings = sections[CACHE_SECTION_DATA];
+    uint32_t strings_size = counts[CACHE_SECTION_DATA];
+
+    const uint8_t *rec = sections[CACHE_SECTION_IMPORTS];
+    for (uint32_t i = 0; i < counts[CACHE_SECTION_IMPORTS]; i++, rec += 12) {
+        cache_import_t import = {
+            .path = read_data_string(strings, strings_size, get_u32(rec)),
+            .line = (int)get_u32(rec + 4),
+            .column = (int)get_u32(rec + 8),
+        };
+        if (!import.path || !array_add(cache->imports, &import)) {
+            return false;
+        }
+    }
+
+    rec = sections[CACHE_SECTION_SYMBOLS];
+    for (uint32_t i = 0; i < counts[CACHE_SECTION_SYMBOLS]; i++, rec += 12) {
+        cache_symbol_t symbol = {
+            .name = read_data_string(strings, strings_size, get_u32(rec)),
+            .index = (int)get_u32(rec + 4),
+            .assignable = get_u32(rec + 8) != 0,
+        };
+        if (!symbol.name || !array_add(cache->symbols, &symbol)) {
+            return false;
+        }
+    }
+
+    rec = sections[CACHE_SECTION_GLOBALS];
+    for (uint32_t i = 0; i < counts[CACHE_SECTION_GLOBALS]; i++, rec += 12) {
+        uint32_t name_offset = get_u32(rec + 8);
+        cache_global_t global = {
+            .kind = (cache_global_kind_t)get_u32(rec),
+            .index = (int)get_u32(rec + 4),
+            .name = name_offset == CACHE_NONE ? NULL : read_data_string(strings, strings_size, name_offset),
+        };
+        if ((name_offset != CACHE_NONE && !global.name) || !array_add(cache->globals, &global)) {
+            return false;
+        }
+    }
+
+    rec = sections[CACHE_SECTION_CONSTANTS];
+    for (uint32_t i = 0; i < counts[CACHE_SECTION_CONSTANTS]; i++, rec += 20) {
+        cache_constant_t constant = {
+            .kind = (cache_constant_kind_t)get_u32(rec),
+            .string = read_data_string(strings, strings_size, get_u32(rec + 4)),
+            .code = (int)get_u32(rec + 8),
+            .num_locals = (int)get_u32(rec + 12),
+            .num_args = (int)get_u32(rec + 16),
+        };
+        if (!constant.string || !array_add(cache->constants, &constant)) {
+            return false;
+        }
+    }
+
+    rec = sections[CACHE_SECTION_CODES];
+    for (uint32_t i = 0; i < counts[CACHE_SECTION_CODES]; i++, rec += 16) {
+        uint32_t bytecode_offset = get_u32(rec);
+        uint32_t count = get_u32(rec + 4);
+        uint32_t positions_offset = get_u32(rec + 8);
+        uint32_t positions_count = get_u32(rec + 12);
+        if (bytecode_offset > strings_size || count > strings_size - bytecode_offset
+            || positions_offset > strings_size || positions_count > (strings_size - positions_offset) / 12) {
+            return false;
+        }
+        cache_code_t code = {
+            .bytecode = strings + bytecode_offset,
+            .count = (int)count,
+            .positions = strings + positions_offset,
+            .positions_count = (int)positions_count,
+        };
+        if (!array_add(cache->codes, &code)) {
+            return false;
+        }
+    }
+    return array_count(cache->codes) > 0;
+}
+
+static const char* read_data_string(const uint8_t *data, uint32_t data_size, uint32_t offset) {
+    if (offset >= data_size || !memchr(data + offset, '\0', data_size - offset)) {
+        return NULL;
+    }
+    return (const char*)data + offset;
+}
+
+static bool add_data_string(array(uint8_t) *data, const char *string, uint32_t *out_offset) {
+    *out_offset = array_count(data);
+    return array_addn(data, string, (int)strlen(string) + 1);
+}
+
+static bool put_u32(array(uint8_t) *buf, uint32_t val) {
+    uint8_t bytes[4] = { (uint8_t)val, (uint8_t)(val >> 8), (uint8_t)(val >> 16), (uint8_t)(val >> 24) };
+    return array_addn(buf, bytes, 4);
+}
+
+static bool put_u64(array(uint8_t) *buf, uint64_t val) {
+    return put_u32(buf, (uint32_t)val) && put_u32(buf, (uint32_t)(val >> 32));
+}
+
+static bool put_padding(array(uint8_t) *buf) {
+    uint8_t zero = 0;
+    while (array_count(buf) % 8 != 0) {
+        if (!array_add(buf, &zero)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void set_u32(array(uint8_t) *buf, int pos, uint32_t val) {
+    uint8_t *data = array_data(buf);
+    data[pos + 0] = (uint8_t)val;
+    data[pos + 1] = (uint8_t)(val >> 8);
+    data[pos + 2] = (uint8_t)(val >> 16);
+    data[pos + 3] = (uint8_t)(val >> 24);
+}
+
+static uint32_t get_u32(const uint8_t *data) {
+    return (uint32_t)data[0] | ((uint32_t)data[1] << 8) | ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+static uint64_t get_u64(const uint8_t *data) {
+    return (uint64_t)get_u32(data) | ((uint64_t)get_u32(data + 4) << 32);
+}
+
+static uint32_t get_checksum(const uint8_t *data, uint32_t size) {
+    uint64_t hash = bytecode_cache_hash(data, 44, 0);
+    hash = bytecode_cache_hash(data + 48, size - 48, hash);
+    return (uint32_t)(hash ^ (hash >> 32));
+}
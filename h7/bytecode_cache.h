@@ -0,0 +1,111 @@
+#ifndef bytecode_cache_h
+#define bytecode_cache_h
+
+#ifndef APE_AMALGAMATED
+#include "common.h"
+#include "collections.h"
+#endif
+
+// Bytecode caches (.apec files) hold a compiled file so that it can be loaded without parsing and compiling it
+// again. Nothing in them depends on where the file is loaded: constants are stored by value, globals the file
+// defines by their index relative to the file's first global and other globals by name. Files are written in
+// sections of fixed size little endian records, readers map them and only copy the bytecode out.
+// Caches are valid for one source (by hash), format version, opcode set and set of ape globals. Files whose
+// checksum doesn't match or whose operands don't fit are not loaded, the source is compiled instead.
+
+#define BYTECODE_CACHE_VERSION 2
+
+typedef enum cache_global_kind {
+    // defined by the file, index is relative to the file's first global. Globals defined in block scopes of
+    // imported modules are placed after twice the module's offset, files using them only load at globals_start.
+    CACHE_GLOBAL_OWN = 0,
+    CACHE_GLOBAL_MODULE,  // defined before the file or by a module it imports, found by name
+    CACHE_GLOBAL_APE,     // builtin or native function, found by name
+} cache_global_kind_t;
+
+typedef enum cache_constant_kind {
+    CACHE_CONSTANT_STRING = 0,
+    CACHE_CONSTANT_FUNCTION,
+} cache_constant_kind_t;
+
+typedef struct cache_import {
+    const char *path;
+    int line;
+    int column;
+} cache_import_t;
+
+typedef struct cache_symbol {
+    const char *name;
+    int index; // relative to the file's first global
+    bool assignable;
+} cache_symbol_t;
+
+typedef struct cache_global {
+    cache_global_kind_t kind;
+    int index;
+    const char *name;
+} cache_global_t;
+
+typedef struct cache_constant {
+    cache_constant_kind_t kind;
+    const char *string; // function name for functions
+    int code;
+    int num_locals;
+    int num_args;
+} cache_constant_t;
+
+// Operands in bytecode point at the cache's constants and globals instead of the compiler's, jumps in the
+// file's top level code (codes[0]) are relative to its start.
+typedef struct cache_code {
+    const uint8_t *bytecode;
+    int count;
+    const uint8_t *positions; // runs of (count, line, column)
+    int positions_count;
+} cache_code_t;
+
+typedef struct bytecode_cache {
+    allocator_t *alloc;
+    uint64_t source_hash;
+    uint64_t globals_hash;
+    bool repl_mode;
+    int globals_span;  // indices reserved by the file after its imports
+    int globals_start; // -1 if the file can be loaded after any globals, see CACHE_GLOBAL_OWN
+    array(cache_import_t) *imports;
+    array(cache_symbol_t) *symbols;
+    array(cache_global_t) *globals;
+    array(cache_constant_t) *constants;
+    array(cache_code_t) *codes;
+
+    ptrarray(void) *owned; // strings, bytecode and positions added when writing
+    const uint8_t *data;
+    size_t data_size;
+    bool data_mapped;
+} bytecode_cache_t;
+
+APE_INTERNAL uint64_t bytecode_cache_hash(const void *data, size_t size, uint64_t hash); // hash is 0 for the first chunk
+APE_INTERNAL char* bytecode_cache_get_path(allocator_t *alloc, const char *source_path); // x.ape -> x.apec
+
+APE_INTERNAL bytecode_cache_t* bytecode_cache_make(allocator_t *alloc);
+APE_INTERNAL void bytecode_cache_destroy(bytecode_cache_t *cache);
+// Returns NULL if there's no cache at path or it isn't valid for the given source hash, globals and mode.
+APE_INTERNAL bytecode_cache_t* bytecode_cache_load(allocator_t *alloc, const char *path,
+                                                   uint64_t source_hash, uint64_t globals_hash, bool repl_mode);
+// Same as bytecode_cache_load for data in memory (allocated with alloc), which the cache takes.
+APE_INTERNAL bytecode_cache_t* bytecode_cache_load_data(allocator_t *alloc, uint8_t *data, size_t size,
+                                                        uint64_t source_hash, uint64_t globals_hash, bool repl_mode);
+APE_INTERNAL bool bytecode_cache_save(const bytecode_cache_t *cache, const char *path);
+// Returns the file bytecode_cache_save writes, allocated with alloc.
+APE_INTERNAL uint8_t* bytecode_cache_serialize(const bytecode_cache_t *cache, allocator_t *alloc, size_t *out_size);
+
+// Strings are copied, add functions return the index of the item added or -1.
+APE_INTERNAL int bytecode_cache_add_import(bytecode_cache_t *cache, const char *path, int line, int column);
+APE_INTERNAL int bytecode_cache_add_symbol(bytecode_cache_t *cache, const char *name, int index, bool assignable);
+APE_INTERNAL int bytecode_cache_add_global(bytecode_cache_t *cache, cache_global_kind_t kind, int index, const char *name);
+APE_INTERNAL int bytecode_cache_add_constant(bytecode_cache_t *cache, cache_constant_kind_t kind, const char *string);
+APE_INTERNAL int bytecode_cache_add_code(bytecode_cache_t *cache, const uint8_t *bytecode, const src_pos_t *positions, int count);
+APE_INTERNAL uint8_t* bytecode_cache_get_added_bytecode(bytecode_cache_t *cache, int code_ix); // the copy, to rewrite operands
+
+// Fills out_positions (if not NULL) with code->count positions in file, false if the runs don't cover the code.
+APE_INTERNAL bool bytecode_cache_read_positions(const cache_code_t *code, const compiled_file_t *file, src_pos_t *out_positions);
+
+#endif /* bytecode_cache_h */
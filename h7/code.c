@@ -60,6 +60,10 @@ static opcode_definition_t g_definitions[OPCODE_MAX + 1] = {
     {"AND", 0, {0}},
     {"LSHIFT", 0, {0}},
     {"RSHIFT", 0, {0}},
+    {"INT", 1, {8}},
+    {"STRUCT", 2, {1, 1}},
+    {"GET_FIELD", 1, {2}},
+    {"SET_FIELD", 1, {2}},
     {"INVALID_MAX", 0, {0}},
 };
 
@@ -167,6 +171,8 @@ void code_to_string(uint8_t *code, src_pos_t *source_positions, size_t code_size
             if (op == OPCODE_NUMBER) {
                 double val_double = ape_uint64_to_double(operands[i]);
                 strbuf_appendf(res, " %1.17g", val_double);
+            } else if (op == OPCODE_INT) {
+                strbuf_appendf(res, " %lld", (long long)operands[i]);
             } else {
                 strbuf_appendf(res, " %llu", (long long unsigned int)operands[i]);
             }
@@ -63,6 +63,10 @@ typedef enum opcode_val {
     OPCODE_AND,
     OPCODE_LSHIFT,
     OPCODE_RSHIFT,
+    OPCODE_INT,
+    OPCODE_STRUCT,
+    OPCODE_GET_FIELD,
+    OPCODE_SET_FIELD,
     OPCODE_MAX,
 } opcode_val_t;
 
@@ -824,11 +824,14 @@ typedef struct array_ {
     unsigned int count;
     unsigned int capacity;
     size_t element_size;
+    unsigned int refcount;
     bool lock_capacity;
 } array_t_;
 
 static bool array_init_with_capacity(array_t_ *arr, allocator_t *alloc, unsigned int capacity, size_t element_size);
 static void array_deinit(array_t_ *arr);
+static unsigned int array_get_front_capacity(const array_t_ *arr);
+static void array_reclaim_front_capacity(array_t_ *arr);
 
 array_t_* array_make_(allocator_t *alloc, size_t element_size) {
     return array_make_with_capacity(alloc, 32, element_size);
@@ -852,6 +855,10 @@ void array_destroy(array_t_ *arr) {
     if (!arr) {
         return;
     }
+    if (arr->refcount > 1) {
+        arr->refcount--;
+        return;
+    }
     allocator_t *alloc = arr->alloc;
     array_deinit(arr);
     allocator_free(alloc, arr);
@@ -874,6 +881,7 @@ array_t_* array_copy(const array_t_ *arr) {
     copy->capacity = arr->capacity;
     copy->count = arr->count;
     copy->element_size = arr->element_size;
+    copy->refcount = 1;
     copy->lock_capacity = arr->lock_capacity;
     if (arr->data_allocated) {
         copy->data_allocated = allocator_malloc(arr->alloc, arr->capacity * arr->element_size);
@@ -891,7 +899,20 @@ array_t_* array_copy(const array_t_ *arr) {
     return copy;
 }
 
+array_t_* array_share(array_t_ *arr) {
+    arr->refcount++;
+    return arr;
+}
+
+bool array_is_shared(const array_t_ *arr) {
+    return arr->refcount > 1;
+}
+
 bool array_add(array_t_ *arr, const void *value) {
+    if (arr->count >= arr->capacity && array_get_front_capacity(arr) >= arr->count) {
+        // at least half of the allocation was freed by removals from the front, reuse it instead of growing
+        array_reclaim_front_capacity(arr);
+    }
     if (arr->count >= arr->capacity) {
         COLLECTIONS_ASSERT(!arr->lock_capacity);
         if (arr->lock_capacity) {
@@ -1034,14 +1055,56 @@ unsigned int array_get_capacity(const array_t_ *arr) {
     return arr->capacity;
 }
 
+bool array_push_front(array_t_ *arr, const void *value) {
+    if (arr->data == arr->data_allocated) {
+        COLLECTIONS_ASSERT(!arr->lock_capacity);
+        if (arr->lock_capacity) {
+            return false;
+        }
+        // leaves as much free space in front as there are items so that pushes to the front are amortised O(1)
+        unsigned int front_capacity = arr->count > 0 ? arr->count : 1;
+        unsigned char *new_data = allocator_malloc(arr->alloc, (front_capacity + arr->capacity) * arr->element_size);
+        if (!new_data) {
+            return false;
+        }
+        if (arr->count > 0) {
+            memcpy(new_data + (front_capacity * arr->element_size), arr->data, arr->count * arr->element_size);
+        }
+        allocator_free(arr->alloc, arr->data_allocated);
+        arr->data_allocated = new_data;
+        arr->data = new_data + (front_capacity * arr->element_size);
+    }
+    arr->data -= arr->element_size;
+    arr->capacity++;
+    arr->count++;
+    if (value) {
+        memcpy(arr->data, value, arr->element_size);
+    }
+    return true;
+}
+
+bool array_pop_front(array_t_ *arr, void *out_value) {
+    if (arr->count <= 0) {
+        return false;
+    }
+    if (out_value) {
+        memcpy(out_value, arr->data, arr->element_size);
+    }
+    return array_remove_at(arr, 0);
+}
+
 bool array_remove_at(array_t_ *arr, unsigned int ix) {
     if (ix >= arr->count) {
         return false;
     }
     if (ix == 0) {
+        // the freed slot is kept in front of data and reclaimed by array_push_front, array_add or array_clear
         arr->data += arr->element_size;
         arr->capacity--;
         arr->count--;
+        if (arr->count == 0) {
+            array_reclaim_front_capacity(arr);
+        }
         return true;
     }
     if (ix == (arr->count - 1)) {
@@ -1066,6 +1129,7 @@ bool array_remove_item(array_t_ *arr, void *ptr) {
 
 void array_clear(array_t_ *arr) {
     arr->count = 0;
+    array_reclaim_front_capacity(arr);
 }
 
 void array_clear_and_deinit_items_(array_t_ *arr, array_item_deinit_fn deinit_fn) {
@@ -1141,6 +1205,7 @@ static bool array_init_with_capacity(array_t_ *arr, allocator_t *alloc, unsigned
     arr->capacity = capacity;
     arr->count = 0;
     arr->element_size = element_size;
+    arr->refcount = 1;
     arr->lock_capacity = false;
     return true;
 }
@@ -1149,6 +1214,22 @@ static void array_deinit(array_t_ *arr) {
     allocator_free(arr->alloc, arr->data_allocated);
 }
 
+static unsigned int array_get_front_capacity(const array_t_ *arr) {
+    return (unsigned int)((arr->data - arr->data_allocated) / arr->element_size);
+}
+
+static void array_reclaim_front_capacity(array_t_ *arr) {
+    unsigned int front_capacity = array_get_front_capacity(arr);
+    if (front_capacity == 0) {
+        return;
+    }
+    if (arr->count > 0) {
+        memmove(arr->data_allocated, arr->data, arr->count * arr->element_size);
+    }
+    arr->data = arr->data_allocated;
+    arr->capacity += front_capacity;
+}
+
 //-----------------------------------------------------------------------------
 // Pointer Array
 //-----------------------------------------------------------------------------
@@ -1403,10 +1484,13 @@ void strbuf_clear(strbuf_t *buf) {
 }
 
 bool strbuf_append(strbuf_t *buf, const char *str) {
+    return strbuf_appendn(buf, str, strlen(str));
+}
+
+bool strbuf_appendn(strbuf_t *buf, const char *str, size_t str_len) {
     if (buf->failed) {
         return false;
     }
-    size_t str_len = strlen(str);
     if (str_len == 0) {
         return true;
     }
@@ -120,11 +120,15 @@ COLLECTIONS_API array_t_*    array_make_with_capacity(allocator_t *alloc, unsign
 COLLECTIONS_API void         array_destroy(array_t_ *arr);
 COLLECTIONS_API void         array_destroy_with_items_(array_t_ *arr, array_item_deinit_fn deinit_fn);
 COLLECTIONS_API array_t_*    array_copy(const array_t_ *arr);
+COLLECTIONS_API array_t_*    array_share(array_t_ *arr); // adds a reference, array_destroy only frees the last one
+COLLECTIONS_API bool         array_is_shared(const array_t_ *arr); // shared arrays must be copied before writing
 COLLECTIONS_API bool         array_add(array_t_ *arr, const void *value);
 COLLECTIONS_API bool         array_addn(array_t_ *arr, const void *values, int n);
 COLLECTIONS_API bool         array_add_array(array_t_ *dest, array_t_ *source);
 COLLECTIONS_API bool         array_push(array_t_ *arr, const void *value);
 COLLECTIONS_API bool         array_pop(array_t_ *arr, void *out_value);
+COLLECTIONS_API bool         array_push_front(array_t_ *arr, const void *value); // amortised O(1)
+COLLECTIONS_API bool         array_pop_front(array_t_ *arr, void *out_value); // O(1)
 COLLECTIONS_API void *       array_top(array_t_ *arr);
 COLLECTIONS_API bool         array_set(array_t_ *arr, unsigned int ix, void *value);
 COLLECTIONS_API bool         array_setn(array_t_ *arr, unsigned int ix, void *values, int n);
@@ -197,6 +201,7 @@ COLLECTIONS_API strbuf_t* strbuf_make_with_capacity(allocator_t *alloc, unsigned
 COLLECTIONS_API void strbuf_destroy(strbuf_t *buf);
 COLLECTIONS_API void strbuf_clear(strbuf_t *buf);
 COLLECTIONS_API bool strbuf_append(strbuf_t *buf, const char *str);
+COLLECTIONS_API bool strbuf_appendn(strbuf_t *buf, const char *str, size_t str_len);
 COLLECTIONS_API bool strbuf_appendf(strbuf_t *buf, const char *fmt, ...)  __attribute__((format(printf, 2, 3)));
 COLLECTIONS_API const char * strbuf_get_string(const strbuf_t *buf);
 COLLECTIONS_API size_t strbuf_get_length(const strbuf_t *buf);
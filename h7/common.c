@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdarg.h>
+#include <errno.h>
 
 #ifndef APE_AMALGAMATED
 #include "common.h"
@@ -87,6 +88,463 @@ double ape_uint64_to_double(uint64_t val) {
     return temp.val_double;
 }
 
+int64_t ape_double_to_int64(double val) {
+    if (val != val) {
+        return 0;
+    }
+    if (val >= 9223372036854775807.0) {
+        return INT64_MAX;
+    }
+    if (val <= -9223372036854775808.0) {
+        return INT64_MIN;
+    }
+    return (int64_t)val;
+}
+
+bool ape_int64_is_exact_double(int64_t val) {
+    double val_double = (double)val;
+    // 2^63 doesn't fit in int64 so it's checked before converting back
+    return val_double < 9223372036854775807.0 && (int64_t)val_double == val;
+}
+
+bool ape_int64_add(int64_t a, int64_t b, int64_t *out_res) {
+    return !__builtin_add_overflow(a, b, out_res);
+}
+
+bool ape_int64_sub(int64_t a, int64_t b, int64_t *out_res) {
+    return !__builtin_sub_overflow(a, b, out_res);
+}
+
+bool ape_int64_mul(int64_t a, int64_t b, int64_t *out_res) {
+    return !__builtin_mul_overflow(a, b, out_res);
+}
+
+bool ape_int64_div(int64_t a, int64_t b, int64_t *out_res) {
+    if (b == 0 || (a == INT64_MIN && b == -1) || a % b != 0) {
+        return false;
+    }
+    *out_res = a / b;
+    return true;
+}
+
+bool ape_int64_mod(int64_t a, int64_t b, int64_t *out_res) {
+    if (b == 0) {
+        return false;
+    }
+    *out_res = b == -1 ? 0 : a % b; // same sign as a, like fmod
+    return true;
+}
+
+int64_t ape_int64_lshift(int64_t a, int64_t b) {
+    if (b < 0 || b > 63) {
+        return 0;
+    }
+    return (int64_t)((uint64_t)a << b);
+}
+
+int64_t ape_int64_rshift(int64_t a, int64_t b) {
+    if (b < 0 || b > 63) {
+        return a < 0 ? -1 : 0;
+    }
+    return a >> b;
+}
+
+// Round-trip double formatting, Grisu2 (Loitsch, "Printing Floating-Point Numbers
+// Quickly and Accurately with Integers") with an integer fast path. Grisu2 gives the shortest
+// digits for almost all values, a few get one more (1e23 prints as 9.999999999999999e+22).
+typedef struct {
+    uint64_t f;
+    int e;
+} diyfp_t;
+
+static const uint64_t g_cached_powers_f[] = {
+    0xfa8fd5a0081c0288ULL, 0xbaaee17fa23ebf76ULL, 0x8b16fb203055ac76ULL, 0xcf42894a5dce35eaULL,
+    0x9a6bb0aa55653b2dULL, 0xe61acf033d1a45dfULL, 0xab70fe17c79ac6caULL, 0xff77b1fcbebcdc4fULL,
+    0xbe5691ef416bd60cULL, 0x8dd01fad907ffc3cULL, 0xd3515c2831559a83ULL, 0x9d71ac8fada6c9b5ULL,
+    0xea9c227723ee8bcbULL, 0xaecc49914078536dULL, 0x823c12795db6ce57ULL, 0xc21094364dfb5637ULL,
+    0x9096ea6f3848984fULL, 0xd77485cb25823ac7ULL, 0xa086cfcd97bf97f4ULL, 0xef340a98172aace5ULL,
+    0xb23867fb2a35b28eULL, 0x84c8d4dfd2c63f3bULL, 0xc5dd44271ad3cdbaULL, 0x936b9fcebb25c996ULL,
+    0xdbac6c247d62a584ULL, 0xa3ab66580d5fdaf6ULL, 0xf3e2f893dec3f126ULL, 0xb5b5ada8aaff80b8ULL,
+    0x87625f056c7c4a8bULL, 0xc9bcff6034c13053ULL, 0x964e858c91ba2655ULL, 0xdff9772470297ebdULL,
+    0xa6dfbd9fb8e5b88fULL, 0xf8a95fcf88747d94ULL, 0xb94470938fa89bcfULL, 0x8a08f0f8bf0f156bULL,
+    0xcdb02555653131b6ULL, 0x993fe2c6d07b7facULL, 0xe45c10c42a2b3b06ULL, 0xaa242499697392d3ULL,
+    0xfd87b5f28300ca0eULL, 0xbce5086492111aebULL, 0x8cbccc096f5088ccULL, 0xd1b71758e219652cULL,
+    0x9c40000000000000ULL, 0xe8d4a51000000000ULL, 0xad78ebc5ac620000ULL, 0x813f3978f8940984ULL,
+    0xc097ce7bc90715b3ULL, 0x8f7e32ce7bea5c70ULL, 0xd5d238a4abe98068ULL, 0x9f4f2726179a2245ULL,
+    0xed63a231d4c4fb27ULL, 0xb0de65388cc8ada8ULL, 0x83c7088e1aab65dbULL, 0xc45d1df942711d9aULL,
+    0x924d692ca61be758ULL, 0xda01ee641a708deaULL, 0xa26da3999aef774aULL, 0xf209787bb47d6b85ULL,
+    0xb454e4a179dd1877ULL, 0x865b86925b9bc5c2ULL, 0xc83553c5c8965d3dULL, 0x952ab45cfa97a0b3ULL,
+    0xde469fbd99a05fe3ULL, 0xa59bc234db398c25ULL, 0xf6c69a72a3989f5cULL, 0xb7dcbf5354e9beceULL,
+    0x88fcf317f22241e2ULL, 0xcc20ce9bd35c78a5ULL, 0x98165af37b2153dfULL, 0xe2a0b5dc971f303aULL,
+    0xa8d9d1535ce3b396ULL, 0xfb9b7cd9a4a7443cULL, 0xbb764c4ca7a44410ULL, 0x8bab8eefb6409c1aULL,
+    0xd01fef10a657842cULL, 0x9b10a4e5e9913129ULL, 0xe7109bfba19c0c9dULL, 0xac2820d9623bf429ULL,
+    0x80444b5e7aa7cf85ULL, 0xbf21e44003acdd2dULL, 0x8e679c2f5e44ff8fULL, 0xd433179d9c8cb841ULL,
+    0x9e19db92b4e31ba9ULL, 0xeb96bf6ebadf77d9ULL, 0xaf87023b9bf0ee6bULL,
+};
+
+static const int16_t g_cached_powers_e[] = {
+    -1220, -1193, -1166, -1140, -1113, -1087, -1060, -1034, -1007,  -980,
+     -954,  -927,  -901,  -874,  -847,  -821,  -794,  -768,  -741,  -715,
+     -688,  -661,  -635,  -608,  -582,  -555,  -529,  -502,  -475,  -449,
+     -422,  -396,  -369,  -343,  -316,  -289,  -263,  -236,  -210,  -183,
+     -157,  -130,  -103,   -77,   -50,   -24,     3,    30,    56,    83,
+      109,   136,   162,   189,   216,   242,   269,   295,   322,   348,
+      375,   402,   428,   455,   481,   508,   534,   561,   588,   614,
+      641,   667,   694,   720,   747,   774,   800,   827,   853,   880,
+      907,   933,   960,   986,  1013,  1039,  1066,
+};
+
+static const uint64_t g_pow10[] = {
+    1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL, 100000000ULL,
+    1000000000ULL, 10000000000ULL, 100000000000ULL, 1000000000000ULL, 10000000000000ULL,
+    100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL, 100000000000000000ULL,
+    1000000000000000000ULL, 10000000000000000000ULL,
+};
+
+#define DIYFP_SIGNIFICAND_SIZE 52
+#define DIYFP_EXPONENT_BIAS (0x3ff + DIYFP_SIGNIFICAND_SIZE)
+#define DIYFP_HIDDEN_BIT 0x0010000000000000ULL
+#define DIYFP_SIGNIFICAND_MASK 0x000fffffffffffffULL
+#define DIYFP_EXPONENT_MASK 0x7ff0000000000000ULL
+
+static diyfp_t diyfp_make(uint64_t f, int e) {
+    return (diyfp_t) { .f = f, .e = e };
+}
+
+static diyfp_t diyfp_from_double(double val) {
+    uint64_t bits = ape_double_to_uint64(val);
+    int biased_e = (int)((bits & DIYFP_EXPONENT_MASK) >> DIYFP_SIGNIFICAND_SIZE);
+    uint64_t significand = bits & DIYFP_SIGNIFICAND_MASK;
+    if (biased_e != 0) {
+        return diyfp_make(significand + DIYFP_HIDDEN_BIT, biased_e - DIYFP_EXPONENT_BIAS);
+    }
+    return diyfp_make(significand, 1 - DIYFP_EXPONENT_BIAS);
+}
+
+static diyfp_t diyfp_mul(diyfp_t a, diyfp_t b) {
+    const uint64_t m32 = 0xffffffffULL;
+    uint64_t ah = a.f >> 32, al = a.f & m32;
+    uint64_t bh = b.f >> 32, bl = b.f & m32;
+    uint64_t hh = ah * bh, lh = al * bh, hl = ah * bl, ll = al * bl;
+    uint64_t tmp = (ll >> 32) + (hl & m32) + (lh & m32);
+    tmp += 1ULL << 31; // round
+    return diyfp_make(hh + (hl >> 32) + (lh >> 32) + (tmp >> 32), a.e + b.e + 64);
+}
+
+static diyfp_t diyfp_normalize(diyfp_t x) {
+    while (!(x.f & (1ULL << 63))) {
+        x.f <<= 1;
+        x.e--;
+    }
+    return x;
+}
+
+static void diyfp_normalized_boundaries(diyfp_t v, diyfp_t *out_minus, diyfp_t *out_plus) {
+    diyfp_t plus = diyfp_make((v.f << 1) + 1, v.e - 1);
+    while (!(plus.f & (DIYFP_HIDDEN_BIT << 1))) {
+        plus.f <<= 1;
+        plus.e--;
+    }
+    plus.f <<= 64 - DIYFP_SIGNIFICAND_SIZE - 2;
+    plus.e -= 64 - DIYFP_SIGNIFICAND_SIZE - 2;
+    diyfp_t minus = v.f == DIYFP_HIDDEN_BIT ? diyfp_make((v.f << 2) - 1, v.e - 2) : diyfp_make((v.f << 1) - 1, v.e - 1);
+    minus.f <<= minus.e - plus.e;
+    minus.e = plus.e;
+    *out_minus = minus;
+    *out_plus = plus;
+}
+
+static diyfp_t get_cached_power(int e, int *out_k) {
+    double dk = (-61 - e) * 0.30102999566398114 + 347; // dk must be positive so it can be ceiled
+    int k = (int)dk;
+    if (dk - k > 0.0) {
+        k++;
+    }
+    int index = (k >> 3) + 1;
+    *out_k = -(-348 + index * 8);
+    return diyfp_make(g_cached_powers_f[index], g_cached_powers_e[index]);
+}
+
+static void grisu_round(char *buf, int len, uint64_t delta, uint64_t rest, uint64_t ten_kappa, uint64_t wp_w) {
+    while (rest < wp_w && delta - rest >= ten_kappa
+           && (rest + ten_kappa < wp_w || wp_w - rest > rest + ten_kappa - wp_w)) {
+        buf[len - 1]--;
+        rest += ten_kappa;
+    }
+}
+
+static int count_decimal_digits_32(uint32_t n) {
+    int count = 1;
+    while (n >= 10) {
+        n /= 10;
+        count++;
+    }
+    return count;
+}
+
+static void grisu_digit_gen(diyfp_t w, diyfp_t mp, uint64_t delta, char *buf, int *out_len, int *out_k) {
+    diyfp_t one = diyfp_make(1ULL << -mp.e, mp.e);
+    uint64_t wp_w = mp.f - w.f;
+    uint32_t p1 = (uint32_t)(mp.f >> -one.e);
+    uint64_t p2 = mp.f & (one.f - 1);
+    int kappa = count_decimal_digits_32(p1);
+    int len = 0;
+    while (kappa > 0) {
+        uint32_t pow10 = (uint32_t)g_pow10[kappa - 1];
+        uint32_t d = p1 / pow10;
+        p1 %= pow10;
+        if (d || len) {
+            buf[len++] = (char)('0' + d);
+        }
+        kappa--;
+        uint64_t rest = ((uint64_t)p1 << -one.e) + p2;
+        if (rest <= delta) {
+            *out_k += kappa;
+            grisu_round(buf, len, delta, rest, g_pow10[kappa] << -one.e, wp_w);
+            *out_len = len;
+            return;
+        }
+    }
+    for (;;) {
+        p2 *= 10;
+        delta *= 10;
+        char d = (char)(p2 >> -one.e);
+        if (d || len) {
+            buf[len++] = (char)('0' + d);
+        }
+        p2 &= one.f - 1;
+        kappa--;
+        if (p2 < delta) {
+            *out_k += kappa;
+            int ix = -kappa;
+            grisu_round(buf, len, delta, p2, one.f, wp_w * (ix < APE_ARRAY_LEN(g_pow10) ? g_pow10[ix] : 0));
+            *out_len = len;
+            return;
+        }
+    }
+}
+
+static int write_exponent(int k, char *buf) {
+    int len = 0;
+    if (k < 0) {
+        buf[len++] = '-';
+        k = -k;
+    } else {
+        buf[len++] = '+';
+    }
+    if (k >= 100) {
+        buf[len++] = (char)('0' + k / 100);
+        k %= 100;
+        buf[len++] = (char)('0' + k / 10);
+        buf[len++] = (char)('0' + k % 10);
+    } else if (k >= 10) {
+        buf[len++] = (char)('0' + k / 10);
+        buf[len++] = (char)('0' + k % 10);
+    } else {
+        buf[len++] = (char)('0' + k);
+    }
+    return len;
+}
+
+// digits in buf represent digits * 10^k, result is written in place
+static int prettify_digits(char *buf, int len, int k) {
+    int kk = len + k; // 10^(kk - 1) <= v < 10^kk
+    if (k >= 0 && kk <= 21) { // 1234e7 -> 12340000000
+        for (int i = len; i < kk; i++) {
+            buf[i] = '0';
+        }
+        return kk;
+    } else if (kk > 0 && kk <= 21) { // 1234e-2 -> 12.34
+        memmove(&buf[kk + 1], &buf[kk], len - kk);
+        buf[kk] = '.';
+        return len + 1;
+    } else if (kk > -6 && kk <= 0) { // 1234e-6 -> 0.001234
+        int offset = 2 - kk;
+        memmove(&buf[offset], &buf[0], len);
+        buf[0] = '0';
+        buf[1] = '.';
+        for (int i = 2; i < offset; i++) {
+            buf[i] = '0';
+        }
+        return len + offset;
+    } else if (len == 1) { // 1e30
+        buf[1] = 'e';
+        return 2 + write_exponent(kk - 1, &buf[2]);
+    } else { // 1234e30 -> 1.234e+33
+        memmove(&buf[2], &buf[1], len - 1);
+        buf[1] = '.';
+        buf[len + 1] = 'e';
+        return len + 2 + write_exponent(kk - 1, &buf[len + 2]);
+    }
+}
+
+static int write_uint64(uint64_t val, char *buf) {
+    char tmp[20];
+    int len = 0;
+    do {
+        tmp[len++] = (char)('0' + val % 10);
+        val /= 10;
+    } while (val);
+    for (int i = 0; i < len; i++) {
+        buf[i] = tmp[len - i - 1];
+    }
+    return len;
+}
+
+int ape_dtoa(double val, char *buf) {
+    int len = 0;
+    if (isnan(val)) {
+        memcpy(buf, "nan", 4);
+        return 3;
+    }
+    if (signbit(val)) {
+        buf[len++] = '-';
+        val = -val;
+    }
+    if (isinf(val)) {
+        memcpy(buf + len, "inf", 4);
+        return len + 3;
+    }
+    if (val < 9007199254740992.0 && val == (double)(uint64_t)val) { // integers below 2^53
+        len += write_uint64((uint64_t)val, buf + len);
+        buf[len] = '\0';
+        return len;
+    }
+    diyfp_t v = diyfp_from_double(val);
+    diyfp_t w_m, w_p;
+    diyfp_normalized_boundaries(v, &w_m, &w_p);
+    int k = 0;
+    diyfp_t c_mk = get_cached_power(w_p.e, &k);
+    diyfp_t w = diyfp_mul(diyfp_normalize(v), c_mk);
+    diyfp_t wp = diyfp_mul(w_p, c_mk);
+    diyfp_t wm = diyfp_mul(w_m, c_mk);
+    wm.f++;
+    wp.f--;
+    int digits_len = 0;
+    grisu_digit_gen(w, wp, wp.f - wm.f, buf + len, &digits_len, &k);
+    len += prettify_digits(buf + len, digits_len, k);
+    buf[len] = '\0';
+    return len;
+}
+
+// Clinger's fast path: a decimal with at most 19 significant digits whose mantissa fits in
+// 53 bits and whose exponent is within [-22, 22] can be converted with a single
+// correctly rounded multiplication or division. Everything else goes to strtod.
+static const double g_exact_pow10[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+static bool parse_number_fast(const char *str, int len, double *out_val) {
+    const char *p = str;
+    const char *end = str + len;
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = *p == '-';
+        p++;
+    }
+    uint64_t mantissa = 0;
+    int digits = 0;
+    int exponent = 0;
+    const char *digits_start = p;
+    while (p < end && *p >= '0' && *p <= '9') {
+        if (digits > 0 || *p != '0') {
+            if (digits >= 19) {
+                return false;
+            }
+            mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+            digits++;
+        }
+        p++;
+    }
+    bool has_int_part = p != digits_start;
+    bool has_frac_part = false;
+    if (p < end && *p == '.') {
+        p++;
+        const char *frac_start = p;
+        while (p < end && *p >= '0' && *p <= '9') {
+            if (digits > 0 || *p != '0') {
+                if (digits >= 19) {
+                    return false;
+                }
+                mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+                digits++;
+            }
+            exponent--;
+            p++;
+        }
+        has_frac_part = p != frac_start;
+    }
+    if (!has_int_part && !has_frac_part) {
+        return false;
+    }
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        p++;
+        bool exp_negative = false;
+        if (p < end && (*p == '-' || *p == '+')) {
+            exp_negative = *p == '-';
+            p++;
+        }
+        if (p == end) {
+            return false;
+        }
+        int exp_val = 0;
+        while (p < end && *p >= '0' && *p <= '9') {
+            if (exp_val > 1000) {
+                return false;
+            }
+            exp_val = exp_val * 10 + (*p - '0');
+            p++;
+        }
+        exponent += exp_negative ? -exp_val : exp_val;
+    }
+    if (p != end) {
+        return false;
+    }
+    if (mantissa > (1ULL << 53) || exponent < -22 || exponent > 22) {
+        return false;
+    }
+    double val = (double)mantissa;
+    if (exponent < 0) {
+        val /= g_exact_pow10[-exponent];
+    } else {
+        val *= g_exact_pow10[exponent];
+    }
+    *out_val = negative ? -val : val;
+    return true;
+}
+
+bool ape_parse_number(const char *str, int len, double *out_val) {
+    if (parse_number_fast(str, len, out_val)) {
+        return true;
+    }
+    char *end = NULL;
+    errno = 0;
+    double val = strtod(str, &end);
+    if (errno == ERANGE && (val <= -HUGE_VAL || val >= HUGE_VAL)) {
+        return false;
+    }
+    if (errno && errno != ERANGE) {
+        return false;
+    }
+    if ((int)(end - str) != len) {
+        return false;
+    }
+    *out_val = val;
+    return true;
+}
+
+uint64_t ape_random_next(uint64_t *state) {
+    uint64_t z = (*state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+double ape_random_next_double(uint64_t *state) {
+    return (ape_random_next(state) >> 11) * (1.0 / 9007199254740992.0);
+}
+
 bool ape_timer_platform_supported() {
 #if defined(APE_POSIX) || defined(APE_EMSCRIPTEN) || defined(APE_WINDOWS)
     return true;
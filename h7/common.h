@@ -91,6 +91,8 @@ typedef struct ape_config {
     } fileio;
 
     bool repl_mode; // allows redefinition of symbols
+    bool bytecode_cache;
+    bool module_cache;
 
     double max_execution_time_ms;
     bool max_execution_time_set;
@@ -119,6 +121,32 @@ APE_INTERNAL char* ape_strdup(allocator_t *alloc, const char *string);
 APE_INTERNAL uint64_t ape_double_to_uint64(double val);
 APE_INTERNAL double ape_uint64_to_double(uint64_t val);
 
+// Truncates towards zero, values outside of the int64 range saturate and NaN gives 0.
+APE_INTERNAL int64_t ape_double_to_int64(double val);
+// True if val converts to a double and back without changing.
+APE_INTERNAL bool ape_int64_is_exact_double(int64_t val);
+
+// Integer arithmetic shared by the VM and constant folding. These return false when the result
+// isn't an exact int64 (overflow, division by zero or with a remainder) and callers fall back to doubles.
+APE_INTERNAL bool ape_int64_add(int64_t a, int64_t b, int64_t *out_res);
+APE_INTERNAL bool ape_int64_sub(int64_t a, int64_t b, int64_t *out_res);
+APE_INTERNAL bool ape_int64_mul(int64_t a, int64_t b, int64_t *out_res);
+APE_INTERNAL bool ape_int64_div(int64_t a, int64_t b, int64_t *out_res);
+APE_INTERNAL bool ape_int64_mod(int64_t a, int64_t b, int64_t *out_res);
+// Shift counts outside of [0, 63] shift everything out, right shifts are arithmetic.
+APE_INTERNAL int64_t ape_int64_lshift(int64_t a, int64_t b);
+APE_INTERNAL int64_t ape_int64_rshift(int64_t a, int64_t b);
+
+#define APE_DTOA_BUFFER_SIZE 32
+// Writes a string that reads back as val, the shortest one for almost all values, returns its length.
+APE_INTERNAL int ape_dtoa(double val, char *buf);
+// Parses the whole of str (len chars, null terminated) as a number.
+APE_INTERNAL bool ape_parse_number(const char *str, int len, double *out_val);
+
+// splitmix64, state is per vm so that instances on different threads don't share it (unlike rand()).
+APE_INTERNAL uint64_t ape_random_next(uint64_t *state);
+APE_INTERNAL double   ape_random_next_double(uint64_t *state); // in [0, 1)
+
 APE_INTERNAL bool ape_timer_platform_supported(void);
 APE_INTERNAL ape_timer_t ape_timer_start(void);
 APE_INTERNAL double ape_timer_get_elapsed_ms(const ape_timer_t *timer);
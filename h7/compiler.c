@@ -12,6 +12,9 @@
 #include "symbol_table.h"
 #include "errors.h"
 #include "optimisation.h"
+#include "global_store.h"
+#include "bytecode_cache.h"
+#include "module_cache.h"
 #endif
 
 typedef struct module {
@@ -43,6 +46,14 @@ typedef struct compiler {
     dict(int) *string_constants_positions;
 } compiler_t;
 
+typedef struct compiler_globals {
+    allocator_t *alloc;
+    ptrarray(symbol_t) *symbols; // module globals visible in global scope
+    int count;
+    dict(module_t) *modules;
+    ptrarray(char) *loaded_module_names;
+} compiler_globals_t;
+
 static bool compiler_init(compiler_t *comp,
                           allocator_t *alloc,
                           const ape_config_t *config,
@@ -53,6 +64,8 @@ static void compiler_deinit(compiler_t *comp);
 
 static bool compiler_init_shallow_copy(compiler_t *copy, compiler_t *src); // used to restore compiler's state if something fails
 
+static compilation_result_t* compile(compiler_t *comp, const char *code, bool is_file);
+
 static int emit(compiler_t *comp, opcode_t op, int operands_count, uint64_t *operands);
 static compilation_scope_t* get_compilation_scope(compiler_t *comp);
 static bool push_compilation_scope(compiler_t *comp);
@@ -61,12 +74,24 @@ static bool push_symbol_table(compiler_t *comp, int global_offset);
 static void pop_symbol_table(compiler_t *comp);
 static opcode_t get_last_opcode(compiler_t *comp);
 static bool compile_code(compiler_t *comp, const char *code);
+static bool compile_file_code(compiler_t *comp, const char *code, bool is_module);
+static bool compile_file_statements(compiler_t *comp, const char *code, int imports_done, const char *cache_path,
+                                    bool module_cache, uint64_t source_hash, uint64_t globals_hash);
+static bool check_cached_file(const bytecode_cache_t *cache);
+static bool load_cached_file(compiler_t *comp, const bytecode_cache_t *cache, const char *code, int imports_done,
+                             bool *out_loaded);
+static bool save_file_cache(compiler_t *comp, const char *cache_path, bool module_cache, uint64_t source_hash,
+                            uint64_t globals_hash, ptrarray(statement_t) *imports, int code_start,
+                            int own_globals_start);
+static uint64_t get_globals_hash(compiler_t *comp);
 static bool compile_statements(compiler_t *comp, ptrarray(statement_t) *statements);
 static bool import_module(compiler_t *comp, const statement_t *import_stmt);
 static bool compile_statement(compiler_t *comp, const statement_t *stmt);
 static bool compile_expression(compiler_t *comp, expression_t *expr);
 static bool compile_code_block(compiler_t *comp, const code_block_t *block);
 static int  add_constant(compiler_t *comp, object_t obj);
+static int  add_string_constant(compiler_t *comp, const char *string);
+static bool compile_struct_statement(compiler_t *comp, const statement_t *stmt);
 static void change_uint16_operand(compiler_t *comp, int ip, uint16_t operand);
 static bool last_opcode_is(compiler_t *comp, opcode_t op);
 static bool read_symbol(compiler_t *comp, const symbol_t *symbol);
@@ -95,6 +120,7 @@ static void set_compilation_scope(compiler_t *comp, compilation_scope_t *scope);
 static module_t* module_make(allocator_t *alloc, const char *name);
 static void module_destroy(module_t *module);
 static module_t* module_copy(module_t *module);
+static module_t* module_copy_with_alloc(allocator_t *alloc, module_t *module);
 static bool module_add_symbol(module_t *module, const symbol_t *symbol);
 
 static const char* get_module_name(const char *path);
@@ -123,44 +149,7 @@ void compiler_destroy(compiler_t *comp) {
 }
 
 compilation_result_t* compiler_compile(compiler_t *comp, const char *code) {
-    compilation_scope_t *compilation_scope = get_compilation_scope(comp);
-
-    APE_ASSERT(array_count(comp->src_positions_stack) == 0);
-    APE_ASSERT(array_count(compilation_scope->bytecode) == 0);
-    APE_ASSERT(array_count(compilation_scope->break_ip_stack) == 0);
-    APE_ASSERT(array_count(compilation_scope->continue_ip_stack) == 0);
-
-    array_clear(comp->src_positions_stack);
-    array_clear(compilation_scope->bytecode);
-    array_clear(compilation_scope->src_positions);
-    array_clear(compilation_scope->break_ip_stack);
-    array_clear(compilation_scope->continue_ip_stack);
-
-    compiler_t comp_shallow_copy;
-    bool ok = compiler_init_shallow_copy(&comp_shallow_copy, comp);
-    if (!ok) {
-        return NULL;
-    }
-
-    ok = compile_code(comp, code);
-    if (!ok) {
-        goto err;
-    }
-
-    compilation_scope = get_compilation_scope(comp); // might've changed
-    APE_ASSERT(compilation_scope->outer == NULL);
-
-    compilation_scope = get_compilation_scope(comp);
-    compilation_result_t *res = compilation_scope_orphan_result(compilation_scope);
-    if (!res) {
-        goto err;
-    }
-    compiler_deinit(&comp_shallow_copy);
-    return res;
-err:
-    compiler_deinit(comp);
-    *comp = comp_shallow_copy;
-    return NULL;
+    return compile(comp, code, false);
 }
 
 compilation_result_t* compiler_compile_file(compiler_t *comp, const char *path) {
@@ -199,7 +188,7 @@ compilation_result_t* compiler_compile_file(compiler_t *comp, const char *path)
     compiled_file_t *prev_file = file_scope->file; // todo: push file scope instead?
     file_scope->file = file;
 
-    res = compiler_compile(comp, code);
+    res = compile(comp, code, true);
     if (!res) {
         file_scope->file = prev_file;
         goto err;
@@ -213,6 +202,113 @@ err:
     return NULL;
 }
 
+compiler_globals_t* compiler_copy_globals(compiler_t *comp) {
+    compiler_globals_t *globals = allocator_malloc(comp->alloc, sizeof(compiler_globals_t));
+    if (!globals) {
+        return NULL;
+    }
+    memset(globals, 0, sizeof(compiler_globals_t));
+    globals->alloc = comp->alloc;
+    globals->symbols = ptrarray_make(comp->alloc);
+    globals->modules = dict_copy_with_items(comp->modules);
+    globals->loaded_module_names = ptrarray_make(comp->alloc);
+    if (!globals->symbols || !globals->modules || !globals->loaded_module_names) {
+        goto err;
+    }
+
+    symbol_table_t *symbol_table = compiler_get_symbol_table(comp);
+    block_scope_t *scope = symbol_table_get_block_scope(symbol_table);
+    for (int i = 0; i < dict_count(scope->store); i++) {
+        symbol_t *symbol = dict_get_value_at(scope->store, i);
+        if (symbol->type != SYMBOL_MODULE_GLOBAL) {
+            continue;
+        }
+        symbol_t *copy = symbol_copy(symbol);
+        if (!copy) {
+            goto err;
+        }
+        bool ok = ptrarray_add(globals->symbols, copy);
+        if (!ok) {
+            symbol_destroy(copy);
+            goto err;
+        }
+    }
+    // includes globals of imported modules that aren't visible here
+    globals->count = scope->offset + scope->num_definitions;
+
+    file_scope_t *file_scope = ptrarray_top(comp->file_scopes);
+    for (int i = 0; i < ptrarray_count(file_scope->loaded_module_names); i++) {
+        char *name = ape_strdup(comp->alloc, ptrarray_get(file_scope->loaded_module_names, i));
+        if (!name) {
+            goto err;
+        }
+        bool ok = ptrarray_add(globals->loaded_module_names, name);
+        if (!ok) {
+            allocator_free(comp->alloc, name);
+            goto err;
+        }
+    }
+    return globals;
+err:
+    compiler_globals_destroy(globals);
+    return NULL;
+}
+
+void compiler_globals_destroy(compiler_globals_t *globals) {
+    if (!globals) {
+        return;
+    }
+    ptrarray_destroy_with_items(globals->symbols, symbol_destroy);
+    dict_destroy_with_items(globals->modules);
+    for (int i = 0; i < ptrarray_count(globals->loaded_module_names); i++) {
+        allocator_free(globals->alloc, ptrarray_get(globals->loaded_module_names, i));
+    }
+    ptrarray_destroy(globals->loaded_module_names);
+    allocator_free(globals->alloc, globals);
+}
+
+bool compiler_define_shared_globals(compiler_t *comp, const compiler_globals_t *globals,
+                                    array(object_t) *constants) {
+    symbol_table_t *symbol_table = compiler_get_symbol_table(comp);
+    block_scope_t *scope = symbol_table_get_block_scope(symbol_table);
+    if (ptrarray_count(comp->file_scopes) != 1 || scope->num_definitions > 0 || array_count(comp->constants) > 0) {
+        return false;
+    }
+    for (int i = 0; i < ptrarray_count(globals->symbols); i++) {
+        bool ok = symbol_table_add_module_symbol(symbol_table, ptrarray_get(globals->symbols, i));
+        if (!ok) {
+            return false;
+        }
+    }
+    scope->num_definitions = globals->count; // reserves the indices so that later definitions don't reuse them
+
+    // everything is copied with comp's allocator, globals can be used from other threads
+    for (int i = 0; i < dict_count(globals->modules); i++) {
+        module_t *module = module_copy_with_alloc(comp->alloc, dict_get_value_at(globals->modules, i));
+        if (!module) {
+            return false;
+        }
+        bool ok = dict_set(comp->modules, dict_get_key_at(globals->modules, i), module);
+        if (!ok) {
+            module_destroy(module);
+            return false;
+        }
+    }
+    file_scope_t *file_scope = ptrarray_top(comp->file_scopes);
+    for (int i = 0; i < ptrarray_count(globals->loaded_module_names); i++) {
+        char *name = ape_strdup(comp->alloc, ptrarray_get(globals->loaded_module_names, i));
+        if (!name) {
+            return false;
+        }
+        bool ok = ptrarray_add(file_scope->loaded_module_names, name);
+        if (!ok) {
+            allocator_free(comp->alloc, name);
+            return false;
+        }
+    }
+    return array_add_array(comp->constants, constants);
+}
+
 symbol_table_t* compiler_get_symbol_table(compiler_t *comp) {
     file_scope_t *file_scope = ptrarray_top(comp->file_scopes);
     if (!file_scope) {
@@ -382,6 +478,47 @@ err:
     return false;
 }
 
+static compilation_result_t* compile(compiler_t *comp, const char *code, bool is_file) {
+    compilation_scope_t *compilation_scope = get_compilation_scope(comp);
+
+    APE_ASSERT(array_count(comp->src_positions_stack) == 0);
+    APE_ASSERT(array_count(compilation_scope->bytecode) == 0);
+    APE_ASSERT(array_count(compilation_scope->break_ip_stack) == 0);
+    APE_ASSERT(array_count(compilation_scope->continue_ip_stack) == 0);
+
+    array_clear(comp->src_positions_stack);
+    array_clear(compilation_scope->bytecode);
+    array_clear(compilation_scope->src_positions);
+    array_clear(compilation_scope->break_ip_stack);
+    array_clear(compilation_scope->continue_ip_stack);
+
+    compiler_t comp_shallow_copy;
+    bool ok = compiler_init_shallow_copy(&comp_shallow_copy, comp);
+    if (!ok) {
+        return NULL;
+    }
+
+    ok = is_file ? compile_file_code(comp, code, false) : compile_code(comp, code);
+    if (!ok) {
+        goto err;
+    }
+
+    compilation_scope = get_compilation_scope(comp); // might've changed
+    APE_ASSERT(compilation_scope->outer == NULL);
+
+    compilation_scope = get_compilation_scope(comp);
+    compilation_result_t *res = compilation_scope_orphan_result(compilation_scope);
+    if (!res) {
+        goto err;
+    }
+    compiler_deinit(&comp_shallow_copy);
+    return res;
+err:
+    compiler_deinit(comp);
+    *comp = comp_shallow_copy;
+    return NULL;
+}
+
 static int emit(compiler_t *comp, opcode_t op, int operands_count, uint64_t *operands) {
     int ip = get_ip(comp);
     int len = code_make(op, operands_count, operands, get_bytecode(comp));
@@ -485,6 +622,709 @@ static bool compile_code(compiler_t *comp, const char *code) {
     return ok;
 }
 
+// Files are compiled from the module cache (modules only) or their bytecode cache if they have a valid one,
+// only files that import modules before anything else are cached so that their own globals and bytecode come
+// after all of their imports.
+static bool compile_file_code(compiler_t *comp, const char *code, bool is_module) {
+    bool module_cache = is_module && comp->config->module_cache;
+    if (!comp->config->bytecode_cache && !module_cache) {
+        return compile_code(comp, code);
+    }
+
+    file_scope_t *file_scope = ptrarray_top(comp->file_scopes);
+    char *cache_path = NULL;
+    if (comp->config->bytecode_cache) {
+        cache_path = bytecode_cache_get_path(comp->alloc, file_scope->file->path);
+        if (!cache_path) {
+            return false;
+        }
+    }
+    uint64_t source_hash = bytecode_cache_hash(code, strlen(code), 0);
+    uint64_t globals_hash = get_globals_hash(comp);
+
+    const char *path = file_scope->file->path; // canonical for modules
+    bool repl_mode = comp->config->repl_mode;
+    int imports_done = 0;
+    bool ok = true;
+    bool loaded = false;
+    bytecode_cache_t *cache = NULL;
+    if (module_cache) {
+        cache = module_cache_load(comp->alloc, path, source_hash, globals_hash, repl_mode, -1);
+    }
+    bool in_module_cache = cache != NULL;
+    if (!cache && cache_path) {
+        cache = bytecode_cache_load(comp->alloc, cache_path, source_hash, globals_hash, repl_mode);
+        if (cache && !check_cached_file(cache)) {
+            bytecode_cache_destroy(cache);
+            cache = NULL;
+        }
+    }
+    if (cache) {
+        ok = load_cached_file(comp, cache, code, 0, &loaded);
+        imports_done = array_count(cache->imports);
+        bool positioned = cache->globals_start >= 0;
+        if (ok && loaded && module_cache && !in_module_cache) {
+            module_cache_add(path, cache);
+        }
+        bytecode_cache_destroy(cache);
+        cache = NULL;
+
+        // the cache doesn't fit what was defined before the file, the module cache might have it for
+        // where the file's globals start now
+        block_scope_t *scope = symbol_table_get_block_scope(compiler_get_symbol_table(comp));
+        if (ok && !loaded && module_cache && positioned) {
+            cache = module_cache_load(comp->alloc, path, source_hash, globals_hash, repl_mode,
+                                      scope->offset + scope->num_definitions);
+            in_module_cache = cache != NULL;
+        }
+        if (cache) {
+            ok = load_cached_file(comp, cache, code, imports_done, &loaded);
+            bytecode_cache_destroy(cache);
+        }
+    }
+    if (ok && !loaded) {
+        // .apec files are only written for files compiled from the start, so that files that fit in some
+        // places only don't change them every time
+        ok = compile_file_statements(comp, code, imports_done, imports_done == 0 ? cache_path : NULL,
+                                     module_cache && !in_module_cache, source_hash, globals_hash);
+    }
+    allocator_free(comp->alloc, cache_path);
+    return ok;
+}
+
+static bool compile_file_statements(compiler_t *comp, const char *code, int imports_done, const char *cache_path,
+                                    bool module_cache, uint64_t source_hash, uint64_t globals_hash) {
+    file_scope_t *file_scope = ptrarray_top(comp->file_scopes);
+    ptrarray(statement_t) *statements = parser_parse_all(file_scope->parser, code, file_scope->file);
+    if (!statements) {
+        // errors are added by parser
+        return false;
+    }
+
+    int imports_count = 0;
+    bool cacheable = cache_path != NULL || module_cache;
+    for (int i = 0; i < ptrarray_count(statements); i++) {
+        const statement_t *stmt = ptrarray_get(statements, i);
+        if (stmt->type == STATEMENT_IMPORT) {
+            cacheable = cacheable && imports_count == i;
+            imports_count += imports_count == i ? 1 : 0;
+        }
+    }
+    APE_ASSERT(imports_done <= imports_count);
+
+    bool ok = true;
+    int code_start = 0;
+    int own_globals_start = 0;
+    for (int i = imports_done; ok && i <= ptrarray_count(statements); i++) {
+        if (i == imports_count) {
+            block_scope_t *scope = symbol_table_get_block_scope(compiler_get_symbol_table(comp));
+            code_start = array_count(get_bytecode(comp));
+            own_globals_start = scope->offset + scope->num_definitions;
+        }
+        if (i < ptrarray_count(statements)) {
+            ok = compile_statement(comp, ptrarray_get(statements, i));
+        }
+    }
+
+    if (ok && cacheable) {
+        ptrarray(statement_t) *imports = ptrarray_make(comp->alloc);
+        for (int i = 0; imports && i < imports_count; i++) {
+            ptrarray_add(imports, ptrarray_get(statements, i));
+        }
+        if (imports && ptrarray_count(imports) == imports_count) {
+            // failing to save only means compiling again next time
+            save_file_cache(comp, cache_path, module_cache, source_hash, globals_hash, imports, code_start,
+                            own_globals_start);
+        }
+        ptrarray_destroy(imports);
+    }
+
+    ptrarray_destroy_with_items(statements, statement_destroy);
+    return ok;
+}
+
+typedef struct cache_writer {
+    compiler_t *comp;
+    bytecode_cache_t *cache;
+    int code_start;
+    int own_globals_start;
+    valdict(int, const char*) *named_globals; // defined before the file or imported, by index
+    valdict(int, int) *constants;             // compiler's constant index -> cache's
+    valdict(int, int) *module_globals;
+    valdict(int, int) *ape_globals;
+} cache_writer_t;
+
+static int cache_write_code(cache_writer_t *writer, const uint8_t *bytecode, const src_pos_t *positions,
+                            int count, bool top_level);
+
+static int cache_write_constant(cache_writer_t *writer, int ix) {
+    int *existing = valdict_get(writer->constants, &ix);
+    if (existing) {
+        return *existing;
+    }
+    object_t *obj = array_get(writer->comp->constants, ix);
+    if (!obj) {
+        return -1;
+    }
+    int res = -1;
+    if (object_get_type(*obj) == OBJECT_STRING) {
+        const char *string = object_get_string(*obj);
+        if ((int)strlen(string) != object_get_string_length(*obj)) {
+            return -1; // strings with zeros aren't supported
+        }
+        res = bytecode_cache_add_constant(writer->cache, CACHE_CONSTANT_STRING, string);
+    } else if (object_get_type(*obj) == OBJECT_FUNCTION) {
+        const function_t *function = object_get_function(*obj);
+        if (!function->owns_data || function->free_vals_count > 0) {
+            return -1;
+        }
+        res = bytecode_cache_add_constant(writer->cache, CACHE_CONSTANT_FUNCTION, object_get_function_name(*obj));
+        if (res < 0 || !valdict_set(writer->constants, &ix, &res)) {
+            return -1;
+        }
+        const compilation_result_t *comp_res = function->comp_result;
+        int code_ix = cache_write_code(writer, comp_res->bytecode, comp_res->src_positions, comp_res->count, false);
+        if (code_ix < 0) {
+            return -1;
+        }
+        cache_constant_t *constant = array_get(writer->cache->constants, res);
+        constant->code = code_ix;
+        constant->num_locals = function->num_locals;
+        constant->num_args = function->num_args;
+        return res;
+    }
+    if (res < 0 || !valdict_set(writer->constants, &ix, &res)) {
+        return -1;
+    }
+    return res;
+}
+
+static int cache_write_module_global(cache_writer_t *writer, int ix) {
+    int *existing = valdict_get(writer->module_globals, &ix);
+    if (existing) {
+        return *existing;
+    }
+    int res = -1;
+    const char **name = valdict_get(writer->named_globals, &ix);
+    if (name) {
+        res = bytecode_cache_add_global(writer->cache, CACHE_GLOBAL_MODULE, 0, *name);
+    } else if (ix >= writer->own_globals_start) {
+        res = bytecode_cache_add_global(writer->cache, CACHE_GLOBAL_OWN, ix - writer->own_globals_start, NULL);
+        if (ix - writer->own_globals_start >= writer->cache->globals_span) {
+            writer->cache->globals_start = writer->own_globals_start;
+        }
+    }
+    if (res < 0 || !valdict_set(writer->module_globals, &ix, &res)) {
+        return -1;
+    }
+    return res;
+}
+
+static int cache_write_ape_global(cache_writer_t *writer, int ix) {
+    int *existing = valdict_get(writer->ape_globals, &ix);
+    if (existing) {
+        return *existing;
+    }
+    const char *name = global_store_get_name_at(writer->comp->global_store, ix);
+    if (!name) {
+        return -1;
+    }
+    int res = bytecode_cache_add_global(writer->cache, CACHE_GLOBAL_APE, 0, name);
+    if (res < 0 || !valdict_set(writer->ape_globals, &ix, &res)) {
+        return -1;
+    }
+    return res;
+}
+
+static int get_instruction_len(const uint8_t *bytecode, int ip, int count) {
+    opcode_definition_t *def = opcode_lookup(bytecode[ip]);
+    if (!def) {
+        return -1;
+    }
+    int len = 1;
+    for (int i = 0; i < def->num_operands; i++) {
+        len += def->operand_widths[i];
+    }
+    return len <= count - ip ? len : -1;
+}
+
+static int get_uint16_operand(const uint8_t *bytecode, int ip, int len) {
+    return len >= 3 ? (bytecode[ip + 1] << 8) | bytecode[ip + 2] : 0;
+}
+
+static void set_uint16_operand(uint8_t *bytecode, int ip, int operand) {
+    bytecode[ip + 1] = (uint8_t)(operand >> 8);
+    bytecode[ip + 2] = (uint8_t)operand;
+}
+
+static int cache_write_code(cache_writer_t *writer, const uint8_t *bytecode, const src_pos_t *positions,
+                            int count, bool top_level) {
+    int code_ix = bytecode_cache_add_code(writer->cache, bytecode, positions, count);
+    if (code_ix < 0) {
+        return -1;
+    }
+    int ip = 0;
+    while (ip < count) {
+        int len = get_instruction_len(bytecode, ip, count);
+        if (len < 0) {
+            return -1;
+        }
+        int operand = get_uint16_operand(bytecode, ip, len);
+        switch (bytecode[ip]) {
+            case OPCODE_CONSTANT: case OPCODE_FUNCTION: case OPCODE_GET_FIELD: case OPCODE_SET_FIELD:
+                operand = cache_write_constant(writer, operand);
+                break;
+            case OPCODE_GET_MODULE_GLOBAL: case OPCODE_SET_MODULE_GLOBAL: case OPCODE_DEFINE_MODULE_GLOBAL:
+                operand = cache_write_module_global(writer, operand);
+                break;
+            case OPCODE_GET_APE_GLOBAL:
+                operand = cache_write_ape_global(writer, operand);
+                break;
+            case OPCODE_JUMP: case OPCODE_JUMP_IF_FALSE: case OPCODE_JUMP_IF_TRUE: case OPCODE_SET_RECOVER:
+                if (top_level) {
+                    operand -= writer->code_start;
+                    operand = operand <= count ? operand : -1;
+                }
+                break;
+            default:
+                ip += len;
+                continue;
+        }
+        if (operand < 0 || operand > UINT16_MAX) {
+            return -1;
+        }
+        // bytecode_cache_add_code copied bytecode, so writing operands doesn't change the compiled code
+        set_uint16_operand(bytecode_cache_get_added_bytecode(writer->cache, code_ix), ip, operand);
+        ip += len;
+    }
+    return code_ix;
+}
+
+static bool save_file_cache(compiler_t *comp, const char *cache_path, bool module_cache, uint64_t source_hash,
+                            uint64_t globals_hash, ptrarray(statement_t) *imports, int code_start,
+                            int own_globals_start) {
+    bool result = false;
+    symbol_table_t *symbol_table = compiler_get_symbol_table(comp);
+    block_scope_t *scope = symbol_table_get_block_scope(symbol_table);
+
+    cache_writer_t writer;
+    memset(&writer, 0, sizeof(cache_writer_t));
+    writer.comp = comp;
+    writer.code_start = code_start;
+    writer.own_globals_start = own_globals_start;
+    writer.cache = bytecode_cache_make(comp->alloc);
+    writer.named_globals = valdict_make(comp->alloc, int, const char*);
+    writer.constants = valdict_make(comp->alloc, int, int);
+    writer.module_globals = valdict_make(comp->alloc, int, int);
+    writer.ape_globals = valdict_make(comp->alloc, int, int);
+    if (!writer.cache || !writer.named_globals || !writer.constants || !writer.module_globals || !writer.ape_globals) {
+        goto end;
+    }
+    bytecode_cache_t *cache = writer.cache;
+    cache->source_hash = source_hash;
+    cache->globals_hash = globals_hash;
+    cache->repl_mode = comp->config->repl_mode;
+    cache->globals_span = scope->offset + scope->num_definitions - own_globals_start;
+
+    for (int i = 0; i < ptrarray_count(imports); i++) {
+        const statement_t *import = ptrarray_get(imports, i);
+        if (bytecode_cache_add_import(cache, import->import.path, import->pos.line, import->pos.column) < 0) {
+            goto end;
+        }
+    }
+    for (int i = 0; i < symbol_table_get_module_global_symbol_count(symbol_table); i++) {
+        const symbol_t *symbol = symbol_table_get_module_global_symbol_at(symbol_table, i);
+        if (symbol->index < own_globals_start) {
+            continue;
+        }
+        if (bytecode_cache_add_symbol(cache, symbol->name, symbol->index - own_globals_start, symbol->assignable) < 0) {
+            goto end;
+        }
+    }
+    for (int i = 0; i < dict_count(scope->store); i++) {
+        const symbol_t *symbol = dict_get_value_at(scope->store, i);
+        if (symbol->type != SYMBOL_MODULE_GLOBAL || symbol->index >= own_globals_start) {
+            continue;
+        }
+        int ix = symbol->index;
+        const char *name = symbol->name;
+        if (!valdict_set(writer.named_globals, &ix, &name)) {
+            goto end;
+        }
+    }
+
+    array(uint8_t) *bytecode = get_bytecode(comp);
+    array(src_pos_t) *src_positions = get_src_positions(comp);
+    const uint8_t *code = (const uint8_t*)array_data(bytecode) + code_start;
+    const src_pos_t *positions = (const src_pos_t*)array_data(src_positions) + code_start;
+    int code_ix = cache_write_code(&writer, code, positions, array_count(bytecode) - code_start, true);
+    if (code_ix != 0) {
+        goto end;
+    }
+    result = true;
+    if (module_cache) {
+        file_scope_t *file_scope = ptrarray_top(comp->file_scopes);
+        result = module_cache_add(file_scope->file->path, cache);
+    }
+    if (cache_path) {
+        result = bytecode_cache_save(cache, cache_path) && result;
+    }
+end:
+    bytecode_cache_destroy(writer.cache);
+    valdict_destroy(writer.named_globals);
+    valdict_destroy(writer.constants);
+    valdict_destroy(writer.module_globals);
+    valdict_destroy(writer.ape_globals);
+    return result;
+}
+
+// Checks operands before anything is loaded, so that a cache that doesn't fit falls back on compiling.
+// num_locals is -1 for the file's top level code, which has no locals.
+static bool check_cached_code(const bytecode_cache_t *cache, const cache_code_t *code, int num_locals) {
+    int ip = 0;
+    int loads_count = 0; // instructions in a row reading a symbol, OPCODE_FUNCTION takes its free values from them
+    while (ip < code->count) {
+        int len = get_instruction_len(code->bytecode, ip, code->count);
+        if (len < 0) {
+            return false;
+        }
+        int operand = get_uint16_operand(code->bytecode, ip, len);
+        const cache_constant_t *constant = NULL;
+        const cache_global_t *global = NULL;
+        switch (code->bytecode[ip]) {
+            case OPCODE_CONSTANT: case OPCODE_GET_FIELD: case OPCODE_SET_FIELD:
+                if (operand >= array_count(cache->constants)) {
+                    return false;
+                }
+                break;
+            case OPCODE_FUNCTION:
+                constant = operand < array_count(cache->constants) ? array_get_const(cache->constants, operand) : NULL;
+                if (!constant || constant->kind != CACHE_CONSTANT_FUNCTION || code->bytecode[ip + 3] > loads_count) {
+                    return false;
+                }
+                break;
+            case OPCODE_GET_MODULE_GLOBAL: case OPCODE_SET_MODULE_GLOBAL: case OPCODE_DEFINE_MODULE_GLOBAL:
+                global = operand < array_count(cache->globals) ? array_get_const(cache->globals, operand) : NULL;
+                if (!global || global->kind == CACHE_GLOBAL_APE) {
+                    return false;
+                }
+                break;
+            case OPCODE_GET_APE_GLOBAL:
+                global = operand < array_count(cache->globals) ? array_get_const(cache->globals, operand) : NULL;
+                if (!global || global->kind != CACHE_GLOBAL_APE) {
+                    return false;
+                }
+                break;
+            case OPCODE_JUMP: case OPCODE_JUMP_IF_FALSE: case OPCODE_JUMP_IF_TRUE: case OPCODE_SET_RECOVER:
+                if (operand > code->count) {
+                    return false;
+                }
+                break;
+            case OPCODE_GET_LOCAL: case OPCODE_SET_LOCAL: case OPCODE_DEFINE_LOCAL:
+                if (num_locals >= 0 && code->bytecode[ip + 1] >= num_locals) {
+                    return false;
+                }
+                break;
+            default:
+                break;
+        }
+        switch (code->bytecode[ip]) {
+            case OPCODE_GET_MODULE_GLOBAL: case OPCODE_GET_APE_GLOBAL: case OPCODE_GET_LOCAL: case OPCODE_GET_FREE:
+            case OPCODE_CURRENT_FUNCTION: case OPCODE_GET_THIS:
+                loads_count++;
+                break;
+            default:
+                loads_count = 0;
+                break;
+        }
+        ip += len;
+    }
+    return bytecode_cache_read_positions(code, NULL, NULL);
+}
+
+// Checks what doesn't depend on where the file is loaded, before its imports are compiled. Files failing this
+// are damaged and are compiled (and saved again) as if there was no cache.
+static bool check_cached_file(const bytecode_cache_t *cache) {
+    if (array_count(cache->codes) == 0) {
+        return false;
+    }
+    for (int i = 0; i < array_count(cache->symbols); i++) {
+        const cache_symbol_t *symbol = array_get_const(cache->symbols, i);
+        if (symbol->index < 0 || symbol->index >= cache->globals_span || strchr(symbol->name, ':')) {
+            return false;
+        }
+    }
+    for (int i = 0; i < array_count(cache->constants); i++) {
+        const cache_constant_t *constant = array_get_const(cache->constants, i);
+        if (constant->kind == CACHE_CONSTANT_FUNCTION) {
+            bool code_exists = constant->code > 0 && constant->code < array_count(cache->codes);
+            const cache_code_t *code = code_exists ? array_get_const(cache->codes, constant->code) : NULL;
+            if (!code || constant->num_args < 0 || constant->num_locals < constant->num_args
+                || !check_cached_code(cache, code, constant->num_locals)) {
+                return false;
+            }
+        } else if (constant->kind != CACHE_CONSTANT_STRING) {
+            return false;
+        }
+    }
+    return check_cached_code(cache, array_get_const(cache->codes, 0), -1);
+}
+
+// Operands are checked again as they're rewritten, false means the cache can't be loaded.
+static bool relocate_cached_code(const bytecode_cache_t *cache, uint8_t *bytecode, int count, const int *constants,
+                                 const int *globals, int jump_offset, opcode_t *out_last_opcode) {
+    opcode_t last_opcode = OPCODE_NONE;
+    int ip = 0;
+    while (ip < count) {
+        int len = get_instruction_len(bytecode, ip, count);
+        if (len < 0) {
+            return false;
+        }
+        int operand = get_uint16_operand(bytecode, ip, len);
+        last_opcode = bytecode[ip];
+        switch (bytecode[ip]) {
+            case OPCODE_CONSTANT: case OPCODE_FUNCTION: case OPCODE_GET_FIELD: case OPCODE_SET_FIELD:
+                if (operand >= array_count(cache->constants) || constants[operand] > UINT16_MAX) {
+                    return false;
+                }
+                set_uint16_operand(bytecode, ip, constants[operand]);
+                break;
+            case OPCODE_GET_MODULE_GLOBAL: case OPCODE_SET_MODULE_GLOBAL: case OPCODE_DEFINE_MODULE_GLOBAL:
+            case OPCODE_GET_APE_GLOBAL:
+                if (operand >= array_count(cache->globals)) {
+                    return false;
+                }
+                set_uint16_operand(bytecode, ip, globals[operand]);
+                break;
+            case OPCODE_JUMP: case OPCODE_JUMP_IF_FALSE: case OPCODE_JUMP_IF_TRUE: case OPCODE_SET_RECOVER:
+                if (operand > count || operand + jump_offset > UINT16_MAX) {
+                    return false;
+                }
+                set_uint16_operand(bytecode, ip, operand + jump_offset);
+                break;
+            default:
+                break;
+        }
+        ip += len;
+    }
+    if (out_last_opcode) {
+        *out_last_opcode = last_opcode;
+    }
+    return true;
+}
+
+static bool resolve_cached_globals(compiler_t *comp, const bytecode_cache_t *cache, int own_globals_start,
+                                   int *out_globals) {
+    symbol_table_t *symbol_table = compiler_get_symbol_table(comp);
+    if (cache->globals_start >= 0 && cache->globals_start != own_globals_start) {
+        return false;
+    }
+    for (int i = 0; i < array_count(cache->globals); i++) {
+        const cache_global_t *global = array_get_const(cache->globals, i);
+        const symbol_t *symbol = NULL;
+        switch (global->kind) {
+            case CACHE_GLOBAL_OWN:
+                if (global->index < 0 || (global->index >= cache->globals_span && cache->globals_start < 0)) {
+                    return false;
+                }
+                out_globals[i] = own_globals_start + global->index;
+                break;
+            case CACHE_GLOBAL_MODULE:
+                symbol = global->name ? symbol_table_resolve(symbol_table, global->name) : NULL;
+                if (!symbol || symbol->type != SYMBOL_MODULE_GLOBAL) {
+                    return false;
+                }
+                out_globals[i] = symbol->index;
+                break;
+            case CACHE_GLOBAL_APE:
+                symbol = global->name ? global_store_get_symbol(comp->global_store, global->name) : NULL;
+                if (!symbol || symbol->type != SYMBOL_APE_GLOBAL) {
+                    return false;
+                }
+                out_globals[i] = symbol->index;
+                break;
+            default:
+                return false;
+        }
+        if (out_globals[i] > UINT16_MAX) {
+            return false;
+        }
+    }
+    for (int i = 0; i < array_count(cache->symbols); i++) {
+        const cache_symbol_t *symbol = array_get_const(cache->symbols, i);
+        if (global_store_get_symbol(comp->global_store, symbol->name)
+            || (!comp->config->repl_mode && symbol_table_symbol_is_defined(symbol_table, symbol->name))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool add_file_lines(compiled_file_t *file, const char *code) {
+    const char *line_start = code;
+    while (true) {
+        const char *new_line_ptr = strchr(line_start, '\n');
+        char *line = new_line_ptr ? ape_strndup(file->alloc, line_start, new_line_ptr - line_start)
+                                  : ape_strdup(file->alloc, line_start);
+        if (!line) {
+            return false;
+        }
+        if (!ptrarray_add(file->lines, line)) {
+            allocator_free(file->alloc, line);
+            return false;
+        }
+        if (!new_line_ptr) {
+            return true;
+        }
+        line_start = new_line_ptr + 1;
+    }
+}
+
+static void clear_file_lines(compiled_file_t *file) {
+    for (int i = 0; i < ptrarray_count(file->lines); i++) {
+        allocator_free(file->alloc, ptrarray_get(file->lines, i));
+    }
+    ptrarray_clear(file->lines);
+}
+
+// Imports (after imports_done) are compiled as in the source, then the file's own code, constants and globals are
+// added. out_loaded is false if the file has to be compiled after its imports.
+static bool load_cached_file(compiler_t *comp, const bytecode_cache_t *cache, const char *code, int imports_done,
+                             bool *out_loaded) {
+    *out_loaded = false;
+    file_scope_t *file_scope = ptrarray_top(comp->file_scopes);
+    compiled_file_t *file = file_scope->file;
+    if (!add_file_lines(file, code)) { // the lexer adds them when compiling
+        return false;
+    }
+
+    for (int i = imports_done; i < array_count(cache->imports); i++) {
+        const cache_import_t *import = array_get_const(cache->imports, i);
+        statement_t import_stmt;
+        memset(&import_stmt, 0, sizeof(statement_t));
+        import_stmt.alloc = comp->alloc;
+        import_stmt.type = STATEMENT_IMPORT;
+        import_stmt.import.path = (char*)import->path;
+        import_stmt.pos = src_pos_make(file, import->line, import->column);
+        bool ok = compile_statement(comp, &import_stmt);
+        if (!ok) {
+            return false;
+        }
+    }
+
+    symbol_table_t *symbol_table = compiler_get_symbol_table(comp);
+    block_scope_t *scope = symbol_table_get_block_scope(symbol_table);
+    int own_globals_start = scope->offset + scope->num_definitions;
+
+    bool result = false;
+    const cache_code_t *top_code = array_get_const(cache->codes, 0);
+    int *globals = allocator_malloc(comp->alloc, sizeof(int) * (array_count(cache->globals) + 1));
+    int *constants = allocator_malloc(comp->alloc, sizeof(int) * (array_count(cache->constants) + 1));
+    src_pos_t *positions = allocator_malloc(comp->alloc, sizeof(src_pos_t) * (top_code->count + 1));
+    uint8_t *top_bytecode = allocator_malloc(comp->alloc, top_code->count + 1);
+    if (!globals || !constants || !positions || !top_bytecode) {
+        goto end;
+    }
+    if (!resolve_cached_globals(comp, cache, own_globals_start, globals)) {
+        goto discard;
+    }
+
+    for (int i = 0; i < array_count(cache->constants); i++) {
+        const cache_constant_t *constant = array_get_const(cache->constants, i);
+        if (constant->kind == CACHE_CONSTANT_STRING) {
+            constants[i] = add_string_constant(comp, constant->string);
+        } else {
+            constants[i] = add_constant(comp, object_make_null()); // set when all indices are known
+        }
+        if (constants[i] < 0) {
+            goto end;
+        }
+    }
+    for (int i = 0; i < array_count(cache->constants); i++) {
+        const cache_constant_t *constant = array_get_const(cache->constants, i);
+        if (constant->kind != CACHE_CONSTANT_FUNCTION) {
+            continue;
+        }
+        const cache_code_t *fn_code = array_get_const(cache->codes, constant->code);
+        uint8_t *fn_bytecode = allocator_malloc(comp->alloc, fn_code->count + 1);
+        src_pos_t *fn_positions = allocator_malloc(comp->alloc, sizeof(src_pos_t) * (fn_code->count + 1));
+        compilation_result_t *comp_res = NULL;
+        bool relocated = false;
+        if (fn_bytecode && fn_positions) {
+            memcpy(fn_bytecode, fn_code->bytecode, fn_code->count);
+            relocated = relocate_cached_code(cache, fn_bytecode, fn_code->count, constants, globals, 0, NULL);
+            if (relocated) {
+                bytecode_cache_read_positions(fn_code, file, fn_positions);
+                comp_res = compilation_result_make(comp->alloc, fn_bytecode, fn_positions, fn_code->count);
+            }
+        }
+        if (!comp_res) {
+            allocator_free(comp->alloc, fn_bytecode);
+            allocator_free(comp->alloc, fn_positions);
+            if (fn_bytecode && fn_positions && !relocated) {
+                goto discard; // constants added so far aren't used by anything
+            }
+            goto end;
+        }
+        object_t obj = object_make_function(comp->mem, constant->string, comp_res, true,
+                                            constant->num_locals, constant->num_args, 0);
+        if (object_is_null(obj)) {
+            compilation_result_destroy(comp_res);
+            goto end;
+        }
+        array_set(comp->constants, constants[i], &obj);
+    }
+
+    array(uint8_t) *bytecode = get_bytecode(comp);
+    int code_start = array_count(bytecode);
+    memcpy(top_bytecode, top_code->bytecode, top_code->count);
+    opcode_t last_opcode = OPCODE_NONE;
+    if (!relocate_cached_code(cache, top_bytecode, top_code->count, constants, globals, code_start, &last_opcode)) {
+        goto discard;
+    }
+    bytecode_cache_read_positions(top_code, file, positions);
+    bool ok = array_addn(bytecode, top_bytecode, top_code->count)
+           && array_addn(get_src_positions(comp), positions, top_code->count);
+    if (!ok) {
+        goto end;
+    }
+    if (top_code->count > 0) {
+        get_compilation_scope(comp)->last_opcode = last_opcode;
+    }
+
+    for (int i = 0; i < array_count(cache->symbols); i++) {
+        const cache_symbol_t *symbol = array_get_const(cache->symbols, i);
+        if (!symbol_table_define_module_global_at(symbol_table, symbol->name, own_globals_start + symbol->index,
+                                                  symbol->assignable)) {
+            goto end;
+        }
+    }
+    scope->num_definitions = own_globals_start - scope->offset + cache->globals_span;
+    *out_loaded = true;
+    result = true;
+    goto end;
+discard:
+    clear_file_lines(file);
+    result = true;
+end:
+    allocator_free(comp->alloc, globals);
+    allocator_free(comp->alloc, constants);
+    allocator_free(comp->alloc, positions);
+    allocator_free(comp->alloc, top_bytecode);
+    return result;
+}
+
+static uint64_t get_globals_hash(compiler_t *comp) {
+    uint64_t hash = 0;
+    for (int i = 0; i < global_store_get_object_count(comp->global_store); i++) {
+        const char *name = global_store_get_name_at(comp->global_store, i);
+        if (name) {
+            hash = bytecode_cache_hash(name, strlen(name) + 1, hash);
+        }
+    }
+    return hash;
+}
+
 static bool compile_statements(compiler_t *comp, ptrarray(statement_t) *statements) {
     bool ok = true;
     for (int i = 0; i < ptrarray_count(statements); i++) {
@@ -585,7 +1425,7 @@ static bool import_module(compiler_t *comp, const statement_t *import_stmt) { //
             goto end;
         }
 
-        ok = compile_code(comp, code);
+        ok = compile_file_code(comp, code, true);
         if (!ok) {
             module_destroy(module);
             result = false;
@@ -842,7 +1682,7 @@ static bool compile_statement(compiler_t *comp, const statement_t *stmt) {
                 return false;
             }
 
-            ip = emit(comp, OPCODE_NUMBER, 1, (uint64_t[]){0});
+            ip = emit(comp, OPCODE_INT, 1, (uint64_t[]){0});
             if (ip < 0) {
                 return false;
             }
@@ -887,7 +1727,7 @@ static bool compile_statement(compiler_t *comp, const statement_t *stmt) {
                 return false;
             }
 
-            ip = emit(comp, OPCODE_NUMBER, 1, (uint64_t[]){ape_double_to_uint64(1)});
+            ip = emit(comp, OPCODE_INT, 1, (uint64_t[]){1});
             if (ip < 0) {
                 return false;
             }
@@ -1110,6 +1950,13 @@ static bool compile_statement(compiler_t *comp, const statement_t *stmt) {
             }
             break;
         }
+        case STATEMENT_STRUCT: {
+            ok = compile_struct_statement(comp, stmt);
+            if (!ok) {
+                return false;
+            }
+            break;
+        }
         case STATEMENT_RECOVER: {
             const recover_statement_t *recover = &stmt->recover;
 
@@ -1280,33 +2127,18 @@ static bool compile_expression(compiler_t *comp, expression_t *expr) {
 
             break;
         }
-        case EXPRESSION_STRING_LITERAL: {
-            int pos = 0;
-            int *current_pos = dict_get(comp->string_constants_positions, expr->string_literal);
-            if (current_pos) {
-                pos = *current_pos;
-            } else {
-                object_t obj = object_make_string(comp->mem, expr->string_literal);
-                if (object_is_null(obj)) {
-                    goto error;
-                }
-
-                pos = add_constant(comp, obj);
-                if (pos < 0) {
-                    goto error;
-                }
-
-                int *pos_val = allocator_malloc(comp->alloc, sizeof(int));
-                if (!pos_val) {
-                    goto error;
-                }
+        case EXPRESSION_INT_LITERAL: {
+            ip = emit(comp, OPCODE_INT, 1, (uint64_t[]){(uint64_t)expr->int_literal});
+            if (ip < 0) {
+                goto error;
+            }
 
-                *pos_val = pos;
-                ok = dict_set(comp->string_constants_positions, expr->string_literal, pos_val);
-                if (!ok) {
-                    allocator_free(comp->alloc, pos_val);
-                    goto error;
-                }
+            break;
+        }
+        case EXPRESSION_STRING_LITERAL: {
+            int pos = add_string_constant(comp, expr->string_literal);
+            if (pos < 0) {
+                goto error;
             }
 
             ip = emit(comp, OPCODE_CONSTANT, 1, (uint64_t[]){pos});
@@ -1416,6 +2248,18 @@ static bool compile_expression(compiler_t *comp, expression_t *expr) {
             if (!ok) {
                 goto error;
             }
+            if (index->index->type == EXPRESSION_STRING_LITERAL) {
+                // a.b and a["b"] address a field by a constant name, structs resolve it without hashing
+                int pos = add_string_constant(comp, index->index->string_literal);
+                if (pos < 0) {
+                    goto error;
+                }
+                ip = emit(comp, OPCODE_GET_FIELD, 1, (uint64_t[]){pos});
+                if (ip < 0) {
+                    goto error;
+                }
+                break;
+            }
             ok = compile_expression(comp, index->index);
             if (!ok) {
                 goto error;
@@ -1601,11 +2445,19 @@ static bool compile_expression(compiler_t *comp, expression_t *expr) {
                 if (!ok) {
                     goto error;
                 }
-                ok = compile_expression(comp, index->index);
-                if (!ok) {
-                    goto error;
+                if (index->index->type == EXPRESSION_STRING_LITERAL) {
+                    int pos = add_string_constant(comp, index->index->string_literal);
+                    if (pos < 0) {
+                        goto error;
+                    }
+                    ip = emit(comp, OPCODE_SET_FIELD, 1, (uint64_t[]){pos});
+                } else {
+                    ok = compile_expression(comp, index->index);
+                    if (!ok) {
+                        goto error;
+                    }
+                    ip = emit(comp, OPCODE_SET_INDEX, 0, NULL);
                 }
-                ip = emit(comp, OPCODE_SET_INDEX, 0, NULL);
                 if (ip < 0) {
                     goto error;
                 }
@@ -1705,6 +2557,90 @@ end:
     return res;
 }
 
+static bool compile_struct_statement(compiler_t *comp, const statement_t *stmt) {
+    const struct_statement_t *struct_stmt = &stmt->struct_statement;
+    symbol_table_t *symbol_table = compiler_get_symbol_table(comp);
+
+    // operator functions read the struct through its global when constructing results,
+    // a local would be captured before it's assigned
+    if (!symbol_table_is_module_global_scope(symbol_table)) {
+        errors_add_error(comp->errors, ERROR_COMPILATION, stmt->pos,
+                         "Struct can only be declared in global scope");
+        return false;
+    }
+
+    int fields_count = ptrarray_count(struct_stmt->fields);
+    int operators_count = ptrarray_count(struct_stmt->operators);
+    if (fields_count > UINT8_MAX || operators_count > UINT8_MAX) {
+        errors_add_errorf(comp->errors, ERROR_COMPILATION, stmt->pos,
+                          "Struct \"%s\" has too many fields or operators", struct_stmt->name->value);
+        return false;
+    }
+
+    const symbol_t *symbol = define_symbol(comp, struct_stmt->name->pos, struct_stmt->name->value, false, false);
+    if (!symbol) {
+        return false;
+    }
+
+    int pos = add_string_constant(comp, struct_stmt->name->value);
+    if (pos < 0) {
+        return false;
+    }
+    int ip = emit(comp, OPCODE_CONSTANT, 1, (uint64_t[]){pos});
+    if (ip < 0) {
+        return false;
+    }
+
+    for (int i = 0; i < fields_count; i++) {
+        const ident_t *field = ptrarray_get(struct_stmt->fields, i);
+        for (int j = 0; j < i; j++) {
+            const ident_t *prev_field = ptrarray_get(struct_stmt->fields, j);
+            if (APE_STREQ(field->value, prev_field->value)) {
+                errors_add_errorf(comp->errors, ERROR_COMPILATION, field->pos,
+                                  "Field \"%s\" is already defined", field->value);
+                return false;
+            }
+        }
+        pos = add_string_constant(comp, field->value);
+        if (pos < 0) {
+            return false;
+        }
+        ip = emit(comp, OPCODE_CONSTANT, 1, (uint64_t[]){pos});
+        if (ip < 0) {
+            return false;
+        }
+    }
+
+    for (int i = 0; i < operators_count; i++) {
+        expression_t *op_fn = ptrarray_get(struct_stmt->operators, i);
+        const char *op_name = op_fn->fn_literal.name;
+        if (strncmp(op_name, "__operator_", 11) != 0) {
+            errors_add_errorf(comp->errors, ERROR_COMPILATION, op_fn->pos,
+                              "Only operator overloads can be declared in a struct, got \"%s\"", op_name);
+            return false;
+        }
+        pos = add_string_constant(comp, op_name);
+        if (pos < 0) {
+            return false;
+        }
+        ip = emit(comp, OPCODE_CONSTANT, 1, (uint64_t[]){pos});
+        if (ip < 0) {
+            return false;
+        }
+        bool ok = compile_expression(comp, op_fn);
+        if (!ok) {
+            return false;
+        }
+    }
+
+    ip = emit(comp, OPCODE_STRUCT, 2, (uint64_t[]){fields_count, operators_count});
+    if (ip < 0) {
+        return false;
+    }
+
+    return write_symbol(comp, symbol, true);
+}
+
 static bool compile_code_block(compiler_t *comp, const code_block_t *block) {
     symbol_table_t *symbol_table = compiler_get_symbol_table(comp);
     if (!symbol_table) {
@@ -1747,6 +2683,36 @@ static int add_constant(compiler_t *comp, object_t obj) {
     return pos;
 }
 
+static int add_string_constant(compiler_t *comp, const char *string) {
+    int *current_pos = dict_get(comp->string_constants_positions, string);
+    if (current_pos) {
+        return *current_pos;
+    }
+
+    object_t obj = object_make_string(comp->mem, string);
+    if (object_is_null(obj)) {
+        return -1;
+    }
+
+    int pos = add_constant(comp, obj);
+    if (pos < 0) {
+        return -1;
+    }
+
+    int *pos_val = allocator_malloc(comp->alloc, sizeof(int));
+    if (!pos_val) {
+        return -1;
+    }
+
+    *pos_val = pos;
+    bool ok = dict_set(comp->string_constants_positions, string, pos_val);
+    if (!ok) {
+        allocator_free(comp->alloc, pos_val);
+        return -1;
+    }
+    return pos;
+}
+
 static void change_uint16_operand(compiler_t *comp, int ip, uint16_t operand) {
     array(uint8_t) *bytecode = get_bytecode(comp);
     if ((ip + 1) >= array_count(bytecode)) {
@@ -1999,21 +2965,27 @@ static void module_destroy(module_t *module) {
 }
 
 static module_t* module_copy(module_t *src) {
-    module_t *copy = allocator_malloc(src->alloc, sizeof(module_t));
+    return module_copy_with_alloc(src->alloc, src);
+}
+
+static module_t* module_copy_with_alloc(allocator_t *alloc, module_t *src) {
+    module_t *copy = module_make(alloc, src->name);
     if (!copy) {
         return NULL;
     }
-    memset(copy, 0, sizeof(module_t));
-    copy->alloc = src->alloc;
-    copy->name = ape_strdup(copy->alloc, src->name);
-    if (!copy->name) {
-        module_destroy(copy);
-        return NULL;
-    }
-    copy->symbols = ptrarray_copy_with_items(src->symbols, symbol_copy, symbol_destroy);
-    if (!copy->symbols) {
-        module_destroy(copy);
-        return NULL;
+    for (int i = 0; i < ptrarray_count(src->symbols); i++) {
+        symbol_t *symbol = ptrarray_get(src->symbols, i);
+        symbol_t *symbol_copy = symbol_make(alloc, symbol->name, symbol->type, symbol->index, symbol->assignable);
+        if (!symbol_copy) {
+            module_destroy(copy);
+            return NULL;
+        }
+        bool ok = ptrarray_add(copy->symbols, symbol_copy);
+        if (!ok) {
+            symbol_destroy(symbol_copy);
+            module_destroy(copy);
+            return NULL;
+        }
     }
     return copy;
 }
@@ -15,6 +15,7 @@
 typedef struct ape_config ape_config_t;
 typedef struct gcmem gcmem_t;
 typedef struct symbol_table symbol_table_t;
+typedef struct symbol symbol_t;
 
 typedef struct compiler compiler_t;
 typedef struct compilation_result compilation_result_t;
@@ -32,4 +33,13 @@ APE_INTERNAL symbol_table_t* compiler_get_symbol_table(compiler_t *comp);
 APE_INTERNAL void compiler_set_symbol_table(compiler_t *comp, symbol_table_t *table);
 APE_INTERNAL array(object_t)* compiler_get_constants(const compiler_t *comp);
 
+// Global symbols and imported modules of a compiler, used to run code compiled by one compiler on instances with
+// other compilers (see ape_shared_program_t and ape_snapshot_t) and to compile more code on them.
+// compiler_define_shared_globals only succeeds if comp hasn't defined any globals or constants yet.
+typedef struct compiler_globals compiler_globals_t;
+APE_INTERNAL compiler_globals_t* compiler_copy_globals(compiler_t *comp);
+APE_INTERNAL void compiler_globals_destroy(compiler_globals_t *globals);
+APE_INTERNAL bool compiler_define_shared_globals(compiler_t *comp, const compiler_globals_t *globals,
+                                                 array(object_t) *constants);
+
 #endif /* compiler_h */
@@ -30,6 +30,7 @@ gcmem_t *gcmem_make(allocator_t *alloc) {
         goto error;
     }
     mem->allocations_since_sweep = 0;
+    mem->live_objects_count = 0;
     mem->data_only_pool.count = 0;
 
     for (int i = 0; i < GCMEM_POOLS_NUM; i++) {
@@ -161,23 +162,14 @@ void gc_mark_object(object_t obj) {
     data->gcmark = true;
     switch (data->type) {
         case OBJECT_MAP: {
-            int len = object_get_map_length(obj);
-            for (int i = 0; i < len; i++) {
-                object_t key = object_get_map_key_at(obj, i);
-                if (object_is_allocated(key)) {
-                    object_data_t *key_data = object_get_allocated_data(key);
-                    if (!key_data->gcmark) {
-                        gc_mark_object(key);
-                    }
-                }
-                object_t val = object_get_map_value_at(obj, i);
-                if (object_is_allocated(val)) {
-                    object_data_t *val_data = object_get_allocated_data(val);
-                    if (!val_data->gcmark) {
-                        gc_mark_object(val);
-                    }
-                }
-            }
+            // raw slots so that marking never compacts the map, removed slots are null
+            int slots_count = objmap_get_slots_count(&data->map);
+            gc_mark_objects(objmap_get_keys(&data->map), slots_count);
+            gc_mark_objects(objmap_get_values(&data->map), slots_count);
+            break;
+        }
+        case OBJECT_SET: {
+            gc_mark_objects(objmap_get_keys(&data->set), objmap_get_slots_count(&data->set));
             break;
         }
         case OBJECT_ARRAY: {
@@ -207,6 +199,18 @@ void gc_mark_object(object_t obj) {
             }
             break;
         }
+        case OBJECT_STRUCT: {
+            object_t struct_type = object_get_struct_type(obj);
+            gc_mark_object(struct_type);
+            gc_mark_objects(object_get_struct_fields(obj), object_get_struct_type_fields_count(struct_type));
+            break;
+        }
+        case OBJECT_STRUCT_TYPE: {
+            object_struct_type_t *struct_type = &data->struct_type;
+            gc_mark_objects(struct_type->field_names, struct_type->fields_count);
+            gc_mark_objects(struct_type->operators, struct_type->operators_count);
+            break;
+        }
         default: {
             break;
         }
@@ -246,6 +250,7 @@ void gc_sweep(gcmem_t *mem) {
     mem->objects = mem->objects_back;
     mem->objects_back = objs_temp;
     mem->allocations_since_sweep = 0;
+    mem->live_objects_count = ptrarray_count(mem->objects);
 }
 
 bool gc_disable_on_object(object_t obj) {
@@ -253,6 +258,9 @@ bool gc_disable_on_object(object_t obj) {
         return false;
     }
     object_data_t *data = object_get_allocated_data(obj);
+    if (!data->mem) {
+        return false; // static objects are never collected
+    }
     if (array_contains(data->mem->objects_not_gced, &obj)) {
         return false;
     }
@@ -265,11 +273,16 @@ void gc_enable_on_object(object_t obj) {
         return;
     }
     object_data_t *data = object_get_allocated_data(obj);
+    if (!data->mem) {
+        return;
+    }
     array_remove_item(data->mem->objects_not_gced, &obj);
 }
 
 int gc_should_sweep(gcmem_t *mem) {
-    return mem->allocations_since_sweep > GCMEM_SWEEP_INTERVAL;
+    // every sweep marks all live objects, so with a large heap they have to be further apart
+    int interval = mem->live_objects_count > GCMEM_SWEEP_INTERVAL ? mem->live_objects_count : GCMEM_SWEEP_INTERVAL;
+    return mem->allocations_since_sweep > interval;
 }
 
 // INTERNAL
@@ -22,6 +22,7 @@ typedef struct object_data_pool {
 typedef struct gcmem {
     allocator_t *alloc;
     int allocations_since_sweep;
+    int live_objects_count; // after the last sweep
 
     ptrarray(object_data_t) *objects;
     ptrarray(object_data_t) *objects_back;
@@ -56,6 +56,17 @@ void global_store_destroy(global_store_t *store) {
     allocator_free(store->alloc, store);
 }
 
+bool global_store_has_symbols_of(global_store_t *store, global_store_t *other) {
+    for (int i = 0; i < dict_count(other->symbols); i++) {
+        const symbol_t *other_symbol = dict_get_value_at(other->symbols, i);
+        const symbol_t *symbol = global_store_get_symbol(store, other_symbol->name);
+        if (!symbol || symbol->index != other_symbol->index) {
+            return false;
+        }
+    }
+    return true;
+}
+
 const symbol_t* global_store_get_symbol(global_store_t *store, const char *name) {
     return dict_get(store->symbols, name);
 }
@@ -118,3 +129,8 @@ object_t *global_store_get_object_data(global_store_t *store) {
 int global_store_get_object_count(global_store_t *store) {
     return array_count(store->objects);
 }
+
+const char* global_store_get_name_at(global_store_t *store, int ix) {
+    const symbol_t *symbol = dict_get_value_at(store->symbols, ix); // symbols are added in index order
+    return symbol ? symbol->name : NULL;
+}
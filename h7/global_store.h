@@ -20,5 +20,7 @@ APE_INTERNAL object_t global_store_get_object_at(global_store_t *store, int ix,
 APE_INTERNAL bool global_store_set_object_at(global_store_t *store, int ix, object_t object);
 APE_INTERNAL object_t *global_store_get_object_data(global_store_t *store);
 APE_INTERNAL int global_store_get_object_count(global_store_t *store);
+APE_INTERNAL const char* global_store_get_name_at(global_store_t *store, int ix);
+APE_INTERNAL bool global_store_has_symbols_of(global_store_t *store, global_store_t *other); // with the same indices
 
 #endif /* global_store_h */
@@ -479,6 +479,7 @@ static token_type_t lookup_identifier(const char *ident, int len) {
         {"null", 4, TOKEN_NULL},
         {"import", 6, TOKEN_IMPORT},
         {"recover", 7, TOKEN_RECOVER},
+        {"struct", 6, TOKEN_STRUCT},
 
         {"byte", 4, TOKEN_BYTE},
         {"short", 5, TOKEN_SHORT},
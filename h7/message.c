@@ -0,0 +1,626 @@
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef APE_AMALGAMATED
+#include "message.h"
+#include "gc.h"
+#include "code.h"
+#include "builtins.h"
+#endif
+
+#define MESSAGE_MAX_DEPTH 256
+
+typedef enum message_tag {
+    MESSAGE_TAG_NULL = 0,
+    MESSAGE_TAG_FALSE,
+    MESSAGE_TAG_TRUE,
+    MESSAGE_TAG_NUMBER,
+    MESSAGE_TAG_INT,
+    MESSAGE_TAG_STRING,
+    MESSAGE_TAG_ARRAY,
+    MESSAGE_TAG_MAP,
+    MESSAGE_TAG_SET,
+    MESSAGE_TAG_TYPED_ARRAY,
+    MESSAGE_TAG_FUNCTION,
+    MESSAGE_TAG_BUILTIN,
+    MESSAGE_TAG_STRUCT_TYPE,
+    MESSAGE_TAG_STRUCT,
+    MESSAGE_TAG_REF, // to an object written before or added as external
+} message_tag_t;
+
+// Writers and readers number objects in the same order, when they're first written and right after they're
+// made when read. Objects are numbered before their items are written so that items can point back at them.
+
+static bool write_value(message_writer_t *writer, object_t obj, int depth);
+static bool write_function(message_writer_t *writer, object_t obj, int depth);
+static bool write_struct_type(message_writer_t *writer, object_t obj, int depth);
+static bool write_struct(message_writer_t *writer, object_t obj, int depth);
+static bool write_tag(message_writer_t *writer, message_tag_t tag);
+static bool write_count(message_writer_t *writer, int count);
+static bool add_ref(message_writer_t *writer, object_t obj);
+static bool read_value(message_reader_t *reader, int depth, object_t *out_obj);
+static bool read_function(message_reader_t *reader, int depth, object_t *out_obj);
+static bool read_struct_type(message_reader_t *reader, int depth, object_t *out_obj);
+static bool read_struct(message_reader_t *reader, int depth, object_t *out_obj);
+static bool read_bytes(message_reader_t *reader, void *out, int n);
+static bool read_count(message_reader_t *reader, int *out_count);
+
+void message_writer_init(message_writer_t *writer, allocator_t *alloc, array(uint8_t) *buf, bool functions) {
+    memset(writer, 0, sizeof(message_writer_t));
+    writer->alloc = alloc;
+    writer->buf = buf;
+    writer->functions = functions;
+}
+
+void message_writer_deinit(message_writer_t *writer) {
+    valdict_destroy(writer->refs);
+    memset(writer, 0, sizeof(message_writer_t));
+}
+
+bool message_writer_add_external(message_writer_t *writer, object_t obj) {
+    if (!object_is_allocated(obj)) {
+        return false;
+    }
+    return add_ref(writer, obj);
+}
+
+bool message_writer_write(message_writer_t *writer, object_t obj) {
+    return write_value(writer, obj, 0);
+}
+
+void message_reader_init(message_reader_t *reader, gcmem_t *mem, const uint8_t *data, int len) {
+    memset(reader, 0, sizeof(message_reader_t));
+    reader->mem = mem;
+    reader->data = data;
+    reader->len = len;
+}
+
+void message_reader_deinit(message_reader_t *reader) {
+    array_destroy(reader->refs);
+    memset(reader, 0, sizeof(message_reader_t));
+}
+
+bool message_reader_add_external(message_reader_t *reader, object_t obj) {
+    if (!reader->refs) {
+        reader->refs = array_make(reader->mem->alloc, object_t);
+        if (!reader->refs) {
+            return false;
+        }
+    }
+    return array_add(reader->refs, &obj);
+}
+
+bool message_reader_read(message_reader_t *reader, object_t *out_obj) {
+    return read_value(reader, 0, out_obj);
+}
+
+bool message_write(array(uint8_t) *buf, object_t obj, bool functions) {
+    allocator_t alloc = allocator_make(NULL, NULL, NULL); // refs only live during the call
+    message_writer_t writer;
+    message_writer_init(&writer, &alloc, buf, functions);
+    bool ok = message_writer_write(&writer, obj);
+    message_writer_deinit(&writer);
+    return ok;
+}
+
+bool message_read(gcmem_t *mem, const uint8_t *data, int len, int *pos, object_t *out_obj) {
+    message_reader_t reader;
+    message_reader_init(&reader, mem, data, len);
+    reader.pos = *pos;
+    bool ok = message_reader_read(&reader, out_obj);
+    *pos = reader.pos;
+    message_reader_deinit(&reader);
+    return ok;
+}
+
+//-----------------------------------------------------------------------------
+// Private
+//-----------------------------------------------------------------------------
+
+static bool write_value(message_writer_t *writer, object_t obj, int depth) {
+    if (depth > MESSAGE_MAX_DEPTH) {
+        return false;
+    }
+    if (writer->refs && object_is_allocated(obj)) {
+        object_data_t *data = object_get_allocated_data(obj);
+        int *ref_ix = valdict_get(writer->refs, &data);
+        if (ref_ix) {
+            return write_tag(writer, MESSAGE_TAG_REF) && write_count(writer, *ref_ix);
+        }
+    }
+    object_type_t type = object_get_type(obj);
+    switch (type) {
+        case OBJECT_NULL: {
+            return write_tag(writer, MESSAGE_TAG_NULL);
+        }
+        case OBJECT_BOOL: {
+            return write_tag(writer, object_get_bool(obj) ? MESSAGE_TAG_TRUE : MESSAGE_TAG_FALSE);
+        }
+        case OBJECT_NUMBER: {
+            if (object_is_int(obj)) {
+                int64_t val = object_get_int(obj);
+                return write_tag(writer, MESSAGE_TAG_INT) && array_addn(writer->buf, &val, sizeof(int64_t));
+            }
+            double val = object_get_number(obj);
+            return write_tag(writer, MESSAGE_TAG_NUMBER) && array_addn(writer->buf, &val, sizeof(double));
+        }
+        case OBJECT_STRING: {
+            int len = object_get_string_length(obj);
+            return add_ref(writer, obj)
+                && write_tag(writer, MESSAGE_TAG_STRING)
+                && write_count(writer, len)
+                && array_addn(writer->buf, object_get_string(obj), len);
+        }
+        case OBJECT_ARRAY: {
+            int len = object_get_array_length(obj);
+            if (!add_ref(writer, obj) || !write_tag(writer, MESSAGE_TAG_ARRAY) || !write_count(writer, len)) {
+                return false;
+            }
+            for (int i = 0; i < len; i++) {
+                if (!write_value(writer, object_get_array_value_at(obj, i), depth + 1)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+        case OBJECT_MAP: {
+            int len = object_get_map_length(obj);
+            if (!add_ref(writer, obj) || !write_tag(writer, MESSAGE_TAG_MAP) || !write_count(writer, len)) {
+                return false;
+            }
+            for (int i = 0; i < len; i++) {
+                if (!write_value(writer, object_get_map_key_at(obj, i), depth + 1)
+                    || !write_value(writer, object_get_map_value_at(obj, i), depth + 1)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+        case OBJECT_SET: {
+            int len = object_get_set_length(obj);
+            if (!add_ref(writer, obj) || !write_tag(writer, MESSAGE_TAG_SET) || !write_count(writer, len)) {
+                return false;
+            }
+            for (int i = 0; i < len; i++) {
+                if (!write_value(writer, object_get_set_value_at(obj, i), depth + 1)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+        case OBJECT_TYPED_ARRAY: {
+            typed_array_type_t array_type = object_get_typed_array_type(obj);
+            int len = object_get_typed_array_length(obj);
+            uint8_t array_type_byte = (uint8_t)array_type;
+            return add_ref(writer, obj)
+                && write_tag(writer, MESSAGE_TAG_TYPED_ARRAY)
+                && array_add(writer->buf, &array_type_byte)
+                && write_count(writer, len)
+                && array_addn(writer->buf, object_get_typed_array_data(obj), len * typed_array_type_get_size(array_type));
+        }
+        case OBJECT_STRUCT_TYPE: {
+            return write_struct_type(writer, obj, depth);
+        }
+        case OBJECT_STRUCT: {
+            return write_struct(writer, obj, depth);
+        }
+        case OBJECT_FUNCTION: {
+            return write_function(writer, obj, depth);
+        }
+        case OBJECT_NATIVE_FUNCTION: {
+            int builtin_ix = builtins_get_ix(object_get_native_function(obj)->fn);
+            if (!writer->functions || builtin_ix < 0) {
+                return false; // other natives can reference their instance
+            }
+            return write_tag(writer, MESSAGE_TAG_BUILTIN) && write_count(writer, builtin_ix);
+        }
+        default: {
+            return false;
+        }
+    }
+}
+
+static bool write_function(message_writer_t *writer, object_t obj, int depth) {
+    const function_t *function = object_get_function(obj);
+    if (!writer->functions || function->owns_data) {
+        return false;
+    }
+    const char *name = object_get_function_name(obj);
+    if (!add_ref(writer, obj)
+        || !write_tag(writer, MESSAGE_TAG_FUNCTION)
+        || !array_addn(writer->buf, &function->comp_result, sizeof(compilation_result_t*))
+        || !array_addn(writer->buf, &name, sizeof(const char*))
+        || !write_count(writer, function->num_locals)
+        || !write_count(writer, function->num_args)
+        || !write_count(writer, function->free_vals_count)) {
+        return false;
+    }
+    for (int i = 0; i < function->free_vals_count; i++) {
+        if (!write_value(writer, object_get_function_free_val(obj, i), depth + 1)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool write_struct_type(message_writer_t *writer, object_t obj, int depth) {
+    const char *name = object_get_struct_type_name(obj);
+    int name_len = (int)strlen(name);
+    int fields_count = object_get_struct_type_fields_count(obj);
+    int operators_count = 0;
+    for (int i = 0; i < OPCODE_MAX; i++) {
+        if (!object_is_null(object_get_struct_type_operator(obj, i))) {
+            operators_count++;
+        }
+    }
+    if (!write_tag(writer, MESSAGE_TAG_STRUCT_TYPE)
+        || !write_count(writer, name_len)
+        || !array_addn(writer->buf, name, name_len)
+        || !write_count(writer, fields_count)
+        || !write_count(writer, operators_count)) {
+        return false;
+    }
+    // field names are needed to make the type, they're strings so they can't point back at it
+    for (int i = 0; i < fields_count; i++) {
+        if (!write_value(writer, object_get_struct_type_field_name(obj, i), depth + 1)) {
+            return false;
+        }
+    }
+    if (!add_ref(writer, obj)) {
+        return false;
+    }
+    for (int i = 0; i < OPCODE_MAX; i++) {
+        object_t op = object_get_struct_type_operator(obj, i);
+        if (object_is_null(op)) {
+            continue;
+        }
+        if (!write_count(writer, i) || !write_value(writer, op, depth + 1)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool write_struct(message_writer_t *writer, object_t obj, int depth) {
+    // the type is needed to make the instance, so instances can't be pointed at from their type's operators
+    object_t struct_type = object_get_struct_type(obj);
+    if (!write_tag(writer, MESSAGE_TAG_STRUCT)
+        || !write_value(writer, struct_type, depth + 1)
+        || !add_ref(writer, obj)) {
+        return false;
+    }
+    int fields_count = object_get_struct_type_fields_count(struct_type);
+    object_t *fields = object_get_struct_fields(obj);
+    for (int i = 0; i < fields_count; i++) {
+        if (!write_value(writer, fields[i], depth + 1)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool write_tag(message_writer_t *writer, message_tag_t tag) {
+    uint8_t tag_byte = (uint8_t)tag;
+    return array_add(writer->buf, &tag_byte);
+}
+
+static bool write_count(message_writer_t *writer, int count) {
+    int32_t count32 = count;
+    return array_addn(writer->buf, &count32, sizeof(int32_t));
+}
+
+static bool add_ref(message_writer_t *writer, object_t obj) {
+    if (!writer->refs) {
+        writer->refs = valdict_make(writer->alloc, object_data_t*, int);
+        if (!writer->refs) {
+            return false;
+        }
+    }
+    object_data_t *data = object_get_allocated_data(obj);
+    int ref_ix = writer->refs_count;
+    if (!valdict_set(writer->refs, &data, &ref_ix)) {
+        return false;
+    }
+    writer->refs_count++;
+    return true;
+}
+
+static bool read_value(message_reader_t *reader, int depth, object_t *out_obj) {
+    if (depth > MESSAGE_MAX_DEPTH) {
+        return false;
+    }
+    uint8_t tag = 0;
+    if (!read_bytes(reader, &tag, 1)) {
+        return false;
+    }
+    gcmem_t *mem = reader->mem;
+    object_t res = object_make_null();
+    switch (tag) {
+        case MESSAGE_TAG_NULL: {
+            break;
+        }
+        case MESSAGE_TAG_FALSE:
+        case MESSAGE_TAG_TRUE: {
+            res = object_make_bool(tag == MESSAGE_TAG_TRUE);
+            break;
+        }
+        case MESSAGE_TAG_NUMBER: {
+            double val = 0;
+            if (!read_bytes(reader, &val, sizeof(double))) {
+                return false;
+            }
+            res = object_make_number(val);
+            break;
+        }
+        case MESSAGE_TAG_INT: {
+            int64_t val = 0;
+            if (!read_bytes(reader, &val, sizeof(int64_t))) {
+                return false;
+            }
+            res = object_make_int(mem, val);
+            if (object_is_null(res)) {
+                return false;
+            }
+            break;
+        }
+        case MESSAGE_TAG_STRING: {
+            int str_len = 0;
+            if (!read_count(reader, &str_len) || str_len > reader->len - reader->pos) {
+                return false;
+            }
+            res = object_make_string_with_capacity(mem, str_len);
+            if (object_is_null(res)
+                || !message_reader_add_external(reader, res)
+                || !object_string_append(res, (const char*)reader->data + reader->pos, str_len)) {
+                return false;
+            }
+            reader->pos += str_len;
+            break;
+        }
+        case MESSAGE_TAG_ARRAY: {
+            int count = 0;
+            if (!read_count(reader, &count) || count > reader->len - reader->pos) {
+                return false;
+            }
+            res = object_make_array_with_capacity(mem, count);
+            if (object_is_null(res) || !message_reader_add_external(reader, res)) {
+                return false;
+            }
+            for (int i = 0; i < count; i++) {
+                object_t item = object_make_null();
+                if (!read_value(reader, depth + 1, &item) || !object_add_array_value(res, item)) {
+                    return false;
+                }
+            }
+            break;
+        }
+        case MESSAGE_TAG_MAP: {
+            int count = 0;
+            if (!read_count(reader, &count) || count > reader->len - reader->pos) {
+                return false;
+            }
+            res = object_make_map_with_capacity(mem, count);
+            if (object_is_null(res) || !message_reader_add_external(reader, res)) {
+                return false;
+            }
+            for (int i = 0; i < count; i++) {
+                object_t key = object_make_null();
+                object_t val = object_make_null();
+                if (!read_value(reader, depth + 1, &key)
+                    || !read_value(reader, depth + 1, &val)
+                    || !object_is_hashable(key)
+                    || !object_set_map_value(res, key, val)) {
+                    return false;
+                }
+            }
+            break;
+        }
+        case MESSAGE_TAG_SET: {
+            int count = 0;
+            if (!read_count(reader, &count) || count > reader->len - reader->pos) {
+                return false;
+            }
+            res = object_make_set(mem, count);
+            if (object_is_null(res) || !message_reader_add_external(reader, res)) {
+                return false;
+            }
+            for (int i = 0; i < count; i++) {
+                object_t item = object_make_null();
+                if (!read_value(reader, depth + 1, &item)
+                    || !object_is_hashable(item)
+                    || !object_set_add(res, item)) {
+                    return false;
+                }
+            }
+            break;
+        }
+        case MESSAGE_TAG_TYPED_ARRAY: {
+            uint8_t array_type_byte = 0;
+            int count = 0;
+            if (!read_bytes(reader, &array_type_byte, 1) || !read_count(reader, &count)) {
+                return false;
+            }
+            typed_array_type_t array_type = (typed_array_type_t)array_type_byte;
+            int item_size = typed_array_type_get_size(array_type);
+            if (item_size == 0 || count > (reader->len - reader->pos) / item_size) {
+                return false;
+            }
+            res = object_make_typed_array(mem, array_type, count);
+            if (object_is_null(res) || !message_reader_add_external(reader, res)) {
+                return false;
+            }
+            memcpy(object_get_typed_array_data(res), reader->data + reader->pos, (size_t)count * item_size);
+            reader->pos += count * item_size;
+            break;
+        }
+        case MESSAGE_TAG_STRUCT_TYPE: {
+            if (!read_struct_type(reader, depth, &res)) {
+                return false;
+            }
+            break;
+        }
+        case MESSAGE_TAG_STRUCT: {
+            if (!read_struct(reader, depth, &res)) {
+                return false;
+            }
+            break;
+        }
+        case MESSAGE_TAG_FUNCTION: {
+            if (!read_function(reader, depth, &res)) {
+                return false;
+            }
+            break;
+        }
+        case MESSAGE_TAG_BUILTIN: {
+            int builtin_ix = 0;
+            if (!read_count(reader, &builtin_ix) || builtin_ix >= builtins_count()) {
+                return false;
+            }
+            res = object_make_native_function(mem, builtins_get_name(builtin_ix), builtins_get_fn(builtin_ix), NULL, 0);
+            if (object_is_null(res)) {
+                return false;
+            }
+            break;
+        }
+        case MESSAGE_TAG_REF: {
+            int ref_ix = 0;
+            if (!read_count(reader, &ref_ix) || !reader->refs || ref_ix >= array_count(reader->refs)) {
+                return false;
+            }
+            object_t *ref = array_get(reader->refs, ref_ix);
+            res = *ref;
+            break;
+        }
+        default: {
+            return false;
+        }
+    }
+    *out_obj = res;
+    return true;
+}
+
+static bool read_function(message_reader_t *reader, int depth, object_t *out_obj) {
+    compilation_result_t *comp_res = NULL;
+    const char *name = NULL;
+    int num_locals = 0;
+    int num_args = 0;
+    int free_vals_count = 0;
+    if (!read_bytes(reader, &comp_res, sizeof(compilation_result_t*))
+        || !read_bytes(reader, &name, sizeof(const char*))
+        || !read_count(reader, &num_locals)
+        || !read_count(reader, &num_args)
+        || !read_count(reader, &free_vals_count)
+        || free_vals_count > reader->len - reader->pos) {
+        return false;
+    }
+    object_t res = object_make_function(reader->mem, name, comp_res, false, num_locals, num_args, free_vals_count);
+    if (object_is_null(res) || !message_reader_add_external(reader, res)) {
+        return false;
+    }
+    for (int i = 0; i < free_vals_count; i++) {
+        object_t free_val = object_make_null();
+        if (!read_value(reader, depth + 1, &free_val)) {
+            return false;
+        }
+        object_set_function_free_val(res, i, free_val);
+    }
+    *out_obj = res;
+    return true;
+}
+
+static bool read_struct_type(message_reader_t *reader, int depth, object_t *out_obj) {
+    int name_len = 0;
+    if (!read_count(reader, &name_len) || name_len > reader->len - reader->pos) {
+        return false;
+    }
+    allocator_t *alloc = reader->mem->alloc;
+    char *name = ape_strndup(alloc, (const char*)reader->data + reader->pos, name_len);
+    if (!name) {
+        return false;
+    }
+    reader->pos += name_len;
+
+    object_t res = object_make_null();
+    object_t *field_names = NULL;
+    int fields_count = 0;
+    int operators_count = 0;
+    if (!read_count(reader, &fields_count)
+        || !read_count(reader, &operators_count)
+        || fields_count > reader->len - reader->pos
+        || operators_count > OPCODE_MAX) {
+        goto err;
+    }
+    if (fields_count > 0) {
+        field_names = allocator_malloc(alloc, sizeof(object_t) * fields_count);
+        if (!field_names) {
+            goto err;
+        }
+    }
+    for (int i = 0; i < fields_count; i++) {
+        if (!read_value(reader, depth + 1, &field_names[i]) || object_get_type(field_names[i]) != OBJECT_STRING) {
+            goto err;
+        }
+    }
+    res = object_make_struct_type(reader->mem, name, field_names, fields_count, operators_count > 0 ? OPCODE_MAX : 0);
+    if (object_is_null(res) || !message_reader_add_external(reader, res)) {
+        goto err;
+    }
+    allocator_free(alloc, field_names);
+    field_names = NULL;
+    allocator_free(alloc, name);
+    name = NULL;
+    for (int i = 0; i < operators_count; i++) {
+        int op = 0;
+        object_t fn = object_make_null();
+        if (!read_count(reader, &op)
+            || !read_value(reader, depth + 1, &fn)
+            || !object_set_struct_type_operator(res, op, fn)) {
+            return false;
+        }
+    }
+    *out_obj = res;
+    return true;
+err:
+    allocator_free(alloc, field_names);
+    allocator_free(alloc, name);
+    return false;
+}
+
+static bool read_struct(message_reader_t *reader, int depth, object_t *out_obj) {
+    object_t struct_type = object_make_null();
+    if (!read_value(reader, depth + 1, &struct_type) || object_get_type(struct_type) != OBJECT_STRUCT_TYPE) {
+        return false;
+    }
+    object_t res = object_make_struct(reader->mem, struct_type);
+    if (object_is_null(res) || !message_reader_add_external(reader, res)) {
+        return false;
+    }
+    int fields_count = object_get_struct_type_fields_count(struct_type);
+    for (int i = 0; i < fields_count; i++) {
+        object_t field = object_make_null();
+        if (!read_value(reader, depth + 1, &field)) {
+            return false;
+        }
+        object_get_struct_fields(res)[i] = field;
+    }
+    *out_obj = res;
+    return true;
+}
+
+static bool read_bytes(message_reader_t *reader, void *out, int n) {
+    if (n > reader->len - reader->pos) {
+        return false;
+    }
+    memcpy(out, reader->data + reader->pos, n);
+    reader->pos += n;
+    return true;
+}
+
+static bool read_count(message_reader_t *reader, int *out_count) {
+    int32_t count32 = 0;
+    if (!read_bytes(reader, &count32, sizeof(int32_t)) || count32 < 0) {
+        return false;
+    }
+    *out_count = count32;
+    return true;
+}
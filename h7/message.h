@@ -0,0 +1,51 @@
+#ifndef message_h
+#define message_h
+
+#ifndef APE_AMALGAMATED
+#include "common.h"
+#include "collections.h"
+#include "object.h"
+#endif
+
+typedef struct gcmem gcmem_t;
+
+// Messages are values serialized into plain bytes that don't belong to any gcmem, so they can be passed
+// between ape instances running on different threads. Only data can be serialized: null, bools, numbers,
+// strings, arrays, maps, sets, typed arrays, structs and their types. Writing other types fails.
+// With functions set, functions are written as references to their compiled code (their free values are
+// serialized) and builtin native functions by index. The compiled code stays owned by the constants it came
+// from, so readers must not outlive them. Functions owning their code (deep copies) aren't supported.
+// Objects referenced more than once (including cycles) are written once, so the values read share
+// the same objects as the values written, for all values written with the same writer.
+typedef struct message_writer {
+    allocator_t *alloc;
+    array(uint8_t) *buf;
+    bool functions;
+    valdict(object_data_t*, int) *refs; // made when the first allocated object is written
+    int refs_count;
+} message_writer_t;
+
+typedef struct message_reader {
+    gcmem_t *mem;
+    const uint8_t *data;
+    int len;
+    int pos;
+    array(object_t) *refs; // made when the first allocated object is read
+} message_reader_t;
+
+APE_INTERNAL void message_writer_init(message_writer_t *writer, allocator_t *alloc, array(uint8_t) *buf, bool functions);
+APE_INTERNAL void message_writer_deinit(message_writer_t *writer);
+// Objects that aren't written but referenced, the reader has to add matching objects in the same order.
+APE_INTERNAL bool message_writer_add_external(message_writer_t *writer, object_t obj);
+APE_INTERNAL bool message_writer_write(message_writer_t *writer, object_t obj);
+
+APE_INTERNAL void message_reader_init(message_reader_t *reader, gcmem_t *mem, const uint8_t *data, int len);
+APE_INTERNAL void message_reader_deinit(message_reader_t *reader);
+APE_INTERNAL bool message_reader_add_external(message_reader_t *reader, object_t obj);
+APE_INTERNAL bool message_reader_read(message_reader_t *reader, object_t *out_obj);
+
+// Single value messages, pos is advanced past the value read.
+APE_INTERNAL bool message_write(array(uint8_t) *buf, object_t obj, bool functions);
+APE_INTERNAL bool message_read(gcmem_t *mem, const uint8_t *data, int len, int *pos, object_t *out_obj);
+
+#endif /* message_h */
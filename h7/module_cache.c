@@ -0,0 +1,164 @@
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef APE_AMALGAMATED
+#include "module_cache.h"
+#endif
+
+#if defined(APE_POSIX)
+#include <pthread.h>
+#endif
+
+#if defined(APE_POSIX)
+
+typedef struct module_cache_entry {
+    char *path;
+    uint64_t source_hash;
+    uint64_t globals_hash;
+    bool repl_mode;
+    int globals_start;
+    uint8_t *data; // serialized bytecode cache, never changed after it's added
+    size_t size;
+} module_cache_entry_t;
+
+// Entries live until module_cache_clear or the end of the process, they're allocated with malloc
+// because instances adding them can be destroyed before others use them.
+static pthread_mutex_t g_mutex = PTHREAD_MUTEX_INITIALIZER;
+static ptrarray(module_cache_entry_t) *g_entries = NULL;
+
+static bool entry_matches(const module_cache_entry_t *entry, const char *canonical_path,
+                          uint64_t source_hash, uint64_t globals_hash, bool repl_mode);
+static void entry_destroy(module_cache_entry_t *entry);
+
+bytecode_cache_t* module_cache_load(allocator_t *alloc, const char *canonical_path,
+                                    uint64_t source_hash, uint64_t globals_hash, bool repl_mode,
+                                    int globals_start) {
+    uint8_t *data = NULL;
+    size_t size = 0;
+    pthread_mutex_lock(&g_mutex);
+    for (int i = 0; i < ptrarray_count(g_entries); i++) {
+        module_cache_entry_t *entry = ptrarray_get(g_entries, i);
+        if (!entry_matches(entry, canonical_path, source_hash, globals_hash, repl_mode)
+            || (globals_start >= 0 && entry->globals_start != globals_start)) {
+            continue;
+        }
+        // copied so that the entry can be replaced while the instance loads it
+        data = allocator_malloc(alloc, entry->size);
+        if (data) {
+            memcpy(data, entry->data, entry->size);
+            size = entry->size;
+        }
+        break;
+    }
+    pthread_mutex_unlock(&g_mutex);
+    if (!data) {
+        return NULL;
+    }
+    return bytecode_cache_load_data(alloc, data, size, source_hash, globals_hash, repl_mode);
+}
+
+bool module_cache_add(const char *canonical_path, const bytecode_cache_t *cache) {
+    module_cache_entry_t *entry = malloc(sizeof(module_cache_entry_t));
+    if (!entry) {
+        return false;
+    }
+    memset(entry, 0, sizeof(module_cache_entry_t));
+    entry->path = ape_strdup(NULL, canonical_path);
+    entry->source_hash = cache->source_hash;
+    entry->globals_hash = cache->globals_hash;
+    entry->repl_mode = cache->repl_mode;
+    entry->globals_start = cache->globals_start;
+    entry->data = bytecode_cache_serialize(cache, NULL, &entry->size);
+    if (!entry->path || !entry->data) {
+        entry_destroy(entry);
+        return false;
+    }
+
+    ptrarray(module_cache_entry_t) *replaced = ptrarray_make(NULL);
+    if (!replaced) {
+        entry_destroy(entry);
+        return false;
+    }
+    pthread_mutex_lock(&g_mutex);
+    bool ok = true;
+    if (!g_entries) {
+        g_entries = ptrarray_make(NULL);
+        ok = g_entries != NULL;
+    }
+    for (int i = 0; ok && i < ptrarray_count(g_entries); i++) {
+        module_cache_entry_t *prev_entry = ptrarray_get(g_entries, i);
+        if (!APE_STREQ(prev_entry->path, canonical_path)) {
+            continue;
+        }
+        if (!entry_matches(prev_entry, canonical_path, entry->source_hash, entry->globals_hash, entry->repl_mode)
+            || prev_entry->globals_start == entry->globals_start) {
+            ok = ptrarray_add(replaced, prev_entry);
+            if (ok) {
+                ptrarray_remove_at(g_entries, i);
+                i--;
+            }
+        }
+    }
+    ok = ok && ptrarray_add(g_entries, entry);
+    pthread_mutex_unlock(&g_mutex);
+
+    ptrarray_destroy_with_items(replaced, entry_destroy);
+    if (!ok) {
+        entry_destroy(entry);
+    }
+    return ok;
+}
+
+void module_cache_clear(void) {
+    pthread_mutex_lock(&g_mutex);
+    ptrarray(module_cache_entry_t) *entries = g_entries;
+    g_entries = NULL;
+    pthread_mutex_unlock(&g_mutex);
+    ptrarray_destroy_with_items(entries, entry_destroy);
+}
+
+int module_cache_count(void) {
+    pthread_mutex_lock(&g_mutex);
+    int count = ptrarray_count(g_entries);
+    pthread_mutex_unlock(&g_mutex);
+    return count;
+}
+
+// INTERNAL
+static bool entry_matches(const module_cache_entry_t *entry, const char *canonical_path,
+                          uint64_t source_hash, uint64_t globals_hash, bool repl_mode) {
+    return APE_STREQ(entry->path, canonical_path) && entry->source_hash == source_hash
+        && entry->globals_hash == globals_hash && entry->repl_mode == repl_mode;
+}
+
+static void entry_destroy(module_cache_entry_t *entry) {
+    if (!entry) {
+        return;
+    }
+    free(entry->path);
+    free(entry->data);
+    free(entry);
+}
+
+#else
+
+bytecode_cache_t* module_cache_load(allocator_t *alloc, const char *canonical_path,
+                                    uint64_t source_hash, uint64_t globals_hash, bool repl_mode,
+                                    int globals_start) {
+    (void)alloc; (void)canonical_path; (void)source_hash; (void)globals_hash; (void)repl_mode; (void)globals_start;
+    return NULL;
+}
+
+bool module_cache_add(const char *canonical_path, const bytecode_cache_t *cache) {
+    (void)canonical_path; (void)cache;
+    return false;
+}
+
+void module_cache_clear(void) {
+}
+
+int module_cache_count(void) {
+    return 0;
+}
+
+#endif
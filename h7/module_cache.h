@@ -0,0 +1,26 @@
+#ifndef module_cache_h
+#define module_cache_h
+
+#ifndef APE_AMALGAMATED
+#include "common.h"
+#include "collections.h"
+#include "bytecode_cache.h"
+#endif
+
+// Process wide cache of compiled modules shared by all ape instances (and threads), so that instances importing
+// the same modules compile each of them once. Modules are kept in the bytecode cache format (bytecode_cache.h)
+// by canonical path and loaded into the importing compiler's constants and globals like .apec files. A path can
+// have a module for every globals start it was cached at if it can't be loaded anywhere (see globals_start).
+// Only available where ape has threads (APE_POSIX), elsewhere nothing is cached.
+
+// Returns NULL if there's no module at canonical_path with the given source hash, globals, mode and globals start
+// (-1 for any).
+APE_INTERNAL bytecode_cache_t* module_cache_load(allocator_t *alloc, const char *canonical_path,
+                                                 uint64_t source_hash, uint64_t globals_hash, bool repl_mode,
+                                                 int globals_start);
+// Replaces modules cached at canonical_path for other sources or globals and at the same globals start.
+APE_INTERNAL bool module_cache_add(const char *canonical_path, const bytecode_cache_t *cache);
+APE_INTERNAL void module_cache_clear(void);
+APE_INTERNAL int module_cache_count(void); // number of cached modules
+
+#endif /* module_cache_h */
@@ -3,6 +3,7 @@
 #include <stdarg.h>
 #include <string.h>
 #include <float.h>
+#include <limits.h>
 #include <math.h>
 
 #ifndef APE_AMALGAMATED
@@ -20,14 +21,16 @@
 #define OBJECT_NULL_PATTERN     0xfffa000000000000
 
 static object_t object_deep_copy_internal(gcmem_t *mem, object_t obj, valdict(object_t, object_t) *copies);
-static bool object_equals_wrapped(const object_t *a, const object_t *b);
-static unsigned long object_hash(object_t *obj_ptr);
 static unsigned long object_hash_string(const char *str);
-static unsigned long object_hash_double(double val);
 static array(object_t)* object_get_allocated_array(object_t object);
+static bool object_array_make_unique(object_array_t *array);
+static bool object_items_are_immutable(object_t *items, int count);
+static double compare_int_to_double(int64_t a, double b);
 static bool object_is_number(object_t obj);
+static bool object_is_unboxed_number(object_t obj);
 static uint64_t get_type_tag(object_type_t type);
 static bool freevals_are_allocated(function_t *fun);
+static bool struct_fields_are_allocated(object_struct_t *obj);
 static char *object_data_get_string(object_data_t *data);
 static bool object_data_string_reserve_capacity(object_data_t *data, int capacity);
 
@@ -40,6 +43,61 @@ object_t object_make_from_data(object_type_t type, object_data_t *data) {
     return object;
 }
 
+object_t object_make_static_copy(allocator_t *alloc, object_t obj) {
+    object_type_t type = object_get_type(obj);
+    if (type != OBJECT_STRING && type != OBJECT_FUNCTION) {
+        return object_make_null();
+    }
+    object_data_t *data = allocator_malloc(alloc, sizeof(object_data_t));
+    if (!data) {
+        return object_make_null();
+    }
+    memset(data, 0, sizeof(object_data_t));
+    data->mem = NULL;
+    data->gcmark = true;
+    data->type = type;
+    if (type == OBJECT_STRING) {
+        int len = object_get_string_length(obj);
+        char *value = data->string.value_buf;
+        data->string.capacity = OBJECT_STRING_BUF_SIZE - 1;
+        if (len > data->string.capacity) {
+            value = allocator_malloc(alloc, len + 1);
+            if (!value) {
+                allocator_free(alloc, data);
+                return object_make_null();
+            }
+            data->string.value_allocated = value;
+            data->string.is_allocated = true;
+            data->string.capacity = len;
+        }
+        memcpy(value, object_get_string(obj), len + 1);
+        data->string.length = len;
+        data->string.hash = object_get_string_hash(obj); // computed now, it's cached lazily otherwise
+    } else {
+        // constants never have free values, the compiled code and name stay owned by the original
+        const function_t *function = object_get_function(obj);
+        data->function.const_name = object_get_function_name(obj);
+        data->function.comp_result = function->comp_result;
+        data->function.owns_data = false;
+        data->function.num_locals = function->num_locals;
+        data->function.num_args = function->num_args;
+        data->function.free_vals_count = 0;
+    }
+    return object_make_from_data(type, data);
+}
+
+void object_destroy_static_copy(allocator_t *alloc, object_t obj) {
+    if (!object_is_allocated(obj)) {
+        return;
+    }
+    object_data_t *data = object_get_allocated_data(obj);
+    APE_ASSERT(data->mem == NULL);
+    if (data->type == OBJECT_STRING && data->string.is_allocated) {
+        allocator_free(alloc, data->string.value_allocated);
+    }
+    allocator_free(alloc, data);
+}
+
 object_t object_make_number(double val) {
     object_t o = { .number = val };
     if ((o.handle & OBJECT_PATTERN) == OBJECT_PATTERN) {
@@ -48,6 +106,18 @@ object_t object_make_number(double val) {
     return o;
 }
 
+object_t object_make_int(gcmem_t *mem, int64_t val) {
+    if (val >= OBJECT_SMALL_INT_MIN && val <= OBJECT_SMALL_INT_MAX) {
+        return object_make_small_int(val);
+    }
+    object_data_t *data = gcmem_alloc_object_data(mem, OBJECT_NUMBER);
+    if (!data) {
+        return object_make_null();
+    }
+    data->boxed_int = val;
+    return object_make_from_data(OBJECT_NUMBER, data);
+}
+
 object_t object_make_bool(bool val) {
     return (object_t) { .handle = OBJECT_BOOL_HEADER | val };
 }
@@ -138,44 +208,67 @@ object_t object_make_array(gcmem_t *mem) {
 
 object_t object_make_array_with_capacity(gcmem_t *mem, unsigned capacity) {
     object_data_t *data = gcmem_get_object_data_from_pool(mem, OBJECT_ARRAY);
+    if (data && data->array.items_shared && array_is_shared(data->array.items)) {
+        array_destroy(data->array.items);
+        data->array.items = array_make_with_capacity(mem->alloc, capacity, sizeof(object_t));
+        if (!data->array.items) {
+            return object_make_null();
+        }
+    }
     if (data) {
-        array_clear(data->array);
+        array_clear(data->array.items);
+        data->array.only_numbers = true;
+        data->array.only_doubles = true;
+        data->array.items_shared = false;
         return object_make_from_data(OBJECT_ARRAY, data);
     }
     data = gcmem_alloc_object_data(mem, OBJECT_ARRAY);
     if (!data) {
         return object_make_null();
     }
-    data->array = array_make_with_capacity(mem->alloc, capacity, sizeof(object_t));
-    if (!data->array) {
+    data->array.items = array_make_with_capacity(mem->alloc, capacity, sizeof(object_t));
+    if (!data->array.items) {
         return object_make_null();
     }
+    data->array.only_numbers = true;
+    data->array.only_doubles = true;
+    data->array.items_shared = false;
     return object_make_from_data(OBJECT_ARRAY, data);
 }
 
 object_t object_make_map(gcmem_t *mem) {
-    return object_make_map_with_capacity(mem, 32);
+    return object_make_map_with_capacity(mem, 0);
 }
 
 object_t object_make_map_with_capacity(gcmem_t *mem, unsigned capacity) {
     object_data_t *data = gcmem_get_object_data_from_pool(mem, OBJECT_MAP);
     if (data) {
-        valdict_clear(data->map);
+        objmap_clear(&data->map);
         return object_make_from_data(OBJECT_MAP, data);
     }
     data = gcmem_alloc_object_data(mem, OBJECT_MAP);
     if (!data) {
         return object_make_null();
     }
-    data->map = valdict_make_with_capacity(mem->alloc, capacity, sizeof(object_t), sizeof(object_t));
-    if (!data->map) {
+    bool ok = objmap_init(&data->map, mem->alloc, capacity);
+    if (!ok) {
         return object_make_null();
     }
-    valdict_set_hash_function(data->map, (collections_hash_fn)object_hash);
-    valdict_set_equals_function(data->map, (collections_equals_fn)object_equals_wrapped);
     return object_make_from_data(OBJECT_MAP, data);
 }
 
+object_t object_make_set(gcmem_t *mem, unsigned capacity) {
+    object_data_t *data = gcmem_alloc_object_data(mem, OBJECT_SET);
+    if (!data) {
+        return object_make_null();
+    }
+    bool ok = objmap_init_keys_only(&data->set, mem->alloc, capacity);
+    if (!ok) {
+        return object_make_null();
+    }
+    return object_make_from_data(OBJECT_SET, data);
+}
+
 object_t object_make_error(gcmem_t *mem, const char *error) {
     char *error_str = ape_strdup(mem->alloc, error);
     if (!error_str) {
@@ -262,6 +355,107 @@ object_t object_make_external(gcmem_t *mem, void *data) {
     return object_make_from_data(OBJECT_EXTERNAL, obj);
 }
 
+object_t object_make_range(gcmem_t *mem, int start, int end, int step) {
+    APE_ASSERT(step != 0);
+    object_data_t *obj = gcmem_alloc_object_data(mem, OBJECT_RANGE);
+    if (!obj) {
+        return object_make_null();
+    }
+    int64_t length = object_count_range_values(start, end, step);
+    APE_ASSERT(length <= INT_MAX);
+    obj->range.start = start;
+    obj->range.step = step;
+    obj->range.length = (int)length;
+    return object_make_from_data(OBJECT_RANGE, obj);
+}
+
+object_t object_make_typed_array(gcmem_t *mem, typed_array_type_t type, int length) {
+    APE_ASSERT(length >= 0);
+    object_t res = object_make_typed_array_with_data(mem, type, NULL, length, NULL);
+    if (object_is_null(res)) {
+        return object_make_null();
+    }
+    size_t size = (size_t)length * typed_array_type_get_size(type);
+    void *data = allocator_malloc(mem->alloc, size > 0 ? size : 1);
+    if (!data) {
+        return object_make_null();
+    }
+    memset(data, 0, size);
+    object_data_t *obj = object_get_allocated_data(res);
+    obj->typed_array.data = data;
+    obj->typed_array.owns_data = true;
+    return res;
+}
+
+object_t object_make_typed_array_with_data(gcmem_t *mem, typed_array_type_t type, void *data, int length,
+                                           external_data_destroy_fn destroy_fn) {
+    object_data_t *obj = gcmem_alloc_object_data(mem, OBJECT_TYPED_ARRAY);
+    if (!obj) {
+        return object_make_null();
+    }
+    obj->typed_array.data = data;
+    obj->typed_array.length = length;
+    obj->typed_array.type = type;
+    obj->typed_array.owns_data = false;
+    obj->typed_array.data_destroy_fn = destroy_fn;
+    return object_make_from_data(OBJECT_TYPED_ARRAY, obj);
+}
+
+object_t object_make_struct_type(gcmem_t *mem, const char *name, object_t *field_names, int fields_count,
+                                 int operators_count) {
+    object_data_t *obj = gcmem_alloc_object_data(mem, OBJECT_STRUCT_TYPE);
+    if (!obj) {
+        return object_make_null();
+    }
+    object_struct_type_t *struct_type = &obj->struct_type;
+    struct_type->name = ape_strdup(mem->alloc, name);
+    if (!struct_type->name) {
+        return object_make_null();
+    }
+    if (fields_count > 0) {
+        struct_type->field_names = allocator_malloc(mem->alloc, sizeof(object_t) * fields_count);
+        if (!struct_type->field_names) {
+            return object_make_null();
+        }
+        memcpy(struct_type->field_names, field_names, sizeof(object_t) * fields_count);
+    }
+    struct_type->fields_count = fields_count;
+    if (operators_count > 0) {
+        struct_type->operators = allocator_malloc(mem->alloc, sizeof(object_t) * operators_count);
+        if (!struct_type->operators) {
+            return object_make_null();
+        }
+        for (int i = 0; i < operators_count; i++) {
+            struct_type->operators[i] = object_make_null();
+        }
+    }
+    struct_type->operators_count = operators_count;
+    return object_make_from_data(OBJECT_STRUCT_TYPE, obj);
+}
+
+object_t object_make_struct(gcmem_t *mem, object_t struct_type) {
+    int fields_count = object_get_struct_type_fields_count(struct_type);
+    object_data_t *obj = gcmem_alloc_object_data(mem, OBJECT_STRUCT);
+    if (!obj) {
+        return object_make_null();
+    }
+    obj->struct_obj.type = struct_type;
+    obj->struct_obj.fields_count = fields_count;
+    object_t *fields = obj->struct_obj.fields_buf;
+    if (struct_fields_are_allocated(&obj->struct_obj)) {
+        fields = allocator_malloc(mem->alloc, sizeof(object_t) * fields_count);
+        if (!fields) {
+            obj->struct_obj.fields_count = 0;
+            return object_make_null();
+        }
+        obj->struct_obj.fields_allocated = fields;
+    }
+    for (int i = 0; i < fields_count; i++) {
+        fields[i] = object_make_null();
+    }
+    return object_make_from_data(OBJECT_STRUCT, obj);
+}
+
 void object_deinit(object_t obj) {
     if (object_is_allocated(obj)) {
         object_data_t *data = object_get_allocated_data(obj);
@@ -292,11 +486,15 @@ void object_data_deinit(object_data_t *data) {
             break;
         }
         case OBJECT_ARRAY: {
-            array_destroy(data->array);
+            array_destroy(data->array.items);
             break;
         }
         case OBJECT_MAP: {
-            valdict_destroy(data->map);
+            objmap_deinit(&data->map);
+            break;
+        }
+        case OBJECT_SET: {
+            objmap_deinit(&data->set);
             break;
         }
         case OBJECT_NATIVE_FUNCTION: {
@@ -309,6 +507,26 @@ void object_data_deinit(object_data_t *data) {
             }
             break;
         }
+        case OBJECT_TYPED_ARRAY: {
+            if (data->typed_array.owns_data) {
+                allocator_free(data->mem->alloc, data->typed_array.data);
+            } else if (data->typed_array.data_destroy_fn) {
+                data->typed_array.data_destroy_fn(data->typed_array.data);
+            }
+            break;
+        }
+        case OBJECT_STRUCT_TYPE: {
+            allocator_free(data->mem->alloc, data->struct_type.name);
+            allocator_free(data->mem->alloc, data->struct_type.field_names);
+            allocator_free(data->mem->alloc, data->struct_type.operators);
+            break;
+        }
+        case OBJECT_STRUCT: {
+            if (struct_fields_are_allocated(&data->struct_obj)) {
+                allocator_free(data->mem->alloc, data->struct_obj.fields_allocated);
+            }
+            break;
+        }
         case OBJECT_ERROR: {
             allocator_free(data->mem->alloc, data->error.message);
             traceback_destroy(data->error.traceback);
@@ -352,8 +570,13 @@ void object_to_string(object_t obj, strbuf_t *buf, bool quote_str) {
             break;
         }
         case OBJECT_NUMBER: {
-            double number = object_get_number(obj);
-            strbuf_appendf(buf, "%1.10g", number);
+            if (object_is_int(obj)) {
+                strbuf_appendf(buf, "%lld", (long long)object_get_int(obj));
+                break;
+            }
+            char number_str[APE_DTOA_BUFFER_SIZE];
+            int number_len = ape_dtoa(object_get_number(obj), number_str);
+            strbuf_appendn(buf, number_str, number_len);
             break;
         }
         case OBJECT_BOOL: {
@@ -406,6 +629,18 @@ void object_to_string(object_t obj, strbuf_t *buf, bool quote_str) {
             strbuf_append(buf, "}");
             break;
         }
+        case OBJECT_SET: {
+            int len = object_get_set_length(obj);
+            strbuf_append(buf, "set[");
+            for (int i = 0; i < len; i++) {
+                object_to_string(object_get_set_value_at(obj, i), buf, true);
+                if (i < (len - 1)) {
+                    strbuf_append(buf, ", ");
+                }
+            }
+            strbuf_append(buf, "]");
+            break;
+        }
         case OBJECT_NATIVE_FUNCTION: {
             strbuf_append(buf, "NATIVE_FUNCTION");
             break;
@@ -414,6 +649,49 @@ void object_to_string(object_t obj, strbuf_t *buf, bool quote_str) {
             strbuf_append(buf, "EXTERNAL");
             break;
         }
+        case OBJECT_RANGE: {
+            strbuf_append(buf, "[");
+            for (int i = 0; i < object_get_range_length(obj); i++) {
+                object_to_string(object_get_range_value_at(obj, i), buf, true);
+                if (i < (object_get_range_length(obj) - 1)) {
+                    strbuf_append(buf, ", ");
+                }
+            }
+            strbuf_append(buf, "]");
+            break;
+        }
+        case OBJECT_TYPED_ARRAY: {
+            int len = object_get_typed_array_length(obj);
+            strbuf_appendf(buf, "%s[", typed_array_type_get_name(object_get_typed_array_type(obj)));
+            for (int i = 0; i < len; i++) {
+                object_to_string(object_get_typed_array_value_at(obj, i), buf, true);
+                if (i < (len - 1)) {
+                    strbuf_append(buf, ", ");
+                }
+            }
+            strbuf_append(buf, "]");
+            break;
+        }
+        case OBJECT_STRUCT: {
+            object_t struct_type = object_get_struct_type(obj);
+            object_t *fields = object_get_struct_fields(obj);
+            int fields_count = object_get_struct_type_fields_count(struct_type);
+            strbuf_appendf(buf, "%s{", object_get_struct_type_name(struct_type));
+            for (int i = 0; i < fields_count; i++) {
+                object_to_string(object_get_struct_type_field_name(struct_type, i), buf, false);
+                strbuf_append(buf, ": ");
+                object_to_string(fields[i], buf, true);
+                if (i < (fields_count - 1)) {
+                    strbuf_append(buf, ", ");
+                }
+            }
+            strbuf_append(buf, "}");
+            break;
+        }
+        case OBJECT_STRUCT_TYPE: {
+            strbuf_appendf(buf, "STRUCT_TYPE: %s", object_get_struct_type_name(obj));
+            break;
+        }
         case OBJECT_ERROR: {
             strbuf_appendf(buf, "ERROR: %s\n", object_get_error_message(obj));
             traceback_t *traceback = object_get_error_traceback(obj);
@@ -441,8 +719,13 @@ const char *object_get_type_name(const object_type_t type) {
         case OBJECT_NATIVE_FUNCTION: return "NATIVE_FUNCTION";
         case OBJECT_ARRAY:           return "ARRAY";
         case OBJECT_MAP:             return "MAP";
+        case OBJECT_SET:             return "SET";
         case OBJECT_FUNCTION:        return "FUNCTION";
         case OBJECT_EXTERNAL:        return "EXTERNAL";
+        case OBJECT_RANGE:           return "RANGE";
+        case OBJECT_TYPED_ARRAY:     return "TYPED_ARRAY";
+        case OBJECT_STRUCT:          return "STRUCT";
+        case OBJECT_STRUCT_TYPE:     return "STRUCT_TYPE";
         case OBJECT_ERROR:           return "ERROR";
         case OBJECT_ANY:             return "ANY";
     }
@@ -476,8 +759,13 @@ char* object_get_type_union_name(allocator_t *alloc, const object_type_t type) {
     CHECK_TYPE(OBJECT_NATIVE_FUNCTION);
     CHECK_TYPE(OBJECT_ARRAY);
     CHECK_TYPE(OBJECT_MAP);
+    CHECK_TYPE(OBJECT_SET);
     CHECK_TYPE(OBJECT_FUNCTION);
     CHECK_TYPE(OBJECT_EXTERNAL);
+    CHECK_TYPE(OBJECT_RANGE);
+    CHECK_TYPE(OBJECT_TYPED_ARRAY);
+    CHECK_TYPE(OBJECT_STRUCT);
+    CHECK_TYPE(OBJECT_STRUCT_TYPE);
     CHECK_TYPE(OBJECT_ERROR);
 
     return strbuf_get_string_and_destroy(res);
@@ -519,6 +807,8 @@ object_t object_copy(gcmem_t *mem, object_t obj) {
         case OBJECT_NULL:
         case OBJECT_FUNCTION:
         case OBJECT_NATIVE_FUNCTION:
+        case OBJECT_RANGE:
+        case OBJECT_STRUCT_TYPE:
         case OBJECT_ERROR: {
             copy = obj;
             break;
@@ -528,31 +818,40 @@ object_t object_copy(gcmem_t *mem, object_t obj) {
             copy = object_make_string(mem, str);
             break;
         }
-        case OBJECT_ARRAY: {
-            int len = object_get_array_length(obj);
-            copy = object_make_array_with_capacity(mem, len);
+        case OBJECT_STRUCT: {
+            copy = object_make_struct(mem, object_get_struct_type(obj));
             if (object_is_null(copy)) {
                 return object_make_null();
             }
-            for (int i = 0; i < len; i++) {
-                object_t item = object_get_array_value_at(obj, i);
-                bool ok = object_add_array_value(copy, item);
-                if (!ok) {
-                    return object_make_null();
-                }
+            int fields_count = object_get_struct_type_fields_count(object_get_struct_type(obj));
+            memcpy(object_get_struct_fields(copy), object_get_struct_fields(obj), sizeof(object_t) * fields_count);
+            break;
+        }
+        case OBJECT_ARRAY: {
+            // items are shared until either array is modified
+            object_data_t *data = object_get_allocated_data(obj);
+            object_data_t *copy_data = gcmem_alloc_object_data(mem, OBJECT_ARRAY);
+            if (!copy_data) {
+                return object_make_null();
             }
+            copy_data->array.items = array_share(data->array.items);
+            copy_data->array.only_numbers = data->array.only_numbers;
+            copy_data->array.only_doubles = data->array.only_doubles;
+            copy_data->array.items_shared = true;
+            data->array.items_shared = true;
+            copy = object_make_from_data(OBJECT_ARRAY, copy_data);
             break;
         }
-        case OBJECT_MAP: {
-            copy = object_make_map(mem);
-            for (int i = 0; i < object_get_map_length(obj); i++) {
-                object_t key = object_get_map_key_at(obj, i);
-                object_t val = object_get_map_value_at(obj, i);
-                bool ok = object_set_map_value(copy, key, val);
-                if (!ok) {
-                    return object_make_null();
-                }
+        case OBJECT_MAP:
+        case OBJECT_SET: {
+            // storage is shared until either object is modified
+            object_data_t *data = object_get_allocated_data(obj);
+            object_data_t *copy_data = gcmem_alloc_object_data(mem, type);
+            if (!copy_data) {
+                return object_make_null();
             }
+            objmap_init_shared(&copy_data->map, &data->map);
+            copy = object_make_from_data(type, copy_data);
             break;
         }
         case OBJECT_EXTERNAL: {
@@ -572,6 +871,17 @@ object_t object_copy(gcmem_t *mem, object_t obj) {
             object_set_external_copy_function(copy, external->data_copy_fn);
             break;
         }
+        case OBJECT_TYPED_ARRAY: {
+            int len = object_get_typed_array_length(obj);
+            typed_array_type_t array_type = object_get_typed_array_type(obj);
+            copy = object_make_typed_array(mem, array_type, len);
+            if (object_is_null(copy)) {
+                return object_make_null();
+            }
+            memcpy(object_get_typed_array_data(copy), object_get_typed_array_data(obj),
+                   (size_t)len * typed_array_type_get_size(array_type));
+            break;
+        }
     }
     return copy;
 }
@@ -583,11 +893,33 @@ double object_compare(object_t a, object_t b, bool *out_ok) {
 
     *out_ok = true;
 
+    if (object_is_small_int(a) && object_is_small_int(b)) {
+        int64_t a_val = object_get_small_int(a);
+        int64_t b_val = object_get_small_int(b);
+        return a_val < b_val ? -1 : (a_val > b_val ? 1 : 0);
+    } else if (object_is_double(a) && object_is_double(b)) {
+        return a.number - b.number;
+    }
+
     object_type_t a_type = object_get_type(a);
     object_type_t b_type = object_get_type(b);
 
     if ((a_type == OBJECT_NUMBER || a_type == OBJECT_BOOL || a_type == OBJECT_NULL)
         && (b_type == OBJECT_NUMBER || b_type == OBJECT_BOOL || b_type == OBJECT_NULL)) {
+        bool a_is_int = object_is_int(a);
+        bool b_is_int = object_is_int(b);
+        if (a_is_int || b_is_int) {
+            // compared exactly, converting a big int to double could make it equal to a different number
+            if (a_is_int && b_is_int) {
+                int64_t a_val = object_get_int(a);
+                int64_t b_val = object_get_int(b);
+                return a_val < b_val ? -1 : (a_val > b_val ? 1 : 0);
+            } else if (a_is_int) {
+                return compare_int_to_double(object_get_int(a), object_get_number(b));
+            } else {
+                return -compare_int_to_double(object_get_int(b), object_get_number(a));
+            }
+        }
         double left_val = object_get_number(a);
         double right_val = object_get_number(b);
         return left_val - right_val;
@@ -660,9 +992,26 @@ double object_get_number(object_t obj) {
     if (object_is_number(obj)) { // todo: optimise? always return number?
         return obj.number;
     }
+    if (object_is_int(obj)) {
+        return (double)object_get_int(obj);
+    }
     return (double)(obj.handle & (~OBJECT_HEADER_MASK));
 }
 
+int64_t object_get_int(object_t obj) {
+    if (object_is_small_int(obj)) {
+        return object_get_small_int(obj);
+    }
+    if (object_is_number(obj)) {
+        return ape_double_to_int64(obj.number);
+    }
+    if (object_is_allocated(obj)) {
+        object_data_t *data = object_get_allocated_data(obj);
+        return data->type == OBJECT_NUMBER ? data->boxed_int : 0;
+    }
+    return (int64_t)(obj.handle & (~OBJECT_HEADER_MASK));
+}
+
 const char * object_get_string(object_t object) {
     APE_ASSERT(object_get_type(object) == OBJECT_STRING);
     object_data_t *data = object_get_allocated_data(object);
@@ -743,6 +1092,7 @@ object_type_t object_get_type(object_t obj) {
         case 0: return OBJECT_NONE;
         case 1: return OBJECT_BOOL;
         case 2: return OBJECT_NULL;
+        case 3: return OBJECT_NUMBER;
         case 4: {
             object_data_t *data = object_get_allocated_data(obj);
             return data->type;
@@ -751,6 +1101,13 @@ object_type_t object_get_type(object_t obj) {
     }
 }
 
+bool object_is_int(object_t obj) {
+    if (object_is_small_int(obj)) {
+        return true;
+    }
+    return object_is_allocated(obj) && object_get_allocated_data(obj)->type == OBJECT_NUMBER;
+}
+
 bool object_is_numeric(object_t obj) {
     object_type_t type = object_get_type(obj);
     return type == OBJECT_NUMBER || type == OBJECT_BOOL;
@@ -890,17 +1247,39 @@ object_t object_get_array_value_at(object_t object, int ix) {
 
 bool object_set_array_value_at(object_t object, int ix, object_t val) {
     APE_ASSERT(object_get_type(object) == OBJECT_ARRAY);
-    array(object_t)* array = object_get_allocated_array(object);
+    object_data_t *data = object_get_allocated_data(object);
+    array(object_t)* array = data->array.items;
     if (ix < 0 || ix >= array_count(array)) {
         return false;
     }
-    return array_set(array, ix, &val);
+    if (!object_array_make_unique(&data->array)) {
+        return false;
+    }
+    data->array.only_numbers = data->array.only_numbers && object_is_unboxed_number(val);
+    data->array.only_doubles = data->array.only_doubles && object_is_number(val);
+    return array_set(data->array.items, ix, &val);
 }
 
 bool object_add_array_value(object_t object, object_t val) {
     APE_ASSERT(object_get_type(object) == OBJECT_ARRAY);
-    array(object_t)* array = object_get_allocated_array(object);
-    return array_add(array, &val);
+    object_data_t *data = object_get_allocated_data(object);
+    if (!object_array_make_unique(&data->array)) {
+        return false;
+    }
+    data->array.only_numbers = data->array.only_numbers && object_is_unboxed_number(val);
+    data->array.only_doubles = data->array.only_doubles && object_is_number(val);
+    return array_add(data->array.items, &val);
+}
+
+bool object_add_array_value_front(object_t object, object_t val) {
+    APE_ASSERT(object_get_type(object) == OBJECT_ARRAY);
+    object_data_t *data = object_get_allocated_data(object);
+    if (!object_array_make_unique(&data->array)) {
+        return false;
+    }
+    data->array.only_numbers = data->array.only_numbers && object_is_unboxed_number(val);
+    data->array.only_doubles = data->array.only_doubles && object_is_number(val);
+    return array_push_front(data->array.items, &val);
 }
 
 int object_get_array_length(object_t object) {
@@ -909,35 +1288,253 @@ int object_get_array_length(object_t object) {
     return array_count(array);
 }
 
-APE_INTERNAL bool object_remove_array_value_at(object_t object, int ix) {
+object_t* object_get_array_data(object_t object) {
+    APE_ASSERT(object_get_type(object) == OBJECT_ARRAY);
     array(object_t)* array = object_get_allocated_array(object);
-    return array_remove_at(array, ix);
+    return array_data(array);
+}
+
+bool object_array_has_only_numbers(object_t object) {
+    APE_ASSERT(object_get_type(object) == OBJECT_ARRAY);
+    object_data_t *data = object_get_allocated_data(object);
+    if (!data->array.only_numbers) {
+        // stores only ever clear the flag, e.g. array(n) filled with numbers later has to be rechecked
+        object_t *items = array_data(data->array.items);
+        int len = array_count(data->array.items);
+        for (int i = 0; i < len; i++) {
+            if (!object_is_unboxed_number(items[i])) {
+                return false;
+            }
+        }
+        data->array.only_numbers = true;
+    }
+    return true;
+}
+
+bool object_get_array_doubles(object_t object, double **out_doubles) {
+    APE_ASSERT(object_get_type(object) == OBJECT_ARRAY);
+    object_data_t *data = object_get_allocated_data(object);
+    object_t *items = array_data(data->array.items);
+    *out_doubles = NULL;
+    if (!data->array.only_doubles) {
+        int len = array_count(data->array.items);
+        for (int i = 0; i < len; i++) {
+            if (!object_is_number(items[i])) {
+                return false;
+            }
+        }
+        data->array.only_doubles = true;
+    }
+    // doubles are stored as they are (see object_make_number)
+    *out_doubles = (double*)items;
+    return true;
+}
+
+APE_INTERNAL bool object_remove_array_value_at(object_t object, int ix) {
+    object_data_t *data = object_get_allocated_data(object);
+    if (ix < 0 || ix >= array_count(data->array.items)) {
+        return false;
+    }
+    if (!object_array_make_unique(&data->array)) {
+        return false;
+    }
+    return array_remove_at(data->array.items, ix);
+}
+
+int object_get_range_length(object_t object) {
+    APE_ASSERT(object_get_type(object) == OBJECT_RANGE);
+    object_data_t *data = object_get_allocated_data(object);
+    return data->range.length;
+}
+
+int64_t object_count_range_values(int start, int end, int step) {
+    APE_ASSERT(step != 0);
+    int64_t span = step > 0 ? (int64_t)end - start : (int64_t)start - end;
+    int64_t abs_step = step > 0 ? step : -(int64_t)step;
+    return span > 0 ? (span + abs_step - 1) / abs_step : 0;
+}
+
+object_t object_get_range_value_at(object_t object, int ix) {
+    APE_ASSERT(object_get_type(object) == OBJECT_RANGE);
+    object_data_t *data = object_get_allocated_data(object);
+    if (ix < 0 || ix >= data->range.length) {
+        return object_make_null();
+    }
+    return object_make_small_int((int64_t)data->range.start + (int64_t)ix * data->range.step);
+}
+
+int object_get_typed_array_length(object_t object) {
+    APE_ASSERT(object_get_type(object) == OBJECT_TYPED_ARRAY);
+    object_data_t *data = object_get_allocated_data(object);
+    return data->typed_array.length;
+}
+
+typed_array_type_t object_get_typed_array_type(object_t object) {
+    APE_ASSERT(object_get_type(object) == OBJECT_TYPED_ARRAY);
+    object_data_t *data = object_get_allocated_data(object);
+    return data->typed_array.type;
+}
+
+void* object_get_typed_array_data(object_t object) {
+    APE_ASSERT(object_get_type(object) == OBJECT_TYPED_ARRAY);
+    object_data_t *data = object_get_allocated_data(object);
+    return data->typed_array.data;
+}
+
+object_t object_get_typed_array_value_at(object_t object, int ix) {
+    APE_ASSERT(object_get_type(object) == OBJECT_TYPED_ARRAY);
+    object_typed_array_t *typed_array = &object_get_allocated_data(object)->typed_array;
+    if (ix < 0 || ix >= typed_array->length) {
+        return object_make_null();
+    }
+    switch (typed_array->type) {
+        case TYPED_ARRAY_U8:  return object_make_small_int(((uint8_t*)typed_array->data)[ix]);
+        case TYPED_ARRAY_I32: return object_make_small_int(((int32_t*)typed_array->data)[ix]);
+        case TYPED_ARRAY_I64: return object_make_int(object_get_mem(object), ((int64_t*)typed_array->data)[ix]);
+        case TYPED_ARRAY_F32: return object_make_number(((float*)typed_array->data)[ix]);
+        case TYPED_ARRAY_F64: return object_make_number(((double*)typed_array->data)[ix]);
+    }
+    return object_make_null();
+}
+
+// Integer stores truncate towards zero and wrap around to the element size (see ape_double_to_int64)
+bool object_set_typed_array_value_at(object_t object, int ix, object_t val) {
+    APE_ASSERT(object_get_type(object) == OBJECT_TYPED_ARRAY);
+    object_typed_array_t *typed_array = &object_get_allocated_data(object)->typed_array;
+    if (ix < 0 || ix >= typed_array->length) {
+        return false;
+    }
+    switch (typed_array->type) {
+        case TYPED_ARRAY_U8:  ((uint8_t*)typed_array->data)[ix] = (uint8_t)object_get_int(val); break;
+        case TYPED_ARRAY_I32: ((int32_t*)typed_array->data)[ix] = (int32_t)(uint32_t)object_get_int(val); break;
+        case TYPED_ARRAY_I64: ((int64_t*)typed_array->data)[ix] = object_get_int(val); break;
+        case TYPED_ARRAY_F32: ((float*)typed_array->data)[ix] = (float)object_get_number(val); break;
+        case TYPED_ARRAY_F64: ((double*)typed_array->data)[ix] = object_get_number(val); break;
+    }
+    return true;
+}
+
+int typed_array_type_get_size(typed_array_type_t type) {
+    switch (type) {
+        case TYPED_ARRAY_U8:  return sizeof(uint8_t);
+        case TYPED_ARRAY_I32: return sizeof(int32_t);
+        case TYPED_ARRAY_I64: return sizeof(int64_t);
+        case TYPED_ARRAY_F32: return sizeof(float);
+        case TYPED_ARRAY_F64: return sizeof(double);
+    }
+    return 0;
+}
+
+const char* typed_array_type_get_name(typed_array_type_t type) {
+    switch (type) {
+        case TYPED_ARRAY_U8:  return "u8";
+        case TYPED_ARRAY_I32: return "i32";
+        case TYPED_ARRAY_I64: return "i64";
+        case TYPED_ARRAY_F32: return "f32";
+        case TYPED_ARRAY_F64: return "f64";
+    }
+    return "";
+}
+
+const char* object_get_struct_type_name(object_t object) {
+    APE_ASSERT(object_get_type(object) == OBJECT_STRUCT_TYPE);
+    object_data_t *data = object_get_allocated_data(object);
+    return data->struct_type.name;
+}
+
+int object_get_struct_type_fields_count(object_t object) {
+    APE_ASSERT(object_get_type(object) == OBJECT_STRUCT_TYPE);
+    object_data_t *data = object_get_allocated_data(object);
+    return data->struct_type.fields_count;
+}
+
+object_t object_get_struct_type_field_name(object_t object, int ix) {
+    APE_ASSERT(object_get_type(object) == OBJECT_STRUCT_TYPE);
+    object_data_t *data = object_get_allocated_data(object);
+    if (ix < 0 || ix >= data->struct_type.fields_count) {
+        return object_make_null();
+    }
+    return data->struct_type.field_names[ix];
+}
+
+int object_get_struct_type_field_ix(object_t object, object_t name) {
+    APE_ASSERT(object_get_type(object) == OBJECT_STRUCT_TYPE);
+    object_data_t *data = object_get_allocated_data(object);
+    object_struct_type_t *struct_type = &data->struct_type;
+    // names compiled in the same file share constants with the declaration so comparing handles is usually enough
+    for (int i = 0; i < struct_type->fields_count; i++) {
+        if (struct_type->field_names[i].handle == name.handle) {
+            return i;
+        }
+    }
+    if (object_get_type(name) != OBJECT_STRING) {
+        return -1;
+    }
+    for (int i = 0; i < struct_type->fields_count; i++) {
+        if (object_equals(struct_type->field_names[i], name)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+object_t object_get_struct_type_operator(object_t object, int op) {
+    APE_ASSERT(object_get_type(object) == OBJECT_STRUCT_TYPE);
+    object_data_t *data = object_get_allocated_data(object);
+    if (op < 0 || op >= data->struct_type.operators_count) {
+        return object_make_null();
+    }
+    return data->struct_type.operators[op];
+}
+
+bool object_set_struct_type_operator(object_t object, int op, object_t fn) {
+    APE_ASSERT(object_get_type(object) == OBJECT_STRUCT_TYPE);
+    object_data_t *data = object_get_allocated_data(object);
+    if (op < 0 || op >= data->struct_type.operators_count) {
+        return false;
+    }
+    data->struct_type.operators[op] = fn;
+    return true;
+}
+
+object_t object_get_struct_type(object_t object) {
+    APE_ASSERT(object_get_type(object) == OBJECT_STRUCT);
+    object_data_t *data = object_get_allocated_data(object);
+    return data->struct_obj.type;
+}
+
+object_t* object_get_struct_fields(object_t object) {
+    APE_ASSERT(object_get_type(object) == OBJECT_STRUCT);
+    object_data_t *data = object_get_allocated_data(object);
+    if (struct_fields_are_allocated(&data->struct_obj)) {
+        return data->struct_obj.fields_allocated;
+    } else {
+        return data->struct_obj.fields_buf;
+    }
 }
 
 int object_get_map_length(object_t object) {
     APE_ASSERT(object_get_type(object) == OBJECT_MAP);
     object_data_t *data = object_get_allocated_data(object);
-    return valdict_count(data->map);
+    return objmap_count(&data->map);
 }
 
 object_t object_get_map_key_at(object_t object, int ix) {
     APE_ASSERT(object_get_type(object) == OBJECT_MAP);
     object_data_t *data = object_get_allocated_data(object);
-    object_t *res = valdict_get_key_at(data->map, ix);
-    if (!res) {
+    if (ix < 0) {
         return object_make_null();
     }
-    return *res;
+    return objmap_get_key_at(&data->map, ix);
 }
 
 object_t object_get_map_value_at(object_t object, int ix) {
     APE_ASSERT(object_get_type(object) == OBJECT_MAP);
     object_data_t *data = object_get_allocated_data(object);
-    object_t *res = valdict_get_value_at(data->map, ix);
-    if (!res) {
+    if (ix < 0) {
         return object_make_null();
     }
-    return *res;
+    return objmap_get_value_at(&data->map, ix);
 }
 
 bool object_set_map_value_at(object_t object, int ix, object_t val) {
@@ -946,13 +1543,13 @@ bool object_set_map_value_at(object_t object, int ix, object_t val) {
         return false;
     }
     object_data_t *data = object_get_allocated_data(object);
-    return valdict_set_value_at(data->map, ix, &val);
+    return objmap_set_value_at(&data->map, ix, val);
 }
 
 object_t object_get_kv_pair_at(gcmem_t *mem, object_t object, int ix) {
     APE_ASSERT(object_get_type(object) == OBJECT_MAP);
     object_data_t *data = object_get_allocated_data(object);
-    if (ix >= valdict_count(data->map)) {
+    if (ix >= objmap_count(&data->map)) {
         return object_make_null();
     }
     object_t key = object_get_map_key_at(object, ix);
@@ -980,13 +1577,13 @@ object_t object_get_kv_pair_at(gcmem_t *mem, object_t object, int ix) {
 bool object_set_map_value(object_t object, object_t key, object_t val) {
     APE_ASSERT(object_get_type(object) == OBJECT_MAP);
     object_data_t *data = object_get_allocated_data(object);
-    return valdict_set(data->map, &key, &val);
+    return objmap_set(&data->map, key, val);
 }
 
 object_t object_get_map_value(object_t object, object_t key) {
     APE_ASSERT(object_get_type(object) == OBJECT_MAP);
     object_data_t *data = object_get_allocated_data(object);
-    object_t *res = valdict_get(data->map, &key);
+    object_t *res = objmap_get(&data->map, key);
     if (!res) {
         return object_make_null();
     }
@@ -996,8 +1593,46 @@ object_t object_get_map_value(object_t object, object_t key) {
 bool object_map_has_key(object_t object, object_t key) {
     APE_ASSERT(object_get_type(object) == OBJECT_MAP);
     object_data_t *data = object_get_allocated_data(object);
-    object_t *res = valdict_get(data->map, &key);
-    return res != NULL;
+    return objmap_has(&data->map, key);
+}
+
+bool object_remove_map_value(object_t object, object_t key) {
+    APE_ASSERT(object_get_type(object) == OBJECT_MAP);
+    object_data_t *data = object_get_allocated_data(object);
+    return objmap_remove(&data->map, key);
+}
+
+int object_get_set_length(object_t object) {
+    APE_ASSERT(object_get_type(object) == OBJECT_SET);
+    object_data_t *data = object_get_allocated_data(object);
+    return objmap_count(&data->set);
+}
+
+object_t object_get_set_value_at(object_t object, int ix) {
+    APE_ASSERT(object_get_type(object) == OBJECT_SET);
+    object_data_t *data = object_get_allocated_data(object);
+    if (ix < 0) {
+        return object_make_null();
+    }
+    return objmap_get_key_at(&data->set, ix);
+}
+
+bool object_set_add(object_t object, object_t val) {
+    APE_ASSERT(object_get_type(object) == OBJECT_SET);
+    object_data_t *data = object_get_allocated_data(object);
+    return objmap_set(&data->set, val, object_make_null());
+}
+
+bool object_set_has(object_t object, object_t val) {
+    APE_ASSERT(object_get_type(object) == OBJECT_SET);
+    object_data_t *data = object_get_allocated_data(object);
+    return objmap_has(&data->set, val);
+}
+
+bool object_set_remove(object_t object, object_t val) {
+    APE_ASSERT(object_get_type(object) == OBJECT_SET);
+    object_data_t *data = object_get_allocated_data(object);
+    return objmap_remove(&data->set, val);
 }
 
 // INTERNAL
@@ -1089,6 +1724,13 @@ static object_t object_deep_copy_internal(gcmem_t *mem, object_t obj, valdict(ob
         }
         case OBJECT_ARRAY: {
             int len = object_get_array_length(obj);
+            if (object_items_are_immutable(object_get_array_data(obj), len)) {
+                copy = object_copy(mem, obj);
+                if (object_is_null(copy) || !valdict_set(copies, &obj, &copy)) {
+                    return object_make_null();
+                }
+                break;
+            }
             copy = object_make_array_with_capacity(mem, len);
             if (object_is_null(copy)) {
                 return object_make_null();
@@ -1111,7 +1753,16 @@ static object_t object_deep_copy_internal(gcmem_t *mem, object_t obj, valdict(ob
             break;
         }
         case OBJECT_MAP: {
-            copy = object_make_map(mem);
+            // keys are always immutable
+            object_data_t *data = object_get_allocated_data(obj);
+            if (object_items_are_immutable(objmap_get_values(&data->map), objmap_get_slots_count(&data->map))) {
+                copy = object_copy(mem, obj);
+                if (object_is_null(copy) || !valdict_set(copies, &obj, &copy)) {
+                    return object_make_null();
+                }
+                break;
+            }
+            copy = object_make_map_with_capacity(mem, object_get_map_length(obj));
             if (object_is_null(copy)) {
                 return object_make_null();
             }
@@ -1140,10 +1791,41 @@ static object_t object_deep_copy_internal(gcmem_t *mem, object_t obj, valdict(ob
             }
             break;
         }
-        case OBJECT_EXTERNAL: {
+        case OBJECT_SET: {
+            // sets only hold immutable values
+            copy = object_copy(mem, obj);
+            if (object_is_null(copy) || !valdict_set(copies, &obj, &copy)) {
+                return object_make_null();
+            }
+            break;
+        }
+        case OBJECT_STRUCT: {
+            object_t struct_type = object_get_struct_type(obj);
+            copy = object_make_struct(mem, struct_type);
+            if (object_is_null(copy)) {
+                return object_make_null();
+            }
+            bool ok = valdict_set(copies, &obj, &copy);
+            if (!ok) {
+                return object_make_null();
+            }
+            for (int i = 0; i < object_get_struct_type_fields_count(struct_type); i++) {
+                object_t field = object_get_struct_fields(obj)[i];
+                object_t field_copy = object_deep_copy_internal(mem, field, copies);
+                if (!object_is_null(field) && object_is_null(field_copy)) {
+                    return object_make_null();
+                }
+                object_get_struct_fields(copy)[i] = field_copy;
+            }
+            break;
+        }
+        case OBJECT_EXTERNAL:
+        case OBJECT_TYPED_ARRAY: {
             copy = object_copy(mem, obj);
             break;
         }
+        case OBJECT_RANGE:
+        case OBJECT_STRUCT_TYPE:
         case OBJECT_ERROR: {
             copy = obj;
             break;
@@ -1152,35 +1834,6 @@ static object_t object_deep_copy_internal(gcmem_t *mem, object_t obj, valdict(ob
     return copy;
 }
 
-
-static bool object_equals_wrapped(const object_t *a_ptr, const object_t *b_ptr) {
-    object_t a = *a_ptr;
-    object_t b = *b_ptr;
-    return object_equals(a, b);
-}
-
-static unsigned long object_hash(object_t *obj_ptr) {
-    object_t obj = *obj_ptr;
-    object_type_t type = object_get_type(obj);
-
-    switch (type) {
-        case OBJECT_NUMBER: {
-            double val = object_get_number(obj);
-            return object_hash_double(val);
-        }
-        case OBJECT_BOOL: {
-            bool val = object_get_bool(obj);
-            return val;
-        }
-        case OBJECT_STRING: {
-            return object_get_string_hash(obj);
-        }
-        default: {
-            return 0;
-        }
-    }
-}
-
 static unsigned long object_hash_string(const char *str) { /* djb2 */
     unsigned long hash = 5381;
     int c;
@@ -1190,24 +1843,65 @@ static unsigned long object_hash_string(const char *str) { /* djb2 */
     return hash;
 }
 
-static unsigned long object_hash_double(double val) { /* djb2 */
-    uint32_t *val_ptr = (uint32_t*)&val;
-    unsigned long hash = 5381;
-    hash = ((hash << 5) + hash) + val_ptr[0];
-    hash = ((hash << 5) + hash) + val_ptr[1];
-    return hash;
+static bool object_array_make_unique(object_array_t *array) {
+    if (!array->items_shared) {
+        return true;
+    }
+    if (array_is_shared(array->items)) {
+        array(object_t) *items_copy = array_copy(array->items);
+        if (!items_copy) {
+            return false;
+        }
+        array_destroy(array->items); // drops this array's reference
+        array->items = items_copy;
+    }
+    array->items_shared = false;
+    return true;
+}
+
+// values that deep_copy can share between the original and the copy, strings can't be modified by scripts
+static bool object_items_are_immutable(object_t *items, int count) {
+    for (int i = 0; i < count; i++) {
+        object_type_t type = object_get_type(items[i]);
+        if (type != OBJECT_NUMBER && type != OBJECT_BOOL && type != OBJECT_NULL && type != OBJECT_STRING) {
+            return false;
+        }
+    }
+    return true;
 }
 
 array(object_t)* object_get_allocated_array(object_t object) {
     APE_ASSERT(object_get_type(object) == OBJECT_ARRAY);
     object_data_t *data = object_get_allocated_data(object);
-    return data->array;
+    return data->array.items;
+}
+
+static double compare_int_to_double(int64_t a, double b) {
+    if (b != b) {
+        return NAN; // never equal, like comparing doubles with NaN
+    }
+    if (b >= 9223372036854775807.0) {
+        return -1;
+    }
+    if (b < -9223372036854775808.0) {
+        return 1;
+    }
+    int64_t b_int = (int64_t)b;
+    if (a != b_int) {
+        return a < b_int ? -1 : 1;
+    }
+    double b_frac = b - (double)b_int;
+    return b_frac > 0 ? -1 : (b_frac < 0 ? 1 : 0);
 }
 
 static bool object_is_number(object_t o) {
     return (o.handle & OBJECT_PATTERN) != OBJECT_PATTERN;
 }
 
+static bool object_is_unboxed_number(object_t o) {
+    return object_is_number(o) || object_is_small_int(o);
+}
+
 static uint64_t get_type_tag(object_type_t type) {
     switch (type) {
         case OBJECT_NONE: return 0;
@@ -1221,6 +1915,10 @@ static bool freevals_are_allocated(function_t *fun) {
     return fun->free_vals_count >= APE_ARRAY_LEN(fun->free_vals_buf);
 }
 
+static bool struct_fields_are_allocated(object_struct_t *obj) {
+    return obj->fields_count > OBJECT_STRUCT_BUF_SIZE;
+}
+
 static char *object_data_get_string(object_data_t *data) {
     APE_ASSERT(data->type == OBJECT_STRING);
     if (data->string.is_allocated) {
@@ -7,6 +7,7 @@
 #include "common.h"
 #include "collections.h"
 #include "ast.h"
+#include "objmap.h"
 #endif
 
 typedef struct compilation_result compilation_result_t;
@@ -29,9 +30,16 @@ typedef enum {
     OBJECT_FUNCTION  = 1 << 8,
     OBJECT_EXTERNAL  = 1 << 9,
     OBJECT_FREED     = 1 << 10,
+    OBJECT_RANGE     = 1 << 11,
+    OBJECT_TYPED_ARRAY = 1 << 12,
+    OBJECT_STRUCT    = 1 << 13,
+    OBJECT_STRUCT_TYPE = 1 << 14,
+    OBJECT_SET       = 1 << 15,
     OBJECT_ANY       = 0xffff,
 } object_type_t;
 
+// Numbers are stored either as doubles or as ints. Ints that fit in 48 bits live in the handle,
+// bigger ones are boxed (allocated with type OBJECT_NUMBER). Both report OBJECT_NUMBER as their type.
 typedef struct object {
     union {
         uint64_t handle;
@@ -39,6 +47,28 @@ typedef struct object {
     };
 } object_t;
 
+#define OBJECT_SMALL_INT_HEADER 0xfffb000000000000
+#define OBJECT_SMALL_INT_MIN    (-(INT64_C(1) << 47)) // smallest and largest ints stored in the handle
+#define OBJECT_SMALL_INT_MAX    ((INT64_C(1) << 47) - 1)
+
+// Inline checks for the vm's arithmetic fast paths, everything else goes through object_get_type.
+static inline bool object_is_double(object_t obj) {
+    return (obj.handle & 0xfff8000000000000) != 0xfff8000000000000;
+}
+
+static inline bool object_is_small_int(object_t obj) {
+    return (obj.handle & 0xffff000000000000) == OBJECT_SMALL_INT_HEADER;
+}
+
+static inline int64_t object_get_small_int(object_t obj) {
+    return (int64_t)(obj.handle << 16) >> 16; // sign extends the 48 bit payload
+}
+
+static inline object_t object_make_small_int(int64_t val) {
+    APE_ASSERT(val >= OBJECT_SMALL_INT_MIN && val <= OBJECT_SMALL_INT_MAX);
+    return (object_t) { .handle = OBJECT_SMALL_INT_HEADER | ((uint64_t)val & 0x0000ffffffffffff) };
+}
+
 typedef struct function {
     union {
         object_t *free_vals_allocated;
@@ -90,23 +120,85 @@ typedef struct object_string {
     int length;
 } object_string_t;
 
+// Lazy arithmetic sequence returned by range(), values are computed on access
+typedef struct object_range {
+    int start;
+    int step;
+    int length;
+} object_range_t;
+
+typedef struct object_array {
+    array(object_t) *items;
+    bool only_numbers; // known to hold only doubles and ints stored in the handle, items can be read without type lookups
+    bool only_doubles; // known to hold only doubles, items can be read as a double array
+    bool items_shared; // items may be shared with copies (see object_copy) and have to be copied before writing
+} object_array_t;
+
+typedef enum {
+    TYPED_ARRAY_U8,
+    TYPED_ARRAY_I32,
+    TYPED_ARRAY_I64,
+    TYPED_ARRAY_F32,
+    TYPED_ARRAY_F64,
+} typed_array_type_t;
+
+// Fixed length buffer of native numbers, either owned or shared with the host (owns_data == false)
+typedef struct object_typed_array {
+    void *data;
+    int length;
+    typed_array_type_t type;
+    bool owns_data;
+    external_data_destroy_fn data_destroy_fn; // called on shared data when the object is freed, may be NULL
+} object_typed_array_t;
+
+// Declared by a struct statement, holds the field layout and operator overloads shared by all instances
+typedef struct object_struct_type {
+    char *name;
+    object_t *field_names;
+    object_t *operators; // indexed by opcode, NULL if the struct doesn't overload any operators
+    int fields_count;
+    int operators_count;
+} object_struct_type_t;
+
+#define OBJECT_STRUCT_BUF_SIZE 4
+
+typedef struct object_struct {
+    object_t type;
+    union {
+        object_t *fields_allocated;
+        object_t fields_buf[OBJECT_STRUCT_BUF_SIZE];
+    };
+    int fields_count;
+} object_struct_t;
+
 typedef struct object_data {
     gcmem_t *mem;
     union {
         object_string_t string;
         object_error_t error;
-        array(object_t) *array;
-        valdict(object_t, object_t) *map;
+        object_array_t array;
+        objmap_t map;
+        objmap_t set; // keys only
         function_t function;
         native_function_t native_function;
         external_data_t external;
+        object_range_t range;
+        object_typed_array_t typed_array;
+        object_struct_type_t struct_type;
+        object_struct_t struct_obj;
+        int64_t boxed_int;
     };
     bool gcmark;
     object_type_t type;
 } object_data_t;
 
 APE_INTERNAL object_t object_make_from_data(object_type_t type, object_data_t *data);
+// Copies of string and function constants that don't belong to any gcmem, so that many ape instances can share them.
+// They're never modified, gcmark is always set so marking them is a no-op.
+APE_INTERNAL object_t object_make_static_copy(allocator_t *alloc, object_t obj);
+APE_INTERNAL void     object_destroy_static_copy(allocator_t *alloc, object_t obj);
 APE_INTERNAL object_t object_make_number(double val);
+APE_INTERNAL object_t object_make_int(gcmem_t *mem, int64_t val); // allocates only if val doesn't fit in 48 bits
 APE_INTERNAL object_t object_make_bool(bool val);
 APE_INTERNAL object_t object_make_null(void);
 APE_INTERNAL object_t object_make_string(gcmem_t *mem, const char *string);
@@ -116,6 +208,7 @@ APE_INTERNAL object_t object_make_array(gcmem_t *mem);
 APE_INTERNAL object_t object_make_array_with_capacity(gcmem_t *mem, unsigned capacity);
 APE_INTERNAL object_t object_make_map(gcmem_t *mem);
 APE_INTERNAL object_t object_make_map_with_capacity(gcmem_t *mem, unsigned capacity);
+APE_INTERNAL object_t object_make_set(gcmem_t *mem, unsigned capacity);
 APE_INTERNAL object_t object_make_error(gcmem_t *mem, const char *message);
 APE_INTERNAL object_t object_make_error_no_copy(gcmem_t *mem, char *message);
 APE_INTERNAL object_t object_make_errorf(gcmem_t *mem, const char *fmt, ...) __attribute__ ((format (printf, 2, 3)));
@@ -123,6 +216,13 @@ APE_INTERNAL object_t object_make_function(gcmem_t *mem, const char *name, compi
                                            bool owns_data, int num_locals, int num_args,
                                            int free_vals_count);
 APE_INTERNAL object_t object_make_external(gcmem_t *mem, void *data);
+APE_INTERNAL object_t object_make_range(gcmem_t *mem, int start, int end, int step); // length has to fit in an int
+APE_INTERNAL object_t object_make_typed_array(gcmem_t *mem, typed_array_type_t type, int length);
+APE_INTERNAL object_t object_make_typed_array_with_data(gcmem_t *mem, typed_array_type_t type, void *data, int length,
+                                                        external_data_destroy_fn destroy_fn);
+APE_INTERNAL object_t object_make_struct_type(gcmem_t *mem, const char *name, object_t *field_names, int fields_count,
+                                              int operators_count);
+APE_INTERNAL object_t object_make_struct(gcmem_t *mem, object_t struct_type); // fields are set to null
 
 APE_INTERNAL void object_deinit(object_t obj);
 APE_INTERNAL void object_data_deinit(object_data_t *obj);
@@ -143,6 +243,7 @@ APE_INTERNAL object_data_t* object_get_allocated_data(object_t object);
 
 APE_INTERNAL bool           object_get_bool(object_t obj);
 APE_INTERNAL double         object_get_number(object_t obj);
+APE_INTERNAL int64_t        object_get_int(object_t obj); // doubles are converted with ape_double_to_int64
 APE_INTERNAL function_t*    object_get_function(object_t obj);
 APE_INTERNAL const char*    object_get_string(object_t obj);
 APE_INTERNAL int            object_get_string_length(object_t obj);
@@ -155,6 +256,7 @@ APE_INTERNAL native_function_t* object_get_native_function(object_t obj);
 APE_INTERNAL object_type_t  object_get_type(object_t obj);
 
 APE_INTERNAL bool object_is_numeric(object_t obj);
+APE_INTERNAL bool object_is_int(object_t obj);
 APE_INTERNAL bool object_is_null(object_t obj);
 APE_INTERNAL bool object_is_callable(object_t obj);
 
@@ -175,9 +277,35 @@ APE_INTERNAL bool object_set_external_copy_function(object_t object, external_da
 APE_INTERNAL object_t object_get_array_value_at(object_t array, int ix);
 APE_INTERNAL bool     object_set_array_value_at(object_t obj, int ix, object_t val);
 APE_INTERNAL bool     object_add_array_value(object_t array, object_t val);
+APE_INTERNAL bool     object_add_array_value_front(object_t array, object_t val); // amortised O(1), like removing at 0
 APE_INTERNAL int      object_get_array_length(object_t array);
+APE_INTERNAL object_t* object_get_array_data(object_t array); // read only, invalidated by adding or removing values
+APE_INTERNAL bool     object_array_has_only_numbers(object_t array); // doubles and ints stored in the handle, boxed ints aren't counted
+APE_INTERNAL bool     object_get_array_doubles(object_t array, double **out_doubles); // false if any item isn't a double, shares storage with object_get_array_data
 APE_INTERNAL bool     object_remove_array_value_at(object_t array, int ix);
 
+APE_INTERNAL int      object_get_range_length(object_t range);
+APE_INTERNAL int64_t  object_count_range_values(int start, int end, int step); // can be more than INT_MAX
+APE_INTERNAL object_t object_get_range_value_at(object_t range, int ix);
+
+APE_INTERNAL int                object_get_typed_array_length(object_t typed_array);
+APE_INTERNAL typed_array_type_t object_get_typed_array_type(object_t typed_array);
+APE_INTERNAL void*              object_get_typed_array_data(object_t typed_array);
+APE_INTERNAL object_t           object_get_typed_array_value_at(object_t typed_array, int ix);
+APE_INTERNAL bool               object_set_typed_array_value_at(object_t typed_array, int ix, object_t val);
+
+APE_INTERNAL int         typed_array_type_get_size(typed_array_type_t type);
+APE_INTERNAL const char* typed_array_type_get_name(typed_array_type_t type);
+
+APE_INTERNAL const char* object_get_struct_type_name(object_t struct_type);
+APE_INTERNAL int         object_get_struct_type_fields_count(object_t struct_type);
+APE_INTERNAL object_t    object_get_struct_type_field_name(object_t struct_type, int ix);
+APE_INTERNAL int         object_get_struct_type_field_ix(object_t struct_type, object_t name); // -1 if there's no such field
+APE_INTERNAL object_t    object_get_struct_type_operator(object_t struct_type, int op);
+APE_INTERNAL bool        object_set_struct_type_operator(object_t struct_type, int op, object_t fn);
+APE_INTERNAL object_t    object_get_struct_type(object_t obj);
+APE_INTERNAL object_t*   object_get_struct_fields(object_t obj);
+
 APE_INTERNAL int      object_get_map_length(object_t obj);
 APE_INTERNAL object_t object_get_map_key_at(object_t obj, int ix);
 APE_INTERNAL object_t object_get_map_value_at(object_t obj, int ix);
@@ -186,5 +314,12 @@ APE_INTERNAL object_t object_get_kv_pair_at(gcmem_t *mem, object_t obj, int ix);
 APE_INTERNAL bool     object_set_map_value(object_t obj, object_t key, object_t val);
 APE_INTERNAL object_t object_get_map_value(object_t obj, object_t key);
 APE_INTERNAL bool     object_map_has_key(object_t obj, object_t key);
+APE_INTERNAL bool     object_remove_map_value(object_t obj, object_t key); // keeps the order of the other keys
+
+APE_INTERNAL int      object_get_set_length(object_t set);
+APE_INTERNAL object_t object_get_set_value_at(object_t set, int ix); // in insertion order
+APE_INTERNAL bool     object_set_add(object_t set, object_t val);
+APE_INTERNAL bool     object_set_has(object_t set, object_t val);
+APE_INTERNAL bool     object_set_remove(object_t set, object_t val);
 
 #endif /* object_h */
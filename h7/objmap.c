@@ -0,0 +1,448 @@
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef APE_AMALGAMATED
+#include "objmap.h"
+#include "object.h"
+#endif
+
+#define OBJMAP_INITIAL_CAPACITY 4
+#define OBJMAP_MAX_SMALL_CAPACITY 8 // small maps have no cells and are searched linearly by hash
+#define OBJMAP_INVALID_IX UINT32_MAX
+#define OBJMAP_REMOVED_IX (UINT32_MAX - 1) // tombstone, probing continues past it
+
+static bool     objmap_resize(objmap_t *map, unsigned int item_capacity);
+static bool     objmap_compact(objmap_t *map);
+static void     objmap_fill_cells(objmap_t *map);
+static size_t   objmap_get_block_size(bool keys_only, unsigned int item_capacity, unsigned int cell_capacity);
+static unsigned int objmap_get_cell_capacity(const objmap_t *map);
+static uint32_t* objmap_get_refcount(const objmap_t *map);
+static bool     objmap_ensure_unique(objmap_t *map);
+static void     objmap_release_block(objmap_t *map);
+static uint32_t objmap_find_item(const objmap_t *map, object_t key);
+static uint32_t objmap_find_small(const objmap_t *map, object_t key, uint32_t hash);
+static uint32_t objmap_get_cell_ix(const objmap_t *map, object_t key, uint32_t hash, bool *out_found);
+static uint32_t objmap_hash(object_t key);
+static bool     objmap_keys_are_equal(object_t a, object_t b);
+
+bool objmap_init(objmap_t *map, allocator_t *alloc, unsigned int min_capacity) {
+    memset(map, 0, sizeof(objmap_t));
+    map->alloc = alloc;
+    if (min_capacity == 0) {
+        return true;
+    }
+    return objmap_resize(map, min_capacity);
+}
+
+bool objmap_init_keys_only(objmap_t *map, allocator_t *alloc, unsigned int min_capacity) {
+    memset(map, 0, sizeof(objmap_t));
+    map->alloc = alloc;
+    map->keys_only = true;
+    if (min_capacity == 0) {
+        return true;
+    }
+    return objmap_resize(map, min_capacity);
+}
+
+bool objmap_init_shared(objmap_t *map, const objmap_t *src) {
+    *map = *src;
+    if (map->keys) {
+        (*objmap_get_refcount(map))++;
+    }
+    return true;
+}
+
+void objmap_deinit(objmap_t *map) {
+    objmap_release_block(map);
+    map->keys = NULL;
+    map->hashes = NULL;
+    map->cells = NULL;
+    map->count = 0;
+    map->removed_count = 0;
+    map->item_capacity = 0;
+}
+
+bool objmap_set(objmap_t *map, object_t key, object_t val) {
+    if (!objmap_ensure_unique(map)) {
+        return false;
+    }
+    if (map->item_capacity == 0) {
+        bool ok = objmap_resize(map, OBJMAP_INITIAL_CAPACITY);
+        if (!ok) {
+            return false;
+        }
+    }
+    object_t *values = objmap_get_values(map);
+    uint32_t hash = objmap_hash(key);
+    bool found = false;
+    uint32_t cell_ix = OBJMAP_INVALID_IX;
+    if (map->cells) {
+        cell_ix = objmap_get_cell_ix(map, key, hash, &found);
+        if (found) {
+            if (values) {
+                values[map->cells[cell_ix]] = val;
+            }
+            return true;
+        }
+    } else {
+        uint32_t item_ix = objmap_find_small(map, key, hash);
+        if (item_ix != OBJMAP_INVALID_IX) {
+            if (values) {
+                values[item_ix] = val;
+            }
+            return true;
+        }
+    }
+    unsigned int slots_count = map->count + map->removed_count;
+    if (slots_count >= map->item_capacity) {
+        // reuses removed slots if there's enough of them, growing would leave them in place
+        bool ok = map->removed_count * 2 >= slots_count ? objmap_compact(map)
+                                                         : objmap_resize(map, map->item_capacity * 2);
+        if (!ok) {
+            return false;
+        }
+        values = objmap_get_values(map);
+        if (map->cells) {
+            cell_ix = objmap_get_cell_ix(map, key, hash, &found);
+        }
+    }
+    unsigned int ix = map->count + map->removed_count;
+    map->count++;
+    map->keys[ix] = key;
+    if (values) {
+        values[ix] = val;
+    }
+    map->hashes[ix] = hash;
+    if (map->cells) {
+        map->cells[cell_ix] = ix;
+    }
+    return true;
+}
+
+object_t* objmap_get(const objmap_t *map, object_t key) {
+    APE_ASSERT(!map->keys_only);
+    uint32_t item_ix = objmap_find_item(map, key);
+    if (item_ix == OBJMAP_INVALID_IX) {
+        return NULL;
+    }
+    return &objmap_get_values(map)[item_ix];
+}
+
+bool objmap_has(const objmap_t *map, object_t key) {
+    return objmap_find_item(map, key) != OBJMAP_INVALID_IX;
+}
+
+bool objmap_remove(objmap_t *map, object_t key) {
+    if (map->count == 0) {
+        return false;
+    }
+    if (objmap_is_shared(map) && !objmap_has(map, key)) {
+        return false;
+    }
+    if (!objmap_ensure_unique(map)) {
+        return false;
+    }
+    object_t *values = objmap_get_values(map);
+    uint32_t hash = objmap_hash(key);
+    if (!map->cells) {
+        // small maps never have removed slots, the few items after the removed one are moved instead
+        uint32_t item_ix = objmap_find_small(map, key, hash);
+        if (item_ix == OBJMAP_INVALID_IX) {
+            return false;
+        }
+        unsigned int to_move = map->count - item_ix - 1;
+        memmove(map->keys + item_ix, map->keys + item_ix + 1, to_move * sizeof(object_t));
+        if (values) {
+            memmove(values + item_ix, values + item_ix + 1, to_move * sizeof(object_t));
+        }
+        memmove(map->hashes + item_ix, map->hashes + item_ix + 1, to_move * sizeof(uint32_t));
+        map->count--;
+        return true;
+    }
+    bool found = false;
+    uint32_t cell_ix = objmap_get_cell_ix(map, key, hash, &found);
+    if (!found) {
+        return false;
+    }
+    uint32_t item_ix = map->cells[cell_ix];
+    map->cells[cell_ix] = OBJMAP_REMOVED_IX;
+    map->keys[item_ix] = object_make_null(); // null is never a key, so it marks removed slots
+    if (values) {
+        values[item_ix] = object_make_null();
+    }
+    map->count--;
+    map->removed_count++;
+    if (map->count == 0) {
+        objmap_clear(map);
+    }
+    return true;
+}
+
+void objmap_clear(objmap_t *map) {
+    if (objmap_is_shared(map)) {
+        objmap_deinit(map);
+        return;
+    }
+    map->count = 0;
+    map->removed_count = 0;
+    unsigned int cell_capacity = objmap_get_cell_capacity(map);
+    for (unsigned int i = 0; i < cell_capacity; i++) {
+        map->cells[i] = OBJMAP_INVALID_IX;
+    }
+}
+
+int objmap_count(const objmap_t *map) {
+    return map->count;
+}
+
+bool objmap_is_shared(const objmap_t *map) {
+    return map->keys && *objmap_get_refcount(map) > 1;
+}
+
+object_t objmap_get_key_at(objmap_t *map, unsigned int ix) {
+    if (ix >= map->count || (map->removed_count > 0 && !objmap_compact(map))) {
+        return object_make_null();
+    }
+    return map->keys[ix];
+}
+
+object_t objmap_get_value_at(objmap_t *map, unsigned int ix) {
+    if (ix >= map->count || map->keys_only || (map->removed_count > 0 && !objmap_compact(map))) {
+        return object_make_null();
+    }
+    return objmap_get_values(map)[ix];
+}
+
+bool objmap_set_value_at(objmap_t *map, unsigned int ix, object_t val) {
+    if (ix >= map->count || map->keys_only || !objmap_ensure_unique(map)) {
+        return false;
+    }
+    if (map->removed_count > 0 && !objmap_compact(map)) {
+        return false;
+    }
+    objmap_get_values(map)[ix] = val;
+    return true;
+}
+
+int objmap_get_slots_count(const objmap_t *map) {
+    return map->count + map->removed_count;
+}
+
+object_t* objmap_get_keys(const objmap_t *map) {
+    return map->keys;
+}
+
+object_t* objmap_get_values(const objmap_t *map) {
+    if (map->keys_only || !map->keys) {
+        return NULL;
+    }
+    // values follow the keys in the same block
+    return map->keys + map->item_capacity;
+}
+
+// INTERNAL
+static bool objmap_resize(objmap_t *map, unsigned int item_capacity) {
+    unsigned int capacity = 1;
+    while (capacity < item_capacity) {
+        capacity <<= 1;
+    }
+    item_capacity = capacity;
+    unsigned int cell_capacity = item_capacity > OBJMAP_MAX_SMALL_CAPACITY ? item_capacity * 2 : 0;
+    size_t objects_per_item = map->keys_only ? 1 : 2;
+    char *block = allocator_malloc(map->alloc, objmap_get_block_size(map->keys_only, item_capacity, cell_capacity));
+    if (!block) {
+        return false;
+    }
+    object_t *keys = (object_t*)block;
+    object_t *values = map->keys_only ? NULL : keys + item_capacity;
+    uint32_t *hashes = (uint32_t*)(keys + objects_per_item * item_capacity);
+    hashes[item_capacity + cell_capacity] = 1; // refcount
+
+    // removed slots are dropped
+    object_t *old_values = objmap_get_values(map);
+    unsigned int old_slots_count = map->count + map->removed_count;
+    unsigned int count = 0;
+    for (unsigned int i = 0; i < old_slots_count; i++) {
+        if (map->removed_count > 0 && object_is_null(map->keys[i])) {
+            continue;
+        }
+        keys[count] = map->keys[i];
+        if (values) {
+            values[count] = old_values[i];
+        }
+        hashes[count] = map->hashes[i];
+        count++;
+    }
+
+    objmap_release_block(map);
+    map->keys = keys;
+    map->hashes = hashes;
+    map->cells = cell_capacity > 0 ? hashes + item_capacity : NULL;
+    map->count = count;
+    map->removed_count = 0;
+    map->item_capacity = item_capacity;
+    objmap_fill_cells(map);
+    return true;
+}
+
+// moves items over removed slots, keeping their order, and rebuilds cells
+static bool objmap_compact(objmap_t *map) {
+    if (!objmap_ensure_unique(map)) {
+        return false;
+    }
+    object_t *values = objmap_get_values(map);
+    unsigned int slots_count = map->count + map->removed_count;
+    unsigned int count = 0;
+    for (unsigned int i = 0; i < slots_count; i++) {
+        if (object_is_null(map->keys[i])) {
+            continue;
+        }
+        map->keys[count] = map->keys[i];
+        if (values) {
+            values[count] = values[i];
+        }
+        map->hashes[count] = map->hashes[i];
+        count++;
+    }
+    APE_ASSERT(count == map->count);
+    map->removed_count = 0;
+    objmap_fill_cells(map);
+    return true;
+}
+
+static void objmap_fill_cells(objmap_t *map) {
+    unsigned int cell_capacity = objmap_get_cell_capacity(map);
+    if (cell_capacity == 0) {
+        return;
+    }
+    uint32_t *cells = map->cells;
+    for (unsigned int i = 0; i < cell_capacity; i++) {
+        cells[i] = OBJMAP_INVALID_IX;
+    }
+    uint32_t cell_mask = cell_capacity - 1;
+    for (unsigned int i = 0; i < map->count; i++) {
+        uint32_t cell_ix = map->hashes[i] & cell_mask;
+        while (cells[cell_ix] != OBJMAP_INVALID_IX) {
+            cell_ix = (cell_ix + 1) & cell_mask;
+        }
+        cells[cell_ix] = i;
+    }
+}
+
+// keys[item_capacity], values[item_capacity] (unless keys_only), hashes[item_capacity], cells[cell_capacity], refcount
+static size_t objmap_get_block_size(bool keys_only, unsigned int item_capacity, unsigned int cell_capacity) {
+    size_t objects_per_item = keys_only ? 1 : 2;
+    return item_capacity * (objects_per_item * sizeof(object_t) + sizeof(uint32_t))
+           + (cell_capacity + 1) * sizeof(uint32_t);
+}
+
+static unsigned int objmap_get_cell_capacity(const objmap_t *map) {
+    return map->cells ? map->item_capacity * 2 : 0;
+}
+
+static uint32_t* objmap_get_refcount(const objmap_t *map) {
+    return map->hashes + map->item_capacity + objmap_get_cell_capacity(map);
+}
+
+// maps sharing a block (see objmap_init_shared) copy it before their first write
+static bool objmap_ensure_unique(objmap_t *map) {
+    if (!objmap_is_shared(map)) {
+        return true;
+    }
+    size_t block_size = objmap_get_block_size(map->keys_only, map->item_capacity, objmap_get_cell_capacity(map));
+    char *block = allocator_malloc(map->alloc, block_size);
+    if (!block) {
+        return false;
+    }
+    memcpy(block, map->keys, block_size);
+    (*objmap_get_refcount(map))--;
+    size_t objects_per_item = map->keys_only ? 1 : 2;
+    map->keys = (object_t*)block;
+    map->hashes = (uint32_t*)(map->keys + objects_per_item * map->item_capacity);
+    map->cells = map->cells ? map->hashes + map->item_capacity : NULL;
+    *objmap_get_refcount(map) = 1;
+    return true;
+}
+
+static void objmap_release_block(objmap_t *map) {
+    if (!map->keys) {
+        return;
+    }
+    uint32_t *refcount = objmap_get_refcount(map);
+    if (*refcount > 1) {
+        (*refcount)--;
+        return;
+    }
+    allocator_free(map->alloc, map->keys);
+}
+
+static uint32_t objmap_find_item(const objmap_t *map, object_t key) {
+    if (map->count == 0) {
+        return OBJMAP_INVALID_IX;
+    }
+    uint32_t hash = objmap_hash(key);
+    if (!map->cells) {
+        return objmap_find_small(map, key, hash);
+    }
+    bool found = false;
+    uint32_t cell_ix = objmap_get_cell_ix(map, key, hash, &found);
+    if (!found) {
+        return OBJMAP_INVALID_IX;
+    }
+    return map->cells[cell_ix];
+}
+
+static uint32_t objmap_find_small(const objmap_t *map, object_t key, uint32_t hash) {
+    for (unsigned int i = 0; i < map->count; i++) {
+        if (map->hashes[i] == hash && objmap_keys_are_equal(key, map->keys[i])) {
+            return i;
+        }
+    }
+    return OBJMAP_INVALID_IX;
+}
+
+static uint32_t objmap_get_cell_ix(const objmap_t *map, object_t key, uint32_t hash, bool *out_found) {
+    *out_found = false;
+    uint32_t cell_mask = objmap_get_cell_capacity(map) - 1;
+    uint32_t cell_ix = hash & cell_mask;
+    // slots (including removed ones) never fill more than half of the cells so the loop always reaches an empty cell
+    while (true) {
+        uint32_t item_ix = map->cells[cell_ix];
+        if (item_ix == OBJMAP_INVALID_IX) {
+            return cell_ix;
+        }
+        if (item_ix != OBJMAP_REMOVED_IX && map->hashes[item_ix] == hash
+            && objmap_keys_are_equal(key, map->keys[item_ix])) {
+            *out_found = true;
+            return cell_ix;
+        }
+        cell_ix = (cell_ix + 1) & cell_mask;
+    }
+}
+
+static uint32_t objmap_hash(object_t key) {
+    object_type_t type = object_get_type(key);
+    uint64_t bits = key.handle;
+    if (type == OBJECT_STRING) {
+        bits = object_get_string_hash(key);
+    } else if (type == OBJECT_NUMBER && object_is_int(key)) {
+        // ints equal to a double (e.g. 2 and 2.0) have to hash the same
+        int64_t val = object_get_int(key);
+        bits = ape_int64_is_exact_double(val) ? ape_double_to_uint64((double)val) : (uint64_t)val;
+    } else if (type == OBJECT_NUMBER && key.number == 0) {
+        bits = 0; // 0 and -0 are equal keys
+    }
+    // doubles and pointers differ mostly in high or middle bits, mix them into the low bits used for cells
+    bits ^= bits >> 33;
+    bits *= 0xff51afd7ed558ccdull;
+    bits ^= bits >> 33;
+    return (uint32_t)bits;
+}
+
+static bool objmap_keys_are_equal(object_t a, object_t b) {
+    if (a.handle == b.handle) {
+        return true;
+    }
+    return object_equals(a, b);
+}
+
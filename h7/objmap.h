@@ -0,0 +1,53 @@
+#ifndef objmap_h
+#define objmap_h
+
+#include <stdint.h>
+
+#ifndef APE_AMALGAMATED
+#include "common.h"
+#include "collections.h"
+#endif
+
+typedef struct object object_t;
+
+// Insertion ordered object_t -> object_t hash map used by OBJECT_MAP, and OBJECT_SET when initialised with
+// objmap_init_keys_only (values aren't stored at all then).
+// Keys, values, hashes and cells live in a single allocation that is only made on first insert.
+// The allocation is reference counted so that copies can share it until one of them is modified.
+// Small maps have no cells (cells == NULL) and are searched linearly by hash.
+// Removing from a map with cells leaves a null key and value in the item's slot and a tombstone in its cell,
+// slots are compacted when the map would otherwise grow or when items are accessed by index.
+typedef struct objmap {
+    allocator_t *alloc;
+    object_t *keys;
+    uint32_t *hashes;
+    uint32_t *cells;
+    unsigned int count;
+    unsigned int removed_count;
+    unsigned int item_capacity; // power of 2, cells (if any) have twice as many
+    bool keys_only;
+} objmap_t;
+
+APE_INTERNAL bool      objmap_init(objmap_t *map, allocator_t *alloc, unsigned int min_capacity);
+APE_INTERNAL bool      objmap_init_keys_only(objmap_t *map, allocator_t *alloc, unsigned int min_capacity);
+APE_INTERNAL bool      objmap_init_shared(objmap_t *map, const objmap_t *src); // shares src's storage until either map is modified
+APE_INTERNAL void      objmap_deinit(objmap_t *map);
+APE_INTERNAL bool      objmap_set(objmap_t *map, object_t key, object_t val); // val is ignored if keys_only
+APE_INTERNAL object_t* objmap_get(const objmap_t *map, object_t key);
+APE_INTERNAL bool      objmap_has(const objmap_t *map, object_t key);
+APE_INTERNAL bool      objmap_remove(objmap_t *map, object_t key); // keeps insertion order
+APE_INTERNAL void      objmap_clear(objmap_t *map);
+APE_INTERNAL int       objmap_count(const objmap_t *map);
+APE_INTERNAL bool      objmap_is_shared(const objmap_t *map);
+
+// ix is in insertion order, these compact removed slots first
+APE_INTERNAL object_t  objmap_get_key_at(objmap_t *map, unsigned int ix);
+APE_INTERNAL object_t  objmap_get_value_at(objmap_t *map, unsigned int ix);
+APE_INTERNAL bool      objmap_set_value_at(objmap_t *map, unsigned int ix, object_t val);
+
+// raw slots, including removed ones (null key and value), invalidated by set and remove
+APE_INTERNAL int       objmap_get_slots_count(const objmap_t *map);
+APE_INTERNAL object_t* objmap_get_keys(const objmap_t *map);
+APE_INTERNAL object_t* objmap_get_values(const objmap_t *map); // NULL if keys_only
+
+#endif /* objmap_h */
@@ -4,6 +4,9 @@
 
 static expression_t* optimise_infix_expression(expression_t* expr);
 static expression_t* optimise_prefix_expression(expression_t* expr);
+static expression_t* optimise_int_infix(allocator_t *alloc, operator_t op, int64_t left, int64_t right);
+static int64_t get_int_literal(const expression_t *expr);
+static double get_number_literal(const expression_t *expr);
 
 expression_t* optimise_expression(expression_t* expr) {
     switch (expr->type) {
@@ -29,35 +32,45 @@ static expression_t* optimise_infix_expression(expression_t* expr) {
 
     expression_t *res = NULL;
 
-    bool left_is_numeric = left->type == EXPRESSION_NUMBER_LITERAL || left->type == EXPRESSION_BOOL_LITERAL;
-    bool right_is_numeric = right->type == EXPRESSION_NUMBER_LITERAL || right->type == EXPRESSION_BOOL_LITERAL;
+    bool left_is_int = left->type == EXPRESSION_INT_LITERAL || left->type == EXPRESSION_BOOL_LITERAL;
+    bool right_is_int = right->type == EXPRESSION_INT_LITERAL || right->type == EXPRESSION_BOOL_LITERAL;
+
+    bool left_is_numeric = left_is_int || left->type == EXPRESSION_NUMBER_LITERAL;
+    bool right_is_numeric = right_is_int || right->type == EXPRESSION_NUMBER_LITERAL;
 
     bool left_is_string = left->type == EXPRESSION_STRING_LITERAL;
     bool right_is_string = right->type == EXPRESSION_STRING_LITERAL;
 
     allocator_t *alloc = expr->alloc;
-    if (left_is_numeric && right_is_numeric) {
-        double left_val = left->type == EXPRESSION_NUMBER_LITERAL ? left->number_literal : left->bool_literal;
-        double right_val = right->type == EXPRESSION_NUMBER_LITERAL ? right->number_literal : right->bool_literal;
-        int64_t left_val_int = (int64_t)left_val;
-        int64_t right_val_int = (int64_t)right_val;
+    if (left_is_int && right_is_int) {
+        res = optimise_int_infix(alloc, expr->infix.op, get_int_literal(left), get_int_literal(right));
+    }
+    if (!res && left_is_numeric && right_is_numeric) {
+        double left_val = get_number_literal(left);
+        double right_val = get_number_literal(right);
+        // ints are taken as they are, their double value can be rounded
+        int64_t left_val_int = left_is_int ? get_int_literal(left) : ape_double_to_int64(left_val);
+        int64_t right_val_int = right_is_int ? get_int_literal(right) : ape_double_to_int64(right_val);
+        // comparing an int with a double is only exact if the int is representable as a double, leave the rest to the vm
+        bool can_compare = !(left_is_int && !ape_int64_is_exact_double(left_val_int))
+                        && !(right_is_int && !ape_int64_is_exact_double(right_val_int));
         switch (expr->infix.op) {
             case OPERATOR_PLUS:     { res = expression_make_number_literal(alloc, left_val + right_val); break; }
             case OPERATOR_MINUS:    { res = expression_make_number_literal(alloc, left_val - right_val); break; }
             case OPERATOR_ASTERISK: { res = expression_make_number_literal(alloc, left_val * right_val); break; }
             case OPERATOR_SLASH:    { res = expression_make_number_literal(alloc, left_val / right_val); break; }
-            case OPERATOR_LT:       { res = expression_make_bool_literal(alloc, left_val < right_val); break; }
-            case OPERATOR_LTE:      { res = expression_make_bool_literal(alloc, left_val <= right_val); break; }
-            case OPERATOR_GT:       { res = expression_make_bool_literal(alloc, left_val > right_val); break; }
-            case OPERATOR_GTE:      { res = expression_make_bool_literal(alloc, left_val >= right_val); break; }
-            case OPERATOR_EQ:       { res = expression_make_bool_literal(alloc, APE_DBLEQ(left_val, right_val)); break; }
-            case OPERATOR_NOT_EQ:   { res = expression_make_bool_literal(alloc, !APE_DBLEQ(left_val, right_val)); break; }
+            case OPERATOR_LT:       { if (can_compare) { res = expression_make_bool_literal(alloc, left_val < right_val); } break; }
+            case OPERATOR_LTE:      { if (can_compare) { res = expression_make_bool_literal(alloc, left_val <= right_val); } break; }
+            case OPERATOR_GT:       { if (can_compare) { res = expression_make_bool_literal(alloc, left_val > right_val); } break; }
+            case OPERATOR_GTE:      { if (can_compare) { res = expression_make_bool_literal(alloc, left_val >= right_val); } break; }
+            case OPERATOR_EQ:       { if (can_compare) { res = expression_make_bool_literal(alloc, APE_DBLEQ(left_val, right_val)); } break; }
+            case OPERATOR_NOT_EQ:   { if (can_compare) { res = expression_make_bool_literal(alloc, !APE_DBLEQ(left_val, right_val)); } break; }
             case OPERATOR_MODULUS:  { res = expression_make_number_literal(alloc, fmod(left_val, right_val)); break; }
-            case OPERATOR_BIT_AND:  { res = expression_make_number_literal(alloc, (double)(left_val_int & right_val_int)); break; }
-            case OPERATOR_BIT_OR:   { res = expression_make_number_literal(alloc, (double)(left_val_int | right_val_int)); break; }
-            case OPERATOR_BIT_XOR:  { res = expression_make_number_literal(alloc, (double)(left_val_int ^ right_val_int)); break; }
-            case OPERATOR_LSHIFT:   { res = expression_make_number_literal(alloc, (double)(left_val_int << right_val_int)); break; }
-            case OPERATOR_RSHIFT:   { res = expression_make_number_literal(alloc, (double)(left_val_int >> right_val_int)); break; }
+            case OPERATOR_BIT_AND:  { res = expression_make_int_literal(alloc, left_val_int & right_val_int); break; }
+            case OPERATOR_BIT_OR:   { res = expression_make_int_literal(alloc, left_val_int | right_val_int); break; }
+            case OPERATOR_BIT_XOR:  { res = expression_make_int_literal(alloc, left_val_int ^ right_val_int); break; }
+            case OPERATOR_LSHIFT:   { res = expression_make_int_literal(alloc, ape_int64_lshift(left_val_int, right_val_int)); break; }
+            case OPERATOR_RSHIFT:   { res = expression_make_int_literal(alloc, ape_int64_rshift(left_val_int, right_val_int)); break; }
             default: {
                 break;
             }
@@ -91,7 +104,11 @@ expression_t* optimise_prefix_expression(expression_t* expr) {
         right = right_optimised;
     }
     expression_t *res = NULL;
-    if (expr->prefix.op == OPERATOR_MINUS && right->type == EXPRESSION_NUMBER_LITERAL) {
+    if (expr->prefix.op == OPERATOR_MINUS && right->type == EXPRESSION_INT_LITERAL && right->int_literal != INT64_MIN) {
+        res = expression_make_int_literal(expr->alloc, -right->int_literal);
+    } else if (expr->prefix.op == OPERATOR_MINUS && right->type == EXPRESSION_INT_LITERAL) {
+        res = expression_make_number_literal(expr->alloc, -(double)right->int_literal);
+    } else if (expr->prefix.op == OPERATOR_MINUS && right->type == EXPRESSION_NUMBER_LITERAL) {
         res = expression_make_number_literal(expr->alloc, -right->number_literal);
     } else if (expr->prefix.op == OPERATOR_BANG && right->type == EXPRESSION_BOOL_LITERAL) {
         res = expression_make_bool_literal(expr->alloc, !right->bool_literal);
@@ -102,3 +119,42 @@ expression_t* optimise_prefix_expression(expression_t* expr) {
     }
     return res;
 }
+
+// Same rules as the vm: the result stays an int if it's an exact int64, otherwise NULL is returned
+// and the expression is folded on doubles.
+static expression_t* optimise_int_infix(allocator_t *alloc, operator_t op, int64_t left, int64_t right) {
+    int64_t res = 0;
+    switch (op) {
+        case OPERATOR_PLUS:     { return ape_int64_add(left, right, &res) ? expression_make_int_literal(alloc, res) : NULL; }
+        case OPERATOR_MINUS:    { return ape_int64_sub(left, right, &res) ? expression_make_int_literal(alloc, res) : NULL; }
+        case OPERATOR_ASTERISK: { return ape_int64_mul(left, right, &res) ? expression_make_int_literal(alloc, res) : NULL; }
+        case OPERATOR_SLASH:    { return ape_int64_div(left, right, &res) ? expression_make_int_literal(alloc, res) : NULL; }
+        case OPERATOR_MODULUS:  { return ape_int64_mod(left, right, &res) ? expression_make_int_literal(alloc, res) : NULL; }
+        case OPERATOR_BIT_AND:  { return expression_make_int_literal(alloc, left & right); }
+        case OPERATOR_BIT_OR:   { return expression_make_int_literal(alloc, left | right); }
+        case OPERATOR_BIT_XOR:  { return expression_make_int_literal(alloc, left ^ right); }
+        case OPERATOR_LSHIFT:   { return expression_make_int_literal(alloc, ape_int64_lshift(left, right)); }
+        case OPERATOR_RSHIFT:   { return expression_make_int_literal(alloc, ape_int64_rshift(left, right)); }
+        case OPERATOR_LT:       { return expression_make_bool_literal(alloc, left < right); }
+        case OPERATOR_LTE:      { return expression_make_bool_literal(alloc, left <= right); }
+        case OPERATOR_GT:       { return expression_make_bool_literal(alloc, left > right); }
+        case OPERATOR_GTE:      { return expression_make_bool_literal(alloc, left >= right); }
+        case OPERATOR_EQ:       { return expression_make_bool_literal(alloc, left == right); }
+        case OPERATOR_NOT_EQ:   { return expression_make_bool_literal(alloc, left != right); }
+        default: {
+            return NULL;
+        }
+    }
+}
+
+static int64_t get_int_literal(const expression_t *expr) {
+    return expr->type == EXPRESSION_INT_LITERAL ? expr->int_literal : expr->bool_literal;
+}
+
+static double get_number_literal(const expression_t *expr) {
+    switch (expr->type) {
+        case EXPRESSION_INT_LITERAL:  return (double)expr->int_literal;
+        case EXPRESSION_BOOL_LITERAL: return expr->bool_literal;
+        default:                      return expr->number_literal;
+    }
+}
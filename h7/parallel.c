@@ -0,0 +1,440 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef APE_AMALGAMATED
+#include "parallel.h"
+#include "vm.h"
+#include "gc.h"
+#include "errors.h"
+#include "global_store.h"
+#include "builtins.h"
+#include "message.h"
+#include "traceback.h"
+#endif
+
+#if defined(APE_POSIX)
+#include <pthread.h>
+#endif
+
+#define PARALLEL_MAX_THREADS 64
+#define PARALLEL_CHUNKS_PER_THREAD 4 // so that threads finishing early can take more work
+
+uint64_t parallel_item_random_state(uint64_t random_seed, int ix) {
+    uint64_t state = random_seed ^ ((uint64_t)ix * 0x9e3779b97f4a7c15ULL);
+    return ape_random_next(&state);
+}
+
+#if defined(APE_POSIX)
+
+typedef struct parallel_chunk {
+    int start;
+    int end;
+    array(uint8_t) *items;   // written by the caller
+    array(uint8_t) *results; // written by a worker
+    bool failed;
+    error_type_t error_type;
+    src_pos_t error_pos;
+    char error_message[ERROR_MESSAGE_MAX_LENGTH];
+    traceback_t *error_traceback; // allocated with the job's allocator, the worker's is gone after join
+} parallel_chunk_t;
+
+typedef struct parallel_job {
+    allocator_t alloc; // shared by all threads, so it's always malloc
+    const ape_config_t *config;
+    global_store_t *global_store; // caller's, only read for the names of its globals
+    array(object_t) *constants; // static copies of the caller's constants
+    array(uint8_t) *context; // ape globals, module globals and fn
+    array(uint8_t) *ape_global_kinds; // parallel_global_kind_t of every ape global
+    int ape_globals_count;
+    int globals_count;
+    parallel_chunk_t *chunks;
+    int chunks_count;
+    uint64_t random_seed;
+    pthread_mutex_t mutex;
+    int next_chunk;
+    bool failed;
+} parallel_job_t;
+
+typedef enum parallel_global_kind {
+    PARALLEL_GLOBAL_VALUE = 0,
+    PARALLEL_GLOBAL_HOST_NATIVE,
+} parallel_global_kind_t;
+
+static int get_threads_count(void);
+static bool job_init(parallel_job_t *job, vm_t *vm, object_t items, int items_count, parallel_get_item_fn get_item,
+                     object_t fn, int chunk_size, uint64_t random_seed);
+static void job_deinit(parallel_job_t *job);
+static void* worker_run(void *arg);
+static bool worker_read_context(parallel_job_t *job, vm_t *vm, global_store_t *store, object_t *out_fn);
+static void worker_run_chunk(parallel_job_t *job, vm_t *vm, object_t fn, parallel_chunk_t *chunk);
+static object_t host_native_fn(vm_t *vm, void *data, int argc, object_t *args);
+static traceback_t* traceback_copy(allocator_t *alloc, const traceback_t *traceback);
+
+bool parallel_map(vm_t *vm, object_t items, int items_count, parallel_get_item_fn get_item,
+                  object_t fn, int chunk_size, uint64_t random_seed, object_t *out_res) {
+    int threads_count = get_threads_count();
+    if (threads_count < 2 || items_count < 2) {
+        return false;
+    }
+    if (object_get_type(fn) == OBJECT_FUNCTION) {
+        int num_args = object_get_function(fn)->num_args;
+        if (num_args < 1 || num_args > 2) {
+            return false; // the caller reports it
+        }
+    }
+    if (chunk_size <= 0) {
+        int target_chunks_count = threads_count * PARALLEL_CHUNKS_PER_THREAD;
+        chunk_size = (items_count + target_chunks_count - 1) / target_chunks_count;
+    }
+
+    parallel_job_t job;
+    if (!job_init(&job, vm, items, items_count, get_item, fn, chunk_size, random_seed)) {
+        job_deinit(&job);
+        return false;
+    }
+    if (job.chunks_count < 2) {
+        job_deinit(&job);
+        return false;
+    }
+
+    if (threads_count > job.chunks_count) {
+        threads_count = job.chunks_count;
+    }
+    pthread_t threads[PARALLEL_MAX_THREADS];
+    int started_count = 0;
+    for (int i = 0; i < threads_count - 1; i++) { // the calling thread is a worker too
+        if (pthread_create(&threads[started_count], NULL, worker_run, &job) != 0) {
+            break;
+        }
+        started_count++;
+    }
+    worker_run(&job);
+    for (int i = 0; i < started_count; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    // chunks are taken in order and taken chunks always finish, so the first failed chunk is the one
+    // that fails first when called sequentially
+    for (int i = 0; i < job.chunks_count; i++) {
+        parallel_chunk_t *chunk = &job.chunks[i];
+        if (chunk->failed) {
+            int errors_count = errors_get_count(vm->errors);
+            errors_add_error(vm->errors, chunk->error_type, chunk->error_pos, chunk->error_message);
+            if (chunk->error_traceback && errors_get_count(vm->errors) > errors_count) {
+                // keeps the worker's frames, frames of the caller are appended when the error unwinds
+                error_t *err = errors_get_last_error(vm->errors);
+                err->traceback = traceback_copy(vm->alloc, chunk->error_traceback);
+            }
+            job_deinit(&job);
+            *out_res = object_make_null();
+            return true;
+        }
+    }
+
+    object_t res = object_make_array_with_capacity(vm->mem, items_count);
+    if (object_is_null(res)) {
+        job_deinit(&job);
+        *out_res = object_make_null();
+        return true;
+    }
+    for (int i = 0; i < job.chunks_count; i++) {
+        parallel_chunk_t *chunk = &job.chunks[i];
+        const uint8_t *data = array_data(chunk->results);
+        int data_len = array_count(chunk->results);
+        int pos = 0;
+        for (int j = chunk->start; j < chunk->end; j++) {
+            object_t val = object_make_null();
+            bool ok = message_read(vm->mem, data, data_len, &pos, &val) && object_add_array_value(res, val);
+            if (!ok) {
+                job_deinit(&job);
+                *out_res = object_make_null();
+                return true;
+            }
+        }
+    }
+    job_deinit(&job);
+    *out_res = res;
+    return true;
+}
+
+static int get_threads_count(void) {
+#if defined(APE_PARALLEL_THREADS)
+    return APE_PARALLEL_THREADS; // e.g. to test workers on a single core
+#else
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    if (count < 1) {
+        return 1;
+    }
+    return count > PARALLEL_MAX_THREADS ? PARALLEL_MAX_THREADS : (int)count;
+#endif
+}
+
+static bool job_init(parallel_job_t *job, vm_t *vm, object_t items, int items_count, parallel_get_item_fn get_item,
+                     object_t fn, int chunk_size, uint64_t random_seed) {
+    memset(job, 0, sizeof(parallel_job_t));
+    job->alloc = allocator_make(NULL, NULL, NULL);
+    job->config = vm->config;
+    job->global_store = vm->global_store;
+    job->random_seed = random_seed;
+    pthread_mutex_init(&job->mutex, NULL);
+
+    job->constants = array_make(&job->alloc, object_t);
+    if (!job->constants) {
+        return false;
+    }
+    for (int i = 0; i < array_count(vm->constants); i++) {
+        object_t *constant = array_get(vm->constants, i);
+        object_t copy = object_make_static_copy(&job->alloc, *constant);
+        if (object_is_null(copy)) {
+            return false;
+        }
+        if (!array_add(job->constants, &copy)) {
+            object_destroy_static_copy(&job->alloc, copy);
+            return false;
+        }
+    }
+
+    job->context = array_make(&job->alloc, uint8_t);
+    job->ape_global_kinds = array_make(&job->alloc, uint8_t);
+    if (!job->context || !job->ape_global_kinds) {
+        return false;
+    }
+    // written with a single writer so that globals share objects like they do in the caller
+    message_writer_t writer;
+    message_writer_init(&writer, &job->alloc, job->context, true);
+    job->ape_globals_count = global_store_get_object_count(vm->global_store);
+    for (int i = 0; i < job->ape_globals_count; i++) {
+        bool ok = false;
+        object_t global = global_store_get_object_at(vm->global_store, i, &ok);
+        uint8_t kind = PARALLEL_GLOBAL_VALUE;
+        if (object_get_type(global) == OBJECT_NATIVE_FUNCTION
+            && builtins_get_ix(object_get_native_function(global)->fn) < 0) {
+            // natives set by the host are bound to its ape instance and can't be called from other threads
+            kind = PARALLEL_GLOBAL_HOST_NATIVE;
+        }
+        if (!ok || !array_add(job->ape_global_kinds, &kind)) {
+            message_writer_deinit(&writer);
+            return false;
+        }
+        ok = kind == PARALLEL_GLOBAL_HOST_NATIVE ? message_writer_add_external(&writer, global)
+                                                : message_writer_write(&writer, global);
+        if (!ok) {
+            message_writer_deinit(&writer);
+            return false;
+        }
+    }
+    job->globals_count = vm->globals_count;
+    for (int i = 0; i < vm->globals_count; i++) {
+        if (!message_writer_write(&writer, vm->globals[i])) {
+            message_writer_deinit(&writer);
+            return false;
+        }
+    }
+    bool ok = message_writer_write(&writer, fn);
+    message_writer_deinit(&writer);
+    if (!ok) {
+        return false;
+    }
+
+    job->chunks_count = (items_count + chunk_size - 1) / chunk_size;
+    job->chunks = allocator_malloc(&job->alloc, sizeof(parallel_chunk_t) * job->chunks_count);
+    if (!job->chunks) {
+        job->chunks_count = 0;
+        return false;
+    }
+    memset(job->chunks, 0, sizeof(parallel_chunk_t) * job->chunks_count);
+    for (int i = 0; i < job->chunks_count; i++) {
+        parallel_chunk_t *chunk = &job->chunks[i];
+        chunk->start = i * chunk_size;
+        chunk->end = chunk->start + chunk_size < items_count ? chunk->start + chunk_size : items_count;
+        chunk->items = array_make(&job->alloc, uint8_t);
+        chunk->results = array_make(&job->alloc, uint8_t);
+        if (!chunk->items || !chunk->results) {
+            return false;
+        }
+        // items are separate messages, objects read for one item can be collected before the next one is read
+        for (int j = chunk->start; j < chunk->end; j++) {
+            if (!message_write(chunk->items, get_item(items, j), true)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static void job_deinit(parallel_job_t *job) {
+    for (int i = 0; i < job->chunks_count; i++) {
+        array_destroy(job->chunks[i].items);
+        array_destroy(job->chunks[i].results);
+        if (job->chunks[i].error_traceback) {
+            traceback_destroy(job->chunks[i].error_traceback);
+        }
+    }
+    allocator_free(&job->alloc, job->chunks);
+    array_destroy(job->context);
+    array_destroy(job->ape_global_kinds);
+    for (int i = 0; i < array_count(job->constants); i++) {
+        object_t *constant = array_get(job->constants, i);
+        object_destroy_static_copy(&job->alloc, *constant);
+    }
+    array_destroy(job->constants);
+    pthread_mutex_destroy(&job->mutex);
+}
+
+static void* worker_run(void *arg) {
+    parallel_job_t *job = arg;
+
+    // every worker allocates from its own gcmem
+    allocator_t alloc = allocator_make(NULL, NULL, NULL);
+    errors_t errors;
+    errors_init(&errors);
+    gcmem_t *mem = gcmem_make(&alloc);
+    global_store_t *store = mem ? global_store_make(&alloc, NULL) : NULL;
+    vm_t *vm = store ? vm_make(&alloc, job->config, mem, &errors, store) : NULL;
+    object_t fn = object_make_null();
+    bool ok = vm && worker_read_context(job, vm, store, &fn);
+    if (ok) {
+        gc_disable_on_object(fn);
+    }
+
+    while (true) {
+        pthread_mutex_lock(&job->mutex);
+        parallel_chunk_t *chunk = NULL;
+        if (!job->failed && job->next_chunk < job->chunks_count) {
+            chunk = &job->chunks[job->next_chunk];
+            job->next_chunk++;
+        }
+        pthread_mutex_unlock(&job->mutex);
+        if (!chunk) {
+            break;
+        }
+
+        if (ok) {
+            worker_run_chunk(job, vm, fn, chunk);
+        } else {
+            chunk->failed = true;
+            chunk->error_type = ERROR_ALLOCATION;
+            chunk->error_pos = src_pos_invalid;
+            snprintf(chunk->error_message, ERROR_MESSAGE_MAX_LENGTH, "Starting parallel_map worker failed");
+        }
+
+        if (chunk->failed) {
+            pthread_mutex_lock(&job->mutex);
+            job->failed = true;
+            pthread_mutex_unlock(&job->mutex);
+        }
+    }
+
+    vm_destroy(vm);
+    global_store_destroy(store);
+    gcmem_destroy(mem);
+    errors_deinit(&errors);
+    return NULL;
+}
+
+static bool worker_read_context(parallel_job_t *job, vm_t *vm, global_store_t *store, object_t *out_fn) {
+    message_reader_t reader;
+    message_reader_init(&reader, vm->mem, array_data(job->context), array_count(job->context));
+    for (int i = 0; i < job->ape_globals_count; i++) {
+        const char *name = global_store_get_name_at(job->global_store, i);
+        uint8_t *kind = array_get(job->ape_global_kinds, i);
+        object_t global = object_make_null();
+        bool ok = false;
+        if (*kind == PARALLEL_GLOBAL_HOST_NATIVE) {
+            global = object_make_native_function(vm->mem, name, host_native_fn, NULL, 0);
+            ok = !object_is_null(global) && message_reader_add_external(&reader, global);
+        } else {
+            ok = message_reader_read(&reader, &global);
+        }
+        // indices match the caller's because globals are added in the same order
+        if (!ok || !name || !global_store_set(store, name, global)) {
+            message_reader_deinit(&reader);
+            return false;
+        }
+    }
+    for (int i = 0; i < job->globals_count; i++) {
+        object_t global = object_make_null();
+        if (!message_reader_read(&reader, &global) || !vm_set_global(vm, i, global)) {
+            message_reader_deinit(&reader);
+            return false;
+        }
+    }
+    bool ok = message_reader_read(&reader, out_fn);
+    message_reader_deinit(&reader);
+    return ok;
+}
+
+static void worker_run_chunk(parallel_job_t *job, vm_t *vm, object_t fn, parallel_chunk_t *chunk) {
+    int argc = 1;
+    if (object_get_type(fn) == OBJECT_FUNCTION) {
+        argc = object_get_function(fn)->num_args;
+    }
+    const uint8_t *data = array_data(chunk->items);
+    int data_len = array_count(chunk->items);
+    int pos = 0;
+    for (int i = chunk->start; i < chunk->end; i++) {
+        object_t args[2] = { object_make_null(), object_make_int(vm->mem, i) };
+        if (!message_read(vm->mem, data, data_len, &pos, &args[0])) {
+            errors_add_error(vm->errors, ERROR_ALLOCATION, src_pos_invalid, "Passing item to parallel_map worker failed");
+            break;
+        }
+        vm->random_state = parallel_item_random_state(job->random_seed, i);
+        object_t res = vm_call(vm, job->constants, fn, argc, args);
+        if (vm_has_errors(vm)) {
+            break;
+        }
+        if (!message_write(chunk->results, res, true)) {
+            errors_add_errorf(vm->errors, ERROR_RUNTIME, src_pos_invalid,
+                              "parallel_map function returned %s that can't be passed between threads",
+                              object_get_type_name(object_get_type(res)));
+            break;
+        }
+    }
+    if (vm_has_errors(vm)) {
+        const error_t *err = errors_get(vm->errors, 0);
+        chunk->failed = true;
+        chunk->error_type = err->type;
+        chunk->error_pos = err->pos;
+        snprintf(chunk->error_message, ERROR_MESSAGE_MAX_LENGTH, "%s", err->message);
+        if (err->traceback) {
+            chunk->error_traceback = traceback_copy(&job->alloc, err->traceback);
+        }
+        errors_clear(vm->errors);
+    }
+}
+
+static object_t host_native_fn(vm_t *vm, void *data, int argc, object_t *args) {
+    (void)data;
+    (void)argc;
+    (void)args;
+    errors_add_error(vm->errors, ERROR_RUNTIME, src_pos_invalid,
+                     "Native functions set by the host can't be called from parallel_map");
+    return object_make_null();
+}
+
+static traceback_t* traceback_copy(allocator_t *alloc, const traceback_t *traceback) {
+    traceback_t *res = traceback_make(alloc);
+    if (!res) {
+        return NULL;
+    }
+    for (int i = 0; i < array_count(traceback->items); i++) {
+        traceback_item_t *item = array_get(traceback->items, i);
+        if (!traceback_append(res, item->function_name, item->pos)) {
+            traceback_destroy(res);
+            return NULL;
+        }
+    }
+    return res;
+}
+
+#else
+
+bool parallel_map(vm_t *vm, object_t items, int items_count, parallel_get_item_fn get_item,
+                  object_t fn, int chunk_size, uint64_t random_seed, object_t *out_res) {
+    (void)vm; (void)items; (void)items_count; (void)get_item; (void)fn; (void)chunk_size; (void)random_seed;
+    (void)out_res;
+    return false;
+}
+
+#endif
@@ -0,0 +1,25 @@
+#ifndef parallel_h
+#define parallel_h
+
+#ifndef APE_AMALGAMATED
+#include "common.h"
+#include "object.h"
+#endif
+
+typedef struct vm vm_t;
+
+typedef object_t (*parallel_get_item_fn)(object_t items, int ix);
+
+// Calls fn with (item) or (item, index) for every item on worker threads, each with its own gcmem and vm,
+// and gathers the results in order. fn, the items and the globals fn might use are passed to the workers
+// as messages (see message.h), so changes workers make to them aren't visible to the caller.
+// Returns false without adding errors if it can't be done in parallel (a single core, too few items or
+// values that can't be passed to workers) so that the caller can call fn sequentially instead. Errors
+// raised by fn are added to vm's errors and give a null result.
+// Calls on item ix start with the random state parallel_item_random_state(random_seed, ix),
+// so results don't depend on how items are split between threads.
+APE_INTERNAL bool parallel_map(vm_t *vm, object_t items, int items_count, parallel_get_item_fn get_item,
+                               object_t fn, int chunk_size, uint64_t random_seed, object_t *out_res);
+APE_INTERNAL uint64_t parallel_item_random_state(uint64_t random_seed, int ix);
+
+#endif /* parallel_h */
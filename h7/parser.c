@@ -45,12 +45,14 @@ static statement_t* parse_function_statement(parser_t *p);
 static statement_t* parse_block_statement(parser_t *p);
 static statement_t* parse_import_statement(parser_t *p);
 static statement_t* parse_recover_statement(parser_t *p);
+static statement_t* parse_struct_statement(parser_t *p);
 
 static code_block_t* parse_code_block(parser_t *p);
 
 static expression_t* parse_expression(parser_t *p, precedence_t prec);
 static expression_t* parse_identifier(parser_t *p);
 static expression_t* parse_number_literal(parser_t *p);
+static bool parse_int_literal(const char *literal, int len, int64_t *out_val);
 static expression_t* parse_bool_literal(parser_t *p);
 static expression_t* parse_string_literal(parser_t *p);
 static expression_t* parse_template_string_literal(parser_t *p);
@@ -263,6 +265,10 @@ static statement_t* parse_statement(parser_t *p) {
             res = parse_recover_statement(p);
             break;
         }
+        case TOKEN_STRUCT: {
+            res = parse_struct_statement(p);
+            break;
+        }
         default: {
         //may be array/map
 
@@ -601,6 +607,101 @@ err:
 
 }
 
+static statement_t* parse_struct_statement(parser_t *p) {
+    ident_t *name_ident = NULL;
+    ptrarray(ident_t) *fields = NULL;
+    ptrarray(expression_t) *operators = NULL;
+    expression_t *op_fn = NULL;
+
+    lexer_next_token(&p->lexer);
+
+    if (!lexer_expect_current(&p->lexer, TOKEN_IDENT)) {
+        goto err;
+    }
+
+    name_ident = ident_make(p->alloc, p->lexer.cur_token);
+    if (!name_ident) {
+        goto err;
+    }
+
+    lexer_next_token(&p->lexer);
+
+    if (!lexer_expect_current(&p->lexer, TOKEN_LBRACE)) {
+        goto err;
+    }
+
+    lexer_next_token(&p->lexer);
+
+    fields = ptrarray_make(p->alloc);
+    operators = ptrarray_make(p->alloc);
+    if (!fields || !operators) {
+        goto err;
+    }
+
+    while (!lexer_cur_token_is(&p->lexer, TOKEN_RBRACE)) {
+        if (lexer_cur_token_is(&p->lexer, TOKEN_EOF)) {
+            errors_add_error(p->errors, ERROR_PARSING, p->lexer.cur_token.pos, "Unexpected EOF");
+            goto err;
+        }
+        if (lexer_cur_token_is(&p->lexer, TOKEN_COMMA) || lexer_cur_token_is(&p->lexer, TOKEN_SEMICOLON)) {
+            lexer_next_token(&p->lexer);
+            continue;
+        }
+        if (lexer_cur_token_is(&p->lexer, TOKEN_FUNCTION)) {
+            src_pos_t pos = p->lexer.cur_token.pos;
+            lexer_next_token(&p->lexer);
+            if (!lexer_expect_current(&p->lexer, TOKEN_IDENT)) {
+                goto err;
+            }
+            char *op_name = token_duplicate_literal(p->alloc, &p->lexer.cur_token);
+            if (!op_name) {
+                goto err;
+            }
+            lexer_next_token(&p->lexer);
+            op_fn = parse_function_literal(p);
+            if (!op_fn) {
+                allocator_free(p->alloc, op_name);
+                goto err;
+            }
+            op_fn->pos = pos;
+            op_fn->fn_literal.name = op_name;
+            bool ok = ptrarray_add(operators, op_fn);
+            if (!ok) {
+                goto err;
+            }
+            op_fn = NULL;
+            continue;
+        }
+        if (!lexer_expect_current(&p->lexer, TOKEN_IDENT)) {
+            goto err;
+        }
+        ident_t *field = ident_make(p->alloc, p->lexer.cur_token);
+        if (!field) {
+            goto err;
+        }
+        bool ok = ptrarray_add(fields, field);
+        if (!ok) {
+            ident_destroy(field);
+            goto err;
+        }
+        lexer_next_token(&p->lexer);
+    }
+
+    lexer_next_token(&p->lexer);
+
+    statement_t *res = statement_make_struct(p->alloc, name_ident, fields, operators);
+    if (!res) {
+        goto err;
+    }
+    return res;
+err:
+    expression_destroy(op_fn);
+    ptrarray_destroy_with_items(operators, expression_destroy);
+    ptrarray_destroy_with_items(fields, ident_destroy);
+    ident_destroy(name_ident);
+    return NULL;
+}
+
 static statement_t* parse_for_loop_statement(parser_t *p) {
     lexer_next_token(&p->lexer);
 
@@ -760,7 +861,7 @@ static statement_t* parse_function_statement(parser_t *p) {
         goto err;
     }
 
-    statement_t *res = statement_make_define(p->alloc, name_ident, value, false);
+    statement_t *res = statement_make_define(p->alloc, name_ident, TOKEN_FUNCTION, value, false);
     if (!res) {
         goto err;
     }
@@ -877,6 +978,12 @@ static expression_t* parse_identifier(parser_t *p) {
 }
 
 static expression_t* parse_number_literal(parser_t *p) {
+    int64_t int_number = 0;
+    if (parse_int_literal(p->lexer.cur_token.literal, p->lexer.cur_token.len, &int_number)) {
+        lexer_next_token(&p->lexer);
+        return expression_make_int_literal(p->alloc, int_number);
+    }
+
     char *end;
     double number = 0;
     errno = 0;
@@ -893,6 +1000,36 @@ static expression_t* parse_number_literal(parser_t *p) {
     return expression_make_number_literal(p->alloc, number);
 }
 
+// Decimal literals without a fraction or exponent that fit in int64, and hex literals of up to
+// 64 bits (taken as two's complement, so 0xffffffffffffffff is -1).
+static bool parse_int_literal(const char *literal, int len, int64_t *out_val) {
+    bool is_hex = len > 2 && literal[0] == '0' && (literal[1] == 'x' || literal[1] == 'X');
+    int start = is_hex ? 2 : 0;
+    if (len - start > (is_hex ? 16 : 19)) {
+        return false;
+    }
+    uint64_t val = 0;
+    for (int i = start; i < len; i++) {
+        char ch = literal[i];
+        int digit = 0;
+        if (ch >= '0' && ch <= '9') {
+            digit = ch - '0';
+        } else if (is_hex && ch >= 'a' && ch <= 'f') {
+            digit = ch - 'a' + 10;
+        } else if (is_hex && ch >= 'A' && ch <= 'F') {
+            digit = ch - 'A' + 10;
+        } else {
+            return false;
+        }
+        val = val * (is_hex ? 16 : 10) + digit;
+    }
+    if (!is_hex && val > INT64_MAX) {
+        return false;
+    }
+    *out_val = (int64_t)val;
+    return true;
+}
+
 static expression_t* parse_bool_literal(parser_t *p) {
     expression_t *res = expression_make_bool_literal(p->alloc, p->lexer.cur_token.type == TOKEN_TRUE);
     lexer_next_token(&p->lexer);
@@ -1047,6 +1184,7 @@ static expression_t* parse_map_literal(parser_t *p) {
             switch (key->type) {
                 case EXPRESSION_STRING_LITERAL:
                 case EXPRESSION_NUMBER_LITERAL:
+                case EXPRESSION_INT_LITERAL:
                 case EXPRESSION_BOOL_LITERAL: {
                     break;
                 }
@@ -1446,7 +1584,7 @@ static expression_t* parse_incdec_prefix_expression(parser_t *p) {
         goto err;
     }
 
-    expression_t *one_literal = expression_make_number_literal(p->alloc, 1);
+    expression_t *one_literal = expression_make_int_literal(p->alloc, 1);
     if (!one_literal) {
         expression_destroy(dest);
         goto err;
@@ -1494,7 +1632,7 @@ static expression_t* parse_incdec_postfix_expression(parser_t *p, expression_t *
         goto err;
     }
 
-    expression_t *one_literal = expression_make_number_literal(p->alloc, 1);
+    expression_t *one_literal = expression_make_int_literal(p->alloc, 1);
     if (!one_literal) {
         expression_destroy(left_copy);
         goto err;
@@ -135,7 +135,7 @@ bool symbol_table_add_module_symbol(symbol_table_t *st, symbol_t *symbol) {
     if (symbol_table_symbol_is_defined(st, symbol->name)) {
         return true; // todo: make sure it should be true in this case
     }
-    symbol_t *copy = symbol_copy(symbol);
+    symbol_t *copy = symbol_make(st->alloc, symbol->name, symbol->type, symbol->index, symbol->assignable);
     if (!copy) {
         return false;
     }
@@ -204,6 +204,38 @@ const symbol_t *symbol_table_define(symbol_table_t *table, const char *name, boo
     return symbol;
 }
 
+const symbol_t *symbol_table_define_module_global_at(symbol_table_t *table, const char *name, int ix, bool assignable) {
+    if (table->outer != NULL || ptrarray_count(table->block_scopes) != 1) {
+        return NULL;
+    }
+    if (strchr(name, ':') || APE_STREQ(name, "this") || global_store_get_symbol(table->global_store, name)) {
+        return NULL;
+    }
+    symbol_t *symbol = symbol_make(table->alloc, name, SYMBOL_MODULE_GLOBAL, ix, assignable);
+    if (!symbol) {
+        return NULL;
+    }
+    symbol_t *global_symbol_copy = symbol_copy(symbol);
+    if (!global_symbol_copy) {
+        symbol_destroy(symbol);
+        return NULL;
+    }
+    bool ok = ptrarray_add(table->module_global_symbols, global_symbol_copy);
+    if (!ok) {
+        symbol_destroy(global_symbol_copy);
+        symbol_destroy(symbol);
+        return NULL;
+    }
+    ok = set_symbol(table, symbol);
+    if (!ok) {
+        ptrarray_pop(table->module_global_symbols);
+        symbol_destroy(global_symbol_copy);
+        symbol_destroy(symbol);
+        return NULL;
+    }
+    return symbol;
+}
+
 const symbol_t *symbol_table_define_free(symbol_table_t *st, const symbol_t *original) {
     symbol_t *copy = symbol_make(st->alloc, original->name, original->type, original->index, original->assignable);
     if (!copy) {
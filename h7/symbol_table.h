@@ -54,6 +54,8 @@ APE_INTERNAL void symbol_table_destroy(symbol_table_t *st);
 APE_INTERNAL symbol_table_t* symbol_table_copy(symbol_table_t *st);
 APE_INTERNAL bool symbol_table_add_module_symbol(symbol_table_t *st, symbol_t *symbol);
 APE_INTERNAL const symbol_t *symbol_table_define(symbol_table_t *st, const char *name, bool assignable);
+// Defines a global of the top level scope at an index the caller reserved, without counting it as a definition.
+APE_INTERNAL const symbol_t *symbol_table_define_module_global_at(symbol_table_t *st, const char *name, int ix, bool assignable);
 APE_INTERNAL const symbol_t *symbol_table_define_free(symbol_table_t *st, const symbol_t *original);
 APE_INTERNAL const symbol_t *symbol_table_define_function_name(symbol_table_t *st, const char *name, bool assignable);
 APE_INTERNAL const symbol_t *symbol_table_define_this(symbol_table_t *st);
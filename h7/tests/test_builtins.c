@@ -0,0 +1,155 @@
+#include "test_builtins.h"
+
+#include <assert.h>
+#include <stdio.h>
+
+#include "common.h"
+#include "tests.h"
+
+static void test_sort(void);
+static void test_sort_comparator_errors(void);
+static void test_copy_on_write(void);
+static void test_reverse(void);
+static void test_ranges(void);
+
+void builtins_test() {
+    puts("### Builtins test");
+    test_sort();
+    test_sort_comparator_errors();
+    test_copy_on_write();
+    test_reverse();
+    test_ranges();
+    puts("\tOK");
+}
+
+// INTERNAL
+static void test_sort() {
+    check_result("var a = [3, 1, 2]; var res = [sort(a), a]", "[[1, 2, 3], [3, 1, 2]]");
+    check_result("var res = sort([\"b\", \"ab\", \"a\", \"\"])", "[\"\", \"a\", \"ab\", \"b\"]");
+    check_result("var res = sort([])", "[]");
+    check_result("var res = sort(range(5, 0, -1))", "[1, 2, 3, 4, 5]");
+    check_result("var res = sort([3, 1, 2], fn(a, b) { return b - a })", "[3, 2, 1]");
+    check_result("var res = sort_stable([2.5, -1, 1e10, 0])", "[-1, 0, 2.5, 10000000000]");
+
+    // long enough to go past the insertion sort cut-off of both sorts
+    const char *check_sorted =
+        "var a = []\n"
+        "var x = 12345\n"
+        "for (i in range(1000)) { x = (x * 1103515245 + 12345) % 65536; append(a, x % 100) }\n"
+        "var s = sort(a)\n"
+        "var ok = len(s) == len(a)\n"
+        "for (i in range(1, len(s))) { if (s[i - 1] > s[i]) { ok = false } }\n"
+        "var res = ok\n";
+    check_result(check_sorted, "true");
+
+    // equal keys keep their original order, the index is the second item
+    const char *check_stable =
+        "var a = []\n"
+        "for (i in range(1000)) { append(a, [i % 7, i]) }\n"
+        "var s = sort_stable(a, fn(x, y) { return x[0] - y[0] })\n"
+        "var ok = true\n"
+        "for (i in range(1, len(s))) {\n"
+        "    if (s[i - 1][0] > s[i][0] || (s[i - 1][0] == s[i][0] && s[i - 1][1] > s[i][1])) { ok = false }\n"
+        "}\n"
+        "var res = ok\n";
+    check_result(check_stable, "true");
+}
+
+static void test_sort_comparator_errors() {
+    check_result("var res = sort([1, \"a\"])", NULL);
+    check_result("var res = sort([[1], [2]])", NULL);
+    check_result("var res = sort([1, 2, 3], fn(a, b) { return \"a\" })", NULL);
+    check_result("var res = sort_stable([1, 2, 3], fn(a, b) { return null })", NULL);
+    check_result("var res = sort([1, 2, 3], fn(a, b) { return a.x })", NULL);
+    check_result("var res = sort_stable([1, 2, 3], fn(a) { return 0 })", NULL);
+
+    // a comparator that doesn't give consistent answers mustn't break the sort
+    check_result("var res = len(sort(range(200), fn(a, b) { return random() - 0.5 }))", "200");
+    check_result("var res = len(sort_stable(range(200), fn(a, b) { return random() - 0.5 }))", "200");
+
+    // comparators recursing through sort run out of nested calls before the C stack runs out
+    const char *recurse_through_sort =
+        "fn r(n) { return sort([2, 1], fn(a, b) { return r(n + 1) }) }\n"
+        "fn go() {\n"
+        "    recover (e) { return is_error(e) }\n"
+        "    r(0)\n"
+        "    return false\n"
+        "}\n"
+        "var res = [go(), go(), sort([2, 1], fn(a, b) { return a - b })]\n";
+    check_result(recurse_through_sort, "[true, true, [1, 2]]");
+    check_result("fn r(n) { return sort([2, 1], fn(a, b) { return r(n + 1) }) }; r(0)", NULL);
+    check_result("fn depth(n) { if (n == 0) { return 0 }; return map([n], fn(x) { return depth(x - 1) + 1 })[0] }\n"
+                 "var res = depth(200)", "200");
+}
+
+static void test_copy_on_write() {
+    // every way of modifying an array, applied to the copy and to the original
+    const char *array_ops[] = {
+        "x[0] = 9", "append(x, 9)", "remove_at(x, 1)", "remove(x, 2)", "push_front(x, 9)", "pop_front(x)",
+    };
+    for (int i = 0; i < APE_ARRAY_LEN(array_ops); i++) {
+        char code[256];
+        snprintf(code, sizeof(code), "var a = [1, 2, 3]; var b = copy(a); var x = b; %s; var res = a", array_ops[i]);
+        check_result(code, "[1, 2, 3]");
+        snprintf(code, sizeof(code), "var a = [1, 2, 3]; var b = copy(a); var x = a; %s; var res = b", array_ops[i]);
+        check_result(code, "[1, 2, 3]");
+    }
+
+    const char *map_ops[] = {
+        "x.a = 9", "x.c = 9", "x[\"a\"] = 9", "remove(x, \"a\")",
+    };
+    for (int i = 0; i < APE_ARRAY_LEN(map_ops); i++) {
+        char code[256];
+        snprintf(code, sizeof(code), "var a = {a: 1, b: 2}; var b = copy(a); var x = b; %s; var res = a", map_ops[i]);
+        check_result(code, "{\"a\": 1, \"b\": 2}");
+        snprintf(code, sizeof(code), "var a = {a: 1, b: 2}; var b = copy(a); var x = a; %s; var res = b", map_ops[i]);
+        check_result(code, "{\"a\": 1, \"b\": 2}");
+    }
+
+    check_result("var a = set([1, 2]); var b = copy(a); append(b, 3); remove(b, 1); var res = [len(a), has(a, 1), len(b)]",
+                 "[2, true, 2]");
+    check_result("var a = [1, 2]; var b = copy(a); var c = copy(b); c[0] = 5; b[1] = 6; var res = [a, b, c]",
+                 "[[1, 2], [1, 6], [5, 2]]");
+    check_result("var a = [1, 2]; var b = copy(a); b[0] = 5; b[1] = 6; a[0] = 7; var res = [a, b]", "[[7, 2], [5, 6]]");
+
+    // deep_copy shares only values that can't be modified, nested containers are copied
+    check_result("var a = {x: [1, 2], y: \"s\"}; var b = deep_copy(a); append(b.x, 3); b.y = \"t\"; var res = [a, b]",
+                 "[{\"x\": [1, 2], \"y\": \"s\"}, {\"x\": [1, 2, 3], \"y\": \"t\"}]");
+    check_result("var a = [[1], [2]]; var b = copy(a); append(b[0], 3); var res = a", "[[1, 3], [2]]");
+
+    // copies outliving the original, the shared storage is freed by whichever goes last
+    check_result("fn f() { var a = []; for (i in range(100)) { append(a, i) }; return copy(a) }\n"
+                 "var copies = []\n"
+                 "for (i in range(50)) { append(copies, f()) }\n"
+                 "var res = reduce(copies, fn(acc, c) { return acc + c[99] }, 0)", "4950");
+}
+
+static void test_reverse() {
+    // reverse used to return null for non empty arrays
+    check_result("var a = [1, \"b\", [3]]; var res = [reverse(a), a]", "[[[3], \"b\", 1], [1, \"b\", [3]]]");
+    check_result("var res = reverse([])", "[]");
+    check_result("var res = reverse([1, 2]); append(res, 0)", "[2, 1, 0]");
+    check_result("var res = reverse(range(1, 4))", "[3, 2, 1]");
+    check_result("var res = reverse(\"abc\")", "\"cba\"");
+    check_result("var res = reverse(\"\")", "\"\"");
+    check_result("var res = reverse(1)", NULL);
+}
+
+static void test_ranges() {
+    check_result("var res = to_array(range(3))", "[0, 1, 2]");
+    check_result("var res = to_array(range(5, 0, -2))", "[5, 3, 1]");
+    check_result("var res = to_array(range(0))", "[]");
+    check_result("var res = to_array(f64_array([1.5, 2]))", "[1.5, 2]");
+    check_result("var res = to_array(set([3, 1, 3]))", "[3, 1]");
+    check_result("var a = [1, 2]; var res = to_array(a); res[0] = 9; res = [a, res]", "[[1, 2], [9, 2]]");
+    check_result("var res = to_array(range(3)); res[0] = 5; append(res, 3)", "[5, 1, 2, 3]");
+    check_result("var res = to_array(1)", NULL);
+
+    check_result("var res = [is_range(range(3)), is_range(range(0)), is_range([0, 1, 2]), is_range(to_array(range(3)))]",
+                 "[true, true, false, false]");
+    check_result("var res = [is_array(range(3)), is_array(to_array(range(3)))]", "[false, true]");
+
+    // ranges are read-only
+    check_result("var res = range(3); res[0] = 1", NULL);
+    check_result("var res = range(3); append(res, 1)", NULL);
+}
@@ -0,0 +1,6 @@
+#ifndef test_builtins_h
+#define test_builtins_h
+
+void builtins_test(void);
+
+#endif /* test_builtins_h */
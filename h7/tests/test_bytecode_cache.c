@@ -0,0 +1,316 @@
+#include "test_bytecode_cache.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "ape.h"
+#include "common.h"
+#include "code.h"
+#include "bytecode_cache.h"
+
+// Files are written to the working directory and removed afterwards.
+#define SOURCE_PATH "bytecode_cache_test.ape"
+#define MODULE_PATH "bytecode_cache_test_module.ape"
+#define SOURCE_CACHE_PATH SOURCE_PATH "c"
+#define MODULE_CACHE_PATH MODULE_PATH "c"
+#define EXPECTED_RES "[-5, 115, \"module\", \"const\"]"
+
+// Header offsets, see bytecode_cache.c
+#define CACHE_SOURCE_HASH_POS 16
+#define CACHE_GLOBALS_HASH_POS 24
+#define CACHE_CHECKSUM_POS 44
+#define CACHE_SECTIONS_POS 48
+#define CACHE_CONSTANTS_SECTION 3
+#define CACHE_CONSTANT_RECORD_SIZE 20
+
+static const char *g_source =
+    "import \"bytecode_cache_test_module\"\n"
+    "\n"
+    "fn add_up(n) {\n"
+    "    var total = 0\n"
+    "    for (i in range(n)) {\n"
+    "        if (i % 2 == 0) { total += bytecode_cache_test_module::square(i) } else { total -= 1 }\n"
+    "    }\n"
+    "    return total\n"
+    "}\n"
+    "fn make_scaler(k) { return fn(x) { return x * k } }\n"
+    "var res = [add_up(1) - 5, make_scaler(23)(5), bytecode_cache_test_module::name, \"const\"]\n";
+
+static const char *g_module_source =
+    "fn square(x) {\n"
+    "    var res = x * x\n"
+    "    return res\n"
+    "}\n"
+    "var name = \"module\"\n";
+
+static void test_save_and_load(void);
+static void test_damaged_files(void);
+static void test_bad_operands(void);
+
+static void run_cached(void);
+static void check_cache_loads(const char *path);
+static void check_cache_replaced(const char *path, const uint8_t *rejected, size_t rejected_size);
+static void write_bytes(const char *path, const uint8_t *data, size_t size);
+static uint8_t* read_bytes(const char *path, size_t *out_size);
+static void remove_files(void);
+static uint32_t get_u32(const uint8_t *data);
+static uint64_t get_u64(const uint8_t *data);
+static void set_u32(uint8_t *data, uint32_t val);
+static void fix_checksum(uint8_t *data, size_t size);
+static bool find_instruction(const char *path, opcode_t op, size_t *out_pos);
+
+void bytecode_cache_test() {
+    puts("### Bytecode cache test");
+    test_save_and_load();
+    test_damaged_files();
+    test_bad_operands();
+    remove_files();
+    puts("\tOK");
+}
+
+// INTERNAL
+static void test_save_and_load() {
+    remove_files();
+    write_bytes(SOURCE_PATH, (const uint8_t*)g_source, strlen(g_source));
+    write_bytes(MODULE_PATH, (const uint8_t*)g_module_source, strlen(g_module_source));
+
+    run_cached();
+    check_cache_loads(SOURCE_CACHE_PATH);
+    check_cache_loads(MODULE_CACHE_PATH);
+
+    // loaded from the caches this time, they're left as they were
+    size_t size_before = 0;
+    uint8_t *before = read_bytes(SOURCE_CACHE_PATH, &size_before);
+    run_cached();
+    size_t size_after = 0;
+    uint8_t *after = read_bytes(SOURCE_CACHE_PATH, &size_after);
+    assert(size_before == size_after && memcmp(before, after, size_before) == 0);
+    free(before);
+    free(after);
+}
+
+static void test_damaged_files() {
+    allocator_t alloc = allocator_make(NULL, NULL, NULL);
+    const char *paths[] = { SOURCE_CACHE_PATH, MODULE_CACHE_PATH };
+    for (int p = 0; p < APE_ARRAY_LEN(paths); p++) {
+        size_t size = 0;
+        uint8_t *valid = read_bytes(paths[p], &size);
+        uint64_t source_hash = get_u64(valid + CACHE_SOURCE_HASH_POS);
+        uint64_t globals_hash = get_u64(valid + CACHE_GLOBALS_HASH_POS);
+
+        // any changed bit is rejected, either by the header checks or by the checksum
+        for (size_t i = 0; i < size; i++) {
+            uint8_t *data = allocator_malloc(&alloc, size);
+            memcpy(data, valid, size);
+            data[i] ^= 1 << (i % 8);
+            assert(bytecode_cache_load_data(&alloc, data, size, source_hash, globals_hash, false) == NULL);
+        }
+        for (size_t len = 0; len < size; len += 1 + len / 2) {
+            uint8_t *data = allocator_malloc(&alloc, size);
+            memcpy(data, valid, size);
+            assert(bytecode_cache_load_data(&alloc, data, len, source_hash, globals_hash, false) == NULL);
+        }
+
+        // damaged files are compiled from source and replaced with a valid cache
+        uint8_t *damaged = malloc(size);
+        memcpy(damaged, valid, size);
+        damaged[size / 2] ^= 0xff;
+        write_bytes(paths[p], damaged, size);
+        run_cached();
+        check_cache_loads(paths[p]);
+
+        write_bytes(paths[p], valid, size / 3);
+        run_cached();
+        check_cache_loads(paths[p]);
+
+        memset(damaged, 0xab, size);
+        write_bytes(paths[p], damaged, size);
+        run_cached();
+        check_cache_loads(paths[p]);
+
+        free(damaged);
+        free(valid);
+    }
+}
+
+static void test_bad_operands() {
+    // operands pointing outside of the cache's constants, globals, code or locals, written with a valid checksum
+    const opcode_t opcodes[] = {
+        OPCODE_CONSTANT, OPCODE_JUMP, OPCODE_JUMP_IF_FALSE, OPCODE_GET_LOCAL, OPCODE_SET_LOCAL,
+        OPCODE_GET_MODULE_GLOBAL, OPCODE_GET_APE_GLOBAL, OPCODE_FUNCTION,
+    };
+    const char *paths[] = { SOURCE_CACHE_PATH, MODULE_CACHE_PATH };
+    int patched_count = 0;
+    for (int p = 0; p < APE_ARRAY_LEN(paths); p++) {
+        for (int i = 0; i < APE_ARRAY_LEN(opcodes); i++) {
+            size_t pos = 0;
+            if (!find_instruction(paths[p], opcodes[i], &pos)) {
+                continue;
+            }
+            size_t size = 0;
+            uint8_t *data = read_bytes(paths[p], &size);
+            int width = opcode_lookup(opcodes[i])->operand_widths[0];
+            memset(data + pos + 1, 0xff, width);
+            fix_checksum(data, size);
+            write_bytes(paths[p], data, size);
+            run_cached();
+            check_cache_replaced(paths[p], data, size);
+            free(data);
+            patched_count++;
+        }
+
+        // closures taking more free values than were pushed for them
+        size_t pos = 0;
+        if (find_instruction(paths[p], OPCODE_FUNCTION, &pos)) {
+            size_t size = 0;
+            uint8_t *data = read_bytes(paths[p], &size);
+            data[pos + 3] = 0xff;
+            fix_checksum(data, size);
+            write_bytes(paths[p], data, size);
+            run_cached();
+            check_cache_replaced(paths[p], data, size);
+            free(data);
+            patched_count++;
+        }
+
+        // functions declaring more arguments than locals
+        size_t size = 0;
+        uint8_t *data = read_bytes(paths[p], &size);
+        uint32_t constants_pos = get_u32(data + CACHE_SECTIONS_POS + CACHE_CONSTANTS_SECTION * 8);
+        uint32_t constants_count = get_u32(data + CACHE_SECTIONS_POS + CACHE_CONSTANTS_SECTION * 8 + 4);
+        for (uint32_t i = 0; i < constants_count; i++) {
+            uint8_t *record = data + constants_pos + i * CACHE_CONSTANT_RECORD_SIZE;
+            if (get_u32(record) == CACHE_CONSTANT_FUNCTION) {
+                set_u32(record + 16, 1000);
+                patched_count++;
+            }
+        }
+        fix_checksum(data, size);
+        write_bytes(paths[p], data, size);
+        run_cached();
+        check_cache_replaced(paths[p], data, size);
+        free(data);
+    }
+    assert(patched_count >= 10);
+}
+
+static void run_cached() {
+    ape_t *ape = ape_make();
+    ape_set_bytecode_cache(ape, true);
+    ape_execute_file(ape, SOURCE_PATH);
+    if (ape_has_errors(ape)) {
+        char *err_str = ape_error_serialize(ape, ape_get_error(ape, 0));
+        fprintf(stderr, "%s\n", err_str);
+        ape_free_allocated(ape, err_str);
+        assert(false);
+    }
+    char *res_str = ape_object_serialize(ape, ape_get_object(ape, "res"));
+    if (!APE_STREQ(res_str, EXPECTED_RES)) {
+        fprintf(stderr, "expected %s, got %s\n", EXPECTED_RES, res_str);
+        assert(false);
+    }
+    ape_free_allocated(ape, res_str);
+    ape_destroy(ape);
+}
+
+static void check_cache_loads(const char *path) {
+    size_t size = 0;
+    uint8_t *data = read_bytes(path, &size);
+    assert(data);
+    allocator_t alloc = allocator_make(NULL, NULL, NULL);
+    bytecode_cache_t *cache = bytecode_cache_load(&alloc, path, get_u64(data + CACHE_SOURCE_HASH_POS),
+                                                  get_u64(data + CACHE_GLOBALS_HASH_POS), false);
+    assert(cache);
+    assert(array_count(cache->codes) > 0);
+    bytecode_cache_destroy(cache);
+    free(data);
+}
+
+static void check_cache_replaced(const char *path, const uint8_t *rejected, size_t rejected_size) {
+    check_cache_loads(path);
+    size_t size = 0;
+    uint8_t *data = read_bytes(path, &size);
+    assert(size != rejected_size || memcmp(data, rejected, size) != 0);
+    free(data);
+}
+
+static bool find_instruction(const char *path, opcode_t op, size_t *out_pos) {
+    size_t size = 0;
+    uint8_t *data = read_bytes(path, &size);
+    allocator_t alloc = allocator_make(NULL, NULL, NULL);
+    bytecode_cache_t *cache = bytecode_cache_load(&alloc, path, get_u64(data + CACHE_SOURCE_HASH_POS),
+                                                  get_u64(data + CACHE_GLOBALS_HASH_POS), false);
+    assert(cache);
+    bool found = false;
+    for (int i = 0; i < array_count(cache->codes) && !found; i++) {
+        const cache_code_t *code = array_get(cache->codes, i);
+        int ip = 0;
+        while (ip < code->count) {
+            opcode_definition_t *def = opcode_lookup(code->bytecode[ip]);
+            assert(def);
+            if (code->bytecode[ip] == op) {
+                *out_pos = (size_t)(code->bytecode - cache->data) + ip;
+                found = true;
+                break;
+            }
+            ip += 1;
+            for (int j = 0; j < def->num_operands; j++) {
+                ip += def->operand_widths[j];
+            }
+        }
+    }
+    bytecode_cache_destroy(cache);
+    free(data);
+    return found;
+}
+
+static void write_bytes(const char *path, const uint8_t *data, size_t size) {
+    FILE *fp = fopen(path, "wb");
+    assert(fp);
+    assert(fwrite(data, 1, size, fp) == size);
+    fclose(fp);
+}
+
+static uint8_t* read_bytes(const char *path, size_t *out_size) {
+    FILE *fp = fopen(path, "rb");
+    if (!fp) {
+        return NULL;
+    }
+    fseek(fp, 0L, SEEK_END);
+    long size = ftell(fp);
+    rewind(fp);
+    uint8_t *data = malloc(size > 0 ? size : 1);
+    assert(data);
+    assert(fread(data, 1, size, fp) == (size_t)size);
+    fclose(fp);
+    *out_size = size;
+    return data;
+}
+
+static void remove_files() {
+    remove(SOURCE_PATH);
+    remove(MODULE_PATH);
+    remove(SOURCE_CACHE_PATH);
+    remove(MODULE_CACHE_PATH);
+}
+
+static uint32_t get_u32(const uint8_t *data) {
+    return (uint32_t)data[0] | ((uint32_t)data[1] << 8) | ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+static uint64_t get_u64(const uint8_t *data) {
+    return (uint64_t)get_u32(data) | ((uint64_t)get_u32(data + 4) << 32);
+}
+
+static void set_u32(uint8_t *data, uint32_t val) {
+    for (int i = 0; i < 4; i++) {
+        data[i] = (uint8_t)(val >> (i * 8));
+    }
+}
+
+static void fix_checksum(uint8_t *data, size_t size) {
+    uint64_t hash = bytecode_cache_hash(data, CACHE_CHECKSUM_POS, 0);
+    hash = bytecode_cache_hash(data + CACHE_SECTIONS_POS, size - CACHE_SECTIONS_POS, hash);
+    set_u32(data + CACHE_CHECKSUM_POS, (uint32_t)(hash ^ (hash >> 32)));
+}
@@ -0,0 +1,6 @@
+#ifndef test_bytecode_cache_h
+#define test_bytecode_cache_h
+
+void bytecode_cache_test(void);
+
+#endif /* test_bytecode_cache_h */
@@ -0,0 +1,233 @@
+#include "test_calls.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "ape.h"
+#include "common.h"
+#include "tests.h"
+
+static void test_handle_calls(void);
+static void test_handle_reassigned_global(void);
+static void test_invalid_handle(void);
+static void test_native_callbacks(void);
+static void test_native_callback_errors(void);
+static void test_deep_recursion(void);
+
+static void check_number(ape_t *ape, ape_object_t obj, double expected);
+static void check_error(ape_t *ape, const char *message);
+static ape_t* make_callbacks_instance(int *calls);
+static ape_object_t apply_fn(ape_t *ape, void *data, int argc, ape_object_t *args);
+
+void calls_test() {
+    puts("### Calls test");
+    test_handle_calls();
+    test_handle_reassigned_global();
+    test_invalid_handle();
+    test_native_callbacks();
+    test_native_callback_errors();
+    test_deep_recursion();
+    puts("\tOK");
+}
+
+// INTERNAL
+static void test_handle_calls() {
+    ape_t *ape = ape_make();
+    ape_execute(ape, "fn add(a, b) { return a + b }");
+    assert(!ape_has_errors(ape));
+
+    ape_function_handle_t add = ape_get_function_handle(ape, "add");
+    assert(ape_function_handle_is_valid(add));
+    check_number(ape, APE_CALL_HANDLE(ape, add, ape_object_make_number(3), ape_object_make_number(4)), 7);
+
+    // results of earlier calls don't pile up on the stack
+    ape_object_t acc = ape_object_make_number(0);
+    for (int i = 0; i < 10000; i++) {
+        acc = APE_CALL_HANDLE(ape, add, acc, ape_object_make_number(i));
+    }
+    check_number(ape, acc, 49995000);
+
+    // builtins and native functions get handles too
+    ape_function_handle_t len = ape_get_function_handle(ape, "len");
+    assert(ape_function_handle_is_valid(len));
+    check_number(ape, APE_CALL_HANDLE(ape, len, ape_object_make_string(ape, "abc")), 3);
+
+    // a failed call doesn't leave its error to the next one
+    APE_CALL_HANDLE(ape, add, ape_object_make_number(1));
+    assert(ape_has_errors(ape));
+    check_number(ape, APE_CALL_HANDLE(ape, add, ape_object_make_number(1), ape_object_make_number(2)), 3);
+
+    ape_destroy(ape);
+}
+
+static void test_handle_reassigned_global() {
+    ape_t *ape = ape_make();
+    ape_execute(ape, "var op = fn(a, b) { return a + b }");
+    assert(!ape_has_errors(ape));
+    ape_function_handle_t op = ape_get_function_handle(ape, "op");
+    assert(ape_function_handle_is_valid(op));
+    check_number(ape, APE_CALL_HANDLE(ape, op, ape_object_make_number(6), ape_object_make_number(7)), 13);
+
+    // the handle refers to the global, so it calls the new value, and the old one is collectable
+    ape_execute(ape, "op = fn(a, b) { return a * b }");
+    assert(!ape_has_errors(ape));
+    ape_collect_garbage(ape);
+    check_number(ape, APE_CALL_HANDLE(ape, op, ape_object_make_number(6), ape_object_make_number(7)), 42);
+
+    ape_destroy(ape);
+}
+
+static void test_invalid_handle() {
+    ape_t *ape = ape_make();
+    ape_execute(ape, "var x = 1");
+    assert(!ape_has_errors(ape));
+
+    ape_function_handle_t missing = ape_get_function_handle(ape, "missing");
+    assert(!ape_function_handle_is_valid(missing));
+    ape_clear_errors(ape);
+
+    ape_function_handle_t x = ape_get_function_handle(ape, "x");
+    assert(!ape_function_handle_is_valid(x));
+    check_error(ape, "Symbol \"x\" is not callable");
+
+    ape_object_t res = APE_CALL_HANDLE(ape, missing, ape_object_make_number(1));
+    assert(ape_object_is_null(res));
+    check_error(ape, "Invalid function handle");
+
+    ape_destroy(ape);
+}
+
+static void test_native_callbacks() {
+    int calls = 0;
+    ape_t *ape = make_callbacks_instance(&calls);
+
+    // closures keep their free variables when called back from a native function
+    ape_object_t res = ape_execute(ape,
+        "fn adder(n) { return fn(x) { return x + n } }\n"
+        "var k = 10\n"
+        "apply(adder(k), 5)\n");
+    check_number(ape, res, 15);
+    assert(calls == 1);
+
+    // callbacks can call natives that call back again, the outer frames stay intact
+    ape_execute(ape,
+        "fn twice_plus_one(x) {\n"
+        "    var y = apply(fn(v) { return v * 2 }, x)\n"
+        "    return y + 1\n"
+        "}\n"
+        "var total = 0\n"
+        "for (i in range(3)) { total += apply(twice_plus_one, i) }\n");
+    check_number(ape, ape_get_object(ape, "total"), 9);
+    assert(calls == 1 + 3 * 2);
+
+    // the callee can also be called from C after the script returned it
+    ape_object_t closure = ape_execute(ape, "adder(100)");
+    assert(!ape_has_errors(ape));
+    check_number(ape, APE_CALL_OBJECT(ape, closure, ape_object_make_number(1)), 101);
+
+    ape_destroy(ape);
+}
+
+static void test_native_callback_errors() {
+    int calls = 0;
+    ape_t *ape = make_callbacks_instance(&calls);
+
+    // an error raised in the callback propagates through the native to recover in the calling script
+    ape_object_t res = ape_execute(ape,
+        "fn f() {\n"
+        "    recover (e) { return is_error(e) }\n"
+        "    apply(fn(x) { crash(\"boom\") }, 1)\n"
+        "    return false\n"
+        "}\n"
+        "f()\n");
+    assert(!ape_has_errors(ape));
+    assert(ape_object_get_type(res) == APE_OBJECT_BOOL && ape_object_get_bool(res));
+
+    // the vm is usable again after recovering
+    res = ape_execute(ape, "apply(fn(x) { return x + 1 }, 1)");
+    check_number(ape, res, 2);
+
+    // and without recover the callback's error is the script's error
+    ape_execute(ape, "apply(fn(x) { crash(\"boom\") }, 1)");
+    check_error(ape, "boom");
+
+    ape_destroy(ape);
+}
+
+static void test_deep_recursion() {
+    // the vm starts with 32 frames and 256 stack values and grows them on demand, also under natives calling back
+    const char *down = "fn down(n) { return n == 0 ? 0 : 1 + down(n - 1) }\n";
+    char code[512];
+    snprintf(code, sizeof(code), "%s"
+             "var r = map(range(50), fn(x) { return down(x * 10) })\n"
+             "var res = [down(10000), r[49]]\n", down);
+    check_result(code, "[10000, 490]");
+
+    // running out of frames is an error the script can recover from, and the vm is usable again afterwards
+    snprintf(code, sizeof(code), "%s"
+             "fn f() {\n"
+             "    recover (e) { return is_error(e) }\n"
+             "    return down(100000)\n"
+             "}\n"
+             "var res = [f(), down(100)]\n", down);
+    check_result(code, "[true, 100]");
+
+    snprintf(code, sizeof(code), "%s"
+             "var res = down(100000)\n", down);
+    check_result(code, NULL);
+
+    ape_t *ape = ape_make();
+    ape_execute(ape, down);
+    ape_execute(ape,
+        "fn f() {\n"
+        "    recover (e) { return e }\n"
+        "    return down(100000)\n"
+        "}\n"
+        "var e = f()\n");
+    assert(!ape_has_errors(ape));
+    ape_object_t err = ape_get_object(ape, "e");
+    assert(ape_object_get_type(err) == APE_OBJECT_ERROR);
+    assert(APE_STREQ(ape_object_get_error_message(err), "Stack overflow, call depth exceeds 65536"));
+    ape_destroy(ape);
+}
+
+static void check_number(ape_t *ape, ape_object_t obj, double expected) {
+    if (ape_has_errors(ape)) {
+        char *err_str = ape_error_serialize(ape, ape_get_error(ape, 0));
+        fprintf(stderr, "%s\n", err_str);
+        ape_free_allocated(ape, err_str);
+        assert(false);
+    }
+    assert(ape_object_get_type(obj) == APE_OBJECT_NUMBER);
+    assert(ape_object_get_number(obj) == expected);
+}
+
+static void check_error(ape_t *ape, const char *message) {
+    assert(ape_errors_count(ape) == 1);
+    const char *err_message = ape_error_get_message(ape_get_error(ape, 0));
+    if (!APE_STREQ(err_message, message)) {
+        fprintf(stderr, "expected error \"%s\", got \"%s\"\n", message, err_message);
+        assert(false);
+    }
+    ape_clear_errors(ape);
+}
+
+static ape_t* make_callbacks_instance(int *calls) {
+    ape_t *ape = ape_make();
+    ape_set_native_function(ape, "apply", apply_fn, calls);
+    return ape;
+}
+
+static ape_object_t apply_fn(ape_t *ape, void *data, int argc, ape_object_t *args) {
+    if (!APE_CHECK_ARGS(ape, true, argc, args, APE_OBJECT_FUNCTION, APE_OBJECT_ANY)) {
+        return ape_object_make_null();
+    }
+    int *calls = (int*)data;
+    (*calls)++;
+    ape_object_t res = APE_CALL_OBJECT(ape, args[0], args[1]);
+    if (ape_has_errors(ape)) {
+        return ape_object_make_null();
+    }
+    return res;
+}
@@ -0,0 +1,6 @@
+#ifndef test_calls_h
+#define test_calls_h
+
+void calls_test(void);
+
+#endif /* test_calls_h */
@@ -0,0 +1,141 @@
+#include "test_module_cache.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "ape.h"
+#include "common.h"
+#include "module_cache.h"
+
+// Written to the working directory and removed afterwards.
+#define MODULE_PATH "module_cache_test_module.ape"
+
+static const char *g_source =
+    "import \"module_cache_test_module\"\n"
+    "var res = [module_cache_test_module::twice(21), module_cache_test_module::name]\n";
+
+static void test_shared_between_instances(void);
+static void test_edited_source(void);
+static void test_clear(void);
+
+static ape_t* make_instance(bool module_cache);
+static void check_import(ape_t *ape, const char *expected);
+static void write_module(const char *name);
+static void check_count(int count);
+static ape_object_t host_zero(ape_t *ape, void *data, int argc, ape_object_t *args);
+
+void module_cache_test() {
+    puts("### Module cache test");
+    ape_clear_module_cache();
+    test_shared_between_instances();
+    test_edited_source();
+    test_clear();
+    ape_clear_module_cache();
+    remove(MODULE_PATH);
+    puts("\tOK");
+}
+
+// INTERNAL
+static void test_shared_between_instances() {
+    write_module("first");
+    ape_t *a = make_instance(true);
+    check_import(a, "[42, \"first\"]");
+    check_count(1);
+
+    // the second instance loads the module compiled by the first one, which is still alive
+    ape_t *b = make_instance(true);
+    check_import(b, "[42, \"first\"]");
+    check_count(1);
+    ape_destroy(a);
+    ape_destroy(b);
+
+    // and it outlives the instances that added it
+    ape_t *c = make_instance(true);
+    check_import(c, "[42, \"first\"]");
+    ape_destroy(c);
+    check_count(1);
+
+    // instances without the cache don't use it, ones with other globals get their own module
+    ape_t *d = make_instance(false);
+    check_import(d, "[42, \"first\"]");
+    ape_destroy(d);
+    ape_t *e = make_instance(true);
+    ape_set_native_function(e, "host_zero", host_zero, NULL);
+    check_import(e, "[42, \"first\"]");
+    ape_destroy(e);
+}
+
+static void test_edited_source() {
+    ape_t *a = make_instance(true);
+    check_import(a, "[42, \"first\"]");
+    ape_destroy(a);
+
+    write_module("second");
+    ape_t *b = make_instance(true);
+    check_import(b, "[42, \"second\"]");
+    ape_destroy(b);
+    check_count(1); // replaces the entry for the old source
+
+    write_module("first");
+    ape_t *c = make_instance(true);
+    check_import(c, "[42, \"first\"]");
+    ape_destroy(c);
+    check_count(1);
+}
+
+static void test_clear() {
+    check_count(1);
+    ape_clear_module_cache();
+    check_count(0);
+
+    ape_t *ape = make_instance(true);
+    check_import(ape, "[42, \"first\"]");
+    ape_destroy(ape);
+    check_count(1);
+}
+
+static ape_t* make_instance(bool module_cache) {
+    ape_t *ape = ape_make();
+    assert(ape);
+    ape_set_module_cache(ape, module_cache);
+    return ape;
+}
+
+static void check_import(ape_t *ape, const char *expected) {
+    ape_execute(ape, g_source);
+    if (ape_has_errors(ape)) {
+        char *err_str = ape_error_serialize(ape, ape_get_error(ape, 0));
+        fprintf(stderr, "%s\n", err_str);
+        ape_free_allocated(ape, err_str);
+        assert(false);
+    }
+    char *res_str = ape_object_serialize(ape, ape_get_object(ape, "res"));
+    if (!APE_STREQ(res_str, expected)) {
+        fprintf(stderr, "expected %s, got %s\n", expected, res_str);
+        assert(false);
+    }
+    ape_free_allocated(ape, res_str);
+}
+
+static void write_module(const char *name) {
+    FILE *fp = fopen(MODULE_PATH, "w");
+    assert(fp);
+    fprintf(fp, "fn twice(x) { return x * 2 }\nvar name = \"%s\"\n", name);
+    fclose(fp);
+}
+
+// nothing is cached where ape has no threads
+static void check_count(int count) {
+#if defined(APE_POSIX)
+    assert(module_cache_count() == count);
+#else
+    (void)count;
+    assert(module_cache_count() == 0);
+#endif
+}
+
+static ape_object_t host_zero(ape_t *ape, void *data, int argc, ape_object_t *args) {
+    (void)ape; (void)data; (void)argc; (void)args;
+    return ape_object_make_number(0);
+}
@@ -0,0 +1,6 @@
+#ifndef test_module_cache_h
+#define test_module_cache_h
+
+void module_cache_test(void);
+
+#endif /* test_module_cache_h */
@@ -0,0 +1,222 @@
+#include "test_numbers.h"
+
+#include <assert.h>
+#include <stdio.h>
+
+#include "ape.h"
+#include "common.h"
+#include "tests.h"
+
+static void test_int_literals(void);
+static void test_int_promotion(void);
+static void test_shifts(void);
+static void test_int_equality(void);
+static void test_numeric_arrays(void);
+static void test_number_formatting(void);
+static void test_number_parsing(void);
+static void test_to_nums(void);
+
+static void check_both(const char *a, const char *op, const char *b, const char *expected);
+
+void numbers_test() {
+    puts("### Numbers test");
+    test_int_literals();
+    test_int_promotion();
+    test_shifts();
+    test_int_equality();
+    test_numeric_arrays();
+    test_number_formatting();
+    test_number_parsing();
+    test_to_nums();
+    puts("\tOK");
+}
+
+// INTERNAL
+// Every case is checked twice, as written (constant folded by the compiler) and with the operands
+// passed through a function (computed by the vm).
+static void check_both(const char *a, const char *op, const char *b, const char *expected) {
+    char code[512];
+    snprintf(code, sizeof(code), "var res = [%s %s %s, is_int(%s %s %s)]", a, op, b, a, op, b);
+    check_result(code, expected);
+    snprintf(code, sizeof(code), "fn id(x) { return x }\nvar res = [id(%s) %s id(%s), is_int(id(%s) %s id(%s))]",
+             a, op, b, a, op, b);
+    check_result(code, expected);
+}
+
+static void test_int_literals() {
+    check_result("var res = [5, 0x5, 0xa, 0xbeef, 0xffffffffffffffff, 0x7fffffffffffffff, 140737488355328, 007]",
+                 "[5, 5, 10, 48879, -1, 9223372036854775807, 140737488355328, 7]");
+    check_result("var res = map([5, 0xbeef, 0xffffffffffffffff, 9223372036854775807, 140737488355328], fn(x) { return is_int(x) })",
+                 "[true, true, true, true, true]");
+
+    // literals with a fraction or an exponent and ints past int64 are doubles
+    check_result("var res = [1.5, 1e3, 1.0, 2e0, 9223372036854775808, 0x10000000000000000]",
+                 "[1.5, 1000, 1, 2, 9223372036854776000, 18446744073709552000]");
+    check_result("var res = map([1.5, 1e3, 1.0, 9223372036854775808, 0x10000000000000000], fn(x) { return is_int(x) })",
+                 "[false, false, false, false, false]");
+}
+
+static void test_int_promotion() {
+    check_both("9007199254740992", "+", "1", "[9007199254740993, true]");
+    check_both("140737488355327", "+", "1", "[140737488355328, true]"); // past the values stored in the handle
+    check_both("-140737488355328", "-", "1", "[-140737488355329, true]");
+    check_both("9223372036854775807", "+", "1", "[9223372036854776000, false]");
+    check_both("(-9223372036854775807 - 1)", "-", "1", "[-9223372036854776000, false]");
+    check_both("4611686018427387904", "*", "2", "[9223372036854776000, false]");
+    check_both("3037000499", "*", "3037000499", "[9223372030926249001, true]");
+    check_both("6", "/", "2", "[3, true]");
+    check_both("7", "/", "2", "[3.5, false]");
+    check_both("1", "/", "0", "[inf, false]");
+    check_both("(-9223372036854775807 - 1)", "/", "-1", "[9223372036854776000, false]");
+    check_both("-7", "%", "3", "[-1, true]");
+    check_both("3", "*", "1.5", "[4.5, false]");
+    check_both("2", "+", "0.0", "[2, false]");
+    check_result("var res = [0xffffffffffffffff, 0x7fffffffffffffff, to_int(\"42\"), to_int(-3.9)]",
+                 "[-1, 9223372036854775807, 42, -3]");
+    check_result("var res = to_int(1e30)", NULL);
+}
+
+static void test_shifts() {
+    check_both("1", "<<", "62", "[4611686018427387904, true]");
+    check_both("1", "<<", "63", "[-9223372036854775808, true]");
+    check_both("1", "<<", "64", "[0, true]");
+    check_both("1", "<<", "-1", "[0, true]");
+    check_both("-8", ">>", "1", "[-4, true]");
+    check_both("-1", ">>", "63", "[-1, true]");
+    check_both("-1", ">>", "64", "[-1, true]");
+    check_both("1", ">>", "64", "[0, true]");
+    check_both("2.5", "<<", "1", "[4, true]");
+    check_both("0xff", "&", "0x0f", "[15, true]");
+    check_both("5", "|", "2", "[7, true]");
+    check_both("5", "^", "1", "[4, true]");
+    check_both("0x7fffffffffffffff", "^", "-1", "[-9223372036854775808, true]");
+}
+
+static void test_int_equality() {
+    check_result("var res = [1 == 1.0, 2 < 2.5, {1: \"a\"}[1.0], 9007199254740993 == 9007199254740992]",
+                 "[true, true, \"a\", false]");
+    check_result("var m = {}; m[1.0] = 1; m[1] = 2; var res = [len(m), m[1]]", "[1, 2]");
+
+    // ints mixed with doubles, 9007199254740993 isn't representable as a double
+    check_both("1", "==", "1.0", "[true, false]");
+    check_both("9007199254740993", "==", "9007199254740992.0", "[false, false]");
+    check_both("9007199254740992.0", "==", "9007199254740993", "[false, false]");
+    check_both("9007199254740993", "!=", "9007199254740992.0", "[true, false]");
+    check_both("9007199254740993", ">", "9007199254740992.0", "[true, false]");
+    check_both("9007199254740992.0", "<", "9007199254740993", "[true, false]");
+    check_both("9007199254740993", "&", "1.0", "[1, true]");
+    check_both("1.0", "|", "9007199254740992", "[9007199254740993, true]");
+    check_both("9007199254740993", "^", "0.5", "[9007199254740993, true]");
+    check_both("9007199254740993", ">>", "1.0", "[4503599627370496, true]");
+}
+
+static void test_numeric_arrays() {
+    check_result("var res = [sum([1, 2, 3]), sum([]), sum([1, 2.5]), sum([0.5, 0.25, 1, 2, 3, 4, 5])]", "[6, 0, 3.5, 15.75]");
+    check_result("var res = [sum([9007199254740993, 1]), is_int(sum([1, 2])), is_int(sum([1, 2.0]))]",
+                 "[9007199254740994, true, false]");
+    check_result("var res = [sum([9223372036854775807, 1]), is_int(sum([9223372036854775807, 1]))]",
+                 "[9223372036854776000, false]");
+    check_result("var res = [dot([1, 2, 3], [4, 5, 6]), dot([0.5, 2], [2, 0.25]), dot([], [])]", "[32, 1.5, 0]");
+    check_result("var res = dot([3037000499, 1], [3037000499, 1])", "9223372030926249002");
+    check_result("var res = [dot([4611686018427387904, 1], [2, 1]), dot([4611686018427387904], [4])]",
+                 "[9223372036854776000, 18446744073709552000]");
+    check_result("var res = [scale([1, 2, 3], 2), scale([1, 2], 0.5), scale([9007199254740993], 1), scale([4611686018427387904], 4)]",
+                 "[[2, 4, 6], [0.5, 1], [9007199254740993], [18446744073709552000]]");
+
+    // the same results as adding and multiplying the items one by one
+    const char *check_same_as_vm =
+        "var a = [9007199254740993, 1, 140737488355328, -3, 2]\n"
+        "var b = [3, 9007199254740993, 7, 140737488355328, -1]\n"
+        "var add = fn(acc, x) { return acc + x }\n"
+        "var products = map(a, fn(x, i) { return x * b[i] })\n"
+        "var res = [sum(a) == reduce(a, add, 0), dot(a, b) == reduce(products, add, 0), sum(a), dot(a, b)]\n";
+    check_result(check_same_as_vm, "[true, true, 9147936743096321, 36591746972385282]");
+
+    // stores clear the flags checked by the fast paths, they're checked again on the next call
+    check_result("var a = array(3); a[0] = 1; a[1] = 2.5; a[2] = 3; var res = sum(a)", "6.5");
+    check_result("var a = [0.5, 1.5]; a[0] = 1; var s = sum(a); a[0] = 0.5; var res = [s, sum(a), dot(a, a)]", "[2.5, 2, 2.5]");
+    check_result("var a = [1, 2]; a[0] = 9007199254740993; var res = sum(a)", "9007199254740995");
+
+    // typed arrays and ranges are read without converting them to arrays
+    check_result("var res = [sum(f64_array(3)), sum(f64_array([0.5, 1, 2.25])), sum(f32_array([0.5, 1.5]))]", "[0, 3.75, 2]");
+    check_result("var res = [sum(u8_array([255, 255])), sum(i32_array([-5, 3])), sum(i64_array([9007199254740993, 1]))]",
+                 "[510, -2, 9007199254740994]");
+    check_result("var res = [sum(range(5)), sum(range(10, 0, -3)), sum(range(0)), is_int(sum(range(5)))]", "[10, 22, 0, true]");
+    check_result("var res = [dot(f64_array([0.5, 2]), [2, 3]), dot(range(4), i32_array([1, 1, 1, 1])), dot(range(3), range(3))]",
+                 "[7, 6, 5]");
+    check_result("var res = [scale(f32_array([1, 2]), 0.5), scale(range(3), 2), scale(i64_array([9007199254740993]), 1)]",
+                 "[[0.5, 1], [0, 2, 4], [9007199254740993]]");
+    check_result("var t = f64_array(1000); for (i in range(1000)) { t[i] = i * 0.5 }; var res = [sum(t), dot(t, t) == dot(to_array(t), to_array(t))]",
+                 "[249750, true]");
+    check_result("var res = dot(f64_array(2), range(3))", NULL);
+
+    check_result("var res = sum([1, \"a\"])", NULL);
+    check_result("var res = sum([true])", NULL);
+    check_result("var res = dot([1, 2], [1])", NULL);
+    check_result("var res = scale([null], 2)", NULL);
+}
+
+// Doubles print as a string that parses back to the same value (the shortest one in almost all cases),
+// with an exponent below 1e-6 and from 1e21 on.
+static void test_number_formatting() {
+    check_result("var res = [-0.0, 0.0 * -1, to_str(-0.0)]", "[-0, -0, \"-0\"]");
+    check_result("var res = [1 / 0, -1 / 0, 0 / 0, to_str(1 / 0), to_str(0 / 0)]", "[inf, -inf, nan, \"inf\", \"nan\"]");
+    check_result("var res = [1e21, -1e21, 1e20, 123456789012345678901.0, to_str(1e21)]",
+                 "[1e+21, -1e+21, 100000000000000000000, 123456789012345680000, \"1e+21\"]");
+    check_result("var res = [0.0000001, 0.000001, 0.0000015, to_str(0.0000001)]",
+                 "[1e-7, 0.000001, 0.0000015, \"1e-7\"]");
+    check_result("var res = [0.1 + 0.2, 0.3, 1 / 3, to_str(0.1 + 0.2)]",
+                 "[0.30000000000000004, 0.3, 0.3333333333333333, \"0.30000000000000004\"]");
+    check_result("var res = [1.7976931348623157e308, 2.5, 100.0]", "[1.7976931348623157e+308, 2.5, 100]");
+    check_result("var xs = [1e23, 5e22, 0.1 + 0.7, 1 / 7, 123.456, 0.000000000001234]\n"
+                 "var res = map(xs, fn(x) { return to_num(to_str(x)) == x })",
+                 "[true, true, true, true, true, true]");
+}
+
+static void test_number_parsing() {
+    // up to 19 significant digits with a mantissa below 2^53 and an exponent within 22 are converted directly
+    check_result("var xs = [\"1\", \"2.5\", \"-0.125\", \"1e3\", \"1E5\", \".5\", \"5.\", \"+7\", \"-0\", \"0.1\", \"4.35\", \"1e22\"]\n"
+                 "var res = map(xs, fn(s) { return to_num(s) })",
+                 "[1, 2.5, -0.125, 1000, 100000, 0.5, 5, 7, -0, 0.1, 4.35, 1e+22]");
+    check_result("var res = [to_num(\"0.1\") == 0.1, to_num(\"4.35\") == 4.35, to_num(\"1e22\") == 1e22, to_num(\"123456789012345678\") == 123456789012345678.0]",
+                 "[true, true, true, true]");
+
+    // everything else is left to strtod: more than 19 digits, mantissas past 2^53, exponents past 22
+    check_result("var xs = [\"12345678901234567890123\", \"0.1234567890123456789\", \"9007199254740993\", \"1e23\", \"1e-300\", \"1e308\", \"1e-400\"]\n"
+                 "var res = map(xs, fn(s) { return to_num(s) })",
+                 "[1.2345678901234568e+22, 0.12345678901234568, 9007199254740992, 9.999999999999999e+22, 1e-300, 1e+308, 0]");
+    check_result("var res = [to_num(\"1e23\") == 1e23, to_num(\"12345678901234567890123\") == 12345678901234567890123.0]",
+                 "[true, true]");
+
+    const char *malformed[] = { "x", "1x", "1e", "1e+", "-", ".", "1.2.3", "--1", "1 ", "1e400" };
+    for (int i = 0; i < APE_ARRAY_LEN(malformed); i++) {
+        char code[128];
+        snprintf(code, sizeof(code), "var res = to_num(\"%s\")", malformed[i]);
+        check_result(code, NULL);
+    }
+}
+
+static void test_to_nums() {
+    check_result("var res = to_nums([\"1\", \"2.5\", \"1e3\", 4, true, false, null])", "[1, 2.5, 1000, 4, 1, 0, 0]");
+    check_result("var res = to_nums([\"9007199254740993\", \"-0.125\", \"12345678901234567890123\"])",
+                 "[9007199254740992, -0.125, 1.2345678901234568e+22]");
+    check_result("var res = to_nums([])", "[]");
+    check_result("var a = [\"1\"]; var res = [to_nums(a), a]", "[[1], [\"1\"]]");
+
+    check_result("var res = to_nums([\"1\", \"x\"])", NULL);
+    check_result("var res = to_nums([\"1e\"])", NULL);
+    check_result("var res = to_nums([\"1\", \"1e400\"])", NULL);
+    check_result("var res = to_nums([1, [2]])", NULL);
+    check_result("var res = to_nums([{}])", NULL);
+    check_result("var res = to_nums(\"1\")", NULL);
+
+    // the error points at the first value that can't be converted
+    ape_t *ape = ape_make();
+    ape_execute(ape, "to_nums([\"1\", \"2\", \"1x\", \"y\"])");
+    assert(ape_errors_count(ape) == 1);
+    assert(APE_STREQ(ape_error_get_message(ape_get_error(ape, 0)), "Cannot convert \"1x\" at index 2 to number"));
+    ape_execute(ape, "to_nums([1, null, [2]])");
+    assert(ape_errors_count(ape) == 1);
+    assert(APE_STREQ(ape_error_get_message(ape_get_error(ape, 0)), "Cannot convert ARRAY at index 2 to number"));
+    ape_destroy(ape);
+}
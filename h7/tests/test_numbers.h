@@ -0,0 +1,6 @@
+#ifndef test_numbers_h
+#define test_numbers_h
+
+void numbers_test(void);
+
+#endif /* test_numbers_h */
@@ -0,0 +1,231 @@
+#include "test_objmap.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "objmap.h"
+#include "object.h"
+#include "collections.h"
+
+#include "tests.h"
+
+static void test_set_get(void);
+static void test_keys_only(void);
+static void test_clear(void);
+static void test_remove_order(void);
+static void test_remove_from_language(void);
+static void test_shared(void);
+
+static void *counted_malloc(void *ctx, size_t size);
+static void counted_free(void *ctx, void *ptr);
+
+void objmap_test() {
+    puts("### Objmap test");
+    test_set_get();
+    test_keys_only();
+    test_clear();
+    test_remove_order();
+    test_remove_from_language();
+    test_shared();
+    puts("\tOK");
+}
+
+// INTERNAL
+static void test_set_get() {
+    // small maps are searched linearly, bigger ones use cells
+    int counts[] = {1, 5, 8, 9, 100, 5000};
+    for (int c = 0; c < APE_ARRAY_LEN(counts); c++) {
+        int count = counts[c];
+        int malloc_count = 0;
+        allocator_t alloc = allocator_make(counted_malloc, counted_free, &malloc_count);
+        objmap_t map;
+        assert(objmap_init(&map, &alloc, 0));
+        for (int i = 0; i < count; i++) {
+            assert(objmap_set(&map, object_make_number(i * 3), object_make_number(i)));
+        }
+        assert(objmap_count(&map) == count);
+        for (int i = 0; i < count; i++) {
+            object_t *val = objmap_get(&map, object_make_number(i * 3));
+            assert(val && object_get_number(*val) == i);
+            assert(!objmap_has(&map, object_make_number(i * 3 + 1)));
+        }
+
+        // overwriting keeps the count and the position
+        assert(objmap_set(&map, object_make_number(0), object_make_number(-1)));
+        assert(objmap_count(&map) == count);
+        assert(object_get_number(objmap_get_key_at(&map, 0)) == 0);
+        assert(object_get_number(objmap_get_value_at(&map, 0)) == -1);
+        for (int i = 1; i < count; i++) {
+            assert(object_get_number(objmap_get_key_at(&map, i)) == i * 3);
+        }
+
+        assert(objmap_set_value_at(&map, count - 1, object_make_bool(true)));
+        assert(object_get_bool(*objmap_get(&map, object_make_number((count - 1) * 3))));
+
+        objmap_deinit(&map);
+        assert(malloc_count == 0);
+    }
+}
+
+static void test_keys_only() {
+    int malloc_count = 0;
+    allocator_t alloc = allocator_make(counted_malloc, counted_free, &malloc_count);
+    objmap_t set;
+    assert(objmap_init_keys_only(&set, &alloc, 0));
+    for (int i = 0; i < 1000; i++) {
+        assert(objmap_set(&set, object_make_number(i % 100), object_make_null()));
+    }
+    assert(objmap_count(&set) == 100);
+    assert(objmap_get_values(&set) == NULL);
+    assert(objmap_has(&set, object_make_number(99)));
+    assert(!objmap_has(&set, object_make_number(100)));
+    // numbers with the same value are the same key, bools aren't numbers
+    assert(objmap_set(&set, object_make_bool(true), object_make_null()));
+    assert(objmap_count(&set) == 101);
+    assert(objmap_has(&set, object_make_bool(true)));
+    assert(!objmap_has(&set, object_make_bool(false)));
+    objmap_deinit(&set);
+    assert(malloc_count == 0);
+}
+
+static void test_clear() {
+    int malloc_count = 0;
+    allocator_t alloc = allocator_make(counted_malloc, counted_free, &malloc_count);
+    objmap_t map;
+    assert(objmap_init(&map, &alloc, 16));
+    for (int i = 0; i < 50; i++) {
+        assert(objmap_set(&map, object_make_number(i), object_make_number(i)));
+    }
+    objmap_clear(&map);
+    assert(objmap_count(&map) == 0);
+    assert(!objmap_has(&map, object_make_number(1)));
+    for (int i = 0; i < 50; i++) {
+        assert(objmap_set(&map, object_make_number(i + 100), object_make_number(i)));
+    }
+    assert(objmap_count(&map) == 50);
+    assert(object_get_number(objmap_get_key_at(&map, 0)) == 100);
+    objmap_deinit(&map);
+    assert(malloc_count == 0);
+}
+
+static void test_remove_order() {
+    // removes and inserts are checked against a plain array of keys in insertion order
+    int counts[] = {6, 8, 40, 3000};
+    for (int c = 0; c < APE_ARRAY_LEN(counts); c++) {
+        int count = counts[c];
+        int malloc_count = 0;
+        allocator_t alloc = allocator_make(counted_malloc, counted_free, &malloc_count);
+        int *expected = malloc(sizeof(int) * count * 2);
+        int expected_count = 0;
+        int next_key = 0;
+        objmap_t map;
+        assert(objmap_init(&map, &alloc, 0));
+        for (int i = 0; i < count; i++) {
+            assert(objmap_set(&map, object_make_number(next_key), object_make_number(next_key * 2)));
+            expected[expected_count++] = next_key++;
+        }
+
+        unsigned int x = 12345;
+        for (int round = 0; round < count * 2; round++) {
+            x = x * 1103515245 + 12345;
+            if ((x >> 16) % 3 != 0 && expected_count > 0) {
+                int ix = (x >> 8) % expected_count;
+                assert(objmap_remove(&map, object_make_number(expected[ix])));
+                assert(!objmap_remove(&map, object_make_number(expected[ix])));
+                assert(!objmap_has(&map, object_make_number(expected[ix])));
+                memmove(expected + ix, expected + ix + 1, sizeof(int) * (expected_count - ix - 1));
+                expected_count--;
+            } else if (expected_count < count * 2) {
+                assert(objmap_set(&map, object_make_number(next_key), object_make_number(next_key * 2)));
+                expected[expected_count++] = next_key++;
+            }
+            assert(objmap_count(&map) == expected_count);
+
+            // checking the order compacts the map, so only do it every few rounds to also test lookups past removed slots
+            if (round % 7 == 0 || expected_count < 10) {
+                for (int i = 0; i < expected_count; i++) {
+                    assert(object_get_number(objmap_get_key_at(&map, i)) == expected[i]);
+                    assert(object_get_number(objmap_get_value_at(&map, i)) == expected[i] * 2);
+                }
+            } else {
+                for (int i = 0; i < expected_count; i++) {
+                    object_t *val = objmap_get(&map, object_make_number(expected[i]));
+                    assert(val && object_get_number(*val) == expected[i] * 2);
+                }
+            }
+        }
+
+        objmap_deinit(&map);
+        free(expected);
+        assert(malloc_count == 0);
+    }
+}
+
+static void test_remove_from_language() {
+    check_result("var m = {a: 1, b: 2, c: 3, d: 4}; remove(m, \"b\"); m.e = 5; var res = keys(m)",
+                 "[\"a\", \"c\", \"d\", \"e\"]");
+    check_result("var m = {a: 1, b: 2, c: 3}; remove(m, \"a\"); m.a = 6; var res = [keys(m), values(m)]",
+                 "[[\"b\", \"c\", \"a\"], [2, 3, 6]]");
+    check_result("var m = {}\n"
+                 "for (i in range(100)) { m[i] = i }\n"
+                 "for (i in range(0, 100, 2)) { remove(m, i) }\n"
+                 "var res = [len(m), keys(m)[0], keys(m)[49], m[51]]",
+                 "[50, 1, 99, 51]");
+}
+
+static void test_shared() {
+    int malloc_count = 0;
+    allocator_t alloc = allocator_make(counted_malloc, counted_free, &malloc_count);
+    objmap_t a;
+    assert(objmap_init(&a, &alloc, 0));
+    for (int i = 0; i < 20; i++) {
+        assert(objmap_set(&a, object_make_number(i), object_make_number(i)));
+    }
+    assert(objmap_remove(&a, object_make_number(3)));
+
+    objmap_t b, c;
+    assert(objmap_init_shared(&b, &a));
+    assert(objmap_init_shared(&c, &a));
+    assert(objmap_is_shared(&a) && objmap_is_shared(&b));
+    assert(malloc_count == 1);
+
+    assert(objmap_set(&b, object_make_number(100), object_make_number(100)));
+    assert(objmap_remove(&c, object_make_number(0)));
+    assert(objmap_set_value_at(&a, 0, object_make_number(-1)));
+    assert(!objmap_is_shared(&a) && !objmap_is_shared(&b) && !objmap_is_shared(&c));
+
+    assert(objmap_count(&a) == 19 && objmap_count(&b) == 20 && objmap_count(&c) == 18);
+    assert(object_get_number(*objmap_get(&a, object_make_number(0))) == -1);
+    assert(object_get_number(*objmap_get(&b, object_make_number(0))) == 0);
+    assert(!objmap_has(&a, object_make_number(100)) && !objmap_has(&c, object_make_number(100)));
+    assert(!objmap_has(&c, object_make_number(0)) && objmap_has(&b, object_make_number(0)));
+    assert(!objmap_has(&b, object_make_number(3)));
+
+    // the last map to release a shared block frees it
+    objmap_t d;
+    assert(objmap_init_shared(&d, &b));
+    objmap_deinit(&b);
+    assert(object_get_number(objmap_get_key_at(&d, 19)) == 100);
+    objmap_deinit(&a);
+    objmap_deinit(&c);
+    objmap_deinit(&d);
+    assert(malloc_count == 0);
+}
+
+static void *counted_malloc(void *ctx, size_t size) {
+    int *malloc_count = (int*)ctx;
+    void *res = malloc(size);
+    if (res != NULL) {
+        (*malloc_count)++;
+    }
+    return res;
+}
+
+static void counted_free(void *ctx, void *ptr) {
+    int *malloc_count = (int*)ctx;
+    if (ptr != NULL) {
+        (*malloc_count)--;
+    }
+    free(ptr);
+}
@@ -0,0 +1,6 @@
+#ifndef test_objmap_h
+#define test_objmap_h
+
+void objmap_test(void);
+
+#endif /* test_objmap_h */
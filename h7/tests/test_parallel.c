@@ -0,0 +1,244 @@
+#include "test_parallel.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "ape.h"
+#include "common.h"
+#include "tests.h"
+
+#define JOBS_COUNT 200
+
+typedef struct pool_job_result {
+    bool called;
+    bool failed;
+    double number;
+    int array_length;
+} pool_job_result_t;
+
+static const char *g_pool_program =
+    "var calls = 0\n"
+    "fn work(n, items) {\n"
+    "    calls += 1\n"
+    "    var total = 0\n"
+    "    for (x in items) { total += x }\n"
+    "    return host_scale(n * n + total)\n"
+    "}\n"
+    "fn with_calls() { calls += 1; return calls }\n"
+    "fn copy_back(arr, m) { append(arr, len(m)); return arr }\n"
+    "fn fail(n) { crash(\"failed \" + to_str(n)) }\n";
+
+static void test_pool_results(void);
+static void test_pool_isolates(void);
+static void test_pool_errors(void);
+static void test_parallel_map(void);
+static void test_parallel_map_errors(void);
+
+static void pool_setup(ape_t *ape, void *context);
+static void store_result(ape_t *ape, ape_object_t result, void *context);
+static ape_object_t host_scale_fun(ape_t *ape, void *data, int argc, ape_object_t *args);
+static ape_shared_program_t* compile_pool_program(ape_t *ape);
+
+void parallel_test() {
+    puts("### Parallel test");
+    test_pool_results();
+    test_pool_isolates();
+    test_pool_errors();
+    test_parallel_map();
+    test_parallel_map_errors();
+    puts("\tOK");
+}
+
+// INTERNAL
+static void test_pool_results() {
+    ape_t *ape = ape_make();
+    ape_shared_program_t *program = compile_pool_program(ape);
+    ape_pool_t *pool = ape_pool_make(4, pool_setup, NULL);
+    if (!pool) { // no threads on the platform
+        ape_shared_program_destroy(program);
+        ape_destroy(ape);
+        return;
+    }
+
+    pool_job_result_t results[JOBS_COUNT];
+    memset(results, 0, sizeof(results));
+    for (int i = 0; i < JOBS_COUNT; i++) {
+        ape_object_t args[2];
+        args[0] = ape_object_make_number(i);
+        args[1] = ape_object_make_array(ape);
+        for (int j = 0; j < i % 5; j++) {
+            ape_object_add_array_number(args[1], j);
+        }
+        assert(ape_pool_submit(pool, program, "work", 2, args, store_result, &results[i]));
+    }
+    ape_pool_wait(pool);
+    for (int i = 0; i < JOBS_COUNT; i++) {
+        int total = 0;
+        for (int j = 0; j < i % 5; j++) {
+            total += j;
+        }
+        assert(results[i].called && !results[i].failed);
+        assert(results[i].number == (i * i + total) * 2);
+    }
+
+    // arguments are copied when submitting, containers and all
+    pool_job_result_t copy_result;
+    memset(&copy_result, 0, sizeof(copy_result));
+    ape_object_t args[2];
+    args[0] = ape_object_make_array(ape);
+    ape_object_add_array_number(args[0], 1);
+    args[1] = ape_object_make_map(ape);
+    ape_object_set_map_number(args[1], "a", 1);
+    ape_object_set_map_string(args[1], "b", "str");
+    assert(ape_pool_submit(pool, program, "copy_back", 2, args, store_result, &copy_result));
+    ape_object_add_array_number(args[0], 2);
+    ape_object_add_array_number(args[0], 3);
+    ape_pool_wait(pool);
+    assert(copy_result.called && !copy_result.failed && copy_result.array_length == 2);
+    assert(ape_object_get_array_length(args[0]) == 3);
+
+    ape_pool_destroy(pool);
+    ape_shared_program_destroy(program);
+    ape_destroy(ape);
+}
+
+static void test_pool_isolates() {
+    ape_t *ape = ape_make();
+    ape_shared_program_t *program = compile_pool_program(ape);
+    ape_pool_t *pool = ape_pool_make(1, pool_setup, NULL);
+    if (!pool) {
+        ape_shared_program_destroy(program);
+        ape_destroy(ape);
+        return;
+    }
+
+    // a single worker keeps its isolate between jobs, globals persist there but not in the compiling instance
+    pool_job_result_t results[10];
+    memset(results, 0, sizeof(results));
+    for (int i = 0; i < APE_ARRAY_LEN(results); i++) {
+        assert(ape_pool_submit(pool, program, "with_calls", 0, NULL, store_result, &results[i]));
+    }
+    ape_pool_wait(pool);
+    for (int i = 0; i < APE_ARRAY_LEN(results); i++) {
+        assert(results[i].called && results[i].number == i + 1);
+    }
+    ape_execute_shared_program(ape, program);
+    assert(ape_object_get_number(ape_get_object(ape, "calls")) == 0);
+
+    ape_pool_destroy(pool);
+    ape_shared_program_destroy(program);
+    ape_destroy(ape);
+}
+
+static void test_pool_errors() {
+    ape_t *ape = ape_make();
+    ape_shared_program_t *program = compile_pool_program(ape);
+    ape_pool_t *pool = ape_pool_make(2, pool_setup, NULL);
+    if (!pool) {
+        ape_shared_program_destroy(program);
+        ape_destroy(ape);
+        return;
+    }
+
+    pool_job_result_t results[3];
+    memset(results, 0, sizeof(results));
+    ape_object_t arg = ape_object_make_number(1);
+    assert(ape_pool_submit(pool, program, "fail", 1, &arg, store_result, &results[0]));
+    assert(ape_pool_submit(pool, program, "missing_function", 0, NULL, store_result, &results[1]));
+    assert(ape_pool_submit(pool, program, "work", 1, &arg, store_result, &results[2])); // wrong number of arguments
+
+    // functions and external values can't be passed to another instance
+    ape_execute(ape, "fn f() {}");
+    ape_object_t fn_arg = ape_get_object(ape, "f");
+    assert(!ape_pool_submit(pool, program, "fail", 1, &fn_arg, store_result, NULL));
+    int data = 0;
+    ape_object_t external_arg = ape_object_make_external(ape, &data);
+    assert(!ape_pool_submit(pool, program, "fail", 1, &external_arg, store_result, NULL));
+
+    ape_pool_destroy(pool); // waits for the jobs
+    for (int i = 0; i < APE_ARRAY_LEN(results); i++) {
+        assert(results[i].called && results[i].failed);
+    }
+
+    ape_shared_program_destroy(program);
+    ape_destroy(ape);
+}
+
+static void test_parallel_map() {
+    // results are compared with map's, for chunks of one item, uneven chunks and the default size
+    const char *chunk_sizes[] = { "1", "7", "1000", "null" };
+    for (int i = 0; i < APE_ARRAY_LEN(chunk_sizes); i++) {
+        char code[1024];
+        snprintf(code, sizeof(code),
+                 "var g = {offset: 3, names: [\"a\", \"b\"]}\n"
+                 "fn f(x, i) { return [x * x + i + g.offset, g.names[x %% 2], {n: x}] }\n"
+                 "var a = parallel_map(range(1000), f, %s)\n"
+                 "var b = map(range(1000), f)\n"
+                 "var res = [len(a), to_str(a) == to_str(b)]\n", chunk_sizes[i]);
+        check_result(code, "[1000, true]");
+    }
+    check_result("var res = parallel_map([], fn(x) { return x })", "[]");
+    check_result("var res = parallel_map([1, 2, 3], fn(x) { return x * 2 })", "[2, 4, 6]");
+    check_result("var t = f64_array(500); t[499] = 0.5\n"
+                 "var res = parallel_map(t, fn(x, i) { return x + i })[499]", "499.5");
+    check_result("var res = reduce(parallel_map(set(range(600)), fn(x) { return x }), fn(a, x) { return a + x }, 0)",
+                 "179700");
+    check_result("struct point { x, y }\n"
+                 "var res = parallel_map(range(300), fn(x) { return point(x, -x) })[299]", "point{x: 299, y: -299}");
+
+    // random depends on the seed and the item's index only
+    check_result("random_seed(5); var a = parallel_map(range(500), fn(x) { return random() }, 1)\n"
+                 "random_seed(5); var b = parallel_map(range(500), fn(x) { return random() }, 97)\n"
+                 "random_seed(5); var c = parallel_map(range(5), fn(x) { return random() })\n"
+                 "var res = [to_str(a) == to_str(b), a[4] == c[4], a[0] != a[1]]", "[true, true, true]");
+}
+
+static void test_parallel_map_errors() {
+    check_result("var res = parallel_map(range(10), 1)", NULL);
+    check_result("var res = parallel_map(range(10), fn(x) { return x }, 0)", NULL);
+    check_result("var res = parallel_map(1, fn(x) { return x })", NULL);
+
+    // the error for the lowest failing index is reported, wherever it was raised
+    ape_t *ape = ape_make();
+    ape_execute(ape, "var res = parallel_map(range(1000), fn(x) {\n"
+                     "    if (x == 300 || x == 700 || x == 999) { crash(\"failed at \" + to_str(x)) }\n"
+                     "    return x\n"
+                     "}, 10)\n");
+    assert(ape_has_errors(ape));
+    assert(APE_STREQ(ape_error_get_message(ape_get_error(ape, 0)), "failed at 300"));
+    ape_destroy(ape);
+}
+
+static void pool_setup(ape_t *ape, void *context) {
+    (void)context;
+    ape_set_native_function(ape, "host_scale", host_scale_fun, NULL);
+}
+
+static void store_result(ape_t *ape, ape_object_t result, void *context) {
+    pool_job_result_t *res = context;
+    assert(res);
+    res->called = true;
+    res->failed = !ape || ape_has_errors(ape);
+    if (ape_object_get_type(result) == APE_OBJECT_NUMBER) {
+        res->number = ape_object_get_number(result);
+    } else if (ape_object_get_type(result) == APE_OBJECT_ARRAY) {
+        res->array_length = ape_object_get_array_length(result);
+    }
+}
+
+static ape_object_t host_scale_fun(ape_t *ape, void *data, int argc, ape_object_t *args) {
+    (void)data;
+    if (argc != 1) {
+        ape_set_runtime_error(ape, "Invalid number of arguments");
+        return ape_object_make_null();
+    }
+    return ape_object_make_number(ape_object_get_number(args[0]) * 2);
+}
+
+static ape_shared_program_t* compile_pool_program(ape_t *ape) {
+    ape_set_native_function(ape, "host_scale", host_scale_fun, NULL);
+    ape_shared_program_t *program = ape_compile_shared(ape, g_pool_program);
+    assert(program && !ape_has_errors(ape));
+    return program;
+}
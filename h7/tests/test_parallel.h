@@ -0,0 +1,6 @@
+#ifndef test_parallel_h
+#define test_parallel_h
+
+void parallel_test(void);
+
+#endif /* test_parallel_h */
@@ -181,7 +181,7 @@ static void test_string() {
     statement_t *stmt = statement_make_define(NULL, ident_make(NULL, (token_t){
         .literal = "myVar",
         .len = strlen("myVar")
-    }), expr, false);
+    }), TOKEN_CONST, expr, false);
 
     ptrarray_add(statements, stmt);
 
@@ -326,6 +326,10 @@ static void test_prefix_expressions() {
 }
 
 static void test_number_literal(expression_t *expr, double expected) {
+    if (expr->type == EXPRESSION_INT_LITERAL) {
+        assert(APE_DBLEQ((double)expr->int_literal, expected));
+        return;
+    }
     assert(expr->type == EXPRESSION_NUMBER_LITERAL);
     assert(APE_DBLEQ(expr->number_literal, expected));
 }
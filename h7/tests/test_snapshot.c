@@ -0,0 +1,161 @@
+#include "test_snapshot.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "ape.h"
+#include "common.h"
+
+static void test_round_trip(void);
+static void test_instances_are_isolated(void);
+static void test_unsupported_values(void);
+
+static void check_execute(ape_t *ape, const char *code, const char *expected);
+static ape_object_t add_fun(ape_t *ape, void *data, int argc, ape_object_t *args);
+static void *counted_malloc(void *ctx, size_t size);
+static void counted_free(void *ctx, void *ptr);
+
+static const char *g_init_code =
+    "struct vec2 { x, y }\n"
+    "var nums = [1, 2.5, -3, 9223372036854775807, 140737488355328, true, null, \"str\"]\n"
+    "var shared = [1, 2]\n"
+    "var holder = {a: shared, b: shared, nested: {list: [shared]}}\n"
+    "var cycle = {name: \"cycle\"}\n"
+    "cycle.self = cycle\n"
+    "var s = set([1, \"a\", false])\n"
+    "var t = i32_array(3)\n"
+    "t[1] = -7\n"
+    "var v = vec2(1, 2)\n"
+    "var counter = 0\n"
+    "fn next() { counter += 1; return counter }\n"
+    "fn make_adder(n) { return fn(x) { return add(x, n) } }\n"
+    "var add10 = make_adder(10)\n"
+    "next()\n";
+
+void snapshot_test() {
+    puts("### Snapshot test");
+    test_round_trip();
+    test_instances_are_isolated();
+    test_unsupported_values();
+    puts("\tOK");
+}
+
+// INTERNAL
+static void test_round_trip() {
+    int malloc_count = 0;
+    ape_t *ape = ape_make_ex(counted_malloc, counted_free, &malloc_count);
+    ape_set_native_function(ape, "add", add_fun, NULL);
+    ape_execute(ape, g_init_code);
+    assert(!ape_has_errors(ape));
+
+    ape_snapshot_t *snapshot = ape_snapshot_make(ape);
+    assert(snapshot);
+
+    ape_t *copy = ape_make_from_snapshot(snapshot);
+    assert(copy);
+    check_execute(copy, "var res = nums", "[1, 2.5, -3, 9223372036854775807, 140737488355328, true, null, \"str\"]");
+    check_execute(copy, "var res = [is_int(nums[3]), is_int(nums[1])]", "[true, false]");
+    check_execute(copy, "var res = [len(s), has(s, \"a\"), has(s, false), t[1], len(t)]", "[3, true, true, -7, 3]");
+    check_execute(copy, "var res = [v.x + v.y, is_struct(v, vec2), vec2(5).x]", "[3, true, 5]");
+    check_execute(copy, "var res = [next(), next(), counter]", "[2, 3, 3]");
+    check_execute(copy, "var res = [add10(5), make_adder(1)(1)]", "[15, 2]");
+
+    // references between values and cycles are kept
+    check_execute(copy, "append(shared, 3); var res = [holder.a, holder.b, holder.nested.list[0]]",
+                  "[[1, 2, 3], [1, 2, 3], [1, 2, 3]]");
+    check_execute(copy, "var res = [cycle.self.self.name, cycle.self == cycle]", "[\"cycle\", true]");
+
+    ape_destroy(copy);
+    ape_snapshot_destroy(snapshot);
+    ape_destroy(ape);
+    assert(malloc_count == 0);
+}
+
+static void test_instances_are_isolated() {
+    int malloc_count = 0;
+    ape_t *ape = ape_make_ex(counted_malloc, counted_free, &malloc_count);
+    ape_set_native_function(ape, "add", add_fun, NULL);
+    ape_execute(ape, g_init_code);
+    assert(!ape_has_errors(ape));
+    ape_snapshot_t *snapshot = ape_snapshot_make(ape);
+    assert(snapshot);
+
+    ape_t *a = ape_make_from_snapshot(snapshot);
+    ape_t *b = ape_make_from_snapshot(snapshot);
+    assert(a && b);
+    check_execute(a, "append(shared, 3); cycle.name = \"changed\"; next(); t[0] = 5; var res = counter", "2");
+    check_execute(b, "var res = [shared, cycle.name, counter, t[0]]", "[[1, 2], \"cycle\", 1, 0]");
+    check_execute(ape, "var res = [shared, cycle.name, counter, t[0]]", "[[1, 2], \"cycle\", 1, 0]");
+
+    // the snapshot doesn't change when the instance that made it does
+    check_execute(ape, "append(shared, 4); next(); var res = counter", "2");
+    ape_t *c = ape_make_from_snapshot(snapshot);
+    assert(c);
+    check_execute(c, "var res = [shared, counter]", "[[1, 2], 1]");
+
+    // instances made from a snapshot collect garbage and can be destroyed in any order
+    check_execute(b, "for (i in range(1000)) { holder.tmp = [i] }; var res = holder.tmp", "[999]");
+    ape_collect_garbage(b);
+    ape_destroy(a);
+    check_execute(b, "var res = holder.a", "[1, 2]");
+    ape_destroy(b);
+    ape_destroy(c);
+    ape_snapshot_destroy(snapshot);
+    ape_destroy(ape);
+    assert(malloc_count == 0);
+}
+
+static void test_unsupported_values() {
+    int malloc_count = 0;
+    ape_t *ape = ape_make_ex(counted_malloc, counted_free, &malloc_count);
+    int data = 0;
+    ape_set_global_constant(ape, "ext", ape_object_make_external(ape, &data));
+    assert(!ape_has_errors(ape));
+    assert(ape_snapshot_make(ape) == NULL);
+    assert(ape_has_errors(ape));
+    ape_destroy(ape);
+    assert(malloc_count == 0);
+}
+
+static void check_execute(ape_t *ape, const char *code, const char *expected) {
+    ape_execute(ape, code);
+    if (ape_has_errors(ape)) {
+        char *err_str = ape_error_serialize(ape, ape_get_error(ape, 0));
+        fprintf(stderr, "%s\n%s\n", code, err_str);
+        ape_free_allocated(ape, err_str);
+        assert(false);
+    }
+    char *res_str = ape_object_serialize(ape, ape_get_object(ape, "res"));
+    if (!APE_STREQ(res_str, expected)) {
+        fprintf(stderr, "%s\nexpected %s, got %s\n", code, expected, res_str);
+        assert(false);
+    }
+    ape_free_allocated(ape, res_str);
+}
+
+static ape_object_t add_fun(ape_t *ape, void *data, int argc, ape_object_t *args) {
+    (void)data;
+    if (argc != 2) {
+        ape_set_runtime_error(ape, "Invalid number of arguments");
+        return ape_object_make_null();
+    }
+    return ape_object_make_number(ape_object_get_number(args[0]) + ape_object_get_number(args[1]));
+}
+
+static void *counted_malloc(void *ctx, size_t size) {
+    int *malloc_count = (int*)ctx;
+    void *res = malloc(size);
+    if (res != NULL) {
+        (*malloc_count)++;
+    }
+    return res;
+}
+
+static void counted_free(void *ctx, void *ptr) {
+    int *malloc_count = (int*)ctx;
+    if (ptr != NULL) {
+        (*malloc_count)--;
+    }
+    free(ptr);
+}
@@ -0,0 +1,6 @@
+#ifndef test_snapshot_h
+#define test_snapshot_h
+
+void snapshot_test(void);
+
+#endif /* test_snapshot_h */
@@ -0,0 +1,65 @@
+#include "test_struct.h"
+
+#include <assert.h>
+#include <stdio.h>
+
+#include "tests.h"
+
+static void test_fields(void);
+static void test_operators(void);
+static void test_struct_errors(void);
+
+static void check_vec2(const char *code, const char *expected);
+
+static const char *g_vec2 =
+    "struct vec2 {\n"
+    "    x, y\n"
+    "    fn __operator_add__(a, b) { return vec2(a.x + b.x, a.y + b.y) }\n"
+    "}\n";
+
+void struct_test() {
+    puts("### Struct test");
+    test_fields();
+    test_operators();
+    test_struct_errors();
+    puts("\tOK");
+}
+
+// INTERNAL
+static void check_vec2(const char *code, const char *expected) {
+    char buf[1024];
+    snprintf(buf, sizeof(buf), "%s%s", g_vec2, code);
+    check_result(buf, expected);
+}
+
+static void test_fields() {
+    check_vec2("var res = vec2(1, 2)", "vec2{x: 1, y: 2}");
+    check_vec2("var res = vec2(1)", "vec2{x: 1, y: null}");
+    check_vec2("var v = vec2(1, 2); v.x = 10; var f = \"y\"; v[f] = v[f] * 3; var res = [v.x, v.y, v[\"x\"]]",
+               "[10, 6, 10]");
+    check_vec2("var v = vec2(1, 2); var c = copy(v); c.x = 0; var res = [v.x, c.x]", "[1, 0]");
+    check_vec2("var res = [is_struct(vec2(1, 2)), is_struct(vec2(1, 2), vec2), is_struct({x: 1, y: 2})]",
+               "[true, true, false]");
+    check_vec2("fn len2(v) { return v.x * v.x + v.y * v.y }\n"
+               "var total = 0\n"
+               "for (i in range(100)) { total += len2(vec2(i, 1)) }\n"
+               "var res = total", "328450");
+}
+
+static void test_operators() {
+    check_vec2("var res = vec2(1, 2) + vec2(3, 4)", "vec2{x: 4, y: 6}");
+    check_vec2("var v = vec2(0, 0); for (i in range(10)) { v += vec2(i, 1) }; var res = v", "vec2{x: 45, y: 10}");
+    check_vec2("var res = vec2(1, 2) - vec2(3, 4)", NULL); // only + is declared
+
+    // fields and operators on one line
+    check_result("struct v { x, y fn __operator_add__(a, b) { return v(a.x + b.x, a.y + b.y) } }; var res = v(1, 2) + v(3, 4)",
+                 "v{x: 4, y: 6}");
+}
+
+static void test_struct_errors() {
+    check_vec2("var v = vec2(1, 2); v.z = 1; var res = v", NULL);
+    check_vec2("var res = vec2(1, 2).z", NULL);
+    check_vec2("var res = vec2(1, 2, 3)", NULL);
+    check_result("fn f() { struct a { x } }; var res = 1", NULL);
+    check_result("struct a { x, x }; var res = 1", NULL);
+}
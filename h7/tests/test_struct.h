@@ -0,0 +1,6 @@
+#ifndef test_struct_h
+#define test_struct_h
+
+void struct_test(void);
+
+#endif /* test_struct_h */
@@ -0,0 +1,99 @@
+#include "test_typed_array.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdint.h>
+
+#include "ape.h"
+
+static void test_host_data(void);
+static void test_destroy_once(void);
+
+static void count_destroy(void *data);
+static void check_no_errors(ape_t *ape);
+
+static int g_destroy_count = 0;
+static void *g_destroyed_data = NULL;
+
+void typed_array_test() {
+    puts("### Typed array test");
+    test_host_data();
+    test_destroy_once();
+    puts("\tOK");
+}
+
+// INTERNAL
+static void test_host_data() {
+    ape_t *ape = ape_make();
+    double data[4] = { 1, 2, 3, 4 };
+    ape_object_t buf = ape_object_make_typed_array_with_data(ape, APE_TYPED_ARRAY_F64, data, 4, NULL);
+    assert(ape_object_get_typed_array_data(buf) == data);
+    assert(ape_object_get_typed_array_length(buf) == 4);
+    assert(ape_object_get_typed_array_type(buf) == APE_TYPED_ARRAY_F64);
+    ape_set_global_constant(ape, "buf", buf);
+
+    // script writes land in host memory
+    ape_execute(ape, "buf[0] = 10\nbuf[3] += 0.5\n");
+    check_no_errors(ape);
+    assert(data[0] == 10 && data[1] == 2 && data[2] == 3 && data[3] == 4.5);
+
+    // and host writes are seen by scripts
+    data[1] = 20;
+    ape_execute(ape, "var res = [buf[1], sum(buf), len(buf)]\n");
+    check_no_errors(ape);
+    ape_object_t res = ape_get_object(ape, "res");
+    assert(ape_object_get_array_number(res, 0) == 20);
+    assert(ape_object_get_array_number(res, 1) == 37.5);
+    assert(ape_object_get_array_number(res, 2) == 4);
+
+    // integer types store native values too
+    int32_t ints[3] = { 0 };
+    ape_set_global_constant(ape, "ints", ape_object_make_typed_array_with_data(ape, APE_TYPED_ARRAY_I32, ints, 3, NULL));
+    ape_execute(ape, "for (i in range(3)) { ints[i] = i - 1 }\n");
+    check_no_errors(ape);
+    assert(ints[0] == -1 && ints[1] == 0 && ints[2] == 1);
+
+    ape_destroy(ape);
+}
+
+static void test_destroy_once() {
+    ape_t *ape = ape_make();
+    static float unreachable_data[2];
+    static float global_data[2];
+    g_destroy_count = 0;
+
+    // an array nothing refers to is freed by the next collection
+    ape_object_make_typed_array_with_data(ape, APE_TYPED_ARRAY_F32, unreachable_data, 2, count_destroy);
+    assert(g_destroy_count == 0);
+    ape_collect_garbage(ape);
+    assert(g_destroy_count == 1);
+    assert(g_destroyed_data == unreachable_data);
+    ape_collect_garbage(ape);
+    assert(g_destroy_count == 1);
+
+    // one held by a global lives until the instance is destroyed, and isn't destroyed by copies
+    ape_set_global_constant(ape, "buf", ape_object_make_typed_array_with_data(ape, APE_TYPED_ARRAY_F32, global_data,
+                                                                               2, count_destroy));
+    ape_execute(ape, "var dup = f32_array(buf)\ndup[0] = 1\n");
+    check_no_errors(ape);
+    assert(global_data[0] == 0);
+    ape_collect_garbage(ape);
+    assert(g_destroy_count == 1);
+    ape_destroy(ape);
+    assert(g_destroy_count == 2);
+    assert(g_destroyed_data == global_data);
+}
+
+static void count_destroy(void *data) {
+    g_destroy_count++;
+    g_destroyed_data = data;
+}
+
+static void check_no_errors(ape_t *ape) {
+    if (ape_has_errors(ape)) {
+        char *err_str = ape_error_serialize(ape, ape_get_error(ape, 0));
+        fprintf(stderr, "%s\n", err_str);
+        ape_free_allocated(ape, err_str);
+        assert(false);
+    }
+}
@@ -0,0 +1,6 @@
+#ifndef test_typed_array_h
+#define test_typed_array_h
+
+void typed_array_test(void);
+
+#endif /* test_typed_array_h */
@@ -11,11 +11,35 @@
 //#include "test_vm.h"
 #include "test_symbol_table.h"
 #include "test_api.h"
+#include "test_builtins.h"
+#include "test_objmap.h"
+#include "test_numbers.h"
+#include "test_snapshot.h"
+#include "test_bytecode_cache.h"
+#include "test_module_cache.h"
+#include "test_parallel.h"
+#include "test_struct.h"
+#include "test_calls.h"
+#include "test_typed_array.h"
 
+#include "ape.h"
 #include "compiler.h"
 
+static void *counted_malloc(void *ctx, size_t size);
+static void counted_free(void *ctx, void *ptr);
+
 int main() {
     lexer_test();
+    builtins_test();
+    objmap_test();
+    numbers_test();
+    snapshot_test();
+    bytecode_cache_test();
+    module_cache_test();
+    parallel_test();
+    struct_test();
+    calls_test();
+    typed_array_test();
     //parser_test();
     //code_test();
     //symbol_table_test();
@@ -67,3 +91,45 @@ ptrarray(char)* get_lines(const char *code) {
     ptrarray_add(res, rest);
     return res;
 }
+
+void check_result(const char *code, const char *expected) {
+    int malloc_count = 0;
+    ape_t *ape = ape_make_ex(counted_malloc, counted_free, &malloc_count);
+    ape_execute(ape, code);
+    if (!expected) {
+        assert(ape_has_errors(ape));
+    } else {
+        if (ape_has_errors(ape)) {
+            char *err_str = ape_error_serialize(ape, ape_get_error(ape, 0));
+            fprintf(stderr, "%s\n%s\n", code, err_str);
+            ape_free_allocated(ape, err_str);
+            assert(false);
+        }
+        char *res_str = ape_object_serialize(ape, ape_get_object(ape, "res"));
+        if (!APE_STREQ(res_str, expected)) {
+            fprintf(stderr, "%s\nexpected %s, got %s\n", code, expected, res_str);
+            assert(false);
+        }
+        ape_free_allocated(ape, res_str);
+    }
+    ape_destroy(ape);
+    assert(malloc_count == 0);
+}
+
+// INTERNAL
+static void *counted_malloc(void *ctx, size_t size) {
+    int *malloc_count = (int*)ctx;
+    void *res = malloc(size);
+    if (res != NULL) {
+        (*malloc_count)++;
+    }
+    return res;
+}
+
+static void counted_free(void *ctx, void *ptr) {
+    int *malloc_count = (int*)ctx;
+    if (ptr != NULL) {
+        (*malloc_count)--;
+    }
+    free(ptr);
+}
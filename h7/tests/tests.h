@@ -6,6 +6,9 @@
 
 void print_errors(errors_t *errors);
 ptrarray(char)* get_lines(const char *code);
+// Executes code on a new instance and checks that the global res serializes to expected, a NULL expected
+// checks that executing it fails instead. Everything the instance allocated has to be freed.
+void check_result(const char *code, const char *expected);
 
 #ifdef APE_TESTS_MAIN
 int main(void);
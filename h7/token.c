@@ -67,6 +67,7 @@ static const char *g_type_names[] = {
     "NULL",
     "IMPORT",
     "RECOVER",
+    "STRUCT",
     "IDENT",
     "NUMBER",
     "STRING",
@@ -80,6 +80,7 @@ typedef enum {
     TOKEN_NULL,
     TOKEN_IMPORT,
     TOKEN_RECOVER,
+    TOKEN_STRUCT,
 
     // Identifiers and literals
     TOKEN_IDENT,
@@ -5,6 +5,8 @@
 #include "collections.h"
 #endif
 
+#define TRACEBACK_PRINTED_FRAMES 32 // at each end
+
 traceback_t* traceback_make(allocator_t *alloc) {
     traceback_t *traceback = allocator_malloc(alloc, sizeof(traceback_t));
     if (!traceback) {
@@ -61,6 +63,13 @@ bool traceback_append_from_vm(traceback_t *traceback, vm_t *vm) {
 bool traceback_to_string(const traceback_t *traceback, strbuf_t *buf) {
     int depth  = array_count(traceback->items);
     for (int i = 0; i < depth; i++) {
+        // deep recursion would print every frame, keep the outermost and innermost ones
+        if (depth > TRACEBACK_PRINTED_FRAMES * 2 && i == TRACEBACK_PRINTED_FRAMES) {
+            int omitted = depth - TRACEBACK_PRINTED_FRAMES * 2;
+            strbuf_appendf(buf, "... %d frames omitted\n", omitted);
+            i += omitted - 1;
+            continue;
+        }
         traceback_item_t *item = array_get(traceback->items, i);
         const char *filename = traceback_item_get_filepath(item);
         if (item->pos.line >= 0 && item->pos.column >= 0) {
@@ -13,7 +13,7 @@
 #include "gc.h"
 #endif
 
-static void set_sp(vm_t *vm, int new_sp);
+static bool set_sp(vm_t *vm, int new_sp);
 static void stack_push(vm_t *vm, object_t obj);
 static object_t stack_pop(vm_t *vm);
 static object_t stack_get(vm_t *vm, int nth_item);
@@ -22,6 +22,12 @@ static void this_stack_push(vm_t *vm, object_t obj);
 static object_t this_stack_pop(vm_t *vm);
 static object_t this_stack_get(vm_t *vm, int nth_item);
 
+static void* grow_buffer(vm_t *vm, void *buffer, int *capacity, int min_capacity, int max_capacity, size_t item_size);
+static bool grow_stack(vm_t *vm, int min_capacity);
+static void free_retired_stacks(vm_t *vm);
+static src_pos_t get_src_position(vm_t *vm);
+
+static bool execute_frame(vm_t *vm, frame_t new_frame, array(object_t) *constants);
 static bool push_frame(vm_t *vm, frame_t frame);
 static bool pop_frame(vm_t *vm);
 static void run_gc(vm_t *vm, array(object_t) *constants);
@@ -29,6 +35,12 @@ static bool call_object(vm_t *vm, object_t callee, int num_args);
 static object_t call_native_function(vm_t *vm, object_t callee, src_pos_t src_pos, int argc, object_t *args);
 static bool check_assign(vm_t *vm, object_t old_value, object_t new_value);
 static bool try_overload_operator(vm_t *vm, object_t left, object_t right, opcode_t op, bool *out_overload_found);
+static object_t get_operator_overload(vm_t *vm, object_t obj, opcode_t op);
+static bool construct_struct(vm_t *vm, object_t struct_type, int argc, object_t *args, object_t *out_res);
+static bool get_struct_field(vm_t *vm, object_t obj, object_t name, object_t *out_res);
+static bool set_struct_field(vm_t *vm, object_t obj, object_t name, object_t val);
+static bool fast_numeric_binary_op(opcode_t op, object_t left, object_t right, object_t *out_res);
+static bool numeric_binary_op(vm_t *vm, opcode_t op, object_t left, object_t right, object_t *out_res);
 
 vm_t *vm_make(allocator_t *alloc, const ape_config_t *config, gcmem_t *mem, errors_t *errors, global_store_t *global_store) {
     vm_t *vm = allocator_malloc(alloc, sizeof(vm_t));
@@ -47,6 +59,23 @@ vm_t *vm_make(allocator_t *alloc, const ape_config_t *config, gcmem_t *mem, erro
     vm->frames_count = 0;
     vm->last_popped = object_make_null();
     vm->running = false;
+    vm->random_state = VM_DEFAULT_RANDOM_SEED;
+
+    vm->globals_capacity = VM_INITIAL_GLOBALS;
+    vm->globals = allocator_malloc(alloc, vm->globals_capacity * sizeof(object_t));
+    vm->stack_capacity = VM_INITIAL_STACK_SIZE;
+    vm->stack = allocator_malloc(alloc, vm->stack_capacity * sizeof(object_t));
+    vm->retired_stacks = ptrarray_make(alloc);
+    vm->this_stack_capacity = VM_INITIAL_THIS_STACK_SIZE;
+    vm->this_stack = allocator_malloc(alloc, vm->this_stack_capacity * sizeof(object_t));
+    vm->frames_capacity = VM_INITIAL_FRAMES;
+    vm->frames = allocator_malloc(alloc, vm->frames_capacity * sizeof(frame_t));
+    if (!vm->globals || !vm->stack || !vm->retired_stacks || !vm->this_stack || !vm->frames) {
+        goto err;
+    }
+    memset(vm->globals, 0, vm->globals_capacity * sizeof(object_t));
+    memset(vm->stack, 0, vm->stack_capacity * sizeof(object_t));
+    memset(vm->this_stack, 0, vm->this_stack_capacity * sizeof(object_t));
 
     for (int i = 0; i < OPCODE_MAX; i++) {
         vm->operator_oveload_keys[i] = object_make_null();
@@ -83,6 +112,14 @@ void vm_destroy(vm_t *vm) {
     if (!vm) {
         return;
     }
+    if (vm->retired_stacks) {
+        free_retired_stacks(vm);
+        ptrarray_destroy(vm->retired_stacks);
+    }
+    allocator_free(vm->alloc, vm->globals);
+    allocator_free(vm->alloc, vm->stack);
+    allocator_free(vm->alloc, vm->this_stack);
+    allocator_free(vm->alloc, vm->frames);
     allocator_free(vm->alloc, vm);
 }
 
@@ -117,9 +154,17 @@ bool vm_run(vm_t *vm, compilation_result_t *comp_res, array(object_t) *constants
 object_t vm_call(vm_t *vm, array(object_t) *constants, object_t callee, int argc, object_t *args) {
     object_type_t type = object_get_type(callee);
     if (type == OBJECT_FUNCTION) {
-#ifdef APE_DEBUG
+        function_t *callee_function = object_get_function(callee);
+        if (argc != callee_function->num_args) {
+            errors_add_errorf(vm->errors, ERROR_RUNTIME, src_pos_invalid,
+                              "Invalid number of arguments to \"%s\", expected %d, got %d",
+                              object_get_function_name(callee), callee_function->num_args, argc);
+            return object_make_null();
+        }
+        if (vm->sp + argc + 1 > vm->stack_capacity && !grow_stack(vm, vm->sp + argc + 1)) {
+            return object_make_null();
+        }
         int old_sp = vm->sp;
-#endif
         int old_this_sp = vm->this_sp;
         int old_frames_count = vm->frames_count;
         stack_push(vm, callee);
@@ -127,17 +172,21 @@ object_t vm_call(vm_t *vm, array(object_t) *constants, object_t callee, int argc
             stack_push(vm, args[i]);
         }
         bool ok = vm_execute_function(vm, callee, constants);
-        if (!ok) {
-            return object_make_null();
-        }
         while (vm->frames_count > old_frames_count) {
             pop_frame(vm);
         }
-        APE_ASSERT(vm->sp == old_sp);
+        set_sp(vm, old_sp);
         vm->this_sp = old_this_sp;
+        if (!ok) {
+            return object_make_null();
+        }
         return vm_get_last_popped(vm);
     } else if (type == OBJECT_NATIVE_FUNCTION) {
         return call_native_function(vm, callee, src_pos_invalid, argc, args);
+    } else if (type == OBJECT_STRUCT_TYPE) {
+        object_t res = object_make_null();
+        construct_struct(vm, callee, argc, args, &res);
+        return res;
     } else {
         errors_add_error(vm->errors, ERROR_USER, src_pos_invalid, "Object is not callable");
         return object_make_null();
@@ -145,25 +194,90 @@ object_t vm_call(vm_t *vm, array(object_t) *constants, object_t callee, int argc
 }
 
 bool vm_execute_function(vm_t *vm, object_t function, array(object_t) *constants) {
-    if (vm->running) {
-        errors_add_error(vm->errors, ERROR_USER, src_pos_invalid, "VM is already executing code");
-        return false;
-    }
-
     function_t *function_function = object_get_function(function); // naming is hard
     frame_t new_frame;
-    bool ok = false;
-    ok = frame_init(&new_frame, function, vm->sp - function_function->num_args);
+    bool ok = frame_init(&new_frame, function, vm->sp - function_function->num_args);
     if (!ok) {
         return false;
     }
-    ok = push_frame(vm, new_frame);
+    return execute_frame(vm, new_frame, constants);
+}
+
+bool vm_prepare_call(vm_t *vm, object_t callee, int min_argc, int max_argc, vm_prepared_call_t *out_call) {
+    memset(out_call, 0, sizeof(vm_prepared_call_t));
+    out_call->callee = callee;
+    object_type_t type = object_get_type(callee);
+    if (type == OBJECT_NATIVE_FUNCTION) {
+        out_call->argc = min_argc;
+        return true;
+    } else if (type != OBJECT_FUNCTION) {
+        errors_add_errorf(vm->errors, ERROR_RUNTIME, src_pos_invalid,
+                          "%s object is not callable", object_get_type_name(type));
+        return false;
+    }
+    function_t *function = object_get_function(callee);
+    if (function->num_args < min_argc || function->num_args > max_argc) {
+        errors_add_errorf(vm->errors, ERROR_RUNTIME, src_pos_invalid,
+                          "Function \"%s\" takes %d arguments, expected %d to %d",
+                          object_get_function_name(callee), function->num_args, min_argc, max_argc);
+        return false;
+    }
+    out_call->argc = function->num_args;
+    return frame_init(&out_call->frame, callee, 0);
+}
+
+object_t vm_call_prepared(vm_t *vm, vm_prepared_call_t *call, object_t *args) {
+    if (object_get_type(call->callee) == OBJECT_NATIVE_FUNCTION) {
+        return call_native_function(vm, call->callee, src_pos_invalid, call->argc, args);
+    }
+    if (vm->sp + call->argc + 1 > vm->stack_capacity && !grow_stack(vm, vm->sp + call->argc + 1)) {
+        return object_make_null();
+    }
+    int old_sp = vm->sp;
+    int old_this_sp = vm->this_sp;
+    int old_frames_count = vm->frames_count;
+    stack_push(vm, call->callee);
+    for (int i = 0; i < call->argc; i++) {
+        stack_push(vm, args[i]);
+    }
+    call->frame.base_pointer = vm->sp - call->argc;
+    bool ok = execute_frame(vm, call->frame, vm->constants);
+    while (vm->frames_count > old_frames_count) {
+        pop_frame(vm);
+    }
+    set_sp(vm, old_sp);
+    vm->this_sp = old_this_sp;
     if (!ok) {
-        errors_add_error(vm->errors, ERROR_USER, src_pos_invalid, "Pushing frame failed");
+        return object_make_null();
+    }
+    return vm_get_last_popped(vm);
+}
+
+// INTERNAL
+static bool execute_frame(vm_t *vm, frame_t new_frame, array(object_t) *constants) {
+    // Natives can call back into the vm (e.g. sort's comparator). A nested execution
+    // returns as soon as its own frame returns and never unwinds into outer frames.
+    bool is_nested = vm->running;
+    int entry_frames_count = vm->frames_count;
+    array(object_t) *prev_constants = vm->constants;
+
+    if (is_nested && vm->nested_executions >= VM_MAX_NESTED_EXECUTIONS) {
+        errors_add_errorf(vm->errors, ERROR_RUNTIME, get_src_position(vm),
+                          "Stack overflow, nested call depth exceeds %d", VM_MAX_NESTED_EXECUTIONS);
         return false;
     }
 
+    bool ok = push_frame(vm, new_frame);
+    if (!ok) {
+        return false; // push_frame adds the error
+    }
+
+    if (is_nested) {
+        vm->nested_executions++;
+    }
+
     vm->running = true;
+    vm->constants = constants;
     vm->last_popped = object_make_null();
 
     bool check_time = false;
@@ -207,30 +321,18 @@ bool vm_execute_function(vm_t *vm, object_t function, array(object_t) *constants
             {
                 object_t right = stack_pop(vm);
                 object_t left = stack_pop(vm);
+                object_t res = object_make_null();
+                if (fast_numeric_binary_op(opcode, left, right, &res)) {
+                    stack_push(vm, res);
+                    break;
+                }
                 object_type_t left_type = object_get_type(left);
                 object_type_t right_type = object_get_type(right);
                 if (object_is_numeric(left) && object_is_numeric(right)) {
-                    double right_val = object_get_number(right);
-                    double left_val = object_get_number(left);
-
-                    int64_t left_val_int = (int64_t)left_val;
-                    int64_t right_val_int = (int64_t)right_val;
-
-                    double res = 0;
-                    switch (opcode) {
-                        case OPCODE_ADD:    res = left_val + right_val; break;
-                        case OPCODE_SUB:    res = left_val - right_val; break;
-                        case OPCODE_MUL:    res = left_val * right_val; break;
-                        case OPCODE_DIV:    res = left_val / right_val; break;
-                        case OPCODE_MOD:    res = fmod(left_val, right_val); break;
-                        case OPCODE_OR:     res = (double)(left_val_int | right_val_int); break;
-                        case OPCODE_XOR:    res = (double)(left_val_int ^ right_val_int); break;
-                        case OPCODE_AND:    res = (double)(left_val_int & right_val_int); break;
-                        case OPCODE_LSHIFT: res = (double)(left_val_int << right_val_int); break;
-                        case OPCODE_RSHIFT: res = (double)(left_val_int >> right_val_int); break;
-                        default: APE_ASSERT(false); break;
+                    if (!numeric_binary_op(vm, opcode, left, right, &res)) {
+                        goto err;
                     }
-                    stack_push(vm, object_make_number(res));
+                    stack_push(vm, res);
                 } else if (left_type == OBJECT_STRING  && right_type == OBJECT_STRING && opcode == OPCODE_ADD) {
                     int left_len = (int)object_get_string_length(left);
                     int right_len = (int)object_get_string_length(right);
@@ -341,7 +443,13 @@ bool vm_execute_function(vm_t *vm, object_t function, array(object_t) *constants
             {
                 object_t operand = stack_pop(vm);
                 object_type_t operand_type = object_get_type(operand);
-                if (operand_type == OBJECT_NUMBER) {
+                if (operand_type == OBJECT_NUMBER && object_is_int(operand) && object_get_int(operand) != INT64_MIN) {
+                    object_t res = object_make_int(vm->mem, -object_get_int(operand));
+                    if (object_is_null(res)) {
+                        goto err;
+                    }
+                    stack_push(vm, res);
+                } else if (operand_type == OBJECT_NUMBER) {
                     double val = object_get_number(operand);
                     object_t res = object_make_number(-val);
                     stack_push(vm, res);
@@ -426,7 +534,7 @@ bool vm_execute_function(vm_t *vm, object_t function, array(object_t) *constants
             }
             case OPCODE_GET_MODULE_GLOBAL: {
                 uint16_t ix = frame_read_uint16(vm->current_frame);
-                object_t global = vm->globals[ix];
+                object_t global = vm_get_global(vm, ix);
                 stack_push(vm, global);
                 break;
             }
@@ -491,10 +599,42 @@ bool vm_execute_function(vm_t *vm, object_t function, array(object_t) *constants
                 object_t left = stack_pop(vm);
                 object_type_t left_type = object_get_type(left);
                 object_type_t index_type = object_get_type(index);
+
+                if (left_type == OBJECT_ARRAY) { // most common, checked first and read without further checks
+                    if (index_type != OBJECT_NUMBER) {
+                        errors_add_errorf(vm->errors, ERROR_RUNTIME, frame_src_position(vm->current_frame),
+                                          "Cannot index %s with %s", object_get_type_name(left_type),
+                                          object_get_type_name(index_type));
+                        goto err;
+                    }
+                    int len = object_get_array_length(left);
+                    int ix = (int)object_get_number(index);
+                    if (ix < 0) {
+                        ix = len + ix;
+                    }
+                    object_t res = object_make_null();
+                    if (ix >= 0 && ix < len) {
+                        res = object_get_array_data(left)[ix];
+                    }
+                    stack_push(vm, res);
+                    break;
+                }
+
+                if (left_type == OBJECT_STRUCT) {
+                    object_t res = object_make_null();
+                    ok = get_struct_field(vm, left, index, &res);
+                    if (!ok) {
+                        goto err;
+                    }
+                    stack_push(vm, res);
+                    break;
+                }
+
                 const char *left_type_name = object_get_type_name(left_type);
                 const char *index_type_name = object_get_type_name(index_type);
 
-                if (left_type != OBJECT_ARRAY && left_type != OBJECT_MAP && left_type != OBJECT_STRING) {
+                if (left_type != OBJECT_MAP && left_type != OBJECT_STRING
+                    && left_type != OBJECT_RANGE && left_type != OBJECT_TYPED_ARRAY) {
                     errors_add_errorf(vm->errors, ERROR_RUNTIME, frame_src_position(vm->current_frame),
                                       "Type %s is not indexable", left_type_name);
                     goto err;
@@ -502,7 +642,7 @@ bool vm_execute_function(vm_t *vm, object_t function, array(object_t) *constants
 
                 object_t res = object_make_null();
 
-                if (left_type == OBJECT_ARRAY) {
+                if (left_type == OBJECT_RANGE) {
                     if (index_type != OBJECT_NUMBER) {
                         errors_add_errorf(vm->errors, ERROR_RUNTIME, frame_src_position(vm->current_frame),
                                           "Cannot index %s with %s", left_type_name, index_type_name);
@@ -510,11 +650,20 @@ bool vm_execute_function(vm_t *vm, object_t function, array(object_t) *constants
                     }
                     int ix = (int)object_get_number(index);
                     if (ix < 0) {
-                        ix = object_get_array_length(left) + ix;
+                        ix = object_get_range_length(left) + ix;
                     }
-                    if (ix >= 0 && ix < object_get_array_length(left)) {
-                        res = object_get_array_value_at(left, ix);
+                    res = object_get_range_value_at(left, ix);
+                } else if (left_type == OBJECT_TYPED_ARRAY) {
+                    if (index_type != OBJECT_NUMBER) {
+                        errors_add_errorf(vm->errors, ERROR_RUNTIME, frame_src_position(vm->current_frame),
+                                          "Cannot index %s with %s", left_type_name, index_type_name);
+                        goto err;
                     }
+                    int ix = (int)object_get_number(index);
+                    if (ix < 0) {
+                        ix = object_get_typed_array_length(left) + ix;
+                    }
+                    res = object_get_typed_array_value_at(left, ix);
                 } else if (left_type == OBJECT_MAP) {
                     res = object_get_map_value(left, index);
                 } else if (left_type == OBJECT_STRING) {
@@ -534,10 +683,23 @@ bool vm_execute_function(vm_t *vm, object_t function, array(object_t) *constants
                 object_t left = stack_pop(vm);
                 object_type_t left_type = object_get_type(left);
                 object_type_t index_type = object_get_type(index);
+
+                if (left_type == OBJECT_ARRAY && index_type == OBJECT_NUMBER) {
+                    // foreach over an array, the loop body may still have shrunk it
+                    int ix = (int)object_get_number(index);
+                    object_t res = object_make_null();
+                    if (ix >= 0 && ix < object_get_array_length(left)) {
+                        res = object_get_array_data(left)[ix];
+                    }
+                    stack_push(vm, res);
+                    break;
+                }
+
                 const char *left_type_name = object_get_type_name(left_type);
                 const char *index_type_name = object_get_type_name(index_type);
 
-                if (left_type != OBJECT_ARRAY && left_type != OBJECT_MAP && left_type != OBJECT_STRING) {
+                if (left_type != OBJECT_ARRAY && left_type != OBJECT_MAP && left_type != OBJECT_STRING
+                    && left_type != OBJECT_RANGE && left_type != OBJECT_TYPED_ARRAY && left_type != OBJECT_SET) {
                     errors_add_errorf(vm->errors, ERROR_RUNTIME, frame_src_position(vm->current_frame),
                                       "Type %s is not indexable", left_type_name);
                     goto err;
@@ -553,8 +715,14 @@ bool vm_execute_function(vm_t *vm, object_t function, array(object_t) *constants
 
                 if (left_type == OBJECT_ARRAY) {
                     res = object_get_array_value_at(left, ix);
+                } else if (left_type == OBJECT_RANGE) {
+                    res = object_get_range_value_at(left, ix);
+                } else if (left_type == OBJECT_TYPED_ARRAY) {
+                    res = object_get_typed_array_value_at(left, ix);
                 } else if (left_type == OBJECT_MAP) {
                     res = object_get_kv_pair_at(vm->mem, left, ix);
+                } else if (left_type == OBJECT_SET) {
+                    res = object_get_set_value_at(left, ix);
                 } else if (left_type == OBJECT_STRING) {
                     const char *str = object_get_string(left);
                     int left_len = object_get_string_length(left);
@@ -579,7 +747,7 @@ bool vm_execute_function(vm_t *vm, object_t function, array(object_t) *constants
             case OPCODE_RETURN_VALUE: {
                 object_t res = stack_pop(vm);
                 bool ok = pop_frame(vm);
-                if (!ok) {
+                if (!ok || vm->frames_count == entry_frames_count) {
                     goto end;
                 }
                 stack_push(vm, res);
@@ -588,7 +756,7 @@ bool vm_execute_function(vm_t *vm, object_t function, array(object_t) *constants
             case OPCODE_RETURN: {
                 bool ok = pop_frame(vm);
                 stack_push(vm, object_make_null());
-                if (!ok) {
+                if (!ok || vm->frames_count == entry_frames_count) {
                     stack_pop(vm);
                     goto end;
                 }
@@ -680,10 +848,34 @@ bool vm_execute_function(vm_t *vm, object_t function, array(object_t) *constants
                 object_t new_value = stack_pop(vm);
                 object_type_t left_type = object_get_type(left);
                 object_type_t index_type = object_get_type(index);
+
+                if (left_type == OBJECT_ARRAY && index_type == OBJECT_NUMBER) {
+                    int ix = (int)object_get_number(index);
+                    ok = object_set_array_value_at(left, ix, new_value);
+                    if (!ok) {
+                        errors_add_error(vm->errors, ERROR_RUNTIME, frame_src_position(vm->current_frame), "Setting array item failed (out of bounds?)");
+                        goto err;
+                    }
+                    break;
+                }
+
+                if (left_type == OBJECT_STRUCT) {
+                    ok = set_struct_field(vm, left, index, new_value);
+                    if (!ok) {
+                        goto err;
+                    }
+                    break;
+                }
+
                 const char *left_type_name = object_get_type_name(left_type);
                 const char *index_type_name = object_get_type_name(index_type);
 
-                if (left_type != OBJECT_ARRAY && left_type != OBJECT_MAP) {
+                if (left_type == OBJECT_RANGE) {
+                    errors_add_error(vm->errors, ERROR_RUNTIME, frame_src_position(vm->current_frame),
+                                     "Ranges are read-only, to_array makes an array with their values");
+                    goto err;
+                }
+                if (left_type != OBJECT_ARRAY && left_type != OBJECT_MAP && left_type != OBJECT_TYPED_ARRAY) {
                     errors_add_errorf(vm->errors, ERROR_RUNTIME, frame_src_position(vm->current_frame),
                                       "Type %s is not indexable", left_type_name);
                     goto err;
@@ -701,6 +893,25 @@ bool vm_execute_function(vm_t *vm, object_t function, array(object_t) *constants
                         errors_add_error(vm->errors, ERROR_RUNTIME, frame_src_position(vm->current_frame), "Setting array item failed (out of bounds?)");
                         goto err;
                     }
+                } else if (left_type == OBJECT_TYPED_ARRAY) {
+                    if (index_type != OBJECT_NUMBER) {
+                        errors_add_errorf(vm->errors, ERROR_RUNTIME, frame_src_position(vm->current_frame),
+                                          "Cannot index %s with %s", left_type_name, index_type_name);
+                        goto err;
+                    }
+                    object_type_t new_value_type = object_get_type(new_value);
+                    if (new_value_type != OBJECT_NUMBER) {
+                        errors_add_errorf(vm->errors, ERROR_RUNTIME, frame_src_position(vm->current_frame),
+                                          "Cannot store %s in %s typed array", object_get_type_name(new_value_type),
+                                          typed_array_type_get_name(object_get_typed_array_type(left)));
+                        goto err;
+                    }
+                    int ix = (int)object_get_number(index);
+                    ok = object_set_typed_array_value_at(left, ix, new_value);
+                    if (!ok) {
+                        errors_add_error(vm->errors, ERROR_RUNTIME, frame_src_position(vm->current_frame), "Setting typed array item failed (out of bounds?)");
+                        goto err;
+                    }
                 } else if (left_type == OBJECT_MAP) {
                     object_t old_value = object_get_map_value(left, index);
                     if (!check_assign(vm, old_value, new_value)) {
@@ -724,8 +935,14 @@ bool vm_execute_function(vm_t *vm, object_t function, array(object_t) *constants
                 object_type_t type = object_get_type(val);
                 if (type == OBJECT_ARRAY) {
                     len = object_get_array_length(val);
+                } else if (type == OBJECT_RANGE) {
+                    len = object_get_range_length(val);
+                } else if (type == OBJECT_TYPED_ARRAY) {
+                    len = object_get_typed_array_length(val);
                 } else if (type == OBJECT_MAP) {
                     len = object_get_map_length(val);
+                } else if (type == OBJECT_SET) {
+                    len = object_get_set_length(val);
                 } else if (type == OBJECT_STRING) {
                     len = object_get_string_length(val);
                 } else {
@@ -733,7 +950,7 @@ bool vm_execute_function(vm_t *vm, object_t function, array(object_t) *constants
                     errors_add_errorf(vm->errors, ERROR_RUNTIME, frame_src_position(vm->current_frame), "Cannot get length of %s", type_name);
                     goto err;
                 }
-                stack_push(vm, object_make_number(len));
+                stack_push(vm, object_make_int(vm->mem, len));
                 break;
             }
             case OPCODE_NUMBER: {
@@ -743,6 +960,95 @@ bool vm_execute_function(vm_t *vm, object_t function, array(object_t) *constants
                 stack_push(vm, obj);
                 break;
             }
+            case OPCODE_INT: {
+                uint64_t val = frame_read_uint64(vm->current_frame);
+                object_t obj = object_make_int(vm->mem, (int64_t)val);
+                if (object_is_null(obj)) {
+                    goto err;
+                }
+                stack_push(vm, obj);
+                break;
+            }
+            case OPCODE_STRUCT: {
+                uint8_t fields_count = frame_read_uint8(vm->current_frame);
+                uint8_t operators_count = frame_read_uint8(vm->current_frame);
+                object_t *operators = vm->stack + vm->sp - operators_count * 2;
+                object_t *field_names = operators - fields_count;
+                object_t name = field_names[-1];
+                object_t struct_type = object_make_struct_type(vm->mem, object_get_string(name), field_names, fields_count,
+                                                               operators_count > 0 ? OPCODE_MAX : 0);
+                if (object_is_null(struct_type)) {
+                    goto err;
+                }
+                for (int i = 0; i < operators_count * 2; i += 2) {
+                    object_t op_name = operators[i];
+                    int op = OPCODE_NONE;
+                    for (int j = 0; j < OPCODE_MAX; j++) {
+                        if (object_equals(vm->operator_oveload_keys[j], op_name)) {
+                            op = j;
+                            break;
+                        }
+                    }
+                    if (op == OPCODE_NONE) {
+                        errors_add_errorf(vm->errors, ERROR_RUNTIME, frame_src_position(vm->current_frame),
+                                          "Unknown operator \"%s\" in struct \"%s\"",
+                                          object_get_string(op_name), object_get_string(name));
+                        goto err;
+                    }
+                    object_set_struct_type_operator(struct_type, op, operators[i + 1]);
+                }
+                set_sp(vm, vm->sp - operators_count * 2 - fields_count - 1);
+                stack_push(vm, struct_type);
+                break;
+            }
+            case OPCODE_GET_FIELD: {
+                uint16_t constant_ix = frame_read_uint16(vm->current_frame);
+                object_t name = *(object_t*)array_get(constants, constant_ix);
+                object_t left = stack_pop(vm);
+                object_type_t left_type = object_get_type(left);
+                object_t res = object_make_null();
+                if (left_type == OBJECT_STRUCT) {
+                    ok = get_struct_field(vm, left, name, &res);
+                    if (!ok) {
+                        goto err;
+                    }
+                } else if (left_type == OBJECT_MAP) {
+                    res = object_get_map_value(left, name);
+                } else {
+                    errors_add_errorf(vm->errors, ERROR_RUNTIME, frame_src_position(vm->current_frame),
+                                      "Cannot get field \"%s\" of %s", object_get_string(name), object_get_type_name(left_type));
+                    goto err;
+                }
+                stack_push(vm, res);
+                break;
+            }
+            case OPCODE_SET_FIELD: {
+                uint16_t constant_ix = frame_read_uint16(vm->current_frame);
+                object_t name = *(object_t*)array_get(constants, constant_ix);
+                object_t left = stack_pop(vm);
+                object_t new_value = stack_pop(vm);
+                object_type_t left_type = object_get_type(left);
+                if (left_type == OBJECT_STRUCT) {
+                    ok = set_struct_field(vm, left, name, new_value);
+                    if (!ok) {
+                        goto err;
+                    }
+                } else if (left_type == OBJECT_MAP) {
+                    object_t old_value = object_get_map_value(left, name);
+                    if (!check_assign(vm, old_value, new_value)) {
+                        goto err;
+                    }
+                    ok = object_set_map_value(left, name, new_value);
+                    if (!ok) {
+                        goto err;
+                    }
+                } else {
+                    errors_add_errorf(vm->errors, ERROR_RUNTIME, frame_src_position(vm->current_frame),
+                                      "Cannot set field \"%s\" of %s", object_get_string(name), object_get_type_name(left_type));
+                    goto err;
+                }
+                break;
+            }
             case OPCODE_SET_RECOVER: {
                 uint16_t recover_ip = frame_read_uint16(vm->current_frame);
                 vm->current_frame->recover_ip = recover_ip;
@@ -771,7 +1077,7 @@ bool vm_execute_function(vm_t *vm, object_t function, array(object_t) *constants
             error_t *err = errors_get_last_error(vm->errors);
             if (err->type == ERROR_RUNTIME && errors_get_count(vm->errors) == 1) {
                 int recover_frame_ix = -1;
-                for (int i = vm->frames_count - 1; i >= 0; i--) {
+                for (int i = vm->frames_count - 1; i >= entry_frames_count; i--) {
                     frame_t *frame = &vm->frames[i];
                     if (frame->recover_ip >= 0 && !frame->is_recovering) {
                         recover_frame_ix = i;
@@ -815,17 +1121,33 @@ end:
         if (!err->traceback) {
             err->traceback = traceback_make(vm->alloc);
         }
-        if (err->traceback) {
+        if (err->traceback && is_nested) { // outer frames are appended once the error reaches them
+            for (int i = vm->frames_count - 1; i >= entry_frames_count; i--) {
+                frame_t *frame = &vm->frames[i];
+                traceback_append(err->traceback, object_get_function_name(frame->function), frame_src_position(frame));
+            }
+        } else if (err->traceback) {
             traceback_append_from_vm(err->traceback, vm);
         }
     }
 
-    run_gc(vm, constants);
+    // garbage left by a short call is collected once enough is allocated or by vm_collect_garbage
+    if (!is_nested && gc_should_sweep(vm->mem)) {
+        run_gc(vm, constants);
+    }
 
-    vm->running = false;
+    if (is_nested) {
+        vm->nested_executions--;
+    }
+    vm->running = is_nested;
+    vm->constants = prev_constants;
     return errors_get_count(vm->errors) == 0;
 }
 
+void vm_collect_garbage(vm_t *vm, array(object_t) *constants) {
+    run_gc(vm, constants);
+}
+
 object_t vm_get_last_popped(vm_t *vm) {
     return vm->last_popped;
 }
@@ -835,10 +1157,15 @@ bool vm_has_errors(vm_t *vm) {
 }
 
 bool vm_set_global(vm_t *vm, int ix, object_t val) {
-    if (ix >= VM_MAX_GLOBALS) {
-        APE_ASSERT(false);
-        errors_add_error(vm->errors, ERROR_RUNTIME, frame_src_position(vm->current_frame), "Global write out of range");
-        return false;
+    if (ix >= vm->globals_capacity) {
+        object_t *globals = grow_buffer(vm, vm->globals, &vm->globals_capacity, ix + 1, VM_MAX_GLOBALS,
+                                        sizeof(object_t));
+        if (!globals) {
+            errors_add_error(vm->errors, ERROR_RUNTIME, get_src_position(vm), "Global write out of range");
+            return false;
+        }
+        allocator_free(vm->alloc, vm->globals);
+        vm->globals = globals;
     }
     vm->globals[ix] = val;
     if (ix >= vm->globals_count) {
@@ -850,29 +1177,34 @@ bool vm_set_global(vm_t *vm, int ix, object_t val) {
 object_t vm_get_global(vm_t *vm, int ix) {
     if (ix >= VM_MAX_GLOBALS) {
         APE_ASSERT(false);
-        errors_add_error(vm->errors, ERROR_RUNTIME, frame_src_position(vm->current_frame), "Global read out of range");
+        errors_add_error(vm->errors, ERROR_RUNTIME, get_src_position(vm), "Global read out of range");
         return object_make_null();
     }
+    if (ix >= vm->globals_capacity) {
+        return object_make_number(0); // never set, same as the zeroed globals below capacity
+    }
     return vm->globals[ix];
 }
 
-// INTERNAL
-static void set_sp(vm_t *vm, int new_sp) {
+static bool set_sp(vm_t *vm, int new_sp) {
+    if (new_sp > vm->stack_capacity && !grow_stack(vm, new_sp)) {
+        return false;
+    }
     if (new_sp > vm->sp) { // to avoid gcing freed objects
         int count = new_sp - vm->sp;
         size_t bytes_count = count * sizeof(object_t);
         memset(vm->stack + vm->sp, 0, bytes_count);
     }
     vm->sp = new_sp;
+    return true;
 }
 
+// Overflow checks of pushes aren't debug only, stacks grow and scripts can go over their max size
 static void stack_push(vm_t *vm, object_t obj) {
-#ifdef APE_DEBUG
-    if (vm->sp >= VM_STACK_SIZE) {
-        APE_ASSERT(false);
-        errors_add_error(vm->errors, ERROR_RUNTIME, frame_src_position(vm->current_frame), "Stack overflow");
+    if (vm->sp >= vm->stack_capacity && !grow_stack(vm, vm->sp + 1)) {
         return;
     }
+#ifdef APE_DEBUG
     if (vm->current_frame) {
         frame_t *frame = vm->current_frame;
         function_t *current_function = object_get_function(frame->function);
@@ -907,7 +1239,7 @@ static object_t stack_pop(vm_t *vm) {
 static object_t stack_get(vm_t *vm, int nth_item) {
     int ix = vm->sp - 1 - nth_item;
 #ifdef APE_DEBUG
-    if (ix < 0 || ix >= VM_STACK_SIZE) {
+    if (ix < 0 || ix >= vm->stack_capacity) {
         errors_add_errorf(vm->errors, ERROR_RUNTIME, frame_src_position(vm->current_frame),
                                   "Invalid stack index: %d", nth_item);
         APE_ASSERT(false);
@@ -918,13 +1250,16 @@ static object_t stack_get(vm_t *vm, int nth_item) {
 }
 
 static void this_stack_push(vm_t *vm, object_t obj) {
-#ifdef APE_DEBUG
-    if (vm->this_sp >= VM_THIS_STACK_SIZE) {
-        APE_ASSERT(false);
-        errors_add_error(vm->errors, ERROR_RUNTIME, frame_src_position(vm->current_frame), "this stack overflow");
-        return;
+    if (vm->this_sp >= vm->this_stack_capacity) {
+        object_t *this_stack = grow_buffer(vm, vm->this_stack, &vm->this_stack_capacity, vm->this_sp + 1,
+                                           VM_MAX_THIS_STACK_SIZE, sizeof(object_t));
+        if (!this_stack) {
+            errors_add_error(vm->errors, ERROR_RUNTIME, get_src_position(vm), "this stack overflow");
+            return;
+        }
+        allocator_free(vm->alloc, vm->this_stack);
+        vm->this_stack = this_stack;
     }
-#endif
     vm->this_stack[vm->this_sp] = obj;
     vm->this_sp++;
 }
@@ -944,7 +1279,7 @@ static object_t this_stack_pop(vm_t *vm) {
 static object_t this_stack_get(vm_t *vm, int nth_item) {
     int ix = vm->this_sp - 1 - nth_item;
 #ifdef APE_DEBUG
-    if (ix < 0 || ix >= VM_THIS_STACK_SIZE) {
+    if (ix < 0 || ix >= vm->this_stack_capacity) {
         errors_add_errorf(vm->errors, ERROR_RUNTIME, frame_src_position(vm->current_frame),
                                    "Invalid this stack index: %d", nth_item);
         APE_ASSERT(false);
@@ -955,15 +1290,27 @@ static object_t this_stack_get(vm_t *vm, int nth_item) {
 }
 
 static bool push_frame(vm_t *vm, frame_t frame) {
-    if (vm->frames_count >= VM_MAX_FRAMES) {
-        APE_ASSERT(false);
+    if (vm->frames_count >= vm->frames_capacity) {
+        frame_t *frames = grow_buffer(vm, vm->frames, &vm->frames_capacity, vm->frames_count + 1, VM_MAX_FRAMES,
+                                      sizeof(frame_t));
+        if (!frames) {
+            errors_add_errorf(vm->errors, ERROR_RUNTIME, get_src_position(vm),
+                              "Stack overflow, call depth exceeds %d", VM_MAX_FRAMES);
+            return false;
+        }
+        if (vm->current_frame) {
+            vm->current_frame = frames + (vm->current_frame - vm->frames);
+        }
+        allocator_free(vm->alloc, vm->frames);
+        vm->frames = frames;
+    }
+    function_t *frame_function = object_get_function(frame.function);
+    if (!set_sp(vm, frame.base_pointer + frame_function->num_locals)) {
         return false;
     }
     vm->frames[vm->frames_count] = frame;
     vm->current_frame = &vm->frames[vm->frames_count];
     vm->frames_count++;
-    function_t *frame_function = object_get_function(frame.function);
-    set_sp(vm, frame.base_pointer + frame_function->num_locals);
     return true;
 }
 
@@ -983,6 +1330,62 @@ static bool pop_frame(vm_t *vm) {
     return true;
 }
 
+// Returns a copy of buffer with at least min_capacity items (new ones zeroed) and updates capacity, or NULL if
+// it can't have that many. buffer isn't freed.
+static void* grow_buffer(vm_t *vm, void *buffer, int *capacity, int min_capacity, int max_capacity, size_t item_size) {
+    if (min_capacity > max_capacity) {
+        return NULL;
+    }
+    int new_capacity = *capacity * 2;
+    if (new_capacity < min_capacity) {
+        new_capacity = min_capacity;
+    }
+    if (new_capacity > max_capacity) {
+        new_capacity = max_capacity;
+    }
+    uint8_t *new_buffer = allocator_malloc(vm->alloc, new_capacity * item_size);
+    if (!new_buffer) {
+        return NULL;
+    }
+    memcpy(new_buffer, buffer, *capacity * item_size);
+    memset(new_buffer + *capacity * item_size, 0, (new_capacity - *capacity) * item_size);
+    *capacity = new_capacity;
+    return new_buffer;
+}
+
+static bool grow_stack(vm_t *vm, int min_capacity) {
+    int capacity = vm->stack_capacity;
+    object_t *stack = grow_buffer(vm, vm->stack, &capacity, min_capacity, VM_MAX_STACK_SIZE, sizeof(object_t));
+    if (!stack) {
+        errors_add_error(vm->errors, ERROR_RUNTIME, get_src_position(vm), "Stack overflow");
+        return false;
+    }
+    if (vm->native_calls_depth > 0) {
+        // natives that are running keep their pointer to args, the old stack is freed once they return
+        if (!ptrarray_add(vm->retired_stacks, vm->stack)) {
+            allocator_free(vm->alloc, stack);
+            errors_add_error(vm->errors, ERROR_RUNTIME, get_src_position(vm), "Stack overflow");
+            return false;
+        }
+    } else {
+        allocator_free(vm->alloc, vm->stack);
+    }
+    vm->stack = stack;
+    vm->stack_capacity = capacity;
+    return true;
+}
+
+static void free_retired_stacks(vm_t *vm) {
+    for (int i = 0; i < ptrarray_count(vm->retired_stacks); i++) {
+        allocator_free(vm->alloc, ptrarray_get(vm->retired_stacks, i));
+    }
+    ptrarray_clear(vm->retired_stacks);
+}
+
+static src_pos_t get_src_position(vm_t *vm) {
+    return vm->current_frame ? frame_src_position(vm->current_frame) : src_pos_invalid;
+}
+
 static void run_gc(vm_t *vm, array(object_t) *constants) {
     gc_unmark_all(vm->mem);
     gc_mark_objects(global_store_get_object_data(vm->global_store), global_store_get_object_count(vm->global_store));
@@ -1017,8 +1420,7 @@ static bool call_object(vm_t *vm, object_t callee, int num_args) {
         }
         ok = push_frame(vm, callee_frame);
         if (!ok) {
-            errors_add_error(vm->errors, ERROR_RUNTIME, src_pos_invalid, "Pushing frame failed in call_object");
-            return false;
+            return false; // push_frame adds the error
         }
     } else if (callee_type == OBJECT_NATIVE_FUNCTION) {
         object_t *stack_pos = vm->stack + vm->sp - num_args;
@@ -1028,6 +1430,14 @@ static bool call_object(vm_t *vm, object_t callee, int num_args) {
         }
         set_sp(vm, vm->sp - num_args - 1);
         stack_push(vm, res);
+    } else if (callee_type == OBJECT_STRUCT_TYPE) {
+        object_t res = object_make_null();
+        bool ok = construct_struct(vm, callee, num_args, vm->stack + vm->sp - num_args, &res);
+        if (!ok) {
+            return false;
+        }
+        set_sp(vm, vm->sp - num_args - 1);
+        stack_push(vm, res);
     } else {
         const char *callee_type_name = object_get_type_name(callee_type);
         errors_add_errorf(vm->errors, ERROR_RUNTIME, frame_src_position(vm->current_frame),
@@ -1039,11 +1449,18 @@ static bool call_object(vm_t *vm, object_t callee, int num_args) {
 
 static object_t call_native_function(vm_t *vm, object_t callee, src_pos_t src_pos, int argc, object_t *args) {
     native_function_t *native_fun = object_get_native_function(callee);
+    vm->native_calls_depth++; // args can be on the stack, which natives calling back into the vm can grow
     object_t res = native_fun->fn(vm, native_fun->data, argc, args);
+    vm->native_calls_depth--;
+    if (vm->native_calls_depth == 0) {
+        free_retired_stacks(vm);
+    }
     if (errors_has_errors(vm->errors) && !APE_STREQ(native_fun->name, "crash")) {
         error_t *err = errors_get_last_error(vm->errors);
-        err->pos = src_pos;
-        err->traceback = traceback_make(vm->alloc);
+        if (!err->traceback) { // errors raised by code the native called back into already have one
+            err->pos = src_pos;
+            err->traceback = traceback_make(vm->alloc);
+        }
         if (err->traceback) {
             traceback_append(err->traceback, native_fun->name, src_pos_invalid);
         }
@@ -1085,7 +1502,8 @@ static bool try_overload_operator(vm_t *vm, object_t left, object_t right, opcod
     *out_overload_found = false;
     object_type_t left_type = object_get_type(left);
     object_type_t right_type = object_get_type(right);
-    if (left_type != OBJECT_MAP && right_type != OBJECT_MAP) {
+    if (left_type != OBJECT_MAP && right_type != OBJECT_MAP
+        && left_type != OBJECT_STRUCT && right_type != OBJECT_STRUCT) {
         *out_overload_found = false;
         return true;
     }
@@ -1095,15 +1513,9 @@ static bool try_overload_operator(vm_t *vm, object_t left, object_t right, opcod
         num_operands = 1;
     }
 
-    object_t key = vm->operator_oveload_keys[op];
-    object_t callee = object_make_null();
-    if (left_type == OBJECT_MAP) {
-        callee = object_get_map_value(left, key);
-    }
+    object_t callee = get_operator_overload(vm, left, op);
     if (!object_is_callable(callee)) {
-        if (right_type == OBJECT_MAP) {
-            callee = object_get_map_value(right, key);
-        }
+        callee = get_operator_overload(vm, right, op);
 
         if (!object_is_callable(callee)) {
             *out_overload_found = false;
@@ -1121,3 +1533,170 @@ static bool try_overload_operator(vm_t *vm, object_t left, object_t right, opcod
     return call_object(vm, callee, num_operands);
 }
 
+// Structs keep overloads in a table on their type, maps store them under __operator_*__ keys
+static object_t get_operator_overload(vm_t *vm, object_t obj, opcode_t op) {
+    object_type_t type = object_get_type(obj);
+    if (type == OBJECT_STRUCT) {
+        return object_get_struct_type_operator(object_get_struct_type(obj), op);
+    } else if (type == OBJECT_MAP) {
+        return object_get_map_value(obj, vm->operator_oveload_keys[op]);
+    }
+    return object_make_null();
+}
+
+static bool construct_struct(vm_t *vm, object_t struct_type, int argc, object_t *args, object_t *out_res) {
+    int fields_count = object_get_struct_type_fields_count(struct_type);
+    if (argc > fields_count) {
+        errors_add_errorf(vm->errors, ERROR_RUNTIME, frame_src_position(vm->current_frame),
+                          "Too many arguments to \"%s\", expected at most %d, got %d",
+                          object_get_struct_type_name(struct_type), fields_count, argc);
+        return false;
+    }
+    object_t res = object_make_struct(vm->mem, struct_type);
+    if (object_is_null(res)) {
+        return false;
+    }
+    object_t *fields = object_get_struct_fields(res);
+    for (int i = 0; i < argc; i++) {
+        fields[i] = args[i];
+    }
+    *out_res = res;
+    return true;
+}
+
+static bool get_struct_field(vm_t *vm, object_t obj, object_t name, object_t *out_res) {
+    object_t struct_type = object_get_struct_type(obj);
+    int ix = object_get_struct_type_field_ix(struct_type, name);
+    if (ix < 0) {
+        char *name_str = object_serialize(vm->alloc, name);
+        errors_add_errorf(vm->errors, ERROR_RUNTIME, frame_src_position(vm->current_frame),
+                          "Struct \"%s\" has no field %s", object_get_struct_type_name(struct_type),
+                          name_str ? name_str : "");
+        allocator_free(vm->alloc, name_str);
+        return false;
+    }
+    *out_res = object_get_struct_fields(obj)[ix];
+    return true;
+}
+
+static bool set_struct_field(vm_t *vm, object_t obj, object_t name, object_t val) {
+    object_t struct_type = object_get_struct_type(obj);
+    int ix = object_get_struct_type_field_ix(struct_type, name);
+    if (ix < 0) {
+        char *name_str = object_serialize(vm->alloc, name);
+        errors_add_errorf(vm->errors, ERROR_RUNTIME, frame_src_position(vm->current_frame),
+                          "Struct \"%s\" has no field %s", object_get_struct_type_name(struct_type),
+                          name_str ? name_str : "");
+        allocator_free(vm->alloc, name_str);
+        return false;
+    }
+    object_t *fields = object_get_struct_fields(obj);
+    if (!check_assign(vm, fields[ix], val)) {
+        return false;
+    }
+    fields[ix] = val;
+    return true;
+}
+
+// Common cases of numeric_binary_op on small ints and doubles without calls into object.c,
+// returns false if the operands or the result need the general path.
+static bool fast_numeric_binary_op(opcode_t op, object_t left, object_t right, object_t *out_res) {
+    if (object_is_small_int(left) && object_is_small_int(right)) {
+        int64_t left_val = object_get_small_int(left);
+        int64_t right_val = object_get_small_int(right);
+        int64_t res = 0;
+        switch (op) {
+            case OPCODE_ADD: res = left_val + right_val; break;
+            case OPCODE_SUB: res = left_val - right_val; break;
+            case OPCODE_AND: res = left_val & right_val; break;
+            case OPCODE_OR:  res = left_val | right_val; break;
+            case OPCODE_XOR: res = left_val ^ right_val; break;
+            case OPCODE_MUL: {
+                if (!ape_int64_mul(left_val, right_val, &res)) {
+                    return false;
+                }
+                break;
+            }
+            case OPCODE_MOD: {
+                if (right_val == 0) {
+                    return false;
+                }
+                res = left_val % right_val;
+                break;
+            }
+            case OPCODE_LSHIFT: res = ape_int64_lshift(left_val, right_val); break;
+            case OPCODE_RSHIFT: res = ape_int64_rshift(left_val, right_val); break;
+            default: return false;
+        }
+        if (res < OBJECT_SMALL_INT_MIN || res > OBJECT_SMALL_INT_MAX) {
+            return false;
+        }
+        *out_res = object_make_small_int(res);
+        return true;
+    } else if (object_is_double(left) && object_is_double(right)) {
+        double res = 0;
+        switch (op) {
+            case OPCODE_ADD: res = left.number + right.number; break;
+            case OPCODE_SUB: res = left.number - right.number; break;
+            case OPCODE_MUL: res = left.number * right.number; break;
+            case OPCODE_DIV: res = left.number / right.number; break;
+            default: return false;
+        }
+        *out_res = object_make_number(res);
+        return true;
+    }
+    return false;
+}
+
+// Arithmetic on ints (and bools) gives an int if the result is an exact int64, e.g. 6 / 3 but not 7 / 2,
+// otherwise it's done on doubles. Bitwise operators always work on ints, doubles are truncated first.
+static bool numeric_binary_op(vm_t *vm, opcode_t op, object_t left, object_t right, object_t *out_res) {
+    bool left_is_int = object_is_int(left) || object_get_type(left) == OBJECT_BOOL;
+    bool right_is_int = object_is_int(right) || object_get_type(right) == OBJECT_BOOL;
+    int64_t res_int = 0;
+    bool res_is_int = false;
+    if (op == OPCODE_OR || op == OPCODE_XOR || op == OPCODE_AND || op == OPCODE_LSHIFT || op == OPCODE_RSHIFT) {
+        int64_t left_val = object_get_int(left);
+        int64_t right_val = object_get_int(right);
+        switch (op) {
+            case OPCODE_OR:     res_int = left_val | right_val; break;
+            case OPCODE_XOR:    res_int = left_val ^ right_val; break;
+            case OPCODE_AND:    res_int = left_val & right_val; break;
+            case OPCODE_LSHIFT: res_int = ape_int64_lshift(left_val, right_val); break;
+            case OPCODE_RSHIFT: res_int = ape_int64_rshift(left_val, right_val); break;
+            default: APE_ASSERT(false); break;
+        }
+        res_is_int = true;
+    } else if (left_is_int && right_is_int) {
+        int64_t left_val = object_get_int(left);
+        int64_t right_val = object_get_int(right);
+        switch (op) {
+            case OPCODE_ADD: res_is_int = ape_int64_add(left_val, right_val, &res_int); break;
+            case OPCODE_SUB: res_is_int = ape_int64_sub(left_val, right_val, &res_int); break;
+            case OPCODE_MUL: res_is_int = ape_int64_mul(left_val, right_val, &res_int); break;
+            case OPCODE_DIV: res_is_int = ape_int64_div(left_val, right_val, &res_int); break;
+            case OPCODE_MOD: res_is_int = ape_int64_mod(left_val, right_val, &res_int); break;
+            default: APE_ASSERT(false); break;
+        }
+    }
+
+    if (res_is_int) {
+        *out_res = object_make_int(vm->mem, res_int);
+        return !object_is_null(*out_res);
+    }
+
+    double left_val = object_get_number(left);
+    double right_val = object_get_number(right);
+    double res = 0;
+    switch (op) {
+        case OPCODE_ADD: res = left_val + right_val; break;
+        case OPCODE_SUB: res = left_val - right_val; break;
+        case OPCODE_MUL: res = left_val * right_val; break;
+        case OPCODE_DIV: res = left_val / right_val; break;
+        case OPCODE_MOD: res = fmod(left_val, right_val); break;
+        default: APE_ASSERT(false); break;
+    }
+    *out_res = object_make_number(res);
+    return true;
+}
+
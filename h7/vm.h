@@ -11,32 +11,56 @@
 #include "global_store.h"
 #endif
 
-#define VM_STACK_SIZE 2048
-#define VM_MAX_GLOBALS 2048
-#define VM_MAX_FRAMES 2048
-#define VM_THIS_STACK_SIZE 2048
+// Stacks start small and grow when they're full up to their max size, going over it is a runtime error
+#define VM_INITIAL_STACK_SIZE 256
+#define VM_MAX_STACK_SIZE (1 << 20)
+#define VM_INITIAL_GLOBALS 64
+#define VM_MAX_GLOBALS (UINT16_MAX + 1) // global operands are 16 bit
+#define VM_INITIAL_FRAMES 32
+#define VM_MAX_FRAMES (1 << 16)
+#define VM_INITIAL_THIS_STACK_SIZE 16
+#define VM_MAX_THIS_STACK_SIZE (1 << 16)
+#define VM_MAX_NESTED_EXECUTIONS 256 // natives calling back into the vm recurse on the C stack
+#define VM_DEFAULT_RANDOM_SEED 1 // unseeded scripts are deterministic
 
 typedef struct ape_config ape_config_t;
 typedef struct compilation_result compilation_result_t;
 
+// Callee validated once so natives calling it repeatedly (map, filter, ...) can skip
+// the checks and frame setup done by vm_call.
+typedef struct vm_prepared_call {
+    object_t callee;
+    int argc;
+    frame_t frame;
+} vm_prepared_call_t;
+
 typedef struct vm {
     allocator_t *alloc;
     const ape_config_t *config;
     gcmem_t *mem;
     errors_t *errors;
     global_store_t *global_store;
-    object_t globals[VM_MAX_GLOBALS];
+    object_t *globals;
     int globals_count;
-    object_t stack[VM_STACK_SIZE];
+    int globals_capacity;
+    object_t *stack;
     int sp;
-    object_t this_stack[VM_THIS_STACK_SIZE];
+    int stack_capacity;
+    ptrarray(object_t) *retired_stacks; // stacks natives might still read args from, freed when they return
+    int native_calls_depth;
+    int nested_executions;
+    object_t *this_stack;
     int this_sp;
-    frame_t frames[VM_MAX_FRAMES];
+    int this_stack_capacity;
+    frame_t *frames;
     int frames_count;
+    int frames_capacity;
     object_t last_popped;
     frame_t *current_frame;
     bool running;
+    array(object_t) *constants; // constants of the executing program, used by natives calling back into the vm
     object_t operator_oveload_keys[OPCODE_MAX];
+    uint64_t random_state; // used by random(), set by random_seed()
 } vm_t;
 
 APE_INTERNAL vm_t* vm_make(allocator_t *alloc, const ape_config_t *config, gcmem_t *mem, errors_t *errors, global_store_t *global_store); // config can be null (for internal testing purposes)
@@ -47,6 +71,10 @@ APE_INTERNAL void vm_reset(vm_t *vm);
 APE_INTERNAL bool vm_run(vm_t *vm, compilation_result_t *comp_res, array(object_t) *constants);
 APE_INTERNAL object_t vm_call(vm_t *vm, array(object_t) *constants, object_t callee, int argc, object_t *args);
 APE_INTERNAL bool vm_execute_function(vm_t *vm, object_t function, array(object_t) *constants);
+APE_INTERNAL bool vm_prepare_call(vm_t *vm, object_t callee, int min_argc, int max_argc, vm_prepared_call_t *out_call); // natives get min_argc args
+APE_INTERNAL object_t vm_call_prepared(vm_t *vm, vm_prepared_call_t *call, object_t *args);
+
+APE_INTERNAL void vm_collect_garbage(vm_t *vm, array(object_t) *constants);
 
 APE_INTERNAL object_t vm_get_last_popped(vm_t *vm);
 APE_INTERNAL bool vm_has_errors(vm_t *vm);